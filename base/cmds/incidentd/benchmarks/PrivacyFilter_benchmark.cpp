@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "benchmark/benchmark.h"
+
+#include "FdBuffer.h"
+#include "PrivacyFilter.h"
+
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
+
+#include <string>
+
+using namespace android;
+using namespace android::os;
+using namespace android::os::incidentd;
+
+namespace {
+
+const uint8_t STRING_TYPE = 9;
+const uint8_t MESSAGE_TYPE = 11;
+
+void appendVarint(std::string* out, uint64_t value) {
+    while (value >= 0x80) {
+        out->push_back((char)(0x80 | (value & 0x7f)));
+        value >>= 7;
+    }
+    out->push_back((char)value);
+}
+
+// A dumpsys-like section: count repeated messages in field 5, each holding a varint in
+// field 1 and a 1KB string in field 2.
+std::string makeSection(int count) {
+    std::string entry;
+    entry.push_back('\x08');
+    appendVarint(&entry, 150);
+    entry.push_back('\x12');
+    appendVarint(&entry, 1024);
+    entry.append(1024, 'x');
+
+    std::string section;
+    for (int i = 0; i < count; i++) {
+        section.push_back('\x2a');
+        appendVarint(&section, entry.size());
+        section.append(entry);
+    }
+    return section;
+}
+
+class NullFilterFd : public FilterFd {
+public:
+    NullFilterFd(uint8_t privacyPolicy, int fd) : FilterFd(privacyPolicy, fd) {}
+    virtual void onWriteError(status_t) {}
+};
+
+}  // namespace
+
+// Filters a section for a LOCAL, an EXPLICIT and an AUTOMATIC output, as a report with the
+// three kinds of receivers does. The string of each message is LOCAL, so the EXPLICIT and
+// AUTOMATIC outputs need the messages re-encoded.
+static void BM_PrivacyFilterWriteData(benchmark::State& state) {
+    const std::string data = makeSection(state.range(0));
+    FdBuffer buffer;
+    buffer.write((const uint8_t*)data.data(), data.size());
+
+    Privacy nestedField2 = {2, STRING_TYPE, NULL, PRIVACY_POLICY_LOCAL, NULL};
+    Privacy* field5Children[] = {&nestedField2, NULL};
+    Privacy field5 = {5, MESSAGE_TYPE, field5Children, PRIVACY_POLICY_AUTOMATIC, NULL};
+    Privacy* sectionChildren[] = {&field5, NULL};
+    Privacy section = {3000, MESSAGE_TYPE, sectionChildren, PRIVACY_POLICY_EXPLICIT, NULL};
+
+    base::unique_fd devNull(open("/dev/null", O_WRONLY | O_CLOEXEC));
+    for (auto _ : state) {
+        PrivacyFilter filter(3000, &section);
+        filter.addFd(new NullFilterFd(PRIVACY_POLICY_LOCAL, devNull.get()));
+        filter.addFd(new NullFilterFd(PRIVACY_POLICY_EXPLICIT, devNull.get()));
+        filter.addFd(new NullFilterFd(PRIVACY_POLICY_AUTOMATIC, devNull.get()));
+        size_t maxSize;
+        filter.writeData(buffer, PRIVACY_POLICY_LOCAL, &maxSize);
+        benchmark::DoNotOptimize(maxSize);
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_PrivacyFilterWriteData)->Arg(16)->Arg(1024)->Arg(16384);
+
+BENCHMARK_MAIN();
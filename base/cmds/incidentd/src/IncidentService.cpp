@@ -24,6 +24,7 @@
 #include "incidentd_util.h"
 #include "section_list.h"
 
+#include <android-base/properties.h>
 #include <android/os/IncidentReportArgs.h>
 #include <binder/IPCThreadState.h>
 #include <binder/IResultReceiver.h>
@@ -192,7 +193,12 @@ void ReportHandler::take_report() {
         return;
     }
 
-    sp<Reporter> reporter = new Reporter(mWorkDirectory, batch, mRegisteredSections);
+    // Sections can be executed one at a time again, e.g. to tell whether running them together
+    // affects their output.
+    const size_t maxConcurrentSections = android::base::GetUintProperty<size_t>(
+            "debug.incidentd.max_concurrent_sections", DEFAULT_MAX_CONCURRENT_SECTIONS);
+    sp<Reporter> reporter = new Reporter(mWorkDirectory, batch, mRegisteredSections,
+                                         maxConcurrentSections);
 
     // Take the report, which might take a while. More requests might queue
     // up while we're doing this, and we'll handle them in their next batch.
@@ -25,6 +25,9 @@
 #include <android/util/protobuf.h>
 #include <android/util/ProtoFileReader.h>
 #include <log/log.h>
+#include <sys/uio.h>
+
+#include <algorithm>
 
 namespace android {
 namespace os {
@@ -77,168 +80,283 @@ void write_field_or_skip(ProtoOutputStream* out, const sp<ProtoReader>& in,
     }
 }
 
+// ================================================================================
 /**
- * Strip next field based on its private policy and request spec, then stores data in buf.
- * Return NO_ERROR if succeeds, otherwise BAD_VALUE is returned to indicate bad data in
- * FdBuffer.
- *
- * The iterator must point to the head of a protobuf formatted field for successful operation.
- * After exit with NO_ERROR, iterator points to the next protobuf field's head.
- *
- * depth is the depth of recursion, for debugging.
+ * A field of the section, found by tokenizing the original buffer once. Message fields
+ * whose sub-fields have their own privacy policies keep their sub-fields as children,
+ * every other field is either kept or dropped as a whole span of the original buffer.
  */
-status_t strip_field(ProtoOutputStream* out, const sp<ProtoReader>& in,
-        const Privacy* parentPolicy, const PrivacySpec& spec, int depth) {
-    if (!in->hasNext() || parentPolicy == NULL) {
-        return BAD_VALUE;
-    }
-    uint32_t fieldTag = in->readRawVarint();
-    uint32_t fieldId = read_field_id(fieldTag);
-    const Privacy* policy = lookup(parentPolicy, fieldId);
+struct FieldToken {
+    uint32_t fieldId;
+    const Privacy* policy;
+    const Privacy* parentPolicy;
+    size_t start;   // position of the field tag in the original buffer
+    size_t end;     // position right after the field in the original buffer
+    bool isMessage;
+    vector<size_t> children;
+};
 
-    if (policy == NULL || policy->children == NULL) {
-        bool skip = !spec.CheckPremission(policy, parentPolicy->policy);
-        // iterator will point to head of next field
-        size_t currentAt = in->bytesRead();
-        write_field_or_skip(out, in, fieldTag, skip);
-        return NO_ERROR;
+/**
+ * A piece of a filtered section, either a span of the original buffer or bytes
+ * encoded by the filter itself, i.e. the headers of the stripped messages.
+ */
+struct Splice {
+    bool fromData;
+    size_t offset;  // in the original buffer if fromData, in SplicedSection::headers otherwise
+    size_t size;
+};
+
+/**
+ * A section filtered to one privacy level, as a list of splices.
+ */
+struct SplicedSection {
+    vector<Splice> splices;
+    vector<uint8_t> headers;
+    size_t size = 0;
+
+    void clear() {
+        splices.clear();
+        headers.clear();
+        size = 0;
     }
-    // current field is message type and its sub-fields have extra privacy policies
-    uint32_t msgSize = in->readRawVarint();
-    size_t start = in->bytesRead();
-    uint64_t token = out->start(encode_field_id(policy));
-    while (in->bytesRead() - start != msgSize) {
-        status_t err = strip_field(out, in, policy, spec, depth + 1);
-        if (err != NO_ERROR) {
-            ALOGW("Bad value when stripping id %d, wiretype %d, tag %#x, depth %d, size %d, "
-                    "relative pos %zu, ", fieldId, read_wire_type(fieldTag), fieldTag, depth,
-                    msgSize, in->bytesRead() - start);
-            return err;
+
+    void appendData(size_t offset, size_t len) {
+        if (!splices.empty() && splices.back().fromData
+                && splices.back().offset + splices.back().size == offset) {
+            // Adjacent kept fields are written as one span.
+            splices.back().size += len;
+        } else {
+            splices.push_back({true, offset, len});
         }
     }
-    out->end(token);
-    return NO_ERROR;
-}
+};
 
 // ================================================================================
-class FieldStripper {
+class FieldTokenizer {
 public:
-    FieldStripper(const Privacy* restrictions, const sp<ProtoReader>& data,
-            uint8_t bufferLevel);
-
-    ~FieldStripper();
-
-    /**
-     * Take the data that we have, and filter it down so that no fields
-     * are more sensitive than the given privacy policy.
-     */
-    status_t strip(uint8_t privacyPolicy);
+    explicit FieldTokenizer(const Privacy* restrictions);
 
     /**
-     * At the current filter level, how many bytes of data there is.
+     * Tokenize the whole buffer. Returns BAD_VALUE if the data is not a valid protobuf.
      */
-    ssize_t dataSize() const { return mSize; }
+    status_t tokenize(const sp<ProtoReader>& data);
 
     /**
-     * Write the data from the current filter level to the file descriptor.
+     * Compute the splices of the original buffer which make up the data filtered
+     * down to the given privacy spec. The data must have been tokenized.
      */
-    status_t writeData(int fd);
+    void splice(const PrivacySpec& spec, SplicedSection* out) const;
 
 private:
+    status_t tokenizeField(const sp<ProtoReader>& in, const Privacy* parentPolicy,
+            vector<size_t>* siblings, int depth);
+    size_t spliceFields(const vector<size_t>& fields, const PrivacySpec& spec,
+            SplicedSection* out) const;
+
     /**
      * The global set of field --> required privacy level mapping.
      */
     const Privacy* mRestrictions;
 
-    /**
-     * The current buffer.
-     */
-    sp<ProtoReader> mData;
+    vector<FieldToken> mTokens;
+    vector<size_t> mTopLevel;
+};
 
-    /**
-     * The current size of the buffer inside mData.
-     */
-    ssize_t mSize;
+FieldTokenizer::FieldTokenizer(const Privacy* restrictions)
+        :mRestrictions(restrictions),
+         mTokens(),
+         mTopLevel() {
+}
 
-    /**
-     * The current privacy policy that the data is filtered to, as an optimization
-     * so we don't always re-filter data that has already been filtered.
-     */
-    uint8_t mCurrentLevel;
+status_t FieldTokenizer::tokenize(const sp<ProtoReader>& data) {
+    mTokens.clear();
+    mTopLevel.clear();
+    while (data->hasNext()) {
+        status_t err = tokenizeField(data, mRestrictions, &mTopLevel, 0);
+        if (err != NO_ERROR) {
+            return err; // Error logged in tokenizeField.
+        }
+    }
+    if (data->bytesRead() != (size_t)data->size()) {
+        ALOGW("Buffer corrupted: expect %zu bytes, read %zu bytes", data->size(),
+                data->bytesRead());
+        return BAD_VALUE;
+    }
+    return NO_ERROR;
+}
 
-    sp<EncodedBuffer> mEncodedBuffer;
-};
+/**
+ * Tokenize the next field based on its private policy. Return NO_ERROR if succeeds,
+ * otherwise BAD_VALUE is returned to indicate bad data in FdBuffer.
+ *
+ * The iterator must point to the head of a protobuf formatted field for successful operation.
+ * After exit with NO_ERROR, iterator points to the next protobuf field's head.
+ *
+ * depth is the depth of recursion, for debugging.
+ */
+status_t FieldTokenizer::tokenizeField(const sp<ProtoReader>& in, const Privacy* parentPolicy,
+        vector<size_t>* siblings, int depth) {
+    if (!in->hasNext() || parentPolicy == NULL) {
+        return BAD_VALUE;
+    }
+    size_t start = in->bytesRead();
+    uint32_t fieldTag = in->readRawVarint();
+    uint32_t fieldId = read_field_id(fieldTag);
+    const Privacy* policy = lookup(parentPolicy, fieldId);
 
-FieldStripper::FieldStripper(const Privacy* restrictions, const sp<ProtoReader>& data,
-            uint8_t bufferLevel)
-        :mRestrictions(restrictions),
-         mData(data),
-         mSize(data->size()),
-         mCurrentLevel(bufferLevel),
-         mEncodedBuffer(get_buffer_from_pool()) {
-    if (mSize < 0) {
-        ALOGW("FieldStripper constructed with a ProtoReader that doesn't support size."
-                " Data will be missing.");
+    siblings->push_back(mTokens.size());
+    mTokens.push_back({fieldId, policy, parentPolicy, start, 0, false, {}});
+    const size_t index = mTokens.size() - 1;
+
+    if (policy == NULL || policy->children == NULL) {
+        // iterator will point to head of next field
+        write_field_or_skip(NULL, in, fieldTag, true);
+        mTokens[index].end = in->bytesRead();
+        return NO_ERROR;
+    }
+    // current field is message type and its sub-fields have extra privacy policies
+    uint32_t msgSize = in->readRawVarint();
+    size_t msgStart = in->bytesRead();
+    vector<size_t> children;
+    while (in->bytesRead() - msgStart != msgSize) {
+        status_t err = tokenizeField(in, policy, &children, depth + 1);
+        if (err != NO_ERROR) {
+            ALOGW("Bad value when tokenizing id %d, wiretype %d, tag %#x, depth %d, size %d, "
+                    "relative pos %zu, ", fieldId, read_wire_type(fieldTag), fieldTag, depth,
+                    msgSize, in->bytesRead() - msgStart);
+            return err;
+        }
     }
+    mTokens[index].end = in->bytesRead();
+    mTokens[index].isMessage = true;
+    mTokens[index].children = std::move(children);
+    return NO_ERROR;
 }
 
-FieldStripper::~FieldStripper() {
-    return_buffer_to_pool(mEncodedBuffer);
+void FieldTokenizer::splice(const PrivacySpec& spec, SplicedSection* out) const {
+    out->clear();
+    out->size = spliceFields(mTopLevel, spec, out);
 }
 
-status_t FieldStripper::strip(const uint8_t privacyPolicy) {
-    // If the current strip level is less (fewer fields retained) than what's already in the
-    // buffer, then we can skip it.
-    if (mCurrentLevel < privacyPolicy) {
-        PrivacySpec spec(privacyPolicy);
-        mEncodedBuffer->clear();
-        ProtoOutputStream proto(mEncodedBuffer);
-
-        // Optimization when no strip happens.
-        if (mRestrictions == NULL || spec.RequireAll()) {
-            if (spec.CheckPremission(mRestrictions)) {
-                mSize = mData->size();
+/**
+ * Append the splices of the given fields that are allowed by the spec. Return the number
+ * of bytes they amount to.
+ */
+size_t FieldTokenizer::spliceFields(const vector<size_t>& fields, const PrivacySpec& spec,
+        SplicedSection* out) const {
+    size_t size = 0;
+    for (size_t index : fields) {
+        const FieldToken& token = mTokens[index];
+        if (!token.isMessage) {
+            if (spec.CheckPremission(token.policy, token.parentPolicy->policy)) {
+                out->appendData(token.start, token.end - token.start);
+                size += token.end - token.start;
             }
-            return NO_ERROR;
+            continue;
         }
 
-        while (mData->hasNext()) {
-            status_t err = strip_field(&proto, mData, mRestrictions, spec, 0);
-            if (err != NO_ERROR) {
-                return err; // Error logged in strip_field.
-            }
+        // The message header depends on the size of the retained sub-fields, so it is
+        // filled in once they are known.
+        const size_t headerSplice = out->splices.size();
+        out->splices.push_back({false, 0, 0});
+        size_t childrenSize = spliceFields(token.children, spec, out);
+        if (childrenSize == 0) {
+            // Like ProtoOutputStream, empty messages are not written at all.
+            out->splices.resize(headerSplice);
+            continue;
         }
+        uint8_t buf[20];
+        uint8_t* p = write_length_delimited_tag_header(buf, token.fieldId, childrenSize);
+        out->splices[headerSplice] = {false, out->headers.size(), (size_t)(p - buf)};
+        out->headers.insert(out->headers.end(), buf, p);
+        size += (p - buf) + childrenSize;
+    }
+    return size;
+}
 
-        if (mData->bytesRead() != mData->size()) {
-            ALOGW("Buffer corrupted: expect %zu bytes, read %zu bytes", mData->size(),
-                    mData->bytesRead());
-            return BAD_VALUE;
+// ================================================================================
+/**
+ * Write all the iovecs, resuming after partial writes. Return false and set errno on error.
+ */
+static bool writev_fully(int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t n = TEMP_FAILURE_RETRY(writev(fd, iov, count));
+        if (n < 0) {
+            return false;
+        }
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t*)iov->iov_base + n;
+            iov->iov_len -= n;
         }
-
-        mData = proto.data();
-        mSize = proto.size();
-        mCurrentLevel = privacyPolicy;
     }
-    return NO_ERROR;
+    return true;
 }
 
-status_t FieldStripper::writeData(int fd) {
-    status_t err = NO_ERROR;
-    sp<ProtoReader> reader = mData;
-    if (mData == nullptr) {
-        // There had been an error processing the data. We won't write anything,
-        // but we also won't return an error, because errors are fatal.
-        return NO_ERROR;
+/**
+ * Write the section header followed by the spliced section to the file descriptor. The
+ * retained fields are gathered straight from the chunks of the original buffer, so the
+ * data is never copied, and small sections go out in a single writev.
+ */
+static status_t write_spliced_section(int fd, int sectionId, const sp<EncodedBuffer>& data,
+        const SplicedSection& section) {
+    // Check the splices against the buffer before anything is written, so that a bad
+    // splice can't leave a section header without its data in the report.
+    for (const Splice& splice : section.splices) {
+        if (splice.fromData && splice.offset + splice.size > data->size()) {
+            ALOGW("Splice [%zu, %zu) is out of the %zu bytes of section %d", splice.offset,
+                    splice.offset + splice.size, data->size(), sectionId);
+            return NOT_ENOUGH_DATA;
+        }
     }
-    while (reader->readBuffer() != NULL) {
-        err = WriteFully(fd, reader->readBuffer(), reader->currentToRead()) ? NO_ERROR : -errno;
-        reader->move(reader->currentToRead());
-        if (err != NO_ERROR) return err;
+
+    const int MAX_IOVECS = 64;
+    struct iovec iov[MAX_IOVECS];
+    int count = 0;
+
+    uint8_t header[20];
+    uint8_t* p = write_length_delimited_tag_header(header, sectionId, section.size);
+    iov[count++] = {header, (size_t)(p - header)};
+
+    sp<ProtoReader> reader = data->read();
+    for (const Splice& splice : section.splices) {
+        if (!splice.fromData) {
+            if (count == MAX_IOVECS) {
+                if (!writev_fully(fd, iov, count)) return -errno;
+                count = 0;
+            }
+            iov[count++] = {const_cast<uint8_t*>(section.headers.data() + splice.offset),
+                    splice.size};
+            continue;
+        }
+        // Splices of the original buffer are in increasing order.
+        reader->move(splice.offset - reader->bytesRead());
+        size_t remaining = splice.size;
+        while (remaining > 0) {
+            const uint8_t* buf = reader->readBuffer();
+            if (buf == NULL) {
+                return NOT_ENOUGH_DATA;
+            }
+            size_t amt = std::min(reader->currentToRead(), remaining);
+            if (count == MAX_IOVECS) {
+                if (!writev_fully(fd, iov, count)) return -errno;
+                count = 0;
+            }
+            iov[count++] = {const_cast<uint8_t*>(buf), amt};
+            reader->move(amt);
+            remaining -= amt;
+        }
+    }
+    if (count > 0 && !writev_fully(fd, iov, count)) {
+        return -errno;
     }
     return NO_ERROR;
 }
 
-
 // ================================================================================
 FilterFd::FilterFd(uint8_t privacyPolicy, int fd)
         :mPrivacyPolicy(privacyPolicy),
@@ -277,30 +395,41 @@ status_t PrivacyFilter::writeData(const FdBuffer& buffer, uint8_t bufferLevel,
             return a->getPrivacyPolicy() < b->getPrivacyPolicy();
         });
 
+    // The data is tokenized at most once, and each privacy level is then described as
+    // splices of the original buffer, so the retained fields are never copied.
+    sp<EncodedBuffer> data = buffer.data();
+    FieldTokenizer tokenizer(mRestrictions);
+    bool tokenized = false;
+    SplicedSection section;
+    section.appendData(0, buffer.size());
+    section.size = buffer.size();
+
     uint8_t privacyPolicy = PRIVACY_POLICY_LOCAL; // a.k.a. no filtering
-    FieldStripper fieldStripper(mRestrictions, buffer.data()->read(), bufferLevel);
     for (const sp<FilterFd>& output: mOutputs) {
         // Do another level of filtering if necessary
         if (privacyPolicy != output->getPrivacyPolicy()) {
             privacyPolicy = output->getPrivacyPolicy();
-            err = fieldStripper.strip(privacyPolicy);
-            if (err != NO_ERROR) {
-                // We can't successfully strip this data.  We will skip
-                // the rest of this section.
-                return NO_ERROR;
+            PrivacySpec spec(privacyPolicy);
+            // If the buffer is already filtered to this level, or nothing has to be
+            // stripped, keep what we have.
+            if (bufferLevel < privacyPolicy && mRestrictions != NULL && !spec.RequireAll()) {
+                if (!tokenized) {
+                    err = tokenizer.tokenize(data->read());
+                    if (err != NO_ERROR) {
+                        // We can't successfully strip this data.  We will skip
+                        // the rest of this section.
+                        return NO_ERROR;
+                    }
+                    tokenized = true;
+                }
+                tokenizer.splice(spec, &section);
             }
         }
 
-        // Write the resultant buffer to the fd, along with the header.
-        ssize_t dataSize = fieldStripper.dataSize();
+        // Write the resultant splices to the fd, along with the header.
+        size_t dataSize = section.size;
         if (dataSize > 0) {
-            err = write_section_header(output->getFd(), mSectionId, dataSize);
-            if (err != NO_ERROR) {
-                output->onWriteError(err);
-                continue;
-            }
-
-            err = fieldStripper.writeData(output->getFd());
+            err = write_spliced_section(output->getFd(), mSectionId, data, section);
             if (err != NO_ERROR) {
                 output->onWriteError(err);
                 continue;
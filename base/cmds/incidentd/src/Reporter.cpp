@@ -32,13 +32,16 @@
 #include <private/android_filesystem_config.h>
 #include <utils/SystemClock.h>
 
+#include <condition_variable>
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <mutex>
 #include <sys/prctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <string>
+#include <thread>
 #include <time.h>
 #include <wait.h>
 
@@ -385,7 +388,19 @@ void ReportBatch::removeRequest(const sp<ReportRequest>& request) {
 ReportWriter::ReportWriter(const sp<ReportBatch>& batch)
         :mBatch(batch),
          mPersistedFile(),
-         mMaxPersistedPrivacyPolicy(PRIVACY_POLICY_UNSET) {
+         mMaxPersistedPrivacyPolicy(PRIVACY_POLICY_UNSET),
+         mSectionFinishTimeMs(-1),
+         mDeferred(false) {
+}
+
+ReportWriter::ReportWriter(int sectionId)
+        :mBatch(),
+         mPersistedFile(),
+         mMaxPersistedPrivacyPolicy(PRIVACY_POLICY_UNSET),
+         mSectionFinishTimeMs(-1),
+         mDeferred(true),
+         mMaxSectionDataFilteredSize(0) {
+    startSection(sectionId);
 }
 
 ReportWriter::~ReportWriter() {
@@ -402,6 +417,7 @@ void ReportWriter::setMaxPersistedPrivacyPolicy(uint8_t privacyPolicy) {
 void ReportWriter::startSection(int sectionId) {
     mCurrentSectionId = sectionId;
     mSectionStartTimeMs = uptimeMillis();
+    mSectionFinishTimeMs = -1;
 
     mSectionStatsCalledForSectionId = -1;
     mDumpSizeBytes = 0;
@@ -423,7 +439,7 @@ void ReportWriter::setSectionStats(const FdBuffer& buffer) {
 }
 
 void ReportWriter::endSection(IncidentMetadata::SectionStats* sectionMetadata) {
-    long endTime = uptimeMillis();
+    long endTime = mSectionFinishTimeMs >= 0 ? mSectionFinishTimeMs : uptimeMillis();
 
     if (mSectionStatsCalledForSectionId != mCurrentSectionId) {
         ALOGW("setSectionStats not called for section %d", mCurrentSectionId);
@@ -493,6 +509,12 @@ void ReportWriter::vflog(const Section* section, status_t err, int level, const
 
 // Reads data from FdBuffer and writes it to the requests file descriptor.
 status_t ReportWriter::writeSection(const FdBuffer& buffer) {
+    if (mDeferred) {
+        // The section's buffer goes back to the pool once Execute returns, so keep a copy.
+        mDeferredBuffer = make_unique<FdBuffer>();
+        return mDeferredBuffer->write(buffer.data()->read());
+    }
+
     PrivacyFilter filter(mCurrentSectionId, get_privacy_of_section(mCurrentSectionId));
 
     // Add the fd for the persisted requests
@@ -514,15 +536,39 @@ status_t ReportWriter::writeSection(const FdBuffer& buffer) {
     return filter.writeData(buffer, PRIVACY_POLICY_LOCAL, &mMaxSectionDataFilteredSize);
 }
 
+void ReportWriter::finishDeferredSection() {
+    mSectionFinishTimeMs = uptimeMillis();
+}
+
+status_t ReportWriter::writeDeferredSection(const ReportWriter& deferred) {
+    mSectionStartTimeMs = deferred.mSectionStartTimeMs;
+    mSectionFinishTimeMs = deferred.mSectionFinishTimeMs;
+    mSectionStatsCalledForSectionId = deferred.mSectionStatsCalledForSectionId;
+    mDumpSizeBytes = deferred.mDumpSizeBytes;
+    mDumpDurationMs = deferred.mDumpDurationMs;
+    mSectionTimedOut = deferred.mSectionTimedOut;
+    mSectionTruncated = deferred.mSectionTruncated;
+    mSectionBufferSuccess = deferred.mSectionBufferSuccess;
+    mHadError = deferred.mHadError;
+    mSectionErrors = deferred.mSectionErrors;
+
+    if (deferred.mDeferredBuffer == nullptr) {
+        return NO_ERROR;
+    }
+    return writeSection(*deferred.mDeferredBuffer);
+}
+
 
 // ================================================================================
 Reporter::Reporter(const sp<WorkDirectory>& workDirectory,
                    const sp<ReportBatch>& batch,
-                   const vector<BringYourOwnSection*>& registeredSections)
+                   const vector<BringYourOwnSection*>& registeredSections,
+                   size_t maxConcurrentSections)
         :mWorkDirectory(workDirectory),
          mWriter(batch),
          mBatch(batch),
-         mRegisteredSections(registeredSections) {
+         mRegisteredSections(registeredSections),
+         mMaxConcurrentSections(maxConcurrentSections) {
 }
 
 Reporter::~Reporter() {
@@ -635,19 +681,26 @@ void Reporter::runReport(size_t* reportByteSize) {
 
     // For each of the report fields, see if we need it, and if so, execute the command
     // and report to those that care that we're doing it.
-    for (const Section** section = SECTION_LIST; *section; section++) {
-        if (execute_section(*section, &metadata, reportByteSize) != NO_ERROR) {
-            goto DONE;
+    {
+        vector<const Section*> sections;
+        for (const Section** section = SECTION_LIST; *section; section++) {
+            sections.push_back(*section);
+        }
+        for (const Section* section : mRegisteredSections) {
+            sections.push_back(section);
         }
-    }
 
-    for (const Section* section : mRegisteredSections) {
-        if (execute_section(section, &metadata, reportByteSize) != NO_ERROR) {
-            goto DONE;
+        if (mMaxConcurrentSections > 1) {
+            execute_sections_concurrently(sections, &metadata, reportByteSize);
+        } else {
+            for (const Section* section : sections) {
+                if (execute_section(section, &metadata, reportByteSize) != NO_ERROR) {
+                    break;
+                }
+            }
         }
     }
 
-DONE:
     // Finish up the persisted file.
     if (mPersistedFile != nullptr) {
         mPersistedFile->closeDataFile();
@@ -725,6 +778,121 @@ status_t Reporter::execute_section(const Section* section, IncidentMetadata* met
     status_t err = section->Execute(&mWriter);
     mWriter.endSection(sectionMetadata);
 
+    return finish_section(section, err, sectionMetadata, reportByteSize);
+}
+
+status_t Reporter::execute_sections_concurrently(const vector<const Section*>& allSections,
+        IncidentMetadata* metadata, size_t* reportByteSize) {
+    // If nobody wants a section, skip it.
+    vector<const Section*> sections;
+    for (const Section* section : allSections) {
+        if (mBatch->containsSection(section->id)) {
+            sections.push_back(section);
+        }
+    }
+
+    // The sections are executed on the worker threads, each into its own deferred ReportWriter.
+    // This thread writes them in the original order, which keeps the privacy filtering, the
+    // batch and the listener callbacks on a single thread. At most twice as many sections as
+    // there are workers run ahead of the one being written, which bounds the memory held by the
+    // buffered outputs.
+    const size_t maxPendingSections = 2 * mMaxConcurrentSections;
+    std::mutex lock;
+    std::condition_variable cond;
+    size_t nextToStart = 0;
+    size_t nextToWrite = 0;
+    bool cancelled = false;
+    vector<unique_ptr<ReportWriter>> writers(sections.size());
+    vector<status_t> errors(sections.size(), NO_ERROR);
+
+    auto worker = [&]() {
+        std::unique_lock<std::mutex> guard(lock);
+        while (true) {
+            cond.wait(guard, [&]() {
+                return cancelled || nextToStart >= sections.size()
+                        || nextToStart < nextToWrite + maxPendingSections;
+            });
+            if (cancelled || nextToStart >= sections.size()) {
+                return;
+            }
+            const size_t index = nextToStart++;
+            guard.unlock();
+
+            const Section* section = sections[index];
+            ALOGD("Start incident report section %d '%s'", section->id, section->name.string());
+            unique_ptr<ReportWriter> writer = make_unique<ReportWriter>(section->id);
+            status_t err = section->Execute(writer.get());
+            writer->finishDeferredSection();
+
+            guard.lock();
+            writers[index] = std::move(writer);
+            errors[index] = err;
+            cond.notify_all();
+        }
+    };
+
+    vector<std::thread> threads;
+    for (size_t i = 0; i < std::min(mMaxConcurrentSections, sections.size()); i++) {
+        threads.emplace_back(worker);
+    }
+
+    status_t err = NO_ERROR;
+    for (size_t index = 0; index < sections.size(); index++) {
+        unique_ptr<ReportWriter> deferred;
+        status_t sectionErr;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            cond.wait(guard, [&]() { return writers[index] != nullptr; });
+            deferred = std::move(writers[index]);
+            sectionErr = errors[index];
+            nextToWrite = index + 1;
+            cond.notify_all();
+        }
+
+        const Section* section = sections[index];
+        const int sectionId = section->id;
+        // The requests which wanted it may have failed in the meantime.
+        if (!mBatch->containsSection(sectionId)) {
+            continue;
+        }
+        IncidentMetadata::SectionStats* sectionMetadata = metadata->add_sections();
+
+        // The section already ran, but listeners are only told about it now, when its data
+        // gets written.
+        mBatch->forEachListener(sectionId, [sectionId](const auto& listener) {
+            listener->onReportSectionStatus(
+                    sectionId, IIncidentReportStatusListener::STATUS_STARTING);
+        });
+
+        mWriter.startSection(sectionId);
+        status_t writeErr = mWriter.writeDeferredSection(*deferred);
+        mWriter.endSection(sectionMetadata);
+        if (sectionErr == NO_ERROR) {
+            sectionErr = writeErr;
+        }
+
+        err = finish_section(section, sectionErr, sectionMetadata, reportByteSize);
+        if (err != NO_ERROR) {
+            break;
+        }
+    }
+
+    // Stop the workers. The sections they are running are bounded by their own timeouts.
+    {
+        std::scoped_lock<std::mutex> guard(lock);
+        cancelled = true;
+        cond.notify_all();
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return err;
+}
+
+status_t Reporter::finish_section(const Section* section, status_t err,
+        IncidentMetadata::SectionStats* sectionMetadata, size_t* reportByteSize) {
+    const int sectionId = section->id;
+
     // Sections returning errors are fatal. Most errors should not be fatal.
     if (err != NO_ERROR) {
         mWriter.error(section, err, "Section failed. Stopping report.");
@@ -27,6 +27,7 @@
 #include <android/util/protobuf.h>
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -44,6 +45,10 @@ using namespace android::os;
 class BringYourOwnSection;
 class Section;
 
+// Default number of sections a Reporter executes at the same time. Each of them mostly waits on
+// another process (a dumpsys, a command, incident_helper), so they overlap well.
+const size_t DEFAULT_MAX_CONCURRENT_SECTIONS = 4;
+
 // ================================================================================
 class ReportRequest : public virtual RefBase {
 public:
@@ -192,6 +197,14 @@ private:
 class ReportWriter {
 public:
     ReportWriter(const sp<ReportBatch>& batch);
+
+    /**
+     * Creates a writer that captures the output of a single section instead of
+     * writing it, so the section can be executed on a worker thread. The captured
+     * data, stats and errors are written later with writeDeferredSection().
+     */
+    explicit ReportWriter(int sectionId);
+
     ~ReportWriter();
 
     void setPersistedFile(sp<ReportFile> file);
@@ -207,6 +220,18 @@ public:
 
     status_t writeSection(const FdBuffer& buffer);
 
+    /**
+     * Marks the end of the execution of a deferred section, so its duration
+     * doesn't include the time it waited to be written.
+     */
+    void finishDeferredSection();
+
+    /**
+     * Writes the data, stats and errors captured by a deferred writer as the
+     * current section.
+     */
+    status_t writeDeferredSection(const ReportWriter& deferred);
+
 private:
     // Data about all requests
     sp<ReportBatch> mBatch;
@@ -232,6 +257,22 @@ private:
      */
     int64_t mSectionStartTimeMs;
 
+    /**
+     * The time that the current section finished executing, or -1 if it is
+     * being executed right now. Only set for deferred sections.
+     */
+    int64_t mSectionFinishTimeMs;
+
+    /**
+     * Whether this writer captures a single section for writeDeferredSection().
+     */
+    bool mDeferred;
+
+    /**
+     * The data written by the deferred section, if any.
+     */
+    unique_ptr<FdBuffer> mDeferredBuffer;
+
     /**
      * The last section that setSectionStats was called for, so if someone misses
      * it we can log that.
@@ -258,9 +299,12 @@ private:
 // ================================================================================
 class Reporter : public virtual RefBase {
 public:
+    // Up to maxConcurrentSections sections are executed at the same time. With 0 or 1, they are
+    // executed one after another on the thread running the report.
     Reporter(const sp<WorkDirectory>& workDirectory,
              const sp<ReportBatch>& batch,
-             const vector<BringYourOwnSection*>& registeredSections);
+             const vector<BringYourOwnSection*>& registeredSections,
+             size_t maxConcurrentSections = DEFAULT_MAX_CONCURRENT_SECTIONS);
 
     virtual ~Reporter();
 
@@ -273,10 +317,17 @@ private:
     sp<ReportBatch> mBatch;
     sp<ReportFile> mPersistedFile;
     const vector<BringYourOwnSection*>& mRegisteredSections;
+    const size_t mMaxConcurrentSections;
 
     status_t execute_section(const Section* section, IncidentMetadata* metadata,
         size_t* reportByteSize);
 
+    status_t execute_sections_concurrently(const vector<const Section*>& sections,
+        IncidentMetadata* metadata, size_t* reportByteSize);
+
+    status_t finish_section(const Section* section, status_t err,
+        IncidentMetadata::SectionStats* sectionMetadata, size_t* reportByteSize);
+
     void cancel_and_remove_failed_requests();
 };
 
@@ -21,6 +21,7 @@
 #include <dirent.h>
 #include <errno.h>
 #include <mutex>
+#include <optional>
 #include <set>
 #include <thread>
 
@@ -523,6 +524,7 @@ status_t TextDumpsysSection::Execute(ReportWriter* writer) const {
 // ================================================================================
 // initialization only once in Section.cpp.
 map<log_id_t, log_time> LogSection::gLastLogsRetrieved;
+mutex LogSection::gLastLogsRetrievedLock;
 
 LogSection::LogSection(int id, const char* logID, ...) : WorkerThreadSection(id), mLogMode(logModeBase) {
     name = "logcat -b ";
@@ -575,6 +577,17 @@ static inline int32_t get4LE(uint8_t const* src) {
 }
 
 status_t LogSection::BlockingCall(unique_fd& pipeWriteFd) const {
+    // Sections run concurrently, so look up the last retrieved time before forking: the child
+    // must not take a lock another thread may have held when it was forked.
+    optional<log_time> lastLogRetrieved;
+    {
+        lock_guard<mutex> lock(gLastLogsRetrievedLock);
+        auto it = gLastLogsRetrieved.find(mLogID);
+        if (it != gLastLogsRetrieved.end()) {
+            lastLogRetrieved = it->second;
+        }
+    }
+
     // heap profile shows that liblog malloc & free significant amount of memory in this process.
     // Hence forking a new process to prevent memory fragmentation.
     pid_t pid = fork();
@@ -587,9 +600,9 @@ status_t LogSection::BlockingCall(unique_fd& pipeWriteFd) const {
     }
     // Open log buffer and getting logs since last retrieved time if any.
     unique_ptr<logger_list, void (*)(logger_list*)> loggers(
-            gLastLogsRetrieved.find(mLogID) == gLastLogsRetrieved.end()
+            !lastLogRetrieved
                     ? android_logger_list_alloc(mLogMode, 0, 0)
-                    : android_logger_list_alloc_time(mLogMode, gLastLogsRetrieved[mLogID], 0),
+                    : android_logger_list_alloc_time(mLogMode, *lastLogRetrieved, 0),
             android_logger_list_free);
 
     if (android_logger_open(loggers.get(), mLogID) == NULL) {
@@ -709,6 +722,8 @@ status_t LogSection::BlockingCall(unique_fd& pipeWriteFd) const {
         }
         proto.clear();
     }
+    // This is the child's own copy of the map, and the child runs a single thread, so it doesn't
+    // take the lock.
     gLastLogsRetrieved[mLogID] = lastTimestamp;
     _exit(err);
 }
@@ -22,6 +22,7 @@
 
 #include <stdarg.h>
 #include <map>
+#include <mutex>
 
 #include <android/os/IIncidentDumpCallback.h>
 #include <log/log_read.h>
@@ -163,6 +164,8 @@ private:
 class LogSection : public WorkerThreadSection {
     // global last log retrieved timestamp for each log_id_t.
     static map<log_id_t, log_time> gLastLogsRetrieved;
+    // Guards gLastLogsRetrieved, as LogSections may be executed concurrently.
+    static mutex gLastLogsRetrievedLock;
 
     // log mode: non blocking.
     const static int logModeBase = ANDROID_LOG_NONBLOCK;
@@ -24,6 +24,9 @@
 #include <gtest/gtest.h>
 #include <string.h>
 
+#include <memory>
+#include <vector>
+
 using namespace android;
 using namespace android::base;
 using namespace android::os;
@@ -300,3 +303,133 @@ TEST_F(PrivacyFilterTest, AutoMessage) {
 }
 
 #endif
+
+const int SECTION_ID = 1;
+
+// The section header PrivacyFilter writes in front of the data.
+std::string withSectionHeader(const std::string& data) {
+    return "\x0a" + std::string(1, (char)data.size()) + data;
+}
+
+class TestFilterFd : public FilterFd {
+public:
+    TestFilterFd(uint8_t privacyPolicy, int fd)
+            :FilterFd(privacyPolicy, fd),
+             mError(NO_ERROR) {
+    }
+
+    virtual void onWriteError(status_t err) { mError = err; }
+    status_t getError() const { return mError; }
+
+private:
+    status_t mError;
+};
+
+class PrivacyFilterWriteTest : public Test {
+public:
+    void writeToFdBuffer(const std::string& str) {
+        ASSERT_EQ(NO_ERROR, buffer.write((const uint8_t*)str.data(), str.size()));
+        ASSERT_EQ(str.size(), buffer.size());
+    }
+
+    sp<TestFilterFd> addOutput(PrivacyFilter* filter, uint8_t privacyPolicy) {
+        files.emplace_back(new TemporaryFile());
+        sp<TestFilterFd> output = new TestFilterFd(privacyPolicy, files.back()->fd);
+        filter->addFd(output);
+        return output;
+    }
+
+    std::string readOutput(size_t index) {
+        std::string content;
+        EXPECT_TRUE(ReadFileToString(files[index]->path, &content));
+        return content;
+    }
+
+    FdBuffer buffer;
+
+    // Field 1 is AUTOMATIC, and field 5 is an EXPLICIT message whose field 2 is LOCAL.
+    Privacy field1 = {1, OTHER_TYPE, NULL, PRIVACY_POLICY_AUTOMATIC, NULL};
+    Privacy nestedField2 = {2, STRING_TYPE, NULL, PRIVACY_POLICY_LOCAL, NULL};
+    Privacy* field5Children[2] = {&nestedField2, NULL};
+    Privacy field5 = {5, MESSAGE_TYPE, field5Children, PRIVACY_POLICY_EXPLICIT, NULL};
+    Privacy* sectionChildren[3] = {&field1, &field5, NULL};
+    Privacy section = {SECTION_ID, MESSAGE_TYPE, sectionChildren, PRIVACY_POLICY_EXPLICIT, NULL};
+
+private:
+    std::vector<std::unique_ptr<TemporaryFile>> files;
+};
+
+TEST_F(PrivacyFilterWriteTest, NullRestrictionsWriteEverything) {
+    const std::string data = STRING_FIELD_0 + MESSAGE_FIELD_5;
+    writeToFdBuffer(data);
+    PrivacyFilter filter(SECTION_ID, NULL);
+    sp<TestFilterFd> output = addOutput(&filter, PRIVACY_POLICY_AUTOMATIC);
+
+    size_t maxSize;
+    ASSERT_EQ(NO_ERROR, filter.writeData(buffer, PRIVACY_POLICY_LOCAL, &maxSize));
+    EXPECT_EQ(NO_ERROR, output->getError());
+    EXPECT_EQ(data.size(), maxSize);
+    EXPECT_EQ(withSectionHeader(data), readOutput(0));
+}
+
+TEST_F(PrivacyFilterWriteTest, StripEachPrivacyLevel) {
+    const std::string data = VARINT_FIELD_1 + MESSAGE_FIELD_5;
+    writeToFdBuffer(data);
+    PrivacyFilter filter(SECTION_ID, &section);
+    // Added out of order, the filter sorts them.
+    sp<TestFilterFd> automatic = addOutput(&filter, PRIVACY_POLICY_AUTOMATIC);
+    sp<TestFilterFd> local = addOutput(&filter, PRIVACY_POLICY_LOCAL);
+    sp<TestFilterFd> explicitOutput = addOutput(&filter, PRIVACY_POLICY_EXPLICIT);
+
+    size_t maxSize;
+    ASSERT_EQ(NO_ERROR, filter.writeData(buffer, PRIVACY_POLICY_LOCAL, &maxSize));
+    EXPECT_EQ(NO_ERROR, automatic->getError());
+    EXPECT_EQ(NO_ERROR, local->getError());
+    EXPECT_EQ(NO_ERROR, explicitOutput->getError());
+    EXPECT_EQ(data.size(), maxSize);
+
+    // The nested message is dropped once it has nothing left.
+    EXPECT_EQ(withSectionHeader(VARINT_FIELD_1), readOutput(0));
+    EXPECT_EQ(withSectionHeader(data), readOutput(1));
+    // Its header is re-encoded with the size of what is left.
+    EXPECT_EQ(withSectionHeader(VARINT_FIELD_1 + "\x2a\x03" + VARINT_FIELD_1), readOutput(2));
+}
+
+TEST_F(PrivacyFilterWriteTest, BufferAlreadyFiltered) {
+    const std::string data = VARINT_FIELD_1 + MESSAGE_FIELD_5;
+    writeToFdBuffer(data);
+    PrivacyFilter filter(SECTION_ID, &section);
+    sp<TestFilterFd> output = addOutput(&filter, PRIVACY_POLICY_EXPLICIT);
+
+    ASSERT_EQ(NO_ERROR, filter.writeData(buffer, PRIVACY_POLICY_EXPLICIT, NULL));
+    EXPECT_EQ(NO_ERROR, output->getError());
+    EXPECT_EQ(withSectionHeader(data), readOutput(0));
+}
+
+TEST_F(PrivacyFilterWriteTest, BadDataSkipsFilteredOutputs) {
+    const std::string data = VARINT_FIELD_1 + "\x2a\x10" + VARINT_FIELD_1;
+    writeToFdBuffer(data);
+    PrivacyFilter filter(SECTION_ID, &section);
+    sp<TestFilterFd> local = addOutput(&filter, PRIVACY_POLICY_LOCAL);
+    sp<TestFilterFd> automatic = addOutput(&filter, PRIVACY_POLICY_AUTOMATIC);
+
+    ASSERT_EQ(NO_ERROR, filter.writeData(buffer, PRIVACY_POLICY_LOCAL, NULL));
+    EXPECT_EQ(NO_ERROR, local->getError());
+    EXPECT_EQ(NO_ERROR, automatic->getError());
+    EXPECT_EQ(withSectionHeader(data), readOutput(0));
+    EXPECT_EQ("", readOutput(1));
+}
+
+TEST_F(PrivacyFilterWriteTest, WriteErrorIsReportedPerOutput) {
+    const std::string data = VARINT_FIELD_1 + MESSAGE_FIELD_5;
+    writeToFdBuffer(data);
+    PrivacyFilter filter(SECTION_ID, &section);
+    sp<TestFilterFd> broken = new TestFilterFd(PRIVACY_POLICY_LOCAL, -1);
+    filter.addFd(broken);
+    sp<TestFilterFd> output = addOutput(&filter, PRIVACY_POLICY_AUTOMATIC);
+
+    ASSERT_EQ(NO_ERROR, filter.writeData(buffer, PRIVACY_POLICY_LOCAL, NULL));
+    EXPECT_EQ(-EBADF, broken->getError());
+    EXPECT_EQ(NO_ERROR, output->getError());
+    EXPECT_EQ(withSectionHeader(VARINT_FIELD_1), readOutput(0));
+}
@@ -18,9 +18,11 @@
 
 #include <android/os/BnIncidentReportStatusListener.h>
 #include <frameworks/base/core/proto/android/os/header.pb.h>
+#include "frameworks/base/cmds/incidentd/tests/test_proto.pb.h"
 
 #include <dirent.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <android-base/file.h>
 #include <gmock/gmock.h>
@@ -36,6 +38,33 @@ using ::testing::StrEq;
 using ::testing::Test;
 
 namespace {
+
+uint64_t readVarint(const string& data, size_t* pos) {
+    uint64_t value = 0;
+    for (int shift = 0; *pos < data.size(); shift += 7) {
+        const uint8_t byte = data[(*pos)++];
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    return value;
+}
+
+// Returns the id and the payload of each top level field of a report, in the order they were
+// written. All of them are length delimited.
+vector<pair<int, string>> readReportFields(const string& data) {
+    vector<pair<int, string>> fields;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        const int fieldId = readVarint(data, &pos) >> 3;
+        const size_t size = readVarint(data, &pos);
+        fields.emplace_back(fieldId, data.substr(pos, size));
+        pos += size;
+    }
+    return fields;
+}
+
 /*
 void getHeaderData(const IncidentHeaderProto& headerProto, vector<uint8_t>* out) {
     out->clear();
@@ -132,6 +161,27 @@ public:
         return results;
     }
 
+    // Streams a report of all the sections in section_list.cpp and returns it.
+    string RunStreamingReport(size_t maxConcurrentSections) {
+        TemporaryFile tf;
+        IncidentReportArgs args;
+        args.setAll(true);
+        args.setPrivacyPolicy(android::os::PRIVACY_POLICY_LOCAL);
+
+        sp<WorkDirectory> workDirectory = new WorkDirectory(td.path);
+        sp<ReportBatch> batch = new ReportBatch();
+        // The request closes its fd.
+        batch->addStreamingReport(args, listener, dup(tf.fd));
+        vector<BringYourOwnSection*> registeredSections;
+        sp<Reporter> reporter =
+                new Reporter(workDirectory, batch, registeredSections, maxConcurrentSections);
+        reporter->runReport(&size);
+
+        string result;
+        ReadFileToString(tf.path, &result);
+        return result;
+    }
+
 protected:
     TemporaryDir td;
     sp<TestListener> listener;
@@ -149,6 +199,38 @@ TEST_F(ReporterTest, IncidentReportArgs) {
     ASSERT_TRUE(args1.containsSection(3, false));
 }
 
+TEST_F(ReporterTest, RunReportConcurrently) {
+    // The sections finish in the reverse order, but must be written in order.
+    vector<pair<int, string>> fields = readReportFields(RunStreamingReport(4));
+
+    // The metadata comes last.
+    ASSERT_EQ(5UL, fields.size());
+    for (int i = 0; i < 4; i++) {
+        const int sectionId = i + 1;
+        EXPECT_EQ(sectionId, fields[i].first);
+        TestSectionProto section;
+        ASSERT_TRUE(section.ParseFromString(fields[i].second));
+        EXPECT_EQ(sectionId, section.field_1());
+        EXPECT_EQ(sectionId * 10, section.field_2());
+
+        EXPECT_EQ(1, listener->sectionStarted(sectionId));
+        EXPECT_EQ(1, listener->sectionFinished(sectionId));
+    }
+    EXPECT_EQ(0, listener->failedInvoked);
+}
+
+TEST_F(ReporterTest, RunReportConcurrentlyMatchesSerial) {
+    vector<pair<int, string>> concurrent = readReportFields(RunStreamingReport(4));
+    vector<pair<int, string>> serial = readReportFields(RunStreamingReport(1));
+
+    // Everything but the metadata, which has the timings, must be the same.
+    ASSERT_EQ(5UL, concurrent.size());
+    ASSERT_EQ(5UL, serial.size());
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(serial[i], concurrent[i]);
+    }
+}
+
 /*
 TEST_F(ReporterTest, RunReportEmpty) {
     vector<sp<ReportRequest>> requests;
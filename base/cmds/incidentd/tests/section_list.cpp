@@ -3,6 +3,8 @@
 
 #include "frameworks/base/cmds/incidentd/tests/test_proto.pb.h"
 
+#include <unistd.h>
+
 
 namespace android {
 namespace os {
@@ -10,13 +12,18 @@ namespace incidentd {
 
 class TestSection: public Section {
 public:
-    TestSection(int id);
+    TestSection(int id, int delayMs = 0);
     ~TestSection();
     virtual status_t Execute(ReportWriter* writer) const;
+
+private:
+    // How long Execute takes, so that concurrent sections can finish out of order.
+    int mDelayMs;
 };
 
-TestSection::TestSection(int id)
-        :Section(id, 5000 /* ms timeout */) {
+TestSection::TestSection(int id, int delayMs)
+        :Section(id, 5000 /* ms timeout */),
+         mDelayMs(delayMs) {
 }
 
 TestSection::~TestSection() {
@@ -26,6 +33,10 @@ status_t TestSection::Execute(ReportWriter* writer) const {
     uint8_t buf[1024];
     status_t err;
 
+    if (mDelayMs > 0) {
+        usleep(mDelayMs * 1000);
+    }
+
     TestSectionProto proto;
     proto.set_field_1(this->id);
     proto.set_field_2(this->id * 10);
@@ -44,12 +55,18 @@ status_t TestSection::Execute(ReportWriter* writer) const {
     return writer->writeSection(buffer);
 }
 
-TestSection section1(1);
-TestSection section2(2);
+// Each section takes longer than the next one, so that they finish in the reverse of the order
+// they must be written in.
+TestSection section1(1, 300);
+TestSection section2(2, 200);
+TestSection section3(3, 100);
+TestSection section4(4);
 
 const Section* SECTION_LIST[] = {
     &section1,
     &section2,
+    &section3,
+    &section4,
     NULL
 };
 
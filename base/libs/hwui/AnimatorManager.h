@@ -63,6 +63,7 @@ public:
     void endAllActiveAnimators();
 
     bool hasAnimators() { return mAnimators.size(); }
+    bool hasStagingAnimators() { return mNewAnimators.size(); }
 
 private:
     uint32_t animateCommon(TreeInfo& info);
@@ -18,6 +18,8 @@
 
 #include <log/log.h>
 
+#include <algorithm>
+
 #include "RenderNode.h"
 #include "utils/MathUtils.h"
 
@@ -40,6 +42,8 @@ struct DirtyStack {
     // When this frame is pop'd, this rect is mapped through the above transform
     // and applied to the previous (aka parent) frame
     SkRect pendingDirty;
+    // Where the damage batched for this frame starts in mBatchedDamage
+    size_t batchStart;
     DirtyStack* prev;
     DirtyStack* next;
 };
@@ -86,6 +90,7 @@ void DamageAccumulator::pushCommon() {
     }
     mHead = mHead->next;
     mHead->pendingDirty.setEmpty();
+    mHead->batchStart = mBatchedDamage.size();
 }
 
 void DamageAccumulator::pushTransform(const RenderNode* transform) {
@@ -103,6 +108,7 @@ void DamageAccumulator::pushTransform(const Matrix4* transform) {
 void DamageAccumulator::popTransform() {
     LOG_ALWAYS_FATAL_IF(mHead->prev == mHead, "Cannot pop the root frame!");
     DirtyStack* dirtyFrame = mHead;
+    flushBatchedDamage(dirtyFrame);
     mHead = mHead->prev;
     switch (dirtyFrame->type) {
         case TransformRenderNode:
@@ -224,8 +230,10 @@ void DamageAccumulator::applyRenderNodeTransform(DirtyStack* frame) {
         }
     }
 
-    // apply all transforms
-    mapRect(props, frame->pendingDirty, &mHead->pendingDirty);
+    // apply all transforms, right away if the damage is projected as well
+    if (props.getProjectBackwards() || !batchRenderNodeDamage(props, frame->pendingDirty)) {
+        mapRect(props, frame->pendingDirty, &mHead->pendingDirty);
+    }
 
     // project backwards if necessary
     if (props.getProjectBackwards() && !frame->pendingDirty.isEmpty()) {
@@ -242,23 +250,103 @@ void DamageAccumulator::applyRenderNodeTransform(DirtyStack* frame) {
     }
 }
 
+// Mapping the damage through the transforms of most nodes, those that are only translated or
+// scaled, takes a single scale and translate. Those are left to flushBatchedDamage().
+bool DamageAccumulator::batchRenderNodeDamage(const RenderProperties& props, const SkRect& dirty) {
+    if (dirty.isEmpty()) {
+        return true;
+    }
+    if (Properties::getStretchEffectBehavior() == StretchEffectBehavior::UniformScale &&
+        !props.layerProperties().getStretchEffect().isEmpty()) {
+        return false;
+    }
+    const SkMatrix* extraMatrix =
+            props.getStaticMatrix() ? props.getStaticMatrix() : props.getAnimationMatrix();
+    if (extraMatrix && !extraMatrix->isIdentity()) {
+        return false;
+    }
+    const SkMatrix* transform = props.getTransformMatrix();
+    if (transform && !transform->isScaleTranslate()) {
+        return false;
+    }
+    float scaleX = transform ? transform->getScaleX() : 1;
+    float scaleY = transform ? transform->getScaleY() : 1;
+    float translateX = transform ? transform->getTranslateX() : 0;
+    float translateY = transform ? transform->getTranslateY() : 0;
+    float left = props.getLeft();
+    float top = props.getTop();
+    mBatchedDamage.push_back({
+            {dirty.fLeft, dirty.fTop, dirty.fRight, dirty.fBottom},
+            {scaleX, scaleY, -scaleX, -scaleY},
+            {translateX, translateY, -translateX, -translateY},
+            {left, top, -left, -top},
+    });
+    return true;
+}
+
+// Right and bottom are kept negated, so that mapping and joining the rects is the same min(),
+// add and multiply in all four lanes, which the compiler turns into 4-wide vector operations.
+SkRect DamageAccumulator::mapBatchedDamage(const BatchedDamage* begin, const BatchedDamage* end) {
+    float total[4] = {SK_ScalarInfinity, SK_ScalarInfinity, SK_ScalarInfinity, SK_ScalarInfinity};
+    for (const BatchedDamage* damage = begin; damage != end; damage++) {
+        // Same as SkMatrix::mapRect() followed by offsetting by the node's position
+        float mapped[4];
+        for (int i = 0; i < 4; i++) {
+            mapped[i] = damage->rect[i] * damage->scale[i] + damage->translate[i];
+        }
+        // A negative scale swaps left and right, or top and bottom
+        float sorted[4];
+        for (int i = 0; i < 4; i++) {
+            sorted[i] = std::min(mapped[i], -mapped[(i + 2) % 4]) + damage->offset[i];
+        }
+        // SkRect::join() skips empty rects
+        bool isEmpty = !(sorted[0] < -sorted[2] && sorted[1] < -sorted[3]);
+        for (int i = 0; i < 4; i++) {
+            total[i] = std::min(total[i], isEmpty ? SK_ScalarInfinity : sorted[i]);
+        }
+    }
+    return SkRect::MakeLTRB(total[0], total[1], -total[2], -total[3]);
+}
+
+void DamageAccumulator::flushBatchedDamage(DirtyStack* frame) {
+    if (frame->batchStart == mBatchedDamage.size()) {
+        return;
+    }
+    const BatchedDamage* batch = mBatchedDamage.data();
+    frame->pendingDirty.join(mapBatchedDamage(batch + frame->batchStart,
+                                              batch + mBatchedDamage.size()));
+    mBatchedDamage.resize(frame->batchStart);
+}
+
 void DamageAccumulator::dirty(float left, float top, float right, float bottom) {
     mHead->pendingDirty.join({left, top, right, bottom});
 }
 
 void DamageAccumulator::peekAtDirty(SkRect* dest) const {
     *dest = mHead->pendingDirty;
+    const BatchedDamage* batch = mBatchedDamage.data();
+    if (mHead->batchStart != mBatchedDamage.size()) {
+        dest->join(mapBatchedDamage(batch + mHead->batchStart, batch + mBatchedDamage.size()));
+    }
 }
 
 void DamageAccumulator::finish(SkRect* totalDirty) {
     LOG_ALWAYS_FATAL_IF(mHead->prev != mHead, "Cannot finish, mismatched push/pop calls! %p vs. %p",
                         mHead->prev, mHead);
+    flushBatchedDamage(mHead);
     // Root node never has a transform, so this is the fully mapped dirty rect
     *totalDirty = mHead->pendingDirty;
     totalDirty->roundOut(totalDirty);
     mHead->pendingDirty.setEmpty();
 }
 
+void DamageAccumulator::join(const DamageAccumulator& other) {
+    LOG_ALWAYS_FATAL_IF(other.mHead->prev != other.mHead, "Cannot join, mismatched push/pop calls!");
+    SkRect otherDirty;
+    other.peekAtDirty(&otherDirty);
+    mHead->pendingDirty.join(otherDirty);
+}
+
 DamageAccumulator::StretchResult DamageAccumulator::findNearestStretchEffect() const {
     DirtyStack* frame = mHead;
     while (frame->prev != frame) {
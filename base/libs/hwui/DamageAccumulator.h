@@ -25,6 +25,8 @@
 
 #include "utils/Macros.h"
 
+#include <vector>
+
 // Smaller than INT_MIN/INT_MAX because we offset these values
 // and thus don't want to be adding offsets to INT_MAX, that's bad
 #define DIRTY_MIN (-0x7ffffff - 1)
@@ -35,6 +37,7 @@ namespace uirenderer {
 
 struct DirtyStack;
 class RenderNode;
+class RenderProperties;
 class Matrix4;
 
 class DamageAccumulator {
@@ -63,6 +66,10 @@ public:
 
     void finish(SkRect* totalDirty);
 
+    // Adds the damage accumulated by |other|, which must have no pushed transforms left, to the
+    // current frame. Used to merge subtrees prepared in parallel with their own accumulator.
+    void join(const DamageAccumulator& other);
+
     struct StretchResult {
         /**
          * Stretch parameters configured on the stretch container
@@ -88,12 +95,27 @@ public:
     [[nodiscard]] StretchResult findNearestStretchEffect() const;
 
 private:
+    // Damage of a popped RenderNode whose transform is a plain scale and translate, mapped into
+    // its parent's frame only once the parent is popped or its damage is read. Siblings are then
+    // mapped and joined together in one pass instead of one at a time. Every field holds left,
+    // top, right and bottom lanes, see mapBatchedDamage().
+    struct BatchedDamage {
+        float rect[4];
+        float scale[4];
+        float translate[4];
+        float offset[4];
+    };
+
     void pushCommon();
     void applyMatrix4Transform(DirtyStack* frame);
     void applyRenderNodeTransform(DirtyStack* frame);
+    bool batchRenderNodeDamage(const RenderProperties& props, const SkRect& dirty);
+    void flushBatchedDamage(DirtyStack* frame);
+    static SkRect mapBatchedDamage(const BatchedDamage* begin, const BatchedDamage* end);
 
     LinearAllocator mAllocator;
     DirtyStack* mHead;
+    std::vector<BatchedDamage> mBatchedDamage;
 };
 
 } /* namespace uirenderer */
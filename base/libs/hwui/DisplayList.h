@@ -92,6 +92,10 @@ public:
         return mImpl && mImpl->hasVectorDrawables();
     }
 
+    [[nodiscard]] bool canPrepareOffRenderThread() const {
+        return !mImpl || mImpl->canPrepareOffRenderThread();
+    }
+
     void clear(RenderNode* owningNode = nullptr) {
         if (mImpl && owningNode && mImpl->reuseDisplayList(owningNode)) {
             // TODO: This is a bit sketchy to have a unique_ptr temporarily owned twice
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FrameTimingExporter.h"
+
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <log/log.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+
+#include "Properties.h"
+#include "utils/TimeUtils.h"
+
+namespace android {
+namespace uirenderer {
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "FrameTimingHistograms::sequence must be usable from another process");
+
+// Frames reach the histograms at most this late.
+static constexpr nsecs_t kDrainInterval = 100_ms;
+
+void FrameTimingHistograms::init(int32_t pid) {
+    magic = kMagic;
+    version = kVersion;
+    stageCount = kStageCount;
+    bucketCount = kBucketCount;
+    bucketWidthNs = kBucketWidthNs;
+    this->pid = pid;
+    sequence.store(0, std::memory_order_relaxed);
+    frameCount = 0;
+    droppedFrameCount = 0;
+    memset(counts, 0, sizeof(counts));
+}
+
+void FrameTimingHistograms::addFrame(const FrameInfo& frame) {
+    int64_t totalDuration = frame.totalDuration();
+    if (totalDuration <= 0) {
+        return;
+    }
+    auto addDuration = [this](FrameTimingStage stage, int64_t duration) {
+        if (duration < 0) {
+            return;
+        }
+        int64_t bucket = std::min<int64_t>(duration / kBucketWidthNs, kBucketCount - 1);
+        counts[static_cast<int>(stage)][bucket]++;
+    };
+    frameCount++;
+    addDuration(FrameTimingStage::Total, totalDuration);
+    addDuration(FrameTimingStage::Ui, frame.duration(FrameInfoIndex::Vsync,
+                                                     FrameInfoIndex::SyncQueued));
+    addDuration(FrameTimingStage::Sync, frame.duration(FrameInfoIndex::SyncStart,
+                                                       FrameInfoIndex::IssueDrawCommandsStart));
+    addDuration(FrameTimingStage::Draw, frame.duration(FrameInfoIndex::IssueDrawCommandsStart,
+                                                       FrameInfoIndex::SwapBuffers));
+    addDuration(FrameTimingStage::Gpu, frame.gpuDrawTime());
+    addDuration(FrameTimingStage::DequeueBuffer, frame[FrameInfoIndex::DequeueBufferDuration]);
+    addDuration(FrameTimingStage::QueueBuffer, frame[FrameInfoIndex::QueueBufferDuration]);
+}
+
+static constexpr char kFilePrefix[] = "hwui-frametiming-";
+
+// Leaked, so that it is still there when removeHistogramsFile runs at exit.
+static const std::string* sHistogramsPath = nullptr;
+
+static void removeHistogramsFile() {
+    unlink(sHistogramsPath->c_str());
+}
+
+// Most processes are killed rather than exit, so the files of the processes that are gone are
+// removed by the next one to start. Failures are ignored, the files may belong to another uid.
+static void removeStaleHistogramsFiles(const std::string& dir) {
+    std::unique_ptr<DIR, decltype(&closedir)> dirp(opendir(dir.c_str()), closedir);
+    if (!dirp) {
+        return;
+    }
+    const size_t prefixLength = strlen(kFilePrefix);
+    while (struct dirent* entry = readdir(dirp.get())) {
+        if (strncmp(entry->d_name, kFilePrefix, prefixLength) != 0) {
+            continue;
+        }
+        char* end;
+        long pid = strtol(entry->d_name + prefixLength, &end, 10);
+        if (*end != '\0' || pid <= 0 || pid == getpid()) {
+            continue;
+        }
+        if (kill(pid, 0) != 0 && errno == ESRCH) {
+            unlinkat(dirfd(dirp.get()), entry->d_name, 0);
+        }
+    }
+}
+
+static FrameTimingHistograms* mapHistograms(const std::string& dir) {
+    removeStaleHistogramsFiles(dir);
+    std::string path = base::StringPrintf("%s/%s%d", dir.c_str(), kFilePrefix, getpid());
+    base::unique_fd fd(open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+    if (fd.get() < 0) {
+        int err = errno;
+        ALOGW("Failed to create frame timing file %s, error = %d %s", path.c_str(), err,
+              strerror(err));
+        return nullptr;
+    }
+    if (ftruncate(fd.get(), sizeof(FrameTimingHistograms)) != 0) {
+        int err = errno;
+        ALOGW("Failed to size frame timing file %s, error = %d %s", path.c_str(), err,
+              strerror(err));
+        unlink(path.c_str());
+        return nullptr;
+    }
+    void* mapping = mmap(nullptr, sizeof(FrameTimingHistograms), PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd.get(), 0);
+    if (mapping == MAP_FAILED) {
+        int err = errno;
+        ALOGW("Failed to map frame timing file %s, error = %d %s", path.c_str(), err,
+              strerror(err));
+        unlink(path.c_str());
+        return nullptr;
+    }
+    // The mapping is kept for the lifetime of the process. Collectors find the file by its path,
+    // so it is only removed when the process exits, or by the next process if this one is killed.
+    FrameTimingHistograms* histograms = new (mapping) FrameTimingHistograms;
+    histograms->init(getpid());
+    sHistogramsPath = new std::string(path);
+    atexit(removeHistogramsFile);
+    return histograms;
+}
+
+FrameTimingExporter* FrameTimingExporter::getInstance() {
+    static sp<FrameTimingExporter> sInstance = []() -> sp<FrameTimingExporter> {
+        std::string dir = base::GetProperty(PROPERTY_FRAME_TIMING_DIR, "");
+        if (dir.empty()) {
+            return nullptr;
+        }
+        FrameTimingHistograms* histograms = mapHistograms(dir);
+        if (histograms == nullptr) {
+            return nullptr;
+        }
+        sp<FrameTimingExporter> exporter = sp<FrameTimingExporter>::make(histograms);
+        exporter->start("FrameTimingExport");
+        exporter->scheduleDrain();
+        return exporter;
+    }();
+    return sInstance.get();
+}
+
+FrameTimingExporter::FrameTimingExporter(FrameTimingHistograms* histograms)
+        : mHistograms(histograms) {}
+
+status_t FrameTimingExporter::readyToRun() {
+    // Runs on the exporter thread, the constructor runs on whichever thread first asked for the
+    // instance, usually a RenderThread.
+    setpriority(PRIO_PROCESS, 0, PRIORITY_BACKGROUND);
+    return NO_ERROR;
+}
+
+std::shared_ptr<FrameTimingExporter::Source> FrameTimingExporter::createSource() {
+    auto source = std::make_shared<Source>();
+    std::lock_guard lock(mSourcesLock);
+    mSources.push_back(source);
+    return source;
+}
+
+void FrameTimingExporter::scheduleDrain() {
+    queue().postDelayed(kDrainInterval, [this]() {
+        drain();
+        scheduleDrain();
+    });
+}
+
+void FrameTimingExporter::drain() {
+    std::lock_guard lock(mSourcesLock);
+    uint32_t sequence = mHistograms->sequence.load(std::memory_order_relaxed);
+    mHistograms->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    FrameInfo frame;
+    for (auto it = mSources.begin(); it != mSources.end();) {
+        Source& source = **it;
+        // Checked before draining, so that frames pushed right before the tracker let go of the
+        // source still make it in.
+        bool orphaned = it->use_count() == 1;
+        while (source.mFrames.pop(&frame)) {
+            mHistograms->addFrame(frame);
+        }
+        mHistograms->droppedFrameCount +=
+                source.mDroppedFrames.exchange(0, std::memory_order_relaxed);
+        it = orphaned ? mSources.erase(it) : it + 1;
+    }
+
+    mHistograms->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+}  // namespace uirenderer
+}  // namespace android
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "FrameInfo.h"
+#include "thread/ThreadBase.h"
+#include "utils/Macros.h"
+#include "utils/SpscRingBuffer.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace android {
+namespace uirenderer {
+
+enum class FrameTimingStage {
+    // IntendedVsync to FrameCompleted, the duration jank is measured against
+    Total = 0,
+    // Vsync to SyncQueued, the UI thread's share of the frame
+    Ui,
+    // SyncStart to IssueDrawCommandsStart
+    Sync,
+    // IssueDrawCommandsStart to SwapBuffers
+    Draw,
+    // SwapBuffers to GpuCompleted
+    Gpu,
+    DequeueBuffer,
+    QueueBuffer,
+
+    // must be last
+    Count,
+};
+
+/**
+ * Frame timing histograms of a process, laid out to be mapped as-is by on-device collectors
+ * without going through binder or dumpsys gfxinfo. Every stage gets kBucketCount buckets of
+ * kBucketWidthNs, the last bucket also counting anything longer.
+ *
+ * Only the FrameTimingExporter thread writes to the histograms. It makes sequence odd before and
+ * even again after every batch of updates, readers should retry their copy if sequence was odd or
+ * changed while they read.
+ */
+struct FrameTimingHistograms {
+    static constexpr uint32_t kMagic = 0x54465748;  // "HWFT"
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kStageCount = static_cast<uint32_t>(FrameTimingStage::Count);
+    static constexpr uint32_t kBucketCount = 1000;
+    static constexpr uint32_t kBucketWidthNs = 100000;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t stageCount;
+    uint32_t bucketCount;
+    uint32_t bucketWidthNs;
+    int32_t pid;
+    std::atomic<uint32_t> sequence;
+    uint32_t frameCount;
+    // Frames that were lost because a JankTracker produced them faster than they were drained.
+    uint32_t droppedFrameCount;
+    uint32_t counts[kStageCount][kBucketCount];
+
+    void init(int32_t pid);
+    void addFrame(const FrameInfo& frame);
+};
+
+/**
+ * Aggregates the frames finished by every JankTracker of the process into FrameTimingHistograms
+ * mapped from a file in the directory named by PROPERTY_FRAME_TIMING_DIR. Trackers hand their
+ * frames over through a lock-free ring which this thread drains periodically, so the threads
+ * finishing frames never wait on the aggregation or the collector.
+ */
+class FrameTimingExporter : private ThreadBase {
+    PREVENT_COPY_AND_ASSIGN(FrameTimingExporter);
+
+public:
+    // Frames finished by one JankTracker, which must only push to it from one thread at a time.
+    class Source {
+    public:
+        void push(const FrameInfo& frame) {
+            if (!mFrames.push(frame)) {
+                mDroppedFrames.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        friend class FrameTimingExporter;
+
+        // Holds about half a second worth of frames at 120Hz, several times the drain interval.
+        SpscRingBuffer<FrameInfo, 64> mFrames;
+        std::atomic<uint32_t> mDroppedFrames = 0;
+    };
+
+    // Returns nullptr unless PROPERTY_FRAME_TIMING_DIR is set and the histograms could be mapped.
+    static FrameTimingExporter* getInstance();
+
+    // The source is drained for as long as the caller holds on to it, and one last time after.
+    std::shared_ptr<Source> createSource();
+
+private:
+    friend sp<FrameTimingExporter>;
+    explicit FrameTimingExporter(FrameTimingHistograms* histograms);
+
+    status_t readyToRun() override;
+
+    void scheduleDrain();
+    void drain();
+
+    FrameTimingHistograms* const mHistograms;
+    std::mutex mSourcesLock;
+    std::vector<std::shared_ptr<Source>> mSources GUARDED_BY(mSourcesLock);
+};
+
+}  // namespace uirenderer
+}  // namespace android
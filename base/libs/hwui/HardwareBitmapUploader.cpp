@@ -32,11 +32,16 @@
 #include <utils/NdkUtils.h>
 #include <utils/Trace.h>
 
+#include <functional>
+#include <future>
+#include <memory>
 #include <thread>
+#include <vector>
 
 #include "hwui/Bitmap.h"
 #include "renderthread/EglManager.h"
 #include "renderthread/VulkanManager.h"
+#include "thread/CommonPool.h"
 #include "thread/ThreadBase.h"
 #include "utils/TimeUtils.h"
 
@@ -57,6 +62,15 @@ struct FormatInfo {
     bool valid = true;
 };
 
+// A bitmap waiting to be copied into its hardware buffer.
+struct QueuedUpload {
+    SkBitmap bitmap;
+    FormatInfo format;
+    AHardwareBuffer* ahb;
+    std::function<void(bool success)> callback;
+    bool succeeded = false;
+};
+
 class AHBUploader : public RefBase {
 public:
     virtual ~AHBUploader() {}
@@ -75,10 +89,31 @@ public:
     bool uploadHardwareBitmap(const SkBitmap& bitmap, const FormatInfo& format,
                               AHardwareBuffer* ahb) {
         ATRACE_CALL();
-        beginUpload();
-        bool result = onUploadHardwareBitmap(bitmap, format, ahb);
-        endUpload();
-        return result;
+        std::promise<bool> result;
+        std::future<bool> uploaded = result.get_future();
+        queueUpload(bitmap, format, ahb, [&result](bool success) { result.set_value(success); });
+        return uploaded.get();
+    }
+
+    // Queues the upload of bitmap into ahb, both of which must stay valid until callback is
+    // called on the upload thread. Uploads queued while the upload thread is busy are all
+    // submitted together once it's done, behind a single fence.
+    void queueUpload(const SkBitmap& bitmap, const FormatInfo& format, AHardwareBuffer* ahb,
+                     std::function<void(bool success)>&& callback) {
+        std::lock_guard _lock{mLock};
+        mPendingUploads++;
+
+        if (!mUploadThread) {
+            mUploadThread = new ThreadBase{};
+        }
+        if (!mUploadThread->isRunning()) {
+            mUploadThread->start("GrallocUploadThread");
+        }
+
+        if (mQueuedUploads.empty()) {
+            mUploadThread->queue().post([this]() { this->uploadQueued(); });
+        }
+        mQueuedUploads.push_back(QueuedUpload{bitmap, format, ahb, std::move(callback)});
     }
 
     void postIdleTimeoutCheck() {
@@ -93,9 +128,8 @@ private:
     virtual void onIdle() = 0;
     virtual void onDestroy() = 0;
 
-    virtual bool onUploadHardwareBitmap(const SkBitmap& bitmap, const FormatInfo& format,
-                                        AHardwareBuffer* ahb) = 0;
-    virtual void onBeginUpload() = 0;
+    // Called on the upload thread, sets succeeded on every upload that made it to its buffer.
+    virtual void onUploadHardwareBitmaps(std::vector<QueuedUpload>& uploads) = 0;
 
     bool shouldTimeOutLocked() {
         nsecs_t durationSince = systemTime() - mLastUpload;
@@ -111,28 +145,29 @@ private:
         }
     }
 
-    void beginUpload() {
-        std::lock_guard _lock{mLock};
-        mPendingUploads++;
-
-        if (!mUploadThread) {
-            mUploadThread = new ThreadBase{};
+    void uploadQueued() {
+        std::vector<QueuedUpload> uploads;
+        {
+            std::lock_guard _lock{mLock};
+            uploads.swap(mQueuedUploads);
         }
-        if (!mUploadThread->isRunning()) {
-            mUploadThread->start("GrallocUploadThread");
+        {
+            ATRACE_FORMAT("Upload %zu hardware bitmaps", uploads.size());
+            onUploadHardwareBitmaps(uploads);
+        }
+        {
+            std::lock_guard _lock{mLock};
+            mPendingUploads -= uploads.size();
+            mLastUpload = systemTime();
+        }
+        for (auto& upload : uploads) {
+            upload.callback(upload.succeeded);
         }
-
-        onBeginUpload();
-    }
-
-    void endUpload() {
-        std::lock_guard _lock{mLock};
-        mPendingUploads--;
-        mLastUpload = systemTime();
     }
 
     int mPendingUploads = 0;
     nsecs_t mLastUpload = 0;
+    std::vector<QueuedUpload> mQueuedUploads;
 };
 
 #define FENCE_TIMEOUT 2000000000
@@ -146,81 +181,73 @@ private:
         mEglManager.destroy();
     }
 
-    void onBeginUpload() override {
-        if (!mEglManager.hasEglContext()) {
-            mUploadThread->queue().runSync([this]() {
-                this->mEglManager.initialize();
-                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-            });
+    void onUploadHardwareBitmaps(std::vector<QueuedUpload>& uploads) override {
+        ATRACE_CALL();
 
+        if (!mEglManager.hasEglContext()) {
+            mEglManager.initialize();
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
             this->postIdleTimeoutCheck();
         }
-    }
-
-
-    EGLDisplay getUploadEglDisplay() {
-        std::lock_guard _lock{mLock};
-        LOG_ALWAYS_FATAL_IF(!mEglManager.hasEglContext(), "Forgot to begin an upload?");
-        return mEglManager.eglDisplay();
-    }
-
-    bool onUploadHardwareBitmap(const SkBitmap& bitmap, const FormatInfo& format,
-                                AHardwareBuffer* ahb) override {
-        ATRACE_CALL();
-
-        EGLDisplay display = getUploadEglDisplay();
 
+        EGLDisplay display = mEglManager.eglDisplay();
         LOG_ALWAYS_FATAL_IF(display == EGL_NO_DISPLAY, "Failed to get EGL_DEFAULT_DISPLAY! err=%s",
                             uirenderer::renderthread::EglManager::eglErrorString());
-        // We use an EGLImage to access the content of the buffer
-        // The EGL image is later bound to a 2D texture
-        const EGLClientBuffer clientBuffer = eglGetNativeClientBufferANDROID(ahb);
-        AutoEglImage autoImage(display, clientBuffer);
-        if (autoImage.image == EGL_NO_IMAGE_KHR) {
-            ALOGW("Could not create EGL image, err =%s",
-                  uirenderer::renderthread::EglManager::eglErrorString());
-            return false;
-        }
 
-        {
+        // We use an EGLImage to access the content of each buffer. The images have to outlive
+        // the fence that all of the uploads share.
+        std::vector<std::unique_ptr<AutoEglImage>> images;
+        for (auto& upload : uploads) {
+            const SkBitmap& bitmap = upload.bitmap;
             ATRACE_FORMAT("CPU -> gralloc transfer (%dx%d)", bitmap.width(), bitmap.height());
-            EGLSyncKHR fence = mUploadThread->queue().runSync([&]() -> EGLSyncKHR {
-                AutoSkiaGlTexture glTexture;
-                glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, autoImage.image);
-                if (GLUtils::dumpGLErrors()) {
-                    return EGL_NO_SYNC_KHR;
-                }
-
-                // glTexSubImage2D is synchronous in sense that it memcpy() from pointer that we
-                // provide.
-                // But asynchronous in sense that driver may upload texture onto hardware buffer
-                // when we first use it in drawing
-                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, bitmap.width(), bitmap.height(),
-                                format.format, format.type, bitmap.getPixels());
-                if (GLUtils::dumpGLErrors()) {
-                    return EGL_NO_SYNC_KHR;
-                }
-
-                EGLSyncKHR uploadFence =
-                        eglCreateSyncKHR(eglGetCurrentDisplay(), EGL_SYNC_FENCE_KHR, NULL);
-                if (uploadFence == EGL_NO_SYNC_KHR) {
-                    ALOGW("Could not create sync fence %#x", eglGetError());
-                };
-                glFlush();
-                GLUtils::dumpGLErrors();
-                return uploadFence;
-            });
-
-            if (fence == EGL_NO_SYNC_KHR) {
-                return false;
+            const EGLClientBuffer clientBuffer = eglGetNativeClientBufferANDROID(upload.ahb);
+            auto autoImage = std::make_unique<AutoEglImage>(display, clientBuffer);
+            if (autoImage->image == EGL_NO_IMAGE_KHR) {
+                ALOGW("Could not create EGL image, err =%s",
+                      uirenderer::renderthread::EglManager::eglErrorString());
+                continue;
+            }
+
+            AutoSkiaGlTexture glTexture;
+            glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, autoImage->image);
+            if (GLUtils::dumpGLErrors()) {
+                continue;
+            }
+
+            // glTexSubImage2D is synchronous in sense that it memcpy() from pointer that we
+            // provide.
+            // But asynchronous in sense that driver may upload texture onto hardware buffer
+            // when we first use it in drawing
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, bitmap.width(), bitmap.height(),
+                            upload.format.format, upload.format.type, bitmap.getPixels());
+            if (GLUtils::dumpGLErrors()) {
+                continue;
             }
-            EGLint waitStatus = eglClientWaitSyncKHR(display, fence, 0, FENCE_TIMEOUT);
-            ALOGE_IF(waitStatus != EGL_CONDITION_SATISFIED_KHR,
-                    "Failed to wait for the fence %#x", eglGetError());
+            upload.succeeded = true;
+            images.push_back(std::move(autoImage));
+        }
+        if (images.empty()) {
+            return;
+        }
 
-            eglDestroySyncKHR(display, fence);
+        EGLSyncKHR fence = eglCreateSyncKHR(display, EGL_SYNC_FENCE_KHR, NULL);
+        if (fence == EGL_NO_SYNC_KHR) {
+            ALOGW("Could not create sync fence %#x", eglGetError());
+        };
+        glFlush();
+        GLUtils::dumpGLErrors();
+        if (fence == EGL_NO_SYNC_KHR) {
+            for (auto& upload : uploads) {
+                upload.succeeded = false;
+            }
+            return;
         }
-        return true;
+
+        EGLint waitStatus = eglClientWaitSyncKHR(display, fence, 0, FENCE_TIMEOUT);
+        ALOGE_IF(waitStatus != EGL_CONDITION_SATISFIED_KHR,
+                "Failed to wait for the fence %#x", eglGetError());
+
+        eglDestroySyncKHR(display, fence);
     }
 
     renderthread::EglManager mEglManager;
@@ -237,37 +264,36 @@ private:
         onDestroy();
     }
 
-    void onBeginUpload() override {}
-
-    bool onUploadHardwareBitmap(const SkBitmap& bitmap, const FormatInfo& format,
-                                AHardwareBuffer* ahb) override {
-        bool uploadSucceeded = false;
-        mUploadThread->queue().runSync([this, &uploadSucceeded, bitmap, ahb]() {
-          ATRACE_CALL();
-          std::lock_guard _lock{mVkLock};
-
-          renderthread::VulkanManager* vkManager = getVulkanManager();
-          if (!vkManager->hasVkContext()) {
-              LOG_ALWAYS_FATAL_IF(mGrContext,
-                                  "GrContext exists with no VulkanManager for vulkan uploads");
-              vkManager->initialize();
-          }
-
-          if (!mGrContext) {
-              GrContextOptions options;
-              mGrContext = vkManager->createContext(options,
-                      renderthread::VulkanManager::ContextType::kUploadThread);
-              LOG_ALWAYS_FATAL_IF(!mGrContext, "failed to create GrContext for vulkan uploads");
-              this->postIdleTimeoutCheck();
-          }
-
-          sk_sp<SkImage> image =
-              SkImage::MakeFromAHardwareBufferWithData(mGrContext.get(), bitmap.pixmap(), ahb);
-          mGrContext->submit(true);
-
-          uploadSucceeded = (image.get() != nullptr);
-        });
-        return uploadSucceeded;
+    void onUploadHardwareBitmaps(std::vector<QueuedUpload>& uploads) override {
+        ATRACE_CALL();
+        std::lock_guard _lock{mVkLock};
+
+        renderthread::VulkanManager* vkManager = getVulkanManager();
+        if (!vkManager->hasVkContext()) {
+            LOG_ALWAYS_FATAL_IF(mGrContext,
+                                "GrContext exists with no VulkanManager for vulkan uploads");
+            vkManager->initialize();
+        }
+
+        if (!mGrContext) {
+            GrContextOptions options;
+            mGrContext = vkManager->createContext(options,
+                    renderthread::VulkanManager::ContextType::kUploadThread);
+            LOG_ALWAYS_FATAL_IF(!mGrContext, "failed to create GrContext for vulkan uploads");
+            this->postIdleTimeoutCheck();
+        }
+
+        // The images are kept until the single submit below has waited for all of the uploads.
+        std::vector<sk_sp<SkImage>> images;
+        for (auto& upload : uploads) {
+            sk_sp<SkImage> image = SkImage::MakeFromAHardwareBufferWithData(
+                    mGrContext.get(), upload.bitmap.pixmap(), upload.ahb);
+            upload.succeeded = (image.get() != nullptr);
+            if (image) {
+                images.push_back(std::move(image));
+            }
+        }
+        mGrContext->submit(true);
     }
 
     /* must be called on the upload thread after the vkLock has been acquired  */
@@ -387,7 +413,7 @@ static FormatInfo determineFormat(const SkBitmap& skBitmap, bool usingGL) {
     return formatInfo;
 }
 
-static SkBitmap makeHwCompatible(const FormatInfo& format, const SkBitmap& source) {
+static SkBitmap convertToHwCompatible(const FormatInfo& format, const SkBitmap& source) {
     if (format.isSupported) {
         return source;
     } else {
@@ -398,6 +424,10 @@ static SkBitmap makeHwCompatible(const FormatInfo& format, const SkBitmap& sourc
     }
 }
 
+static bool isUsingGL() {
+    return uirenderer::Properties::getRenderPipelineType() ==
+            uirenderer::RenderPipelineType::SkiaGL;
+}
 
 static void createUploader(bool usingGL) {
     static std::mutex lock;
@@ -411,45 +441,93 @@ static void createUploader(bool usingGL) {
     }
 }
 
-sk_sp<Bitmap> HardwareBitmapUploader::allocateHardwareBitmap(const SkBitmap& sourceBitmap) {
-    ATRACE_CALL();
+// Everything a hardware bitmap needs besides the upload itself, which doesn't have to happen on
+// the upload thread.
+struct PreparedUpload {
+    FormatInfo format;
+    SkBitmap bitmap;
+    UniqueAHardwareBuffer ahb;
+    BitmapPalette palette = BitmapPalette::Unknown;
+};
 
-    bool usingGL = uirenderer::Properties::getRenderPipelineType() ==
-            uirenderer::RenderPipelineType::SkiaGL;
+static bool prepareUpload(const SkBitmap& sourceBitmap, PreparedUpload* outUpload) {
+    ATRACE_CALL();
+    bool usingGL = isUsingGL();
 
-    FormatInfo format = determineFormat(sourceBitmap, usingGL);
-    if (!format.valid) {
-        return nullptr;
+    outUpload->format = determineFormat(sourceBitmap, usingGL);
+    if (!outUpload->format.valid) {
+        return false;
     }
 
-    SkBitmap bitmap = makeHwCompatible(format, sourceBitmap);
+    const SkBitmap& bitmap = outUpload->bitmap =
+            convertToHwCompatible(outUpload->format, sourceBitmap);
     AHardwareBuffer_Desc desc = {
             .width = static_cast<uint32_t>(bitmap.width()),
             .height = static_cast<uint32_t>(bitmap.height()),
             .layers = 1,
-            .format = format.bufferFormat,
+            .format = outUpload->format.bufferFormat,
             .usage = AHARDWAREBUFFER_USAGE_CPU_READ_NEVER | AHARDWAREBUFFER_USAGE_CPU_WRITE_NEVER |
                      AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE,
     };
-    UniqueAHardwareBuffer ahb = allocateAHardwareBuffer(desc);
-    if (!ahb) {
+    outUpload->ahb = allocateAHardwareBuffer(desc);
+    if (!outUpload->ahb) {
         ALOGW("allocateHardwareBitmap() failed in AHardwareBuffer_allocate()");
-        return nullptr;
+        return false;
     };
+    outUpload->palette = Bitmap::computePalette(bitmap);
 
     createUploader(usingGL);
+    return true;
+}
+
+static sk_sp<Bitmap> createFromUpload(const PreparedUpload& upload) {
+    const SkBitmap& bitmap = upload.bitmap;
+    return Bitmap::createFrom(upload.ahb.get(), bitmap.colorType(), bitmap.refColorSpace(),
+                              bitmap.alphaType(), upload.palette);
+}
+
+sk_sp<Bitmap> HardwareBitmapUploader::allocateHardwareBitmap(const SkBitmap& sourceBitmap) {
+    ATRACE_CALL();
 
-    if (!sUploader->uploadHardwareBitmap(bitmap, format, ahb.get())) {
+    PreparedUpload upload;
+    if (!prepareUpload(sourceBitmap, &upload)) {
         return nullptr;
     }
-    return Bitmap::createFrom(ahb.get(), bitmap.colorType(), bitmap.refColorSpace(),
-                              bitmap.alphaType(), Bitmap::computePalette(bitmap));
+    if (!sUploader->uploadHardwareBitmap(upload.bitmap, upload.format, upload.ahb.get())) {
+        return nullptr;
+    }
+    return createFromUpload(upload);
+}
+
+std::future<sk_sp<Bitmap>> HardwareBitmapUploader::allocateHardwareBitmapAsync(
+        const SkBitmap& sourceBitmap) {
+    auto result = std::make_shared<std::promise<sk_sp<Bitmap>>>();
+    std::future<sk_sp<Bitmap>> future = result->get_future();
+    CommonPool::post([sourceBitmap, result]() {
+        auto upload = std::make_shared<PreparedUpload>();
+        if (!prepareUpload(sourceBitmap, upload.get())) {
+            result->set_value(nullptr);
+            return;
+        }
+        sUploader->queueUpload(upload->bitmap, upload->format, upload->ahb.get(),
+                               [upload, result](bool success) {
+                                   result->set_value(success ? createFromUpload(*upload)
+                                                             : nullptr);
+                               });
+    });
+    return future;
+}
+
+SkBitmap HardwareBitmapUploader::makeHwCompatible(const SkBitmap& sourceBitmap) {
+    FormatInfo format = determineFormat(sourceBitmap, isUsingGL());
+    if (!format.valid) {
+        return SkBitmap();
+    }
+    return convertToHwCompatible(format, sourceBitmap);
 }
 
 void HardwareBitmapUploader::initialize() {
-    bool usingGL = uirenderer::Properties::getRenderPipelineType() ==
-            uirenderer::RenderPipelineType::SkiaGL;
-    createUploader(usingGL);
+    createUploader(isUsingGL());
 }
 
 void HardwareBitmapUploader::terminate() {
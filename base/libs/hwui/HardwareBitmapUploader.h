@@ -19,6 +19,8 @@
 #include <hwui/Bitmap.h>
 #include <SkRefCnt.h>
 
+#include <future>
+
 class SkBitmap;
 
 namespace android::uirenderer {
@@ -30,6 +32,19 @@ public:
 
     static sk_sp<Bitmap> allocateHardwareBitmap(const SkBitmap& sourceBitmap);
 
+    /**
+     * Same as allocateHardwareBitmap() without blocking the caller. The color type conversion,
+     * buffer allocation and palette computation run on the CommonPool, overlapping with the
+     * uploads of earlier bitmaps, and uploads that queue up behind each other are submitted
+     * together behind a single fence. The pixels of sourceBitmap must not change until the
+     * returned future is ready.
+     */
+    static std::future<sk_sp<Bitmap>> allocateHardwareBitmapAsync(const SkBitmap& sourceBitmap);
+
+    // The CPU side conversion allocateHardwareBitmap() applies to color types the hardware
+    // buffers can't hold. Exposed for benchmarks.
+    static SkBitmap makeHwCompatible(const SkBitmap& sourceBitmap);
+
 #ifdef __ANDROID__
     static bool hasFP16Support();
     static bool has1010102Support();
@@ -97,6 +97,9 @@ JankTracker::JankTracker(ProfileDataContainer* globalData)
         mDequeueTimeForgivenessLegacy = offsetDelta + 4_ms;
     }
     mFrameIntervalLegacy = frameIntervalNanos;
+    if (FrameTimingExporter* exporter = FrameTimingExporter::getInstance()) {
+        mTimingExport = exporter->createSource();
+    }
 }
 
 void JankTracker::calculateLegacyJank(FrameInfo& frame) REQUIRES(mDataMutex) {
@@ -169,6 +172,10 @@ void JankTracker::calculateLegacyJank(FrameInfo& frame) REQUIRES(mDataMutex) {
 
 void JankTracker::finishFrame(FrameInfo& frame, std::unique_ptr<FrameMetricsReporter>& reporter,
                               int64_t frameNumber, int32_t surfaceControlId) {
+    if (CC_UNLIKELY(mTimingExport)) {
+        mTimingExport->push(frame);
+    }
+
     std::lock_guard lock(mDataMutex);
 
     calculateLegacyJank(frame);
@@ -18,6 +18,7 @@
 
 #include "FrameInfo.h"
 #include "FrameMetricsReporter.h"
+#include "FrameTimingExporter.h"
 #include "ProfileData.h"
 #include "ProfileDataContainer.h"
 #include "renderthread/TimeLord.h"
@@ -99,6 +100,10 @@ private:
     // Ring buffer large enough for 2 seconds worth of frames
     RingBuffer<FrameInfo, 120> mFrames;
 
+    // Frames handed to the FrameTimingExporter, if exporting is enabled. Pushed to by whichever
+    // thread finishes the frame, which the callers serialize with their reporter mutex.
+    std::shared_ptr<FrameTimingExporter::Source> mTimingExport;
+
     // Mutex to protect acccess to mData and mGlobalData obtained from mGlobalData->getDataMutex
     std::mutex& mDataMutex;
 };
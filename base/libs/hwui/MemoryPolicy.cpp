@@ -33,6 +33,7 @@ constexpr static MemoryPolicy sPersistentOrSystemPolicy{
 constexpr static MemoryPolicy sLowRamPolicy{
         .useAlternativeUiHidden = true,
         .purgeScratchOnly = false,
+        .maxResourceBudgetScale = 1.0f,
 };
 constexpr static MemoryPolicy sExtremeLowRam{
         .initialMaxSurfaceAreaScale = 0.2f,
@@ -43,6 +44,7 @@ constexpr static MemoryPolicy sExtremeLowRam{
         .useAlternativeUiHidden = true,
         .purgeScratchOnly = false,
         .releaseContextOnStoppedOnly = true,
+        .maxResourceBudgetScale = 1.0f,
 };
 
 const MemoryPolicy& loadMemoryPolicy() {
@@ -62,6 +62,11 @@ struct MemoryPolicy {
     // EXPERIMENTAL: Whether or not to trigger releasing GPU context when all contexts are stopped
     // WARNING: Enabling this option can lead to instability, see b/266626090
     bool releaseContextOnStoppedOnly = false;
+    // How far the resource cache limit may grow past the surface based limit while frames keep
+    // filling the cache up. 1 keeps the limit fixed
+    float maxResourceBudgetScale = 2.0f;
+    // How long unused resources are kept while the cache holds more than the surface based limit
+    nsecs_t grownBudgetResourceRetention = 2_s;
 };
 
 const MemoryPolicy& loadMemoryPolicy();
@@ -19,25 +19,40 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <utils/Log.h>
+
+#include <array>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace android {
 namespace uirenderer {
 
+static constexpr std::array<bool, 256> makeCommandTable() {
+    std::array<bool, 256> table{};
+    // Note that 'e' or 'E' are not valid path commands, but could be
+    // used for floating point numbers' scientific notation.
+    // Therefore, when searching for next command, we should ignore 'e'
+    // and 'E'.
+    for (int c = 'A'; c <= 'Z'; c++) {
+        table[c] = c != 'E';
+    }
+    for (int c = 'a'; c <= 'z'; c++) {
+        table[c] = c != 'e';
+    }
+    return table;
+}
+
+static constexpr std::array<bool, 256> sCommandChars = makeCommandTable();
+
 static size_t nextStart(const char* s, size_t length, size_t startIndex) {
     size_t index = startIndex;
-    while (index < length) {
-        char c = s[index];
-        // Note that 'e' or 'E' are not valid path commands, but could be
-        // used for floating point numbers' scientific notation.
-        // Therefore, when searching for next command, we should ignore 'e'
-        // and 'E'.
-        if ((((c - 'A') * (c - 'Z') <= 0) || ((c - 'a') * (c - 'z') <= 0)) && c != 'e' &&
-            c != 'E') {
-            return index;
-        }
+    while (index < length && !sCommandChars[static_cast<uint8_t>(s[index])]) {
         index++;
     }
     return index;
@@ -115,6 +130,67 @@ static float parseFloat(PathParser::ParseResult* result, const char* startPtr,
     return currentValue;
 }
 
+// The powers of ten a float represents exactly.
+static const float sExactPowersOfTen[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f,
+                                          1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+/**
+ * Parses the plain decimal number starting at s[start], such as "-12.5", without strtof().
+ *
+ * Numbers of up to 24 significant bits, scaled by a power of ten a float represents exactly,
+ * come out of a single correctly rounded multiplication or division, so the value is the one
+ * strtof() returns. Anything else, such as exponents or longer mantissas, is left to strtof().
+ *
+ * @return true on success, with the value and the position of the character after the number.
+ */
+static bool parseSimpleFloat(const char* s, int start, int end, float* outValue,
+                             int* outEndPosition) {
+    int index = start;
+    bool negative = false;
+    if (index < end && (s[index] == '-' || s[index] == '+')) {
+        negative = s[index] == '-';
+        index++;
+    }
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+    bool seenDot = false;
+    for (; index < end; index++) {
+        char c = s[index];
+        if (c >= '0' && c <= '9') {
+            if (mantissa >= (1ull << 59)) {
+                return false;
+            }
+            mantissa = mantissa * 10 + (c - '0');
+            exponent -= seenDot ? 1 : 0;
+            hasDigits = true;
+        } else if (c == '.' && !seenDot) {
+            seenDot = true;
+        } else {
+            break;
+        }
+    }
+    // strtof() reads on past the end of the segment, e.g. into the 'x' of a hexadecimal float,
+    // which is a command.
+    char next = s[index];
+    if (!hasDigits || next == 'e' || next == 'E' || next == 'x' || next == 'X') {
+        return false;
+    }
+    while (mantissa != 0 && mantissa % 10 == 0) {
+        mantissa /= 10;
+        exponent++;
+    }
+    if (mantissa > (1ull << 24) || exponent > 10 || exponent < -10) {
+        return false;
+    }
+    float value = static_cast<float>(mantissa);
+    value = exponent >= 0 ? value * sExactPowersOfTen[exponent]
+                          : value / sExactPowersOfTen[-exponent];
+    *outValue = negative ? -value : value;
+    *outEndPosition = index;
+    return true;
+}
+
 /**
  * Parse the floats in the string.
  *
@@ -133,6 +209,28 @@ static void getFloats(std::vector<float>* outPoints, PathParser::ParseResult* re
     // current number, and endPosition is the character after the current
     // number.
     while (startPosition < end) {
+        char first = pathStr[startPosition];
+        if (first == ' ' || first == ',') {
+            startPosition++;
+            continue;
+        }
+        // Most numbers are plain decimals followed by a separator, which needs neither
+        // extract() nor strtof(). The others go the long way, which tolerates more.
+        float simpleValue;
+        if (parseSimpleFloat(pathStr, startPosition, end, &simpleValue, &endPosition)) {
+            char next = endPosition < end ? pathStr[endPosition] : ' ';
+            if (next == ' ' || next == ',') {
+                outPoints->push_back(simpleValue);
+                startPosition = endPosition + 1;
+                continue;
+            } else if (next == '-' || next == '.') {
+                // Keep the '-' or '.' sign with next number.
+                outPoints->push_back(simpleValue);
+                startPosition = endPosition;
+                continue;
+            }
+        }
+
         bool endWithNegOrDot;
         extract(&endPosition, &endWithNegOrDot, pathStr, startPosition, end);
 
@@ -234,18 +332,20 @@ void PathParser::getPathDataFromAsciiString(PathData* data, ParseResult* result,
 
     while (end < strLen) {
         end = nextStart(pathStr, strLen, end);
-        std::vector<float> points;
-        getFloats(&points, result, pathStr, start, end);
-        validateVerbAndPoints(pathStr[start], points.size(), result);
+        // The floats are parsed straight into the data, and dropped again on failure.
+        size_t pointsStart = data->points.size();
+        getFloats(&data->points, result, pathStr, start, end);
+        size_t pointCount = data->points.size() - pointsStart;
+        validateVerbAndPoints(pathStr[start], pointCount, result);
         if (result->failureOccurred) {
+            data->points.resize(pointsStart);
             // If either verb or points is not valid, return immediately.
             result->failureMessage += "Failure occurred at position " + std::to_string(start) +
                                       " of path: " + pathStr;
             return;
         }
         data->verbs.push_back(pathStr[start]);
-        data->verbSizes.push_back(points.size());
-        data->points.insert(data->points.end(), points.begin(), points.end());
+        data->verbSizes.push_back(pointCount);
         start = end;
         end++;
     }
@@ -263,6 +363,127 @@ void PathParser::getPathDataFromAsciiString(PathData* data, ParseResult* result,
     }
 }
 
+namespace {
+
+// What a path string parses to, shared by everyone parsing the same string.
+struct ParsedPath {
+    PathData data;
+    SkPath path;
+};
+
+/**
+ * The least recently used path strings and what they parsed to, up to a total size.
+ */
+class ParsedPathCache {
+public:
+    static ParsedPathCache& get() {
+        // Leaked, so that it outlives the threads still parsing at exit.
+        static ParsedPathCache* sCache = new ParsedPathCache();
+        return *sCache;
+    }
+
+    std::shared_ptr<const ParsedPath> find(std::string_view pathStr) {
+        std::lock_guard lock(mLock);
+        auto found = mEntries.find(pathStr);
+        if (found == mEntries.end()) {
+            return nullptr;
+        }
+        mLru.splice(mLru.begin(), mLru, found->second);
+        return found->second->parsed;
+    }
+
+    void put(std::string_view pathStr, std::shared_ptr<const ParsedPath> parsed) {
+        size_t size = pathStr.size() + parsed->data.verbs.size() +
+                      parsed->data.verbSizes.size() * sizeof(size_t) +
+                      parsed->data.points.size() * sizeof(float) +
+                      parsed->path.approximateBytesUsed();
+        if (size > kMaxBytes / 16) {
+            // Not worth evicting many smaller paths for.
+            return;
+        }
+        std::lock_guard lock(mLock);
+        if (mEntries.count(pathStr)) {
+            // Parsed by another thread in the meantime.
+            return;
+        }
+        mLru.push_front({std::string(pathStr), std::move(parsed), size});
+        mEntries.emplace(mLru.front().pathStr, mLru.begin());
+        mBytes += size;
+        while (mBytes > kMaxBytes) {
+            Entry& oldest = mLru.back();
+            mBytes -= oldest.size;
+            mEntries.erase(oldest.pathStr);
+            mLru.pop_back();
+        }
+    }
+
+private:
+    struct Entry {
+        std::string pathStr;
+        std::shared_ptr<const ParsedPath> parsed;
+        size_t size;
+    };
+
+    static constexpr size_t kMaxBytes = 256 * 1024;
+
+    std::mutex mLock;
+    // Most recently used first. The keys of mEntries point into the strings of the entries.
+    std::list<Entry> mLru;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> mEntries;
+    size_t mBytes = 0;
+};
+
+}  // namespace
+
+/**
+ * Returns what pathStr parses to, from the cache or parsed and added to it. On failure, returns
+ * the data parsed up to the point of failure, which isn't cached.
+ */
+static std::shared_ptr<const ParsedPath> findOrParse(PathParser::ParseResult* result,
+                                                     const char* pathStr, size_t strLen) {
+    std::string_view key(pathStr, strLen);
+    std::shared_ptr<const ParsedPath> cached = ParsedPathCache::get().find(key);
+    if (cached) {
+        return cached;
+    }
+    auto parsed = std::make_shared<ParsedPath>();
+    PathParser::getPathDataFromAsciiString(&parsed->data, result, pathStr, strLen);
+    if (!result->failureOccurred) {
+        VectorDrawableUtils::verbsToPath(&parsed->path, parsed->data);
+        ParsedPathCache::get().put(key, parsed);
+    }
+    return parsed;
+}
+
+void PathParser::getCachedPathDataFromAsciiString(PathData* data, ParseResult* result,
+                                                  const char* pathStr, size_t strLen) {
+    if (pathStr == NULL) {
+        getPathDataFromAsciiString(data, result, pathStr, strLen);
+        return;
+    }
+    *data = findOrParse(result, pathStr, strLen)->data;
+}
+
+void PathParser::parseCachedAsciiStringForSkPath(SkPath* skPath, ParseResult* result,
+                                                 const char* pathStr, size_t strLen) {
+    if (pathStr == NULL) {
+        parseAsciiStringForSkPath(skPath, result, pathStr, strLen);
+        return;
+    }
+    std::shared_ptr<const ParsedPath> parsed = findOrParse(result, pathStr, strLen);
+    if (result->failureOccurred) {
+        return;
+    }
+    // Check if there is valid data coming out of parsing the string.
+    if (parsed->data.verbs.size() == 0) {
+        result->failureOccurred = true;
+        result->failureMessage = "No verbs found in the string for pathData: ";
+        result->failureMessage += pathStr;
+        return;
+    }
+    *skPath = parsed->path;
+}
+
 void PathParser::dump(const PathData& data) {
     // Print out the path data.
     size_t start = 0;
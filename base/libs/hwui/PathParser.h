@@ -41,6 +41,16 @@ public:
                                           const char* pathStr, size_t strLength);
     static void getPathDataFromAsciiString(PathData* outData, ParseResult* result,
                                            const char* pathStr, size_t strLength);
+    /**
+     * Same as parseAsciiStringForSkPath() and getPathDataFromAsciiString(), except that the
+     * result of an earlier parse of the same string is reused while it is cached. The cache is
+     * shared by the whole process, since the same path strings get inflated over and over, e.g.
+     * by every instance of an icon. Strings that fail to parse aren't cached.
+     */
+    static void parseCachedAsciiStringForSkPath(SkPath* outPath, ParseResult* result,
+                                                const char* pathStr, size_t strLength);
+    static void getCachedPathDataFromAsciiString(PathData* outData, ParseResult* result,
+                                                 const char* pathStr, size_t strLength);
     static void dump(const PathData& data);
     static void validateVerbAndPoints(char verb, size_t points, ParseResult* result);
 };
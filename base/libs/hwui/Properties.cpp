@@ -85,6 +85,8 @@ bool Properties::useHintManager = false;
 int Properties::targetCpuTimePercentage = 70;
 
 bool Properties::enableWebViewOverlays = true;
+bool Properties::parallelPrepareTree = false;
+bool Properties::asyncVectorDrawableRaster = false;
 
 bool Properties::isHighEndGfx = true;
 bool Properties::isLowRam = false;
@@ -150,6 +152,8 @@ bool Properties::load() {
     if (targetCpuTimePercentage <= 0 || targetCpuTimePercentage > 100) targetCpuTimePercentage = 70;
 
     enableWebViewOverlays = base::GetBoolProperty(PROPERTY_WEBVIEW_OVERLAYS_ENABLED, true);
+    parallelPrepareTree = base::GetBoolProperty(PROPERTY_PARALLEL_PREPARE_TREE, false);
+    asyncVectorDrawableRaster = base::GetBoolProperty(PROPERTY_ASYNC_VECTOR_DRAWABLE_RASTER, false);
 
     auto hdrHeadroom = (float)atof(base::GetProperty(PROPERTY_8BIT_HDR_HEADROOM, "").c_str());
     if (hdrHeadroom >= 1.f) {
@@ -211,6 +215,9 @@ RenderPipelineType Properties::peekRenderPipelineType() {
     if (rendererProperty == "skiavk") {
         return RenderPipelineType::SkiaVulkan;
     }
+    if (rendererProperty == "skiacpu") {
+        return RenderPipelineType::SkiaCpu;
+    }
     return RenderPipelineType::SkiaGL;
 }
 
@@ -132,8 +132,8 @@ enum DebugLevel {
 #define PROPERTY_ENABLE_GPU_PIXEL_BUFFERS "debug.hwui.use_gpu_pixel_buffers"
 
 /**
- * Allows to set rendering pipeline mode to OpenGL (default), Skia OpenGL
- * or Vulkan.
+ * Allows to set rendering pipeline mode to OpenGL (default), Skia OpenGL,
+ * Vulkan or CPU raster ("skiacpu"), which needs no GPU.
  */
 #define PROPERTY_RENDERER "debug.hwui.renderer"
 
@@ -210,6 +210,26 @@ enum DebugLevel {
  */
 #define PROPERTY_WEBVIEW_OVERLAYS_ENABLED "debug.hwui.webview_overlays_enabled"
 
+/**
+ * Allows RenderNode::prepareTree to prepare independent subtrees on the CommonPool threads
+ * while the UI thread is blocked on the sync. Accepted values are "true" and "false".
+ */
+#define PROPERTY_PARALLEL_PREPARE_TREE "debug.hwui.parallel_prepare_tree"
+
+/**
+ * Allows VectorDrawables that need a full repaint of their cache to be rasterized on the
+ * CommonPool threads between prepareTree and draw. Accepted values are "true" and "false".
+ */
+#define PROPERTY_ASYNC_VECTOR_DRAWABLE_RASTER "debug.hwui.async_vd_raster"
+
+/**
+ * Directory in which every process exports its frame timing histograms, as
+ * hwui-frametiming-<pid>, for on-device collectors to map. The directory must be writable by
+ * the processes being measured. A file is removed when its process exits, or by the next process
+ * to start if it was killed. Unset or empty disables the export.
+ */
+#define PROPERTY_FRAME_TIMING_DIR "debug.hwui.frame_timing_dir"
+
 /**
  * Property for globally GL drawing state. Can be overridden per process with
  * setDrawingEnabled.
@@ -233,7 +253,7 @@ enum class ProfileType { None, Console, Bars };
 
 enum class OverdrawColorSet { Default = 0, Deuteranomaly };
 
-enum class RenderPipelineType { SkiaGL, SkiaVulkan, NotInitialized = 128 };
+enum class RenderPipelineType { SkiaGL, SkiaVulkan, SkiaCpu, NotInitialized = 128 };
 
 enum class StretchEffectBehavior {
     ShaderHWUI,   // Stretch shader in HWUI only, matrix scale in SF
@@ -319,6 +339,9 @@ public:
 
     static bool enableWebViewOverlays;
 
+    static bool parallelPrepareTree;
+    static bool asyncVectorDrawableRaster;
+
     static bool isHighEndGfx;
     static bool isLowRam;
     static bool isSystemOrPersistent;
@@ -24,6 +24,7 @@
 #include <SkImageInfo.h>
 #include <SkMatrix.h>
 #include <SkPaint.h>
+#include <SkPixmap.h>
 #include <SkRect.h>
 #include <SkRefCnt.h>
 #include <SkSamplingOptions.h>
@@ -107,15 +108,17 @@ void Readback::copySurfaceInto(ANativeWindow* window, const std::shared_ptr<Copy
 
     sk_sp<SkColorSpace> colorSpace =
             DataSpaceToColorSpace(static_cast<android_dataspace>(dataspace));
+    sk_sp<GrDirectContext> grContext = mRenderThread.requireGrContext();
+    // Without a GrContext the buffer can only be drawn from its CPU mapping.
     sk_sp<SkImage> image =
-            SkImage::MakeFromAHardwareBuffer(sourceBuffer.get(), kPremul_SkAlphaType, colorSpace);
+            grContext ? SkImage::MakeFromAHardwareBuffer(sourceBuffer.get(), kPremul_SkAlphaType,
+                                                         colorSpace)
+                      : makeRasterImage(sourceBuffer.get(), description, colorSpace);
 
     if (!image.get()) {
         return request->onCopyFinished(CopyResult::UnknownError);
     }
 
-    sk_sp<GrDirectContext> grContext = mRenderThread.requireGrContext();
-
     SkRect srcRect = request->srcRect.toSkRect();
 
     SkRect imageSrcRect = SkRect::MakeIWH(description.width, description.height);
@@ -170,21 +173,9 @@ void Readback::copySurfaceInto(ANativeWindow* window, const std::shared_ptr<Copy
 
     SkBitmap skBitmap = request->getDestinationBitmap(srcRect.width(), srcRect.height());
     SkBitmap* bitmap = &skBitmap;
-    sk_sp<SkSurface> tmpSurface =
-            SkSurface::MakeRenderTarget(mRenderThread.getGrContext(), skgpu::Budgeted::kYes,
-                                        bitmap->info(), 0, kTopLeft_GrSurfaceOrigin, nullptr);
-
-    // if we can't generate a GPU surface that matches the destination bitmap (e.g. 565) then we
-    // attempt to do the intermediate rendering step in 8888
+    sk_sp<SkSurface> tmpSurface = makeTempSurface(bitmap->info());
     if (!tmpSurface.get()) {
-        SkImageInfo tmpInfo = bitmap->info().makeColorType(SkColorType::kN32_SkColorType);
-        tmpSurface = SkSurface::MakeRenderTarget(mRenderThread.getGrContext(),
-                                                 skgpu::Budgeted::kYes,
-                                                 tmpInfo, 0, kTopLeft_GrSurfaceOrigin, nullptr);
-        if (!tmpSurface.get()) {
-            ALOGW("Unable to generate GPU buffer in a format compatible with the provided bitmap");
-            return request->onCopyFinished(CopyResult::UnknownError);
-        }
+        return request->onCopyFinished(CopyResult::UnknownError);
     }
 
     /*
@@ -305,14 +296,9 @@ CopyResult Readback::copyImageInto(const sk_sp<SkImage>& image, const Rect& srcR
     if (!image.get()) {
         return CopyResult::UnknownError;
     }
-    if (Properties::getRenderPipelineType() == RenderPipelineType::SkiaGL) {
-        mRenderThread.requireGlContext();
-    } else {
-        mRenderThread.requireVkContext();
-    }
+    sk_sp<GrDirectContext> grContext = mRenderThread.requireGrContext();
     int imgWidth = image->width();
     int imgHeight = image->height();
-    sk_sp<GrDirectContext> grContext = sk_ref_sp(mRenderThread.getGrContext());
 
     CopyResult copyResult = CopyResult::UnknownError;
 
@@ -346,28 +332,27 @@ bool Readback::copyLayerInto(Layer* layer, const SkRect* srcRect, const SkRect*
      * a scaling issue (b/62262733) that was encountered when sampling from an EGLImage into a
      * software buffer.
      */
-    sk_sp<SkSurface> tmpSurface = SkSurface::MakeRenderTarget(mRenderThread.getGrContext(),
-                                                              skgpu::Budgeted::kYes,
-                                                              bitmap->info(),
-                                                              0,
-                                                              kTopLeft_GrSurfaceOrigin, nullptr);
-
-    // if we can't generate a GPU surface that matches the destination bitmap (e.g. 565) then we
-    // attempt to do the intermediate rendering step in 8888
+    sk_sp<SkSurface> tmpSurface = makeTempSurface(bitmap->info());
     if (!tmpSurface.get()) {
-        SkImageInfo tmpInfo = bitmap->info().makeColorType(SkColorType::kN32_SkColorType);
-        tmpSurface = SkSurface::MakeRenderTarget(mRenderThread.getGrContext(),
-                                                 skgpu::Budgeted::kYes,
-                                                 tmpInfo, 0, kTopLeft_GrSurfaceOrigin, nullptr);
-        if (!tmpSurface.get()) {
-            ALOGW("Unable to generate GPU buffer in a format compatible with the provided bitmap");
-            return false;
-        }
+        return false;
     }
 
-    if (!skiapipeline::LayerDrawable::DrawLayer(mRenderThread.getGrContext(),
-                                                tmpSurface->getCanvas(), layer, srcRect, dstRect,
-                                                false)) {
+    if (!mRenderThread.getGrContext()) {
+        // Only the CPU pipeline gets here, with the untransformed layer of copyImageInto().
+        sk_sp<SkImage> image = layer->getImage();
+        const SkRect imageRect = SkRect::MakeIWH(image->width(), image->height());
+        const SkRect& src = srcRect ? *srcRect : imageRect;
+        const SkRect& dst = dstRect ? *dstRect : imageRect;
+        SkSamplingOptions sampling(src.width() == dst.width() && src.height() == dst.height()
+                                           ? SkFilterMode::kNearest
+                                           : SkFilterMode::kLinear);
+        SkPaint paint;
+        paint.setBlendMode(SkBlendMode::kSrc);
+        tmpSurface->getCanvas()->drawImageRect(image, src, dst, sampling, &paint,
+                                               SkCanvas::kFast_SrcRectConstraint);
+    } else if (!skiapipeline::LayerDrawable::DrawLayer(mRenderThread.getGrContext(),
+                                                       tmpSurface->getCanvas(), layer, srcRect,
+                                                       dstRect, false)) {
         ALOGW("Unable to draw content from GPU into the provided bitmap");
         return false;
     }
@@ -391,5 +376,47 @@ bool Readback::copyLayerInto(Layer* layer, const SkRect* srcRect, const SkRect*
     return true;
 }
 
+sk_sp<SkSurface> Readback::makeTempSurface(const SkImageInfo& info) {
+    GrDirectContext* grContext = mRenderThread.getGrContext();
+    auto makeSurface = [grContext](const SkImageInfo& info) {
+        return grContext ? SkSurface::MakeRenderTarget(grContext, skgpu::Budgeted::kYes, info, 0,
+                                                       kTopLeft_GrSurfaceOrigin, nullptr)
+                         : SkSurface::MakeRaster(info);
+    };
+    sk_sp<SkSurface> tmpSurface = makeSurface(info);
+
+    // if we can't generate a surface that matches the destination bitmap (e.g. 565) then we
+    // attempt to do the intermediate rendering step in 8888
+    if (!tmpSurface.get()) {
+        tmpSurface = makeSurface(info.makeColorType(SkColorType::kN32_SkColorType));
+        if (!tmpSurface.get()) {
+            ALOGW("Unable to generate a buffer in a format compatible with the provided bitmap");
+        }
+    }
+    return tmpSurface;
+}
+
+sk_sp<SkImage> Readback::makeRasterImage(AHardwareBuffer* buffer,
+                                         const AHardwareBuffer_Desc& description,
+                                         sk_sp<SkColorSpace> colorSpace) {
+    const SkColorType colorType = BufferFormatToColorType(description.format);
+    if (colorType == kUnknown_SkColorType) {
+        ALOGW("Unable to read a buffer of format %u without a GPU context", description.format);
+        return nullptr;
+    }
+    void* pixels = nullptr;
+    if (AHardwareBuffer_lock(buffer, AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN, -1, nullptr, &pixels) !=
+        0) {
+        ALOGW("Failed to lock the buffer for reading");
+        return nullptr;
+    }
+    const SkImageInfo info = SkImageInfo::Make(description.width, description.height, colorType,
+                                               kPremul_SkAlphaType, std::move(colorSpace));
+    sk_sp<SkImage> image = SkImage::MakeRasterCopy(
+            SkPixmap(info, pixels, description.stride * info.bytesPerPixel()));
+    AHardwareBuffer_unlock(buffer, nullptr);
+    return image;
+}
+
 } /* namespace uirenderer */
 } /* namespace android */
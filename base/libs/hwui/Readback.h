@@ -17,6 +17,7 @@
 #pragma once
 
 #include <SkRefCnt.h>
+#include <android/hardware_buffer.h>
 
 #include "CopyRequest.h"
 #include "Matrix.h"
@@ -24,8 +25,11 @@
 #include "renderthread/RenderThread.h"
 
 class SkBitmap;
+class SkColorSpace;
 class SkImage;
+struct SkImageInfo;
 struct SkRect;
+class SkSurface;
 
 namespace android {
 class Bitmap;
@@ -55,6 +59,15 @@ private:
     bool copyLayerInto(Layer* layer, const SkRect* srcRect, const SkRect* dstRect,
                        SkBitmap* bitmap);
 
+    // Intermediate surface to draw into before reading the pixels back into a bitmap of the given
+    // info. It's a GPU surface unless there is no GrContext, with the CPU pipeline.
+    sk_sp<SkSurface> makeTempSurface(const SkImageInfo& info);
+
+    // Copies the pixels of buffer, for the CPU pipeline, which can't sample it as a texture.
+    static sk_sp<SkImage> makeRasterImage(AHardwareBuffer* buffer,
+                                          const AHardwareBuffer_Desc& description,
+                                          sk_sp<SkColorSpace> colorSpace);
+
     renderthread::RenderThread& mRenderThread;
 };
 
@@ -22,6 +22,7 @@
 #include <log/log.h>
 
 #include <experimental/type_traits>
+#include <mutex>
 #include <utility>
 
 #include "Mesh.h"
@@ -62,6 +63,104 @@ namespace uirenderer {
 #define SKLITEDL_PAGE 4096
 #endif
 
+static constexpr inline bool is_power_of_two(int value) {
+    return (value & (value - 1)) == 0;
+}
+
+// A block of recorded ops. Most are SKLITEDL_PAGE bytes, header included, and are recycled
+// through DisplayListChunkPool; an op too large for one of those gets a chunk of its own.
+struct DisplayListChunk {
+    DisplayListChunk* next;
+    size_t capacity;
+    size_t used;
+
+    uint8_t* bytes() { return reinterpret_cast<uint8_t*>(this + 1); }
+    const uint8_t* bytes() const { return reinterpret_cast<const uint8_t*>(this + 1); }
+};
+static_assert(sizeof(DisplayListChunk) % alignof(void*) == 0, "Ops must stay pointer aligned");
+
+static constexpr size_t kChunkCapacity = SKLITEDL_PAGE - sizeof(DisplayListChunk);
+
+// Chunks are mostly released on the RenderThread, when a synced display list replaces the
+// previous one, and allocated again on the UI thread recording the next one, so the pool is
+// shared by all threads rather than per thread.
+class DisplayListChunkPool {
+public:
+    static DisplayListChunkPool& get() {
+        static DisplayListChunkPool* sPool = new DisplayListChunkPool();
+        return *sPool;
+    }
+
+    DisplayListChunk* acquire() {
+        std::lock_guard lock(mLock);
+        DisplayListChunk* chunk = mFree;
+        if (chunk) {
+            mFree = chunk->next;
+            mCount--;
+        }
+        return chunk;
+    }
+
+    void release(DisplayListChunk* chunk) {
+        {
+            std::lock_guard lock(mLock);
+            if (mCount < kMaxPooledChunks) {
+                chunk->next = mFree;
+                mFree = chunk;
+                mCount++;
+                return;
+            }
+        }
+        free(chunk);
+    }
+
+private:
+    // Enough to record a few screens worth of views without going to malloc
+    static constexpr size_t kMaxPooledChunks = 64;
+
+    std::mutex mLock;
+    DisplayListChunk* mFree = nullptr;
+    size_t mCount = 0;
+};
+
+static DisplayListChunk* allocateChunk(size_t size) {
+    static_assert(is_power_of_two(SKLITEDL_PAGE), "This math needs updating for non-pow2.");
+    DisplayListChunk* chunk = nullptr;
+    size_t capacity = kChunkCapacity;
+    if (size <= kChunkCapacity) {
+        chunk = DisplayListChunkPool::get().acquire();
+    } else {
+        // Next greater multiple of SKLITEDL_PAGE, header included.
+        capacity = ((sizeof(DisplayListChunk) + size + SKLITEDL_PAGE - 1) & ~(SKLITEDL_PAGE - 1)) -
+                   sizeof(DisplayListChunk);
+    }
+    if (!chunk) {
+        chunk = static_cast<DisplayListChunk*>(malloc(sizeof(DisplayListChunk) + capacity));
+        LOG_ALWAYS_FATAL_IF(chunk == nullptr, "malloc(%zd) failed",
+                            sizeof(DisplayListChunk) + capacity);
+    }
+    chunk->next = nullptr;
+    chunk->capacity = capacity;
+    chunk->used = 0;
+    return chunk;
+}
+
+// Frees |chunk| and the chunks chained after it, returning how many bytes they could hold.
+static size_t freeChunks(DisplayListChunk* chunk) {
+    size_t capacity = 0;
+    while (chunk) {
+        DisplayListChunk* next = chunk->next;
+        capacity += chunk->capacity;
+        if (chunk->capacity == kChunkCapacity) {
+            DisplayListChunkPool::get().release(chunk);
+        } else {
+            free(chunk);
+        }
+        chunk = next;
+    }
+    return capacity;
+}
+
 // A stand-in for an optional SkRect which was not set, e.g. bounds for a saveLayer().
 static const SkRect kUnset = {SK_ScalarInfinity, 0, 0, 0};
 static const SkRect* maybe_unset(const SkRect& r) {
@@ -713,24 +812,16 @@ public:
 };
 }
 
-static constexpr inline bool is_power_of_two(int value) {
-    return (value & (value - 1)) == 0;
-}
-
 template <typename T, typename... Args>
 void* DisplayListData::push(size_t pod, Args&&... args) {
     size_t skip = SkAlignPtr(sizeof(T) + pod);
     LOG_FATAL_IF(skip >= (1 << 24));
-    if (fUsed + skip > fReserved) {
-        static_assert(is_power_of_two(SKLITEDL_PAGE),
-                      "This math needs updating for non-pow2.");
-        // Next greater multiple of SKLITEDL_PAGE.
-        fReserved = (fUsed + skip + SKLITEDL_PAGE) & ~(SKLITEDL_PAGE - 1);
-        fBytes.realloc(fReserved);
-        LOG_ALWAYS_FATAL_IF(fBytes.get() == nullptr, "realloc(%zd) failed", fReserved);
+    if (!fTail || fTail->used + skip > fTail->capacity) {
+        this->nextChunk(skip);
     }
-    LOG_FATAL_IF((fUsed + skip) > fReserved);
-    auto op = (T*)(fBytes.get() + fUsed);
+    LOG_FATAL_IF((fTail->used + skip) > fTail->capacity);
+    auto op = (T*)(fTail->bytes() + fTail->used);
+    fTail->used += skip;
     fUsed += skip;
     new (op) T{std::forward<Args>(args)...};
     op->type = (uint32_t)T::kType;
@@ -738,17 +829,30 @@ void* DisplayListData::push(size_t pod, Args&&... args) {
     return op + 1;
 }
 
+void DisplayListData::nextChunk(size_t size) {
+    DisplayListChunk*& link = fTail ? fTail->next : fHead;
+    if (!link || link->capacity < size) {
+        DisplayListChunk* chunk = allocateChunk(size);
+        chunk->next = link;
+        link = chunk;
+        fReserved += chunk->capacity;
+    }
+    fTail = link;
+}
+
 template <typename Fn, typename... Args>
 inline void DisplayListData::map(const Fn fns[], Args... args) const {
-    auto end = fBytes.get() + fUsed;
-    for (const uint8_t* ptr = fBytes.get(); ptr < end;) {
-        auto op = (const Op*)ptr;
-        auto type = op->type;
-        auto skip = op->skip;
-        if (auto fn = fns[type]) {  // We replace no-op functions with nullptrs
-            fn(op, args...);        // to avoid the overhead of a pointless call.
+    for (const DisplayListChunk* chunk = fHead; chunk; chunk = chunk->next) {
+        auto end = chunk->bytes() + chunk->used;
+        for (const uint8_t* ptr = chunk->bytes(); ptr < end;) {
+            auto op = (const Op*)ptr;
+            auto type = op->type;
+            auto skip = op->skip;
+            if (auto fn = fns[type]) {  // We replace no-op functions with nullptrs
+                fn(op, args...);        // to avoid the overhead of a pointless call.
+            }
+            ptr += skip;
         }
-        ptr += skip;
     }
 }
 
@@ -947,12 +1051,22 @@ void DisplayListData::draw(SkCanvas* canvas) const {
 
 DisplayListData::~DisplayListData() {
     this->reset();
+    freeChunks(fHead);
 }
 
 void DisplayListData::reset() {
     this->map(dtor_fns);
 
-    // Leave fBytes and fReserved alone.
+    // Keep the chunks the ops filled for the next recording, which is likely to be about as
+    // large, and hand back the ones left over.
+    if (fTail) {
+        fReserved -= freeChunks(fTail->next);
+        fTail->next = nullptr;
+    }
+    for (DisplayListChunk* chunk = fHead; chunk; chunk = chunk->next) {
+        chunk->used = 0;
+    }
+    fTail = nullptr;
     fUsed = 0;
 }
 
@@ -35,7 +35,6 @@
 #include "Gainmap.h"
 #include "hwui/Bitmap.h"
 #include "pipeline/skia/AnimatedDrawables.h"
-#include "utils/AutoMalloc.h"
 #include "utils/Macros.h"
 #include "utils/TypeLogic.h"
 
@@ -107,8 +106,11 @@ struct DrawImagePayload {
 };
 
 class RecordingCanvas;
+struct DisplayListChunk;
 
 class DisplayListData final {
+    PREVENT_COPY_AND_ASSIGN(DisplayListData);
+
 public:
     DisplayListData() : mHasText(false) {}
     ~DisplayListData();
@@ -186,10 +188,18 @@ private:
     template <typename T, typename... Args>
     void* push(size_t, Args&&...);
 
+    // Makes fTail the next chunk of the chain with room for |size| bytes, inserting a new one
+    // if needed.
+    void nextChunk(size_t size);
+
     template <typename Fn, typename... Args>
     void map(const Fn[], Args...) const;
 
-    AutoTMalloc<uint8_t> fBytes;
+    // Ops are recorded into a chain of chunks, so that growing never moves the ops already
+    // recorded. reset() keeps the chain, re-recording a list of the same size reuses it as is.
+    DisplayListChunk* fHead = nullptr;
+    // The chunk being recorded into, nullptr until the first op.
+    DisplayListChunk* fTail = nullptr;
     size_t fUsed = 0;
     size_t fReserved = 0;
 
@@ -22,6 +22,7 @@
 #include "TreeInfo.h"
 #include "VectorDrawable.h"
 #include "private/hwui/WebViewFunctor.h"
+#include "thread/CommonPool.h"
 #ifdef __ANDROID__
 #include "renderthread/CanvasContext.h"
 #else
@@ -35,6 +36,7 @@
 #include <SkPathOps.h>
 #include <algorithm>
 #include <atomic>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <ui/FatVector.h>
@@ -54,6 +56,64 @@ private:
     TreeInfo* mTreeInfo;
 };
 
+#ifdef __ANDROID__ // Layoutlib does not support CommonPool
+// Subtrees prepared together on a CommonPool thread, with their own TreeInfo and
+// DamageAccumulator. What may only be done on the RenderThread, sweeping the nodes removed from
+// the tree and releasing the display lists replaced by a sync, is queued up for when the task
+// is joined.
+struct SubtreePrepareTask final : public TreeObserver {
+    explicit SubtreePrepareTask(const TreeInfo& parentInfo)
+            : info(parentInfo.mode, parentInfo.canvasContext) {
+        info.runAnimations = parentInfo.runAnimations;
+        info.damageAccumulator = &damageAccumulator;
+        info.damageGenerationId = parentInfo.damageGenerationId;
+        info.layerUpdateQueue = parentInfo.layerUpdateQueue;
+        info.errorHandler = parentInfo.errorHandler;
+        info.updateWindowPositions = parentInfo.updateWindowPositions;
+        info.disableForceDark = parentInfo.disableForceDark;
+        info.stretchEffectCount = parentInfo.stretchEffectCount;
+        info.forceDrawFrame = parentInfo.forceDrawFrame;
+        // Isolated subtrees have no mutable images to pin
+        info.prepareTextures = false;
+        info.subtreePrepareTask = this;
+    }
+
+    void onMaybeRemovedFromTree(RenderNode* node) override { removedNodes.emplace_back(node); }
+
+    void run(bool functorsNeedLayer) {
+        ATRACE_FORMAT("prepareIsolatedSubtrees %u nodes", size);
+        for (const auto& child : children) {
+            Matrix4 mat4(child.recordedMatrix);
+            damageAccumulator.pushTransform(&mat4);
+            child.node->prepareTreeImpl(*this, info, functorsNeedLayer);
+            damageAccumulator.popTransform();
+        }
+    }
+
+    // Folds the results of the subtrees into those of their parent
+    void mergeOutInto(TreeInfo::Out& out) const {
+        out.hasFunctors |= info.out.hasFunctors;
+        out.hasAnimations |= info.out.hasAnimations;
+        out.requiresUiRedraw |= info.out.requiresUiRedraw;
+        out.canDrawThisFrame &= info.out.canDrawThisFrame;
+        const nsecs_t delay = info.out.animatedImageDelay;
+        if (delay != TreeInfo::Out::kNoAnimatedImageDelay &&
+            (out.animatedImageDelay == TreeInfo::Out::kNoAnimatedImageDelay ||
+             delay < out.animatedImageDelay)) {
+            out.animatedImageDelay = delay;
+        }
+        out.solelyTextureViewUpdates &= info.out.solelyTextureViewUpdates;
+    }
+
+    std::vector<RenderNode::IsolatedChild> children;
+    uint32_t size = 0;
+    DamageAccumulator damageAccumulator;
+    TreeInfo info;
+    std::vector<sp<RenderNode>> removedNodes;
+    std::vector<std::pair<RenderNode*, DisplayList>> retiredDisplayLists;
+};
+#endif
+
 static int64_t generateId() {
     static std::atomic<int64_t> sNextId{1};
     return sNextId++;
@@ -129,8 +189,21 @@ void RenderNode::prepareTree(TreeInfo& info) {
     LOG_ALWAYS_FATAL_IF(!info.damageAccumulator, "DamageAccumulator missing");
     MarkAndSweepRemoved observer(&info);
 
+#ifdef __ANDROID__ // Layoutlib does not support CommonPool
+    // Only a sync, with the UI thread blocked on it, is worth spreading over several threads
+    if (Properties::parallelPrepareTree && info.mode == TreeInfo::MODE_FULL) {
+        ATRACE_NAME("scanIsolatedSubtrees");
+        static std::atomic<int64_t> sNextScanId{1};
+        info.isolatedSubtreeScanId = sNextScanId++;
+        if (!scanIsolatedSubtrees(info.isolatedSubtreeScanId, nullptr)) {
+            info.isolatedSubtreeScanId = 0;
+        }
+    }
+#endif
+
     const int before = info.disableForceDark;
     prepareTreeImpl(observer, info, false);
+    info.isolatedSubtreeScanId = 0;
     LOG_ALWAYS_FATAL_IF(before != info.disableForceDark, "Mis-matched force dark");
 }
 
@@ -263,13 +336,23 @@ void RenderNode::prepareTreeImpl(TreeObserver& observer, TreeInfo& info, bool fu
     if (mDisplayList) {
         info.out.hasFunctors |= mDisplayList.hasFunctor();
         mHasHolePunches = mDisplayList.hasHolePunches();
+        std::vector<IsolatedChild> isolatedChildren;
+        if (info.isolatedSubtreeScanId) {
+            deferIsolatedChildren(info.isolatedSubtreeScanId, &isolatedChildren);
+        }
         bool isDirty = mDisplayList.prepareListAndChildren(
                 observer, info, childFunctorsNeedLayer,
                 [this](RenderNode* child, TreeObserver& observer, TreeInfo& info,
                        bool functorsNeedLayer) {
+                    if (child->mIsolatedScan.deferred) {
+                        return;
+                    }
                     child->prepareTreeImpl(observer, info, functorsNeedLayer);
                     mHasHolePunches |= child->hasHolePunches();
                 });
+        if (!isolatedChildren.empty()) {
+            prepareIsolatedChildren(observer, info, childFunctorsNeedLayer, isolatedChildren);
+        }
         if (isDirty) {
             damageSelf(info);
         }
@@ -287,6 +370,183 @@ void RenderNode::prepareTreeImpl(TreeObserver& observer, TreeInfo& info, bool fu
     info.damageAccumulator->popTransform();
 }
 
+// Whether preparing this node only touches the node and its display lists. Animators, position
+// listeners, layers, projection and stretch all involve state shared with the RenderThread or
+// with other parts of the tree.
+bool RenderNode::canPrepareOffRenderThread() {
+    if (mAnimatorManager.hasAnimators() || mAnimatorManager.hasStagingAnimators() ||
+        mPositionListener.get() || mStagingPositionListener.get() || hasLayer() ||
+        mIsTextureView || mSnapshotResult.snapshot) {
+        return false;
+    }
+    for (const RenderProperties* props : {&mProperties, &mStagingProperties}) {
+        if (props->effectiveLayerType() == LayerType::RenderLayer ||
+            props->getProjectBackwards() || props->isProjectionReceiver() ||
+            !props->layerProperties().getStretchEffect().isEmpty()) {
+            return false;
+        }
+    }
+    return mDisplayList.canPrepareOffRenderThread() &&
+           (!mNeedsDisplayListSync || mStagingDisplayList.canPrepareOffRenderThread());
+}
+
+/**
+ * Walks the nodes the coming MODE_FULL prepareTreeImpl() visits, recording for each the size of
+ * its subtree if all of it can be prepared off the RenderThread.
+ *
+ * Returns false if a node is referenced by more than one of the display lists involved, old or
+ * new. Subtrees may then share nodes, and none of them can be prepared in parallel.
+ */
+bool RenderNode::scanIsolatedSubtrees(int64_t scanId, RenderNode* parent) {
+    if (mIsolatedScan.id == scanId && (mIsolatedScan.visited || mIsolatedScan.parent != parent)) {
+        return false;
+    }
+    mIsolatedScan.id = scanId;
+    mIsolatedScan.parent = parent;
+    mIsolatedScan.visited = true;
+    mIsolatedScan.deferred = false;
+    mIsolatedScan.isolatedSize = 0;
+
+    bool isolated = canPrepareOffRenderThread();
+    bool referencedOnce = true;
+    if (mNeedsDisplayListSync && mDisplayList) {
+        // The children of the replaced display list lose a parent in the sync
+        mDisplayList.updateChildren([&](RenderNode* child) {
+            IsolatedScan& scan = child->mIsolatedScan;
+            if (scan.id != scanId) {
+                scan.id = scanId;
+                scan.parent = this;
+                scan.visited = false;
+                scan.deferred = false;
+                scan.isolatedSize = 0;
+            } else if (scan.parent != this) {
+                referencedOnce = false;
+            }
+            if (child->mPositionListener.get()) {
+                isolated = false;
+            }
+        });
+    }
+
+    uint32_t size = 1;
+    DisplayList& displayList = mNeedsDisplayListSync ? mStagingDisplayList : mDisplayList;
+    if (referencedOnce && displayList) {
+        displayList.updateChildren([&](RenderNode* child) {
+            if (!referencedOnce) {
+                return;
+            }
+            if (!child->scanIsolatedSubtrees(scanId, this)) {
+                referencedOnce = false;
+            } else if (child->mIsolatedScan.isolatedSize) {
+                size += child->mIsolatedScan.isolatedSize;
+            } else {
+                isolated = false;
+            }
+        });
+    }
+    mIsolatedScan.isolatedSize = isolated ? size : 0;
+    return referencedOnce;
+}
+
+// Fewer nodes than this are prepared faster than they are handed over to the CommonPool
+static constexpr uint32_t kMinParallelPrepareSize = 32;
+
+/**
+ * Picks the children to prepare in parallel once the other children are done: those whose
+ * whole subtree can be prepared off the RenderThread, provided there are enough of them.
+ */
+void RenderNode::deferIsolatedChildren(int64_t scanId, std::vector<IsolatedChild>* outChildren) {
+    const auto& childNodes = mDisplayList.asSkiaDl()->mChildNodes;
+    uint32_t totalSize = 0;
+    for (const auto& child : childNodes) {
+        const IsolatedScan& scan = child.getRenderNode()->mIsolatedScan;
+        if (scan.id == scanId) {
+            totalSize += scan.isolatedSize;
+        }
+    }
+    if (totalSize < kMinParallelPrepareSize) {
+        return;
+    }
+
+    uint32_t deferredSize = 0;
+    for (const auto& child : childNodes) {
+        RenderNode* node = child.getRenderNode();
+        const IsolatedScan& scan = node->mIsolatedScan;
+        // A subtree holding most of the work is better split among its own children, which
+        // happens when the serial walk reaches it.
+        if (scan.id != scanId || !scan.isolatedSize || scan.isolatedSize * 2 > totalSize) {
+            continue;
+        }
+        outChildren->push_back({node, child.getRecordedMatrix()});
+        deferredSize += scan.isolatedSize;
+    }
+    if (outChildren->size() < 2 || deferredSize < kMinParallelPrepareSize) {
+        outChildren->clear();
+        return;
+    }
+    for (const auto& child : *outChildren) {
+        child.node->mIsolatedScan.deferred = true;
+    }
+}
+
+/**
+ * Prepares the children picked by deferIsolatedChildren(), spread over the CommonPool threads
+ * and this one, then merges their damage and results as if they had been prepared in order.
+ */
+void RenderNode::prepareIsolatedChildren(TreeObserver& observer, TreeInfo& info,
+                                         bool functorsNeedLayer,
+                                         const std::vector<IsolatedChild>& children) {
+#ifdef __ANDROID__ // Layoutlib does not support CommonPool
+    ATRACE_NAME("prepareIsolatedChildren");
+    std::vector<std::unique_ptr<SubtreePrepareTask>> tasks;
+    const size_t taskCount = std::min(children.size(), size_t(CommonPool::THREAD_COUNT + 1));
+    for (size_t i = 0; i < taskCount; i++) {
+        tasks.push_back(std::make_unique<SubtreePrepareTask>(info));
+    }
+
+    // Largest subtrees first, each to the least loaded task
+    std::vector<const IsolatedChild*> sorted;
+    for (const auto& child : children) {
+        sorted.push_back(&child);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const IsolatedChild* lhs, const IsolatedChild* rhs) {
+        return lhs->node->mIsolatedScan.isolatedSize > rhs->node->mIsolatedScan.isolatedSize;
+    });
+    for (const IsolatedChild* child : sorted) {
+        auto& task = *std::min_element(tasks.begin(), tasks.end(),
+                                       [](const auto& lhs, const auto& rhs) {
+                                           return lhs->size < rhs->size;
+                                       });
+        task->children.push_back(*child);
+        task->size += child->node->mIsolatedScan.isolatedSize;
+    }
+
+    // If the workers are busy with something else, join() prepares the rest on this thread.
+    CommonPool::TaskGroup group(CommonPool::Priority::High);
+    for (size_t i = 1; i < tasks.size(); i++) {
+        SubtreePrepareTask* task = tasks[i].get();
+        group.run([task, functorsNeedLayer]() { task->run(functorsNeedLayer); });
+    }
+    tasks[0]->run(functorsNeedLayer);
+    group.join();
+
+    for (auto& task : tasks) {
+        for (auto& node : task->removedNodes) {
+            observer.onMaybeRemovedFromTree(node.get());
+        }
+        for (auto& [node, displayList] : task->retiredDisplayLists) {
+            displayList.clear(node);
+        }
+        info.damageAccumulator->join(task->damageAccumulator);
+        task->mergeOutInto(info.out);
+        for (const auto& child : task->children) {
+            child.node->mIsolatedScan.deferred = false;
+            mHasHolePunches |= child.node->hasHolePunches();
+        }
+    }
+#endif
+}
+
 void RenderNode::syncProperties() {
     mProperties = mStagingProperties;
 }
@@ -444,6 +704,15 @@ void RenderNode::deleteDisplayList(TreeObserver& observer, TreeInfo* info) {
     if (mDisplayList) {
         mDisplayList.updateChildren(
                 [&observer, info](RenderNode* child) { child->decParentRefCount(observer, info); });
+#ifdef __ANDROID__ // Layoutlib does not support CommonPool
+        if (CC_UNLIKELY(info && info->subtreePrepareTask)) {
+            // Releasing the list may release the last reference to nodes or images, which must
+            // happen on the RenderThread
+            info->subtreePrepareTask->retiredDisplayLists.emplace_back(this,
+                                                                       std::move(mDisplayList));
+            return;
+        }
+#endif
         mDisplayList.clear(this);
     }
 }
@@ -57,6 +57,7 @@ struct RenderNodeOp;
 
 class TreeInfo;
 class TreeObserver;
+struct SubtreePrepareTask;
 
 namespace proto {
 class RenderNode;
@@ -76,6 +77,7 @@ class RenderNode;
  */
 class RenderNode : public VirtualLightRefBase {
     friend class TestUtils;  // allow TestUtils to access syncDisplayList / syncProperties
+    friend struct SubtreePrepareTask;
 
 public:
     enum DirtyPropertyMask {
@@ -243,6 +245,17 @@ private:
     void deleteDisplayList(TreeObserver& observer, TreeInfo* info = nullptr);
     void damageSelf(TreeInfo& info);
 
+    // A child prepared on a CommonPool thread, with the matrix its parent recorded it with.
+    struct IsolatedChild {
+        RenderNode* node;
+        SkMatrix recordedMatrix;
+    };
+    bool canPrepareOffRenderThread();
+    bool scanIsolatedSubtrees(int64_t scanId, RenderNode* parent);
+    void deferIsolatedChildren(int64_t scanId, std::vector<IsolatedChild>* outChildren);
+    void prepareIsolatedChildren(TreeObserver& observer, TreeInfo& info, bool functorsNeedLayer,
+                                 const std::vector<IsolatedChild>& children);
+
     void incParentRefCount() { mParentCount++; }
     void decParentRefCount(TreeObserver& observer, TreeInfo* info = nullptr);
 
@@ -294,6 +307,21 @@ private:
 
     bool mIsTextureView = false;
 
+    // What the last scanIsolatedSubtrees() reaching this node found out about it.
+    struct IsolatedScan {
+        int64_t id = 0;
+        // The node whose old or new display list references this one.
+        RenderNode* parent = nullptr;
+        // Whether the scan walked this node, rather than only seeing it leave a display list.
+        bool visited = false;
+        // Whether this node is prepared along with its isolated siblings, not by its parent.
+        bool deferred = false;
+        // The number of nodes in this subtree if all of them can be prepared off the
+        // RenderThread, 0 otherwise.
+        uint32_t isolatedSize = 0;
+    };
+    IsolatedScan mIsolatedScan;
+
     // METHODS & FIELDS ONLY USED BY THE SKIA RENDERER
 public:
     /**
@@ -35,6 +35,7 @@ class DamageAccumulator;
 class LayerUpdateQueue;
 class RenderNode;
 class RenderState;
+struct SubtreePrepareTask;
 
 class ErrorHandler {
 public:
@@ -102,6 +103,13 @@ public:
 
     bool forceDrawFrame = false;
 
+    // Non-zero when independent subtrees may be prepared on the CommonPool threads, identifying
+    // the scan that found them. See RenderNode::prepareTree.
+    int64_t isolatedSubtreeScanId = 0;
+    // Set while preparing subtrees on a CommonPool thread, collecting the work that must still
+    // be done on the RenderThread.
+    SubtreePrepareTask* subtreePrepareTask = nullptr;
+
     struct Out {
         bool hasFunctors = false;
         // This is only updated if evaluateAnimations is true
@@ -29,6 +29,7 @@
 
 #ifdef __ANDROID__
 #include "renderthread/RenderThread.h"
+#include "thread/CommonPool.h"
 #endif
 
 #include <gui/TraceUtils.h>
@@ -49,7 +50,7 @@ void Path::dump() {
 Path::Path(const char* pathStr, size_t strLength) {
     PathParser::ParseResult result;
     Data data;
-    PathParser::getPathDataFromAsciiString(&data, &result, pathStr, strLength);
+    PathParser::getCachedPathDataFromAsciiString(&data, &result, pathStr, strLength);
     mStagingProperties.setData(data);
 }
 
@@ -197,6 +198,57 @@ void FullPath::draw(SkCanvas* outCanvas, bool useStagingData) {
     }
 }
 
+SkIRect FullPath::computeCacheBounds(const SkMatrix& matrix) {
+    SkPath tempStagingPath;
+    const SkPath& renderPath = getUpdatedPath(false, &tempStagingPath);
+    if (renderPath.isEmpty()) {
+        return SkIRect::MakeEmpty();
+    }
+
+    // Mirrors the fill and stroke decisions of draw().
+    SkRect bounds = SkRect::MakeEmpty();
+    if (mProperties.getFillGradient() != nullptr ||
+        mProperties.getFillColor() != SK_ColorTRANSPARENT) {
+        if (renderPath.isInverseFillType()) {
+            return SkIRect::MakeLargest();
+        }
+        bounds = renderPath.getBounds();
+    }
+    if (mProperties.getStrokeGradient() != nullptr ||
+        mProperties.getStrokeColor() != SK_ColorTRANSPARENT) {
+        SkPaint paint;
+        paint.setStyle(SkPaint::Style::kStroke_Style);
+        paint.setStrokeJoin(SkPaint::Join(mProperties.getStrokeLineJoin()));
+        paint.setStrokeCap(SkPaint::Cap(mProperties.getStrokeLineCap()));
+        paint.setStrokeMiter(mProperties.getStrokeMiterLimit());
+        paint.setStrokeWidth(mProperties.getStrokeWidth());
+        if (!paint.canComputeFastBounds()) {
+            return SkIRect::MakeLargest();
+        }
+        SkRect storage;
+        bounds.join(paint.computeFastBounds(renderPath.getBounds(), &storage));
+    }
+    if (bounds.isEmpty()) {
+        return SkIRect::MakeEmpty();
+    }
+    matrix.mapRect(&bounds);
+    // Antialiasing touches the pixels just outside of the geometry.
+    return bounds.roundOut().makeOutset(1, 1);
+}
+
+bool FullPath::collectDamage(const SkMatrix& matrix, bool parentDamaged, SkIRect* outDamage) {
+    if (!mDamaged && !parentDamaged) {
+        // Neither the path nor the transform it is drawn with changed.
+        return false;
+    }
+    SkIRect bounds = computeCacheBounds(matrix);
+    outDamage->join(mCachedBounds);
+    outDamage->join(bounds);
+    mCachedBounds = bounds;
+    mDamaged = false;
+    return false;
+}
+
 void FullPath::syncProperties() {
     Path::syncProperties();
 
@@ -273,6 +325,13 @@ void ClipPath::draw(SkCanvas* outCanvas, bool useStagingData) {
     outCanvas->clipPath(getUpdatedPath(useStagingData, &tempStagingPath), true);
 }
 
+bool ClipPath::collectDamage(const SkMatrix& matrix, bool parentDamaged, SkIRect* outDamage) {
+    // A clip draws nothing, but changes what the nodes drawn after it in the group cover.
+    bool damaged = mDamaged;
+    mDamaged = false;
+    return damaged;
+}
+
 Group::Group(const Group& group) : Node(group) {
     mStagingProperties.syncProperties(group.mStagingProperties);
 }
@@ -292,6 +351,19 @@ void Group::draw(SkCanvas* outCanvas, bool useStagingData) {
     // Restore the previous clip and matrix information.
 }
 
+bool Group::collectDamage(const SkMatrix& matrix, bool parentDamaged, SkIRect* outDamage) {
+    bool damaged = parentDamaged || mDamaged;
+    mDamaged = false;
+    SkMatrix localMatrix;
+    getLocalMatrix(&localMatrix, mProperties);
+    SkMatrix stackedMatrix = SkMatrix::Concat(matrix, localMatrix);
+    for (auto& child : mChildren) {
+        damaged |= child->collectDamage(stackedMatrix, damaged, outDamage);
+    }
+    // The group's clips are restored once its children are drawn.
+    return false;
+}
+
 void Group::dump() {
     ALOGD("Group %s has %zu children: ", mName.c_str(), mChildren.size());
     ALOGD("Group translateX, Y : %f, %f, scaleX, Y: %f, %f", mProperties.getTranslateX(),
@@ -487,8 +559,12 @@ void Tree::getPaintFor(Paint* outPaint, const TreeProperties& prop) const {
 }
 
 Bitmap& Tree::getBitmapUpdateIfDirty() {
+    waitForRaster();
     bool redrawNeeded = allocateBitmapIfNeeded(mCache, mProperties.getScaledWidth(),
                                                mProperties.getScaledHeight());
+    if (redrawNeeded) {
+        mCacheComplete = false;
+    }
     if (redrawNeeded || mCache.dirty) {
         updateBitmapCache(*mCache.bitmap, false);
         mCache.dirty = false;
@@ -496,6 +572,30 @@ Bitmap& Tree::getBitmapUpdateIfDirty() {
     return *mCache.bitmap;
 }
 
+#ifdef __ANDROID__ // Layoutlib does not support CommonPool
+void Tree::rasterAsync() {
+    if (mPendingRaster.valid()) {
+        return;
+    }
+    if (allocateBitmapIfNeeded(mCache, mProperties.getScaledWidth(),
+                               mProperties.getScaledHeight())) {
+        mCacheComplete = false;
+    } else if (!mCache.dirty || mCacheComplete) {
+        // Nothing to repaint, or only the nodes that changed, which is left to draw().
+        return;
+    }
+    mCache.dirty = false;
+    mPendingRaster = CommonPool::async([this]() { updateBitmapCache(*mCache.bitmap, false); },
+                                       CommonPool::Priority::High);
+}
+#endif
+
+void Tree::waitForRaster() {
+    if (mPendingRaster.valid()) {
+        mPendingRaster.get();
+    }
+}
+
 void Tree::draw(SkCanvas* canvas, const SkRect& bounds, const SkPaint& inPaint) {
     if (canvas->quickReject(bounds)) {
         // The RenderNode is on screen, but the AVD is not.
@@ -521,8 +621,6 @@ void Tree::updateBitmapCache(Bitmap& bitmap, bool useStagingData) {
     bitmap.getSkBitmap(&outCache);
     int cacheWidth = outCache.width();
     int cacheHeight = outCache.height();
-    ATRACE_FORMAT("VectorDrawable repaint %dx%d", cacheWidth, cacheHeight);
-    outCache.eraseColor(SK_ColorTRANSPARENT);
     SkCanvas outCanvas(outCache);
     float viewportWidth =
             useStagingData ? mStagingProperties.getViewportWidth() : mProperties.getViewportWidth();
@@ -530,7 +628,33 @@ void Tree::updateBitmapCache(Bitmap& bitmap, bool useStagingData) {
                                           : mProperties.getViewportHeight();
     float scaleX = cacheWidth / viewportWidth;
     float scaleY = cacheHeight / viewportHeight;
-    outCanvas.scale(scaleX, scaleY);
+    SkMatrix scale = SkMatrix::Scale(scaleX, scaleY);
+
+    if (useStagingData || !mCacheComplete) {
+        ATRACE_FORMAT("VectorDrawable repaint %dx%d", cacheWidth, cacheHeight);
+        outCache.eraseColor(SK_ColorTRANSPARENT);
+        if (!useStagingData) {
+            // Record what every node covers, for the partial repaints to come.
+            SkIRect ignored = SkIRect::MakeEmpty();
+            mRootNode->collectDamage(scale, true, &ignored);
+            mCacheComplete = true;
+        }
+    } else {
+        // Only the pixels covered by the nodes that changed, before or after the change, need
+        // to be repainted. Drawing the whole tree clipped to them leaves the others untouched.
+        SkIRect damage = SkIRect::MakeEmpty();
+        mRootNode->collectDamage(scale, false, &damage);
+        if (!damage.intersect(SkIRect::MakeWH(cacheWidth, cacheHeight))) {
+            return;
+        }
+        ATRACE_FORMAT("VectorDrawable partial repaint %dx%d of %dx%d", damage.width(),
+                      damage.height(), cacheWidth, cacheHeight);
+        // Erasing through the bitmap, rather than the canvas, bumps its generation id so the
+        // texture made from it is uploaded again.
+        outCache.erase(SK_ColorTRANSPARENT, damage);
+        outCanvas.clipRect(SkRect::Make(damage));
+    }
+    outCanvas.concat(scale);
     mRootNode->draw(&outCanvas, useStagingData);
 }
 
@@ -37,6 +37,7 @@
 
 #include <cutils/compiler.h>
 #include <stddef.h>
+#include <future>
 #include <string>
 #include <vector>
 
@@ -123,9 +124,21 @@ public:
 
     virtual void forEachFillColor(const std::function<void(SkColor)>& func) const { }
 
+    // Render thread only. If the node changed since the last raster of the cache, or
+    // parentDamaged is set, adds the cache pixels it covered then and those it covers now
+    // under matrix to outDamage. Returns whether the nodes drawn after it within the same
+    // group are affected too, which is the case of a changed clip.
+    virtual bool collectDamage(const SkMatrix& matrix, bool parentDamaged,
+                               SkIRect* outDamage) = 0;
+
 protected:
     std::string mName;
     PropertyChangedListener* mPropertyChangedListener = nullptr;
+
+    // Internal data, render thread only. Whether the properties changed since the last raster
+    // of the cache, and the cache pixels the node covered in it.
+    bool mDamaged = true;
+    SkIRect mCachedBounds = SkIRect::MakeEmpty();
 };
 
 class Path : public Node {
@@ -177,6 +190,7 @@ public:
             }
         } else if (prop == &mProperties) {
             mSkPathDirty = true;
+            mDamaged = true;
             if (mPropertyChangedListener) {
                 mPropertyChangedListener->onPropertyChanged();
             }
@@ -346,6 +360,7 @@ public:
                 mPropertyChangedListener->onStagingPropertyChanged();
             }
         } else if (properties == &mProperties) {
+            mDamaged = true;
             if (mPropertyChangedListener) {
                 mPropertyChangedListener->onPropertyChanged();
             }
@@ -355,11 +370,15 @@ public:
     void forEachFillColor(const std::function<void(SkColor)>& func) const override {
         func(mStagingProperties.getFillColor());
     }
+    bool collectDamage(const SkMatrix& matrix, bool parentDamaged, SkIRect* outDamage) override;
 
 protected:
     const SkPath& getUpdatedPath(bool useStagingData, SkPath* tempStagingPath) override;
 
 private:
+    // The cache pixels the fill and stroke of the path cover under matrix.
+    SkIRect computeCacheBounds(const SkMatrix& matrix);
+
     FullPathProperties mProperties = FullPathProperties(this);
     FullPathProperties mStagingProperties = FullPathProperties(this);
     bool mStagingPropertiesDirty = true;
@@ -377,6 +396,7 @@ public:
     ClipPath() : Path() {}
     void draw(SkCanvas* outCanvas, bool useStagingData) override;
     virtual void setAntiAlias(bool aa) {}
+    bool collectDamage(const SkMatrix& matrix, bool parentDamaged, SkIRect* outDamage) override;
 };
 
 class Group : public Node {
@@ -474,12 +494,15 @@ public:
                 mPropertyChangedListener->onStagingPropertyChanged();
             }
         } else {
+            mDamaged = true;
             if (mPropertyChangedListener) {
                 mPropertyChangedListener->onPropertyChanged();
             }
         }
     }
 
+    bool collectDamage(const SkMatrix& matrix, bool parentDamaged, SkIRect* outDamage) override;
+
     virtual void setAntiAlias(bool aa) {
         for (auto& child : mChildren) {
             child->setAntiAlias(aa);
@@ -517,19 +540,32 @@ public:
     void drawStaging(Canvas* canvas);
 
     Bitmap& getBitmapUpdateIfDirty();
+#ifdef __ANDROID__ // Layoutlib does not support CommonPool
+    // Starts repainting the render thread cache on a CommonPool thread if it needs to be
+    // repainted in full, e.g. when the tree is first drawn or resized. The tree's render
+    // thread state must not be changed until waitForRaster() returns.
+    void rasterAsync();
+#endif
+    // Waits for the raster started by rasterAsync(), if any.
+    void waitForRaster();
     void setAllowCaching(bool allowCaching) { mAllowCaching = allowCaching; }
     void syncProperties() {
+        waitForRaster();
         if (mStagingProperties.mNonAnimatablePropertiesDirty) {
-            mCache.dirty |= (mProperties.mNonAnimatableProperties.viewportWidth !=
-                             mStagingProperties.mNonAnimatableProperties.viewportWidth) ||
-                            (mProperties.mNonAnimatableProperties.viewportHeight !=
-                             mStagingProperties.mNonAnimatableProperties.viewportHeight) ||
-                            (mProperties.mNonAnimatableProperties.scaledWidth !=
-                             mStagingProperties.mNonAnimatableProperties.scaledWidth) ||
-                            (mProperties.mNonAnimatableProperties.scaledHeight !=
-                             mStagingProperties.mNonAnimatableProperties.scaledHeight) ||
-                            (mProperties.mNonAnimatableProperties.bounds !=
-                             mStagingProperties.mNonAnimatableProperties.bounds);
+            bool geometryChanged = (mProperties.mNonAnimatableProperties.viewportWidth !=
+                                    mStagingProperties.mNonAnimatableProperties.viewportWidth) ||
+                                   (mProperties.mNonAnimatableProperties.viewportHeight !=
+                                    mStagingProperties.mNonAnimatableProperties.viewportHeight) ||
+                                   (mProperties.mNonAnimatableProperties.scaledWidth !=
+                                    mStagingProperties.mNonAnimatableProperties.scaledWidth) ||
+                                   (mProperties.mNonAnimatableProperties.scaledHeight !=
+                                    mStagingProperties.mNonAnimatableProperties.scaledHeight) ||
+                                   (mProperties.mNonAnimatableProperties.bounds !=
+                                    mStagingProperties.mNonAnimatableProperties.bounds);
+            if (geometryChanged) {
+                mCache.dirty = true;
+                mCacheComplete = false;
+            }
             mProperties.syncNonAnimatableProperties(mStagingProperties);
             mStagingProperties.mNonAnimatablePropertiesDirty = false;
         }
@@ -678,6 +714,10 @@ private:
 
     Cache mStagingCache;
     Cache mCache;
+    // Render thread only. Whether mCache holds a raster of the tree at the current size, over
+    // which only the nodes that changed since need to be repainted.
+    bool mCacheComplete = false;
+    std::future<void> mPendingRaster;
 
     PropertyChangedListener mPropertyChangedListener =
             PropertyChangedListener(&mCache.dirty, &mStagingCache.dirty);
@@ -63,6 +63,10 @@ RenderMode WebViewFunctor_queryPlatformRenderMode() {
             return RenderMode::OpenGL_ES;
         case RenderPipelineType::SkiaVulkan:
             return RenderMode::Vulkan;
+        case RenderPipelineType::SkiaCpu:
+            // GL functors are never invoked by the CPU pipeline, GLFunctorDrawable draws a
+            // placeholder in their place.
+            return RenderMode::OpenGL_ES;
         default:
             LOG_ALWAYS_FATAL("Unknown render pipeline type: %d", (int)pipelineType);
     }
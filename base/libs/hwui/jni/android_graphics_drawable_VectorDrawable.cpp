@@ -185,7 +185,7 @@ static void setPathString(JNIEnv* env, jobject, jlong pathPtr, jstring inputStr,
 
     PathParser::ParseResult result;
     PathData data;
-    PathParser::getPathDataFromAsciiString(&data, &result, pathString, stringLength);
+    PathParser::getCachedPathDataFromAsciiString(&data, &result, pathString, stringLength);
     if (result.failureOccurred) {
         doThrowIAE(env, result.failureMessage.c_str());
     }
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SkiaCpuPipeline.h"
+
+#include <SkImageInfo.h>
+#include <SkSurface.h>
+#include <android/hardware_buffer.h>
+#include <gui/TraceUtils.h>
+
+#include "DeferredLayerUpdater.h"
+#include "FrameInfo.h"
+#include "LightingInfo.h"
+#include "SkiaProfileRenderer.h"
+#include "renderthread/Frame.h"
+#include "renderthread/IRenderPipeline.h"
+#include "utils/Color.h"
+
+using namespace android::uirenderer::renderthread;
+
+namespace android {
+namespace uirenderer {
+namespace skiapipeline {
+
+SkiaCpuPipeline::SkiaCpuPipeline(RenderThread& thread) : SkiaPipeline(thread) {}
+
+SkiaCpuPipeline::~SkiaCpuPipeline() {
+    disconnect();
+}
+
+MakeCurrentResult SkiaCpuPipeline::makeCurrent() {
+    // There is no context to make current, the window is locked for each frame.
+    return MakeCurrentResult::AlreadyCurrent;
+}
+
+Frame SkiaCpuPipeline::getFrame() {
+    LOG_ALWAYS_FATAL_IF(mNativeWindow == nullptr,
+                        "getFrame() called on a context with no surface!");
+    // ANativeWindow_lock() copies what lies outside of the dirty area from the previously
+    // posted buffer, so once a frame was posted every locked buffer starts from it.
+    return Frame(ANativeWindow_getWidth(mNativeWindow.get()),
+                 ANativeWindow_getHeight(mNativeWindow.get()), mHasPostedFrame ? 1 : 0);
+}
+
+sk_sp<SkSurface> SkiaCpuPipeline::lockWindowSurface(const Frame& frame, const SkRect& screenDirty,
+                                                    SkRect* lockedDirty) {
+    SkIRect dirty = screenDirty.roundOut();
+    if (!dirty.intersect(SkIRect::MakeWH(frame.width(), frame.height()))) {
+        dirty = SkIRect::MakeWH(frame.width(), frame.height());
+    }
+    // The window may grow the dirty area, e.g. when there is no previous buffer to copy from.
+    ARect bounds = {dirty.fLeft, dirty.fTop, dirty.fRight, dirty.fBottom};
+    ANativeWindow_Buffer buffer;
+    if (ANativeWindow_lock(mNativeWindow.get(), &buffer, &bounds) != 0) {
+        ALOGE("Failed to lock the window for drawing");
+        return nullptr;
+    }
+    mConnected = true;
+    mWindowLocked = true;
+    lockedDirty->setLTRB(bounds.left, bounds.top, bounds.right, bounds.bottom);
+
+    SkImageInfo info = SkImageInfo::Make(buffer.width, buffer.height,
+                                         BufferFormatToColorType(buffer.format),
+                                         kPremul_SkAlphaType, mSurfaceColorSpace);
+    SkSurfaceProps props(mColorMode == ColorMode::Default ? 0 : SkSurfaceProps::kAlwaysDither_Flag,
+                         kUnknown_SkPixelGeometry);
+    return SkSurface::MakeRasterDirect(info, buffer.bits, buffer.stride * info.bytesPerPixel(),
+                                       &props);
+}
+
+sk_sp<SkSurface> SkiaCpuPipeline::lockBufferSurface(const HardwareBufferRenderParams& params) {
+    AHardwareBuffer_Desc desc;
+    AHardwareBuffer_describe(mHardwareBuffer, &desc);
+    void* pixels = nullptr;
+    if (AHardwareBuffer_lock(mHardwareBuffer, AHARDWAREBUFFER_USAGE_CPU_WRITE_OFTEN, -1, nullptr,
+                             &pixels) != 0) {
+        ALOGE("Failed to lock the hardware buffer for drawing");
+        return nullptr;
+    }
+    SkImageInfo info = SkImageInfo::Make(desc.width, desc.height,
+                                         BufferFormatToColorType(desc.format),
+                                         kPremul_SkAlphaType, params.getColorSpace());
+    sk_sp<SkSurface> surface =
+            SkSurface::MakeRasterDirect(info, pixels, desc.stride * info.bytesPerPixel());
+    if (surface.get() == nullptr) {
+        AHardwareBuffer_unlock(mHardwareBuffer, nullptr);
+    }
+    return surface;
+}
+
+IRenderPipeline::DrawResult SkiaCpuPipeline::draw(
+        const Frame& frame, const SkRect& screenDirty, const SkRect& dirty,
+        const LightGeometry& lightGeometry, LayerUpdateQueue* layerUpdateQueue,
+        const Rect& contentDrawBounds, bool opaque, const LightInfo& lightInfo,
+        const std::vector<sp<RenderNode>>& renderNodes, FrameInfoVisualizer* profiler,
+        const HardwareBufferRenderParams& bufferParams) {
+    sk_sp<SkSurface> surface;
+    SkMatrix preTransform;
+    SkRect clip = dirty;
+    if (mHardwareBuffer) {
+        surface = lockBufferSurface(bufferParams);
+        preTransform = bufferParams.getTransform();
+    } else {
+        surface = lockWindowSurface(frame, screenDirty, &clip);
+        preTransform = SkMatrix::I();
+    }
+
+    if (surface.get() == nullptr) {
+        return {false, IRenderPipeline::DrawResult::kUnknownTime};
+    }
+
+    SkPoint lightCenter = preTransform.mapXY(lightGeometry.center.x, lightGeometry.center.y);
+    LightGeometry localGeometry = lightGeometry;
+    localGeometry.center.x = lightCenter.fX;
+    localGeometry.center.y = lightCenter.fY;
+    LightingInfo::updateLighting(localGeometry, lightInfo);
+    renderFrame(*layerUpdateQueue, clip, renderNodes, opaque, contentDrawBounds, surface,
+                preTransform);
+
+    // Draw visual debugging features
+    if (CC_UNLIKELY(Properties::showDirtyRegions ||
+                    ProfileType::None != Properties::getProfileType())) {
+        SkCanvas* profileCanvas = surface->getCanvas();
+        SkiaProfileRenderer profileRenderer(profileCanvas, frame.width(), frame.height());
+        profiler->draw(profileRenderer);
+    }
+    layerUpdateQueue->clear();
+
+    if (mHardwareBuffer) {
+        AHardwareBuffer_unlock(mHardwareBuffer, nullptr);
+    }
+
+    // The pixels are all written by now, there is no command submission to wait for.
+    return {true, IRenderPipeline::DrawResult::kUnknownTime};
+}
+
+bool SkiaCpuPipeline::swapBuffers(const Frame& frame, bool drew, const SkRect& screenDirty,
+                                  FrameInfo* currentFrameInfo, bool* requireSwap) {
+    // Even if we decided to cancel the frame, from the perspective of jank
+    // metrics the frame was swapped at this point
+    currentFrameInfo->markSwapBuffers();
+
+    if (mHardwareBuffer) {
+        return false;
+    }
+
+    *requireSwap = drew;
+    if (!mWindowLocked) {
+        return false;
+    }
+
+    // A locked buffer can't be cancelled, so it's posted even if drawing failed. Its content is
+    // then unknown, and the next frame is drawn in full.
+    mWindowLocked = false;
+    mHasPostedFrame = false;
+    if (ANativeWindow_unlockAndPost(mNativeWindow.get()) != 0) {
+        ALOGE("Failed to post the window buffer");
+        return false;
+    }
+    mHasPostedFrame = drew;
+    return drew;
+}
+
+DeferredLayerUpdater* SkiaCpuPipeline::createTextureLayer() {
+    ALOGW("Texture layers need a GPU context, unsupported by the CPU pipeline");
+    return nullptr;
+}
+
+[[nodiscard]] android::base::unique_fd SkiaCpuPipeline::flush() {
+    // Drawing is done once draw() returns, there is nothing to wait for.
+    return android::base::unique_fd();
+}
+
+void SkiaCpuPipeline::onStop() {}
+
+bool SkiaCpuPipeline::setSurface(ANativeWindow* surface, SwapBehavior /*swapBehavior*/) {
+    if (surface != mNativeWindow.get()) {
+        disconnect();
+    }
+    mNativeWindow = surface;
+    mHasPostedFrame = false;
+
+    if (surface) {
+        ANativeWindow_setBuffersGeometry(surface, 0, 0, ColorTypeToBufferFormat(mSurfaceColorType));
+        ANativeWindow_setBuffersDataSpace(
+                surface, ColorSpaceToADataSpace(mSurfaceColorSpace.get(), mSurfaceColorType));
+    }
+    return surface != nullptr;
+}
+
+void SkiaCpuPipeline::disconnect() {
+    if (mNativeWindow && mConnected) {
+        native_window_api_disconnect(mNativeWindow.get(), NATIVE_WINDOW_API_CPU);
+    }
+    mConnected = false;
+    mWindowLocked = false;
+}
+
+bool SkiaCpuPipeline::isSurfaceReady() {
+    return mNativeWindow != nullptr;
+}
+
+bool SkiaCpuPipeline::isContextReady() {
+    return true;
+}
+
+void SkiaCpuPipeline::invokeFunctor(const RenderThread& thread, Functor* functor) {
+    ALOGW("Functors need a GPU context, not invoking it with the CPU pipeline");
+}
+
+} /* namespace skiapipeline */
+} /* namespace uirenderer */
+} /* namespace android */
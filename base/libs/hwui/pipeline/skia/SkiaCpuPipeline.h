@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android/native_window.h>
+#include <system/window.h>
+
+#include "SkiaPipeline.h"
+#include "renderthread/HardwareBufferRenderParams.h"
+
+namespace android {
+namespace uirenderer {
+namespace skiapipeline {
+
+/**
+ * Pipeline rasterizing frames with Skia's CPU backend straight into the buffers of the
+ * window, locked with ANativeWindow_lock(), or into the CPU mapping of the hardware buffer.
+ * It needs neither a GrContext nor a GPU, which lets the RenderThread CPU paths (tree
+ * preparation, display list replay, damage) be measured on devices without one.
+ */
+class SkiaCpuPipeline : public SkiaPipeline {
+public:
+    explicit SkiaCpuPipeline(renderthread::RenderThread& thread);
+    virtual ~SkiaCpuPipeline();
+
+    renderthread::MakeCurrentResult makeCurrent() override;
+    renderthread::Frame getFrame() override;
+    renderthread::IRenderPipeline::DrawResult draw(
+            const renderthread::Frame& frame, const SkRect& screenDirty, const SkRect& dirty,
+            const LightGeometry& lightGeometry, LayerUpdateQueue* layerUpdateQueue,
+            const Rect& contentDrawBounds, bool opaque, const LightInfo& lightInfo,
+            const std::vector<sp<RenderNode> >& renderNodes, FrameInfoVisualizer* profiler,
+            const renderthread::HardwareBufferRenderParams& bufferParams) override;
+    GrSurfaceOrigin getSurfaceOrigin() override { return kTopLeft_GrSurfaceOrigin; }
+    bool swapBuffers(const renderthread::Frame& frame, bool drew, const SkRect& screenDirty,
+                     FrameInfo* currentFrameInfo, bool* requireSwap) override;
+    DeferredLayerUpdater* createTextureLayer() override;
+    [[nodiscard]] android::base::unique_fd flush() override;
+
+    bool setSurface(ANativeWindow* surface, renderthread::SwapBehavior swapBehavior) override;
+    void onStop() override;
+    bool isSurfaceReady() override;
+    bool isContextReady() override;
+
+    // Images are drawn from their pixels, there is nothing to upload or pin.
+    using SkiaPipeline::pinImages;
+    bool pinImages(std::vector<SkImage*>& mutableImages) override { return true; }
+
+    const SkM44& getPixelSnapMatrix() const override {
+        static const SkM44 sSnapMatrix;
+        return sSnapMatrix;
+    }
+
+    static void invokeFunctor(const renderthread::RenderThread& thread, Functor* functor);
+
+private:
+    // Lock the buffer to draw into and wrap it in a raster surface. The window is unlocked in
+    // swapBuffers(), the hardware buffer at the end of draw().
+    sk_sp<SkSurface> lockWindowSurface(const renderthread::Frame& frame, const SkRect& screenDirty,
+                                       SkRect* lockedDirty);
+    sk_sp<SkSurface> lockBufferSurface(const renderthread::HardwareBufferRenderParams& params);
+    void disconnect();
+
+    sp<ANativeWindow> mNativeWindow;
+    // Whether a buffer of mNativeWindow is locked, between draw() and swapBuffers().
+    bool mWindowLocked = false;
+    // Whether the window holds a frame we drew, which the next locked buffer starts from.
+    bool mHasPostedFrame = false;
+    // Whether ANativeWindow_lock() connected to mNativeWindow as a CPU producer.
+    bool mConnected = false;
+};
+
+} /* namespace skiapipeline */
+} /* namespace uirenderer */
+} /* namespace android */
@@ -23,6 +23,7 @@
 #else
 #include "DamageAccumulator.h"
 #endif
+#include "Properties.h"
 #include "TreeInfo.h"
 #include "VectorDrawable.h"
 #ifdef __ANDROID__
@@ -164,6 +165,11 @@ bool SkiaDisplayList::prepareListAndChildren(
             if (intersects(info.screenSize, totalMatrix, bounds)) {
                 isDirty = true;
                 vectorDrawable->setPropertyChangeWillBeConsumed(true);
+#ifdef __ANDROID__ // Layoutlib does not support CanvasContext
+                if (Properties::asyncVectorDrawableRaster) {
+                    info.canvasContext.deferVectorDrawableRaster(vectorDrawable);
+                }
+#endif
             }
         }
     }
@@ -96,6 +96,16 @@ public:
 
     bool hasText() const { return mDisplayList.hasText(); }
 
+    /**
+     * Returns true if preparing this list only touches the list and its child RenderNodes, so
+     * that it may happen off the RenderThread: there are no functors, vector drawables,
+     * animated images or meshes to update, no mutable images to pin and no projection receiver.
+     */
+    bool canPrepareOffRenderThread() const {
+        return mChildFunctors.empty() && mVectorDrawables.empty() && mAnimatedImages.empty() &&
+               mMeshes.empty() && mMutableImages.empty() && !mProjectionReceiver;
+    }
+
     /**
      * Attempts to reset and reuse this DisplayList.
      *
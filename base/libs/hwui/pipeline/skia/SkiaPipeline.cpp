@@ -186,10 +186,14 @@ bool SkiaPipeline::createOrUpdateLayer(RenderNode* node, const DamageAccumulator
         info = SkImageInfo::Make(surfaceWidth, surfaceHeight, getSurfaceColorType(),
                                  kPremul_SkAlphaType, getSurfaceColorSpace());
         SkSurfaceProps props(0, kUnknown_SkPixelGeometry);
-        SkASSERT(mRenderThread.getGrContext() != nullptr);
-        node->setLayerSurface(SkSurface::MakeRenderTarget(mRenderThread.getGrContext(),
-                                                          skgpu::Budgeted::kYes, info, 0,
-                                                          this->getSurfaceOrigin(), &props));
+        if (Properties::getRenderPipelineType() == RenderPipelineType::SkiaCpu) {
+            node->setLayerSurface(SkSurface::MakeRaster(info, &props));
+        } else {
+            SkASSERT(mRenderThread.getGrContext() != nullptr);
+            node->setLayerSurface(SkSurface::MakeRenderTarget(mRenderThread.getGrContext(),
+                                                              skgpu::Budgeted::kYes, info, 0,
+                                                              this->getSurfaceOrigin(), &props));
+        }
         if (node->getLayerSurface()) {
             // update the transform in window of the layer to reset its origin wrt light source
             // position
@@ -591,10 +595,14 @@ void SkiaPipeline::renderFrameImpl(const SkRect& clip,
 }
 
 void SkiaPipeline::dumpResourceCacheUsage() const {
+    GrDirectContext* context = mRenderThread.getGrContext();
+    if (!context) {
+        return;
+    }
     int resources;
     size_t bytes;
-    mRenderThread.getGrContext()->getResourceCacheUsage(&resources, &bytes);
-    size_t maxBytes = mRenderThread.getGrContext()->getResourceCacheLimit();
+    context->getResourceCacheUsage(&resources, &bytes);
+    size_t maxBytes = context->getResourceCacheLimit();
 
     SkString log("Resource Cache Usage:\n");
     log.appendf("%8d items\n", resources);
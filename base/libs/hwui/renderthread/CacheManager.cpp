@@ -22,6 +22,7 @@
 #include <math.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <set>
 
 #include "CanvasContext.h"
@@ -40,6 +41,92 @@ namespace android {
 namespace uirenderer {
 namespace renderthread {
 
+// The cache counts as full once it reaches this share of its limit, Skia has started evicting by
+// then as the usage only counts what survived.
+static constexpr float kFullCacheFraction = 0.95f;
+// How many frames of a period have to end with a full cache before the limit grows.
+static constexpr int kFramesAtLimitToGrow = 8;
+// How long the working set is watched before the limit may shrink.
+static constexpr nsecs_t kBudgetPeriod = 5_s;
+// Bytes coming back this soon after a purge are counted as re-uploads.
+static constexpr nsecs_t kReuploadWindow = 2_s;
+// How often resources are aged out while the cache holds more than its base limit.
+static constexpr nsecs_t kResourceAgingInterval = 1_s;
+
+void CacheBudget::setBaseLimit(size_t baseLimit, float maxScale) {
+    mBaseLimit = baseLimit;
+    mMaxLimit = std::max(baseLimit, static_cast<size_t>(baseLimit * maxScale));
+    mLimit = std::clamp(mLimit, mBaseLimit, mMaxLimit);
+}
+
+bool CacheBudget::onFrameCompleted(size_t cacheBytes, nsecs_t now) {
+    if (cacheBytes > mLastCacheBytes) {
+        size_t added = cacheBytes - mLastCacheBytes;
+        mStats.bytesAdded += added;
+        if (now - mLastPurge < kReuploadWindow) {
+            size_t reuploaded = std::min(added, mReuploadableBytes);
+            mStats.bytesReuploaded += reuploaded;
+            mReuploadableBytes -= reuploaded;
+        }
+    } else {
+        mStats.cachedFrames++;
+    }
+    mLastCacheBytes = cacheBytes;
+
+    if (mPeriodStart == 0) {
+        startPeriod(now);
+    }
+    mPeriodPeakBytes = std::max(mPeriodPeakBytes, cacheBytes);
+
+    if (cacheBytes >= static_cast<size_t>(mLimit * kFullCacheFraction)) {
+        mStats.framesAtLimit++;
+        if (++mPeriodFramesAtLimit >= kFramesAtLimitToGrow && mLimit < mMaxLimit) {
+            mLimit = std::min(mMaxLimit, mLimit + mBaseLimit / 4);
+            mStats.limitIncreases++;
+            startPeriod(now);
+            return true;
+        }
+    }
+
+    if (now - mPeriodStart < kBudgetPeriod) {
+        return false;
+    }
+    // Keep half again the peak as headroom, so that the next shrink only comes after the working
+    // set shrank further.
+    size_t target = std::max(mBaseLimit, mPeriodPeakBytes + mPeriodPeakBytes / 2);
+    bool shrink = mPeriodFramesAtLimit == 0 && mPeriodPeakBytes < mLimit / 2 && target < mLimit;
+    startPeriod(now);
+    if (shrink) {
+        mLimit = target;
+        mStats.limitDecreases++;
+    }
+    return shrink;
+}
+
+void CacheBudget::onPurged(size_t bytesBefore, size_t bytesAfter, nsecs_t now) {
+    if (bytesBefore > bytesAfter) {
+        size_t purged = bytesBefore - bytesAfter;
+        mStats.bytesPurged += purged;
+        mReuploadableBytes = (now - mLastPurge < kReuploadWindow ? mReuploadableBytes : 0) + purged;
+        mLastPurge = now;
+    }
+    mLastCacheBytes = bytesAfter;
+}
+
+void CacheBudget::reset() {
+    mLimit = mBaseLimit;
+    mLastCacheBytes = 0;
+    mPeriodStart = 0;
+    mPeriodPeakBytes = 0;
+    mPeriodFramesAtLimit = 0;
+}
+
+void CacheBudget::startPeriod(nsecs_t now) {
+    mPeriodStart = now;
+    mPeriodPeakBytes = 0;
+    mPeriodFramesAtLimit = 0;
+}
+
 CacheManager::CacheManager(RenderThread& thread)
         : mRenderThread(thread), mMemoryPolicy(loadMemoryPolicy()) {
     mMaxSurfaceArea = static_cast<size_t>((DeviceInfo::getWidth() * DeviceInfo::getHeight()) *
@@ -70,8 +157,9 @@ void CacheManager::setupCacheLimits() {
     mBackgroundCpuFontCacheBytes = mMaxCpuFontCacheBytes * mMemoryPolicy.backgroundRetentionPercent;
 
     SkGraphics::SetFontCacheLimit(mMaxCpuFontCacheBytes);
+    mBudget.setBaseLimit(mMaxResourceBytes, mMemoryPolicy.maxResourceBudgetScale);
     if (mGrContext) {
-        mGrContext->setResourceCacheLimit(mMaxResourceBytes);
+        mGrContext->setResourceCacheLimit(mBudget.limit());
     }
 }
 
@@ -82,7 +170,7 @@ void CacheManager::reset(sk_sp<GrDirectContext> context) {
 
     if (context) {
         mGrContext = std::move(context);
-        mGrContext->setResourceCacheLimit(mMaxResourceBytes);
+        mGrContext->setResourceCacheLimit(mBudget.limit());
         mLastDeferredCleanup = systemTime(CLOCK_MONOTONIC);
     }
 }
@@ -90,6 +178,15 @@ void CacheManager::reset(sk_sp<GrDirectContext> context) {
 void CacheManager::destroy() {
     // cleanup any caches here as the GrContext is about to go away...
     mGrContext.reset(nullptr);
+    mBudget.reset();
+}
+
+size_t CacheManager::getResourceCacheBytes() {
+    size_t cacheBytes = 0;
+    if (mGrContext) {
+        mGrContext->getResourceCacheUsage(nullptr, &cacheBytes);
+    }
+    return cacheBytes;
 }
 
 class CommonPoolExecutor : public SkExecutor {
@@ -118,9 +215,12 @@ void CacheManager::trimMemory(TrimLevel mode) {
     // flush and submit all work to the gpu and wait for it to finish
     mGrContext->flushAndSubmit(/*syncCpu=*/true);
 
+    const nsecs_t now = systemTime(CLOCK_MONOTONIC);
+    const size_t cacheBytes = getResourceCacheBytes();
     switch (mode) {
         case TrimLevel::BACKGROUND:
             mGrContext->freeGpuResources();
+            mBudget.onPurged(cacheBytes, getResourceCacheBytes(), now);
             SkGraphics::PurgeAllCaches();
             mRenderThread.destroyRenderingContext();
             break;
@@ -131,7 +231,10 @@ void CacheManager::trimMemory(TrimLevel mode) {
             mGrContext->setResourceCacheLimit(mBackgroundResourceBytes);
             SkGraphics::SetFontCacheLimit(mBackgroundCpuFontCacheBytes);
             mGrContext->purgeUnlockedResources(mMemoryPolicy.purgeScratchOnly);
-            mGrContext->setResourceCacheLimit(mMaxResourceBytes);
+            mBudget.onPurged(cacheBytes, getResourceCacheBytes(), now);
+            // Whatever the frames needed so far has just been purged, start over from the base.
+            mBudget.reset();
+            mGrContext->setResourceCacheLimit(mBudget.limit());
             SkGraphics::SetFontCacheLimit(mMaxCpuFontCacheBytes);
             break;
         default:
@@ -150,7 +253,9 @@ void CacheManager::trimCaches(CacheTrimLevel mode) {
         case CacheTrimLevel::ALL_CACHES:
             SkGraphics::PurgeAllCaches();
             if (mGrContext) {
+                size_t cacheBytes = getResourceCacheBytes();
                 mGrContext->purgeUnlockedResources(false);
+                mBudget.onPurged(cacheBytes, getResourceCacheBytes(), systemTime(CLOCK_MONOTONIC));
             }
             break;
         default:
@@ -163,7 +268,9 @@ void CacheManager::trimStaleResources() {
         return;
     }
     mGrContext->flushAndSubmit();
+    size_t cacheBytes = getResourceCacheBytes();
     mGrContext->purgeResourcesNotUsedInMs(std::chrono::seconds(30));
+    mBudget.onPurged(cacheBytes, getResourceCacheBytes(), systemTime(CLOCK_MONOTONIC));
 }
 
 void CacheManager::getMemoryUsage(size_t* cpuUsage, size_t* gpuUsage) {
@@ -196,6 +303,18 @@ void CacheManager::dumpMemoryUsage(String8& log, const RenderState* renderState)
         log.appendFormat("  IsSystemOrPersistent\n");
     }
     log.appendFormat("  GPU Context timeout: %" PRIu64 "\n", ns2s(mMemoryPolicy.contextTimeout));
+    const CacheBudget::Stats& budgetStats = mBudget.stats();
+    log.appendFormat(R"(Resource budget: %.2fMB (base %.2fMB, max %.2fMB)
+  Limit changes: %u up, %u down
+  Frames: %)" PRIu64 R"( without uploads, %)" PRIu64 R"( at limit
+  Added: %.2fMB, re-uploaded after purges: %.2fMB
+  Purged: %.2fMB
+)",
+                     mBudget.limit() / 1000000.f, mBudget.baseLimit() / 1000000.f,
+                     mBudget.maxLimit() / 1000000.f, budgetStats.limitIncreases,
+                     budgetStats.limitDecreases, budgetStats.cachedFrames,
+                     budgetStats.framesAtLimit, budgetStats.bytesAdded / 1000000.f,
+                     budgetStats.bytesReuploaded / 1000000.f, budgetStats.bytesPurged / 1000000.f);
     size_t stoppedContexts = 0;
     for (auto context : mCanvasContexts) {
         if (context->isStopped()) stoppedContexts++;
@@ -260,7 +379,11 @@ void CacheManager::dumpMemoryUsage(String8& log, const RenderState* renderState)
 
 void CacheManager::onFrameCompleted() {
     cancelDestroyContext();
-    mFrameCompletions.next() = systemTime(CLOCK_MONOTONIC);
+    const nsecs_t now = systemTime(CLOCK_MONOTONIC);
+    mFrameCompletions.next() = now;
+    if (mGrContext && mBudget.onFrameCompleted(getResourceCacheBytes(), now)) {
+        mGrContext->setResourceCacheLimit(mBudget.limit());
+    }
     if (ATRACE_ENABLED()) {
         static skiapipeline::ATraceMemoryDump tracer;
         tracer.startFrame();
@@ -283,8 +406,23 @@ void CacheManager::onThreadIdle() {
         const nsecs_t frameDiffNanos = now - frameCompleteNanos;
         const nsecs_t cleanupMillis =
                 ns2ms(std::max(frameDiffNanos, mMemoryPolicy.minimumResourceRetention));
+        const size_t cacheBytes = getResourceCacheBytes();
         mGrContext->performDeferredCleanup(std::chrono::milliseconds(cleanupMillis),
                                            mMemoryPolicy.purgeScratchOnly);
+        mBudget.onPurged(cacheBytes, getResourceCacheBytes(), now);
+    }
+
+    // Past the base limit, only keep what recent frames used, rather than letting the extra room
+    // fill up with resources of a burst that is over.
+    if (mBudget.limit() > mBudget.baseLimit() &&
+        (now - mLastResourceAging) >= kResourceAgingInterval) {
+        mLastResourceAging = now;
+        const size_t cacheBytes = getResourceCacheBytes();
+        if (cacheBytes > mBudget.baseLimit()) {
+            mGrContext->purgeResourcesNotUsedInMs(std::chrono::milliseconds(
+                    ns2ms(mMemoryPolicy.grownBudgetResourceRetention)));
+            mBudget.onPurged(cacheBytes, getResourceCacheBytes(), now);
+        }
     }
 }
 
@@ -42,6 +42,61 @@ namespace renderthread {
 class RenderThread;
 class CanvasContext;
 
+/**
+ * Adapts the GPU resource cache limit to the working set of recent frames. The surface based
+ * limit is a floor: while frames keep ending with the cache full, Skia has to evict resources
+ * that are likely to be uploaded again, so the limit grows in steps up to maxScale times the
+ * floor. Once the frames of a whole period fit in less than half of it, it shrinks back towards
+ * the peak those frames used.
+ */
+class CacheBudget {
+public:
+    struct Stats {
+        // Frames that didn't add anything to the cache
+        uint64_t cachedFrames = 0;
+        // Frames that ended with the cache at its limit
+        uint64_t framesAtLimit = 0;
+        uint64_t bytesAdded = 0;
+        // Bytes added back soon after purges hwui triggered, an estimate of the re-uploads the
+        // purges caused
+        uint64_t bytesReuploaded = 0;
+        uint64_t bytesPurged = 0;
+        uint32_t limitIncreases = 0;
+        uint32_t limitDecreases = 0;
+    };
+
+    void setBaseLimit(size_t baseLimit, float maxScale);
+    size_t limit() const { return mLimit; }
+    size_t baseLimit() const { return mBaseLimit; }
+    size_t maxLimit() const { return mMaxLimit; }
+    const Stats& stats() const { return mStats; }
+
+    // Called with the cache usage after every frame. Returns whether limit() changed.
+    bool onFrameCompleted(size_t cacheBytes, nsecs_t now);
+    // Called around every purge hwui triggers, so that the drop isn't mistaken for frames using
+    // less and the bytes coming back can be recognized as re-uploads.
+    void onPurged(size_t bytesBefore, size_t bytesAfter, nsecs_t now);
+    // Drops back to the base limit, e.g. when the UI is hidden and the working set is gone.
+    void reset();
+
+private:
+    void startPeriod(nsecs_t now);
+
+    size_t mBaseLimit = 0;
+    size_t mMaxLimit = 0;
+    size_t mLimit = 0;
+
+    size_t mLastCacheBytes = 0;
+    nsecs_t mPeriodStart = 0;
+    size_t mPeriodPeakBytes = 0;
+    int mPeriodFramesAtLimit = 0;
+
+    size_t mReuploadableBytes = 0;
+    nsecs_t mLastPurge = 0;
+
+    Stats mStats;
+};
+
 class CacheManager {
 public:
 #ifdef __ANDROID__ // Layoutlib does not support hardware acceleration
@@ -54,6 +109,8 @@ public:
     void getMemoryUsage(size_t* cpuUsage, size_t* gpuUsage);
 
     size_t getCacheSize() const { return mMaxResourceBytes; }
+    // The current limit of the resource cache, which can grow past getCacheSize()
+    size_t getAdaptiveCacheSize() const { return mBudget.limit(); }
     size_t getBackgroundCacheSize() const { return mBackgroundResourceBytes; }
     void onFrameCompleted();
     void notifyNextFrameSize(int width, int height);
@@ -78,6 +135,7 @@ private:
     void reset(sk_sp<GrDirectContext> grContext);
 #endif
     void destroy();
+    size_t getResourceCacheBytes();
 
     RenderThread& mRenderThread;
     const MemoryPolicy& mMemoryPolicy;
@@ -94,6 +152,9 @@ private:
     size_t mMaxCpuFontCacheBytes = 0;
     size_t mBackgroundCpuFontCacheBytes = 0;
 
+    CacheBudget mBudget;
+    nsecs_t mLastResourceAging = 0;
+
     std::vector<CanvasContext*> mCanvasContexts;
     RingBuffer<uint64_t, 100> mFrameCompletions;
 
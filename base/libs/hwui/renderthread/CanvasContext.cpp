@@ -34,7 +34,9 @@
 #include "LayerUpdateQueue.h"
 #include "Properties.h"
 #include "RenderThread.h"
+#include "VectorDrawable.h"
 #include "hwui/Canvas.h"
+#include "pipeline/skia/SkiaCpuPipeline.h"
 #include "pipeline/skia/SkiaOpenGLPipeline.h"
 #include "pipeline/skia/SkiaPipeline.h"
 #include "pipeline/skia/SkiaVulkanPipeline.h"
@@ -84,6 +86,10 @@ CanvasContext* CanvasContext::create(RenderThread& thread, bool translucent,
             return new CanvasContext(thread, translucent, rootRenderNode, contextFactory,
                                      std::make_unique<skiapipeline::SkiaVulkanPipeline>(thread),
                                      uiThreadId, renderThreadId);
+        case RenderPipelineType::SkiaCpu:
+            return new CanvasContext(thread, translucent, rootRenderNode, contextFactory,
+                                     std::make_unique<skiapipeline::SkiaCpuPipeline>(thread),
+                                     uiThreadId, renderThreadId);
         default:
             LOG_ALWAYS_FATAL("canvas context type %d not supported", (int32_t)renderType);
             break;
@@ -101,6 +107,9 @@ void CanvasContext::invokeFunctor(const RenderThread& thread, Functor* functor)
         case RenderPipelineType::SkiaVulkan:
             skiapipeline::SkiaVulkanPipeline::invokeFunctor(thread, functor);
             break;
+        case RenderPipelineType::SkiaCpu:
+            skiapipeline::SkiaCpuPipeline::invokeFunctor(thread, functor);
+            break;
         default:
             LOG_ALWAYS_FATAL("canvas context type %d not supported", (int32_t)renderType);
             break;
@@ -431,6 +440,11 @@ void CanvasContext::prepareTree(TreeInfo& info, int64_t* uiFrameInfo, int64_t sy
     mAnimationContext->runRemainingAnimations(info);
     GL_CHECKPOINT(MODERATE);
 
+    // The animations have run, nothing changes the trees until they are drawn.
+    for (const sp<VectorDrawableRoot>& tree : mDeferredVectorDrawables) {
+        tree->rasterAsync();
+    }
+
     freePrefetchedLayers();
     GL_CHECKPOINT(MODERATE);
 
@@ -965,17 +979,25 @@ void CanvasContext::setName(const std::string&& name) {
 }
 
 void CanvasContext::waitOnFences() {
-    if (mFrameFences.size()) {
+    if (mFrameFences.size() || mDeferredVectorDrawables.size()) {
         ATRACE_CALL();
         for (auto& fence : mFrameFences) {
             fence.get();
         }
         mFrameFences.clear();
+        for (const sp<VectorDrawableRoot>& tree : mDeferredVectorDrawables) {
+            tree->waitForRaster();
+        }
+        mDeferredVectorDrawables.clear();
     }
 }
 
 void CanvasContext::enqueueFrameWork(std::function<void()>&& func) {
-    mFrameFences.push_back(CommonPool::async(std::move(func)));
+    mFrameFences.push_back(CommonPool::async(std::move(func), CommonPool::Priority::High));
+}
+
+void CanvasContext::deferVectorDrawableRaster(VectorDrawableRoot* tree) {
+    mDeferredVectorDrawables.push_back(tree);
 }
 
 uint64_t CanvasContext::getFrameNumber() {
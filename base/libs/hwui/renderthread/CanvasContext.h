@@ -178,6 +178,10 @@ public:
     // Used to queue up work that needs to be completed before this frame completes
     void enqueueFrameWork(std::function<void()>&& func);
 
+    // Queues the cache of a VectorDrawable drawn this frame to be repainted on the CommonPool
+    // once prepareTree is done changing the trees, see VectorDrawable::Tree::rasterAsync().
+    void deferVectorDrawableRaster(VectorDrawableRoot* tree);
+
     uint64_t getFrameNumber();
 
     void waitOnFences();
@@ -349,6 +353,8 @@ private:
     Rect mContentDrawBounds;
 
     std::vector<std::future<void>> mFrameFences;
+    // VectorDrawables rasterized asynchronously, waited for along with mFrameFences.
+    std::vector<sp<VectorDrawableRoot>> mDeferredVectorDrawables;
     std::unique_ptr<IRenderPipeline> mRenderPipeline;
 
     std::vector<std::function<void(bool)>> mFrameCommitCallbacks;
@@ -42,6 +42,7 @@
 #include "pipeline/skia/SkiaOpenGLPipeline.h"
 #include "pipeline/skia/SkiaVulkanPipeline.h"
 #include "renderstate/RenderState.h"
+#include "thread/CommonPool.h"
 #include "utils/TimeUtils.h"
 
 namespace android {
@@ -326,7 +327,7 @@ void RenderThread::destroyRenderingContext() {
             setGrContext(nullptr);
             mEglManager->destroy();
         }
-    } else {
+    } else if (Properties::getRenderPipelineType() == RenderPipelineType::SkiaVulkan) {
         setGrContext(nullptr);
         mVkManager.clear();
     }
@@ -345,6 +346,8 @@ static const char* pipelineToString() {
             return "Skia (OpenGL)";
         case RenderPipelineType::SkiaVulkan:
             return "Skia (Vulkan)";
+        case RenderPipelineType::SkiaCpu:
+            return "Skia (CPU)";
         default:
             LOG_ALWAYS_FATAL("canvas context type %d not supported", (int32_t)renderType);
     }
@@ -353,6 +356,7 @@ static const char* pipelineToString() {
 void RenderThread::dumpGraphicsMemory(int fd, bool includeProfileData) {
     if (includeProfileData) {
         globalProfileData()->dump(fd);
+        CommonPool::dumpQueueWaitHistograms(fd);
     }
 
     String8 cachesOutput;
@@ -387,7 +391,7 @@ void RenderThread::setGrContext(sk_sp<GrDirectContext> context) {
 sk_sp<GrDirectContext> RenderThread::requireGrContext() {
     if (Properties::getRenderPipelineType() == RenderPipelineType::SkiaGL) {
         requireGlContext();
-    } else {
+    } else if (Properties::getRenderPipelineType() == RenderPipelineType::SkiaVulkan) {
         requireVkContext();
     }
     return mGrContext;
@@ -494,6 +498,9 @@ sk_sp<Bitmap> RenderThread::allocateHardwareBitmap(SkBitmap& skBitmap) {
     switch (renderType) {
         case RenderPipelineType::SkiaVulkan:
             return skiapipeline::SkiaVulkanPipeline::allocateHardwareBitmap(*this, skBitmap);
+        case RenderPipelineType::SkiaCpu:
+            ALOGW("Hardware bitmaps need a GPU context, unsupported by the CPU pipeline");
+            break;
         default:
             LOG_ALWAYS_FATAL("canvas context type %d not supported", (int32_t)renderType);
             break;
@@ -510,7 +517,7 @@ void RenderThread::preload() {
     if (Properties::getRenderPipelineType() == RenderPipelineType::SkiaGL) {
         std::thread eglInitThread([]() { eglGetDisplay(EGL_DEFAULT_DISPLAY); });
         eglInitThread.detach();
-    } else {
+    } else if (Properties::getRenderPipelineType() == RenderPipelineType::SkiaVulkan) {
         requireVkContext();
     }
     HardwareBitmapUploader::initialize();
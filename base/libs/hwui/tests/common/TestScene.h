@@ -41,6 +41,7 @@ public:
         bool renderOffscreen = true;
         bool reportGpuMemoryUsage = false;
         bool reportGpuMemoryUsageVerbose = false;
+        bool reportStageTimes = false;
     };
 
     template <class T>
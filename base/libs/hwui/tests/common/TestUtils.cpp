@@ -107,7 +107,7 @@ void TestUtils::TestTask::run() {
     renderthread::RenderThread& renderThread = renderthread::RenderThread::getInstance();
     if (Properties::getRenderPipelineType() == RenderPipelineType::SkiaVulkan) {
         renderThread.requireVkContext();
-    } else {
+    } else if (Properties::getRenderPipelineType() == RenderPipelineType::SkiaGL) {
         renderThread.requireGlContext();
     }
 
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TestSceneBase.h"
+
+#include <SkBlendMode.h>
+
+#include <cmath>
+#include <vector>
+
+class ParticleGridAnimation;
+
+static TestScene::Registrar _ParticleGrid(TestScene::Info{
+        "particlegrid",
+        "Thousands of tiny RenderNodes, each translated and scaled every frame. "
+        "High CPU load in prepareTree and damage accumulation, low GPU load.",
+        TestScene::simpleCreateScene<ParticleGridAnimation>});
+
+class ParticleGridAnimation : public TestScene {
+public:
+    static constexpr int kParticleSize = 8;
+    static constexpr int kSpacing = 16;
+
+    std::vector<sp<RenderNode>> particles;
+
+    void createContent(int width, int height, Canvas& canvas) override {
+        canvas.drawColor(Color::White, SkBlendMode::kSrcOver);
+        for (int y = 0; y + kParticleSize <= height; y += kSpacing) {
+            for (int x = 0; x + kParticleSize <= width; x += kSpacing) {
+                SkColor color = (x / kSpacing + y / kSpacing) % 2 ? Color::Blue_500
+                                                                  : Color::Red_500;
+                auto particle = TestUtils::createNode(
+                        x, y, x + kParticleSize, y + kParticleSize,
+                        [color](RenderProperties& props, Canvas& canvas) {
+                            canvas.drawColor(color, SkBlendMode::kSrcOver);
+                        });
+                canvas.drawRenderNode(particle.get());
+                particles.push_back(particle);
+            }
+        }
+    }
+
+    void doFrame(int frameNr) override {
+        for (size_t i = 0; i < particles.size(); i++) {
+            float phase = (frameNr + i) * 0.1f;
+            RenderProperties& props = particles[i]->mutateStagingProperties();
+            props.setTranslationX(4 * sinf(phase));
+            props.setTranslationY(4 * cosf(phase));
+            props.setScaleX(1 + 0.25f * sinf(phase));
+            props.setScaleY(1 + 0.25f * sinf(phase));
+            particles[i]->setPropertyFieldsDirty(RenderNode::TRANSLATION_X |
+                                                 RenderNode::TRANSLATION_Y | RenderNode::SCALE_X |
+                                                 RenderNode::SCALE_Y);
+        }
+    }
+};
@@ -16,6 +16,8 @@
 
 #include <gui/TraceUtils.h>
 #include "AnimationContext.h"
+#include "FrameInfo.h"
+#include "FrameMetricsObserver.h"
 #include "RenderNode.h"
 #include "renderthread/RenderProxy.h"
 #include "renderthread/RenderTask.h"
@@ -28,6 +30,9 @@
 #include <log/log.h>
 #include <ui/PixelFormat.h>
 
+#include <array>
+#include <mutex>
+
 // These are unstable internal APIs in google-benchmark. We should just implement our own variant
 // of these instead, but this was quicker. Disabled-by-default to avoid any breakages when
 // google-benchmark updates if they change anything
@@ -76,10 +81,53 @@ private:
     T mAverage;
 };
 
+// Accumulates the time frames spent in each RenderThread stage, as recorded in their FrameInfo.
+// Notified on the RenderThread once each frame is complete.
+class StageTimesObserver : public FrameMetricsObserver {
+public:
+    struct Stage {
+        const char* name;
+        FrameInfoIndex start;
+        FrameInfoIndex end;
+    };
+
+    static constexpr std::array<Stage, 4> kStages = {{
+            // prepareTree: syncing properties and display lists, damage and layer updates
+            {"Sync", FrameInfoIndex::SyncStart, FrameInfoIndex::IssueDrawCommandsStart},
+            // replaying the display lists into the pipeline's surface
+            {"Draw", FrameInfoIndex::IssueDrawCommandsStart, FrameInfoIndex::SwapBuffers},
+            {"Swap", FrameInfoIndex::SwapBuffers, FrameInfoIndex::SwapBuffersCompleted},
+            {"RenderThread", FrameInfoIndex::SyncQueued, FrameInfoIndex::FrameCompleted},
+    }};
+
+    StageTimesObserver() : FrameMetricsObserver(false /*waitForPresentTime*/) {}
+
+    void notify(const int64_t* buffer) override {
+        std::lock_guard lock(mLock);
+        for (size_t i = 0; i < kStages.size(); i++) {
+            mTotals[i] += buffer[static_cast<int>(kStages[i].end)] -
+                          buffer[static_cast<int>(kStages[i].start)];
+        }
+        mFrameCount++;
+    }
+
+    // Average duration of the stage in milliseconds.
+    double averageMs(size_t stage) {
+        std::lock_guard lock(mLock);
+        return mFrameCount ? mTotals[stage] / (mFrameCount * 1000000.0) : 0;
+    }
+
+private:
+    std::mutex mLock;
+    std::array<nsecs_t, kStages.size()> mTotals{};
+    int mFrameCount = 0;
+};
+
 using BenchmarkResults = std::vector<benchmark::BenchmarkReporter::Run>;
 
 void outputBenchmarkReport(const TestScene::Info& info, const TestScene::Options& opts,
-                           double durationInS, int repetationIndex, BenchmarkResults* reports) {
+                           double durationInS, int repetationIndex, StageTimesObserver* stages,
+                           BenchmarkResults* reports) {
     using namespace benchmark;
     benchmark::BenchmarkReporter::Run report;
     report.repetitions = opts.repeatCount;
@@ -95,6 +143,12 @@ void outputBenchmarkReport(const TestScene::Info& info, const TestScene::Options
         report.counters["Rendering RAM"] = Counter{static_cast<double>(cpuUsage + gpuUsage),
                                                    Counter::kDefaults, Counter::kIs1024};
     }
+    if (stages) {
+        for (size_t i = 0; i < StageTimesObserver::kStages.size(); i++) {
+            report.counters[std::string(StageTimesObserver::kStages[i].name) + " ms"] =
+                    stages->averageMs(i);
+        }
+    }
     reports->push_back(report);
 }
 
@@ -147,6 +201,12 @@ static void doRun(const TestScene::Info& info, const TestScene::Options& opts, i
         proxy->syncAndDrawFrame();
     }
 
+    sp<StageTimesObserver> stages;
+    if (opts.reportStageTimes) {
+        stages = sp<StageTimesObserver>::make();
+        proxy->addFrameMetricsObserver(stages.get());
+    }
+
     proxy->resetProfileInfo();
     proxy->fence();
 
@@ -180,9 +240,18 @@ static void doRun(const TestScene::Info& info, const TestScene::Options& opts, i
 
     if (reports) {
         outputBenchmarkReport(info, opts, (end - start) / (double)s2ns(1), repetitionIndex,
-                              reports);
+                              stages.get(), reports);
     } else {
         proxy->dumpProfileInfo(STDOUT_FILENO, DumpFlags::JankStats);
+        if (stages) {
+            for (size_t i = 0; i < StageTimesObserver::kStages.size(); i++) {
+                printf("Average %s time: %.3fms\n", StageTimesObserver::kStages[i].name,
+                       stages->averageMs(i));
+            }
+        }
+    }
+    if (stages) {
+        proxy->removeFrameMetricsObserver(stages.get());
     }
 }
 
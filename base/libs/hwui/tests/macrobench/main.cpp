@@ -69,9 +69,12 @@ OPTIONS:
   --onscreen           Render tests on device screen. By default tests
                        are offscreen rendered
   --benchmark_format   Set output format. Possible values are tabular, json, csv
-  --renderer=TYPE      Sets the render pipeline to use. May be skiagl or skiavk
+  --renderer=TYPE      Sets the render pipeline to use. May be skiagl, skiavk
+                       or skiacpu. skiacpu rasterizes on the CPU and needs no GPU
   --skip-leak-check    Skips the memory leak check
   --report-gpu-memory[=verbose]  Dumps the GPU memory usage after each test run
+  --report-stages      Reports the average time frames spent in each RenderThread
+                       stage (sync, draw, swap), as recorded in their FrameInfo
 )");
 }
 
@@ -153,6 +156,8 @@ static bool setRenderer(const char* renderer) {
         Properties::overrideRenderPipelineType(RenderPipelineType::SkiaGL);
     } else if (!strcmp(renderer, "skiavk")) {
         Properties::overrideRenderPipelineType(RenderPipelineType::SkiaVulkan);
+    } else if (!strcmp(renderer, "skiacpu")) {
+        Properties::overrideRenderPipelineType(RenderPipelineType::SkiaCpu);
     } else {
         fprintf(stderr, "Unknown format '%s'\n", renderer);
         return false;
@@ -175,6 +180,7 @@ enum {
     Renderer,
     SkipLeakCheck,
     ReportGpuMemory,
+    ReportStages,
 };
 }
 
@@ -192,6 +198,7 @@ static const struct option LONG_OPTIONS[] = {
         {"renderer", required_argument, nullptr, LongOpts::Renderer},
         {"skip-leak-check", no_argument, nullptr, LongOpts::SkipLeakCheck},
         {"report-gpu-memory", optional_argument, nullptr, LongOpts::ReportGpuMemory},
+        {"report-stages", no_argument, nullptr, LongOpts::ReportStages},
         {0, 0, 0, 0}};
 
 static const char* SHORT_OPTIONS = "c:r:h";
@@ -306,6 +313,10 @@ void parseOptions(int argc, char* argv[]) {
                 }
                 break;
 
+            case LongOpts::ReportStages:
+                gOpts.reportStageTimes = true;
+                break;
+
             case 'h':
                 printHelp();
                 exit(EXIT_SUCCESS);
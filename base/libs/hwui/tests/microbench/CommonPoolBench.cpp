@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "thread/CommonPool.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace android;
+using namespace android::uirenderer;
+
+static constexpr int kTasksPerIteration = 16;
+
+// Fans out small tasks and waits for them, from as many posting threads as the benchmark runs.
+void BM_CommonPool_asyncFanOut(benchmark::State& state) {
+    std::vector<std::future<void>> futures;
+    futures.reserve(kTasksPerIteration);
+    std::atomic_int count = 0;
+    while (state.KeepRunning()) {
+        for (int i = 0; i < kTasksPerIteration; i++) {
+            futures.push_back(CommonPool::async([&count] { count++; }));
+        }
+        for (auto& future : futures) {
+            future.get();
+        }
+        futures.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * kTasksPerIteration);
+}
+BENCHMARK(BM_CommonPool_asyncFanOut)->ThreadRange(1, 4)->UseRealTime();
+
+void BM_CommonPool_taskGroupFanOut(benchmark::State& state) {
+    std::atomic_int count = 0;
+    while (state.KeepRunning()) {
+        CommonPool::TaskGroup group(CommonPool::Priority::Normal);
+        for (int i = 0; i < kTasksPerIteration; i++) {
+            group.run([&count] { count++; });
+        }
+        group.join();
+    }
+    state.SetItemsProcessed(state.iterations() * kTasksPerIteration);
+}
+BENCHMARK(BM_CommonPool_taskGroupFanOut)->ThreadRange(1, 4)->UseRealTime();
+
+// Round trip of a task posted while another thread keeps the pool busy with bulk work, the way
+// frame work competes with shader cache writes and texture uploads.
+static void runUnderLoad(benchmark::State& state, CommonPool::Priority priority) {
+    std::atomic_bool done = false;
+    std::thread bulk([&done] {
+        std::vector<std::future<void>> futures;
+        while (!done) {
+            for (int i = 0; i < CommonPool::QUEUE_SIZE / 2; i++) {
+                futures.push_back(CommonPool::async([] { usleep(50); }));
+            }
+            for (auto& future : futures) {
+                future.get();
+            }
+            futures.clear();
+        }
+    });
+    while (state.KeepRunning()) {
+        CommonPool::runSync([] {}, priority);
+    }
+    done = true;
+    bulk.join();
+    CommonPool::waitForIdle();
+}
+
+void BM_CommonPool_normalUnderLoad(benchmark::State& state) {
+    runUnderLoad(state, CommonPool::Priority::Normal);
+}
+BENCHMARK(BM_CommonPool_normalUnderLoad)->UseRealTime();
+
+void BM_CommonPool_highUnderLoad(benchmark::State& state) {
+    runUnderLoad(state, CommonPool::Priority::High);
+}
+BENCHMARK(BM_CommonPool_highUnderLoad)->UseRealTime();
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "DamageAccumulator.h"
+#include "RenderNode.h"
+
+#include <memory>
+#include <vector>
+
+using namespace android;
+using namespace android::uirenderer;
+
+// Damages every child of a single parent, the way prepareTree() does when they all animate.
+static void runSiblings(benchmark::State& state, float rotation) {
+    RenderNode parent;
+    parent.animatorProperties().setLeftTopRightBottom(0, 0, 1080, 1920);
+    parent.animatorProperties().updateMatrix();
+    std::vector<std::unique_ptr<RenderNode>> children;
+    for (int i = 0; i < state.range(0); i++) {
+        auto child = std::make_unique<RenderNode>();
+        int x = (i * 16) % 1080;
+        int y = (i * 16) / 1080 * 16;
+        child->animatorProperties().setLeftTopRightBottom(x, y, x + 8, y + 8);
+        child->animatorProperties().setTranslationX(i % 4);
+        child->animatorProperties().setScaleY(1 + (i % 3) * 0.25f);
+        child->animatorProperties().setRotation(rotation);
+        child->animatorProperties().updateMatrix();
+        children.push_back(std::move(child));
+    }
+
+    DamageAccumulator damageAccumulator;
+    SkRect dirty;
+    while (state.KeepRunning()) {
+        damageAccumulator.pushTransform(&parent);
+        for (auto& child : children) {
+            damageAccumulator.pushTransform(child.get());
+            damageAccumulator.dirty(0, 0, 8, 8);
+            damageAccumulator.popTransform();
+        }
+        damageAccumulator.popTransform();
+        damageAccumulator.finish(&dirty);
+        benchmark::DoNotOptimize(dirty);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_DamageAccumulator_scaleTranslateSiblings(benchmark::State& state) {
+    runSiblings(state, 0);
+}
+BENCHMARK(BM_DamageAccumulator_scaleTranslateSiblings)->Arg(100)->Arg(1000)->Arg(5000);
+
+// Rotated children take the unbatched path, for comparison.
+void BM_DamageAccumulator_rotatedSiblings(benchmark::State& state) {
+    runSiblings(state, 10);
+}
+BENCHMARK(BM_DamageAccumulator_rotatedSiblings)->Arg(100)->Arg(1000)->Arg(5000);
@@ -87,6 +87,26 @@ void BM_SkiaDisplayListCanvas_record_translate(benchmark::State& benchState) {
 }
 BENCHMARK(BM_SkiaDisplayListCanvas_record_translate);
 
+/**
+ * Record enough ops to span several pages of op storage, growing the display list
+ * well past its initial size on every recording.
+ */
+void BM_SkiaDisplayListCanvas_record_manyRects(benchmark::State& benchState) {
+    auto canvas = std::make_unique<SkiaRecordingCanvas>(nullptr, 100, 100);
+    static_cast<void>(canvas->finishRecording());
+    Paint paint;
+
+    while (benchState.KeepRunning()) {
+        canvas->resetRecording(100, 100);
+        for (int i = 0; i < benchState.range(0); i++) {
+            canvas->drawRect(0, 0, i % 100, 100, paint);
+        }
+        benchmark::DoNotOptimize(canvas.get());
+        static_cast<void>(canvas->finishRecording());
+    }
+}
+BENCHMARK(BM_SkiaDisplayListCanvas_record_manyRects)->Arg(100)->Arg(1000);
+
 /**
  * Simulate a simple view drawing a background, overlapped by an image.
  *
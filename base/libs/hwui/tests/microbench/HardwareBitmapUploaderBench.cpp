@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "HardwareBitmapUploader.h"
+
+#include <SkBitmap.h>
+#include <SkColorSpace.h>
+
+using namespace android;
+using namespace android::uirenderer;
+
+// Measures the CPU stage of allocateHardwareBitmap(), converting the pixels to a color type the
+// hardware buffers support. Color types the device supports natively aren't converted at all.
+static void runConversion(benchmark::State& state, SkColorType colorType) {
+    SkBitmap source;
+    source.allocPixels(SkImageInfo::Make(state.range(0), state.range(0), colorType,
+                                         kPremul_SkAlphaType, SkColorSpace::MakeSRGB()));
+    source.eraseColor(0x80336699);
+    while (state.KeepRunning()) {
+        SkBitmap converted = HardwareBitmapUploader::makeHwCompatible(source);
+        benchmark::DoNotOptimize(converted.getPixels());
+    }
+    state.SetBytesProcessed(state.iterations() * source.computeByteSize());
+}
+
+void BM_HardwareBitmapUploader_convert4444(benchmark::State& state) {
+    runConversion(state, kARGB_4444_SkColorType);
+}
+BENCHMARK(BM_HardwareBitmapUploader_convert4444)->Arg(512)->Arg(2048);
+
+void BM_HardwareBitmapUploader_convertF16(benchmark::State& state) {
+    runConversion(state, kRGBA_F16_SkColorType);
+}
+BENCHMARK(BM_HardwareBitmapUploader_convertF16)->Arg(512)->Arg(2048);
+
+void BM_HardwareBitmapUploader_convert1010102(benchmark::State& state) {
+    runConversion(state, kRGBA_1010102_SkColorType);
+}
+BENCHMARK(BM_HardwareBitmapUploader_convert1010102)->Arg(512)->Arg(2048);
+
+void BM_HardwareBitmapUploader_convert565(benchmark::State& state) {
+    runConversion(state, kRGB_565_SkColorType);
+}
+BENCHMARK(BM_HardwareBitmapUploader_convert565)->Arg(512)->Arg(2048);
@@ -51,3 +51,28 @@ void BM_PathParser_parseStringPathForPathData(benchmark::State& state) {
     }
 }
 BENCHMARK(BM_PathParser_parseStringPathForPathData);
+
+// Inflating the same icon again, with the parse served from the cache.
+void BM_PathParser_parseCachedStringPathForSkPath(benchmark::State& state) {
+    SkPath skPath;
+    size_t length = strlen(sPathString);
+    PathParser::ParseResult result;
+    while (state.KeepRunning()) {
+        PathParser::parseCachedAsciiStringForSkPath(&skPath, &result, sPathString, length);
+        benchmark::DoNotOptimize(&result);
+        benchmark::DoNotOptimize(&skPath);
+    }
+}
+BENCHMARK(BM_PathParser_parseCachedStringPathForSkPath);
+
+void BM_PathParser_parseCachedStringPathForPathData(benchmark::State& state) {
+    size_t length = strlen(sPathString);
+    PathData outData;
+    PathParser::ParseResult result;
+    while (state.KeepRunning()) {
+        PathParser::getCachedPathDataFromAsciiString(&outData, &result, sPathString, length);
+        benchmark::DoNotOptimize(&result);
+        benchmark::DoNotOptimize(&outData);
+    }
+}
+BENCHMARK(BM_PathParser_parseCachedStringPathForPathData);
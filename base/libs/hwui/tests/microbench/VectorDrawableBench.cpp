@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "VectorDrawable.h"
+
+#include <string.h>
+#include <vector>
+
+using namespace android;
+using namespace android::uirenderer;
+
+static const char* sCellPath = "M 0.5 0.5 L 2.5 0.5 L 2.5 2.5 L 0.5 2.5 Z";
+static const int kCellSize = 3;
+static const int kColumns = 8;
+
+/**
+ * Builds a tree of groupCount groups laid out in a grid, each holding a filled and stroked
+ * square, cached at 4x the viewport size like an icon on a high density screen.
+ */
+static sp<VectorDrawableRoot> createGridTree(int groupCount,
+                                             std::vector<VectorDrawable::Group*>* outGroups) {
+    VectorDrawable::Group* root = new VectorDrawable::Group();
+    for (int i = 0; i < groupCount; i++) {
+        VectorDrawable::Group* group = new VectorDrawable::Group();
+        group->mutateStagingProperties()->setTranslateX((i % kColumns) * kCellSize);
+        group->mutateStagingProperties()->setTranslateY((i / kColumns) * kCellSize);
+        group->mutateStagingProperties()->setPivotX(kCellSize / 2.0f);
+        group->mutateStagingProperties()->setPivotY(kCellSize / 2.0f);
+        VectorDrawable::FullPath* path = new VectorDrawable::FullPath(sCellPath, strlen(sCellPath));
+        path->mutateStagingProperties()->setFillColor(SK_ColorBLUE);
+        path->mutateStagingProperties()->setStrokeColor(SK_ColorBLACK);
+        path->mutateStagingProperties()->setStrokeWidth(0.25f);
+        group->addChild(path);
+        root->addChild(group);
+        outGroups->push_back(group);
+    }
+    int rows = (groupCount + kColumns - 1) / kColumns;
+    sp<VectorDrawableRoot> tree = new VectorDrawableRoot(root);
+    tree->mutateStagingProperties()->setViewportSize(kColumns * kCellSize, rows * kCellSize);
+    tree->mutateStagingProperties()->setScaledSize(kColumns * kCellSize * 4, rows * kCellSize * 4);
+    tree->syncProperties();
+    tree->getBitmapUpdateIfDirty();
+    return tree;
+}
+
+// Rotates a single group per frame, as a loading indicator would.
+void BM_VectorDrawable_repaintOneGroup(benchmark::State& state) {
+    std::vector<VectorDrawable::Group*> groups;
+    sp<VectorDrawableRoot> tree = createGridTree(state.range(0), &groups);
+    float rotation = 0;
+    while (state.KeepRunning()) {
+        rotation += 10;
+        groups[0]->mutateProperties()->setRotation(rotation);
+        benchmark::DoNotOptimize(&tree->getBitmapUpdateIfDirty());
+    }
+}
+BENCHMARK(BM_VectorDrawable_repaintOneGroup)->Arg(8)->Arg(32)->Arg(64);
+
+// Rotates every group per frame, which repaints the whole cache.
+void BM_VectorDrawable_repaintAllGroups(benchmark::State& state) {
+    std::vector<VectorDrawable::Group*> groups;
+    sp<VectorDrawableRoot> tree = createGridTree(state.range(0), &groups);
+    float rotation = 0;
+    while (state.KeepRunning()) {
+        rotation += 10;
+        for (VectorDrawable::Group* group : groups) {
+            group->mutateProperties()->setRotation(rotation);
+        }
+        benchmark::DoNotOptimize(&tree->getBitmapUpdateIfDirty());
+    }
+}
+BENCHMARK(BM_VectorDrawable_repaintAllGroups)->Arg(8)->Arg(32)->Arg(64);
+
+// Marks the tree dirty without changing it, as running animators do on every frame.
+void BM_VectorDrawable_markDirtyUnchanged(benchmark::State& state) {
+    std::vector<VectorDrawable::Group*> groups;
+    sp<VectorDrawableRoot> tree = createGridTree(state.range(0), &groups);
+    while (state.KeepRunning()) {
+        tree->markDirty();
+        benchmark::DoNotOptimize(&tree->getBitmapUpdateIfDirty());
+    }
+}
+BENCHMARK(BM_VectorDrawable_markDirtyUnchanged)->Arg(8)->Arg(64);
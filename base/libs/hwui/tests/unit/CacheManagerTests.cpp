@@ -86,3 +86,78 @@ RENDERTHREAD_SKIA_PIPELINE_TEST(CacheManager, DISABLED_trimMemory) {
     renderThread.cacheManager().trimMemory(TrimLevel::COMPLETE);
     ASSERT_TRUE(0 == grContext->getResourceCachePurgeableBytes());
 }
+
+static constexpr size_t kBaseCacheLimit = 100 * 1024 * 1024;
+
+// Steady frames whose working set fits keep the limit where it is.
+TEST(CacheBudget, steadyWorkingSet) {
+    CacheBudget budget;
+    budget.setBaseLimit(kBaseCacheLimit, 2.0f);
+    nsecs_t now = 1_s;
+    for (int i = 0; i < 1000; i++, now += 16_ms) {
+        EXPECT_FALSE(budget.onFrameCompleted(kBaseCacheLimit / 2, now));
+    }
+    EXPECT_EQ(kBaseCacheLimit, budget.limit());
+    EXPECT_EQ(999u, budget.stats().cachedFrames);
+    EXPECT_EQ(0u, budget.stats().framesAtLimit);
+}
+
+// Bursts of large bitmaps keeping the cache full grow the limit in steps, up to the max.
+TEST(CacheBudget, burstsGrowLimit) {
+    CacheBudget budget;
+    budget.setBaseLimit(kBaseCacheLimit, 2.0f);
+    nsecs_t now = 1_s;
+    size_t previousLimit = budget.limit();
+    for (int i = 0; i < 1000; i++, now += 16_ms) {
+        budget.onFrameCompleted(budget.limit(), now);
+        EXPECT_GE(budget.limit(), previousLimit);
+        previousLimit = budget.limit();
+    }
+    EXPECT_EQ(2 * kBaseCacheLimit, budget.limit());
+    EXPECT_EQ(4u, budget.stats().limitIncreases);
+
+    // A single full frame now and then isn't enough.
+    budget.reset();
+    for (int i = 0; i < 100; i++, now += 16_ms) {
+        budget.onFrameCompleted(i % 50 ? kBaseCacheLimit / 2 : kBaseCacheLimit, now);
+    }
+    EXPECT_EQ(kBaseCacheLimit, budget.limit());
+}
+
+// Once the bursts are over, the limit goes back down towards what the frames still use.
+TEST(CacheBudget, shrinkAfterBursts) {
+    CacheBudget budget;
+    budget.setBaseLimit(kBaseCacheLimit, 2.0f);
+    nsecs_t now = 1_s;
+    for (int i = 0; i < 100; i++, now += 16_ms) {
+        budget.onFrameCompleted(budget.limit(), now);
+    }
+    ASSERT_EQ(2 * kBaseCacheLimit, budget.limit());
+
+    for (int i = 0; i < 1000; i++, now += 16_ms) {
+        budget.onFrameCompleted(kBaseCacheLimit / 4, now);
+    }
+    EXPECT_EQ(kBaseCacheLimit, budget.limit());
+    EXPECT_EQ(1u, budget.stats().limitDecreases);
+
+    // Growing the base limit, e.g. for a larger surface, raises the floor.
+    budget.setBaseLimit(3 * kBaseCacheLimit, 2.0f);
+    EXPECT_EQ(3 * kBaseCacheLimit, budget.limit());
+}
+
+// Bytes coming back soon after a purge are counted as re-uploads, later ones aren't.
+TEST(CacheBudget, purgeAndReupload) {
+    CacheBudget budget;
+    budget.setBaseLimit(kBaseCacheLimit, 2.0f);
+    nsecs_t now = 1_s;
+    budget.onFrameCompleted(50 * 1024 * 1024, now);
+    budget.onPurged(50 * 1024 * 1024, 20 * 1024 * 1024, now);
+    EXPECT_EQ(30u * 1024 * 1024, budget.stats().bytesPurged);
+
+    budget.onFrameCompleted(30 * 1024 * 1024, now + 16_ms);
+    EXPECT_EQ(10u * 1024 * 1024, budget.stats().bytesReuploaded);
+
+    budget.onFrameCompleted(80 * 1024 * 1024, now + 10_s);
+    EXPECT_EQ(10u * 1024 * 1024, budget.stats().bytesReuploaded);
+    EXPECT_EQ(110u * 1024 * 1024, budget.stats().bytesAdded);
+}
@@ -18,8 +18,10 @@
 
 #include "thread/CommonPool.h"
 
+#include <algorithm>
 #include <array>
 #include <condition_variable>
+#include <numeric>
 #include <set>
 #include <thread>
 #include "unistd.h"
@@ -186,3 +188,141 @@ TEST(CommonPool, syncLifecycleCheck) {
     CommonPool::waitForIdle();
     ASSERT_EQ(0, ObjectTracker::count());
 }
+
+// Parks every worker until the returned release() is called, so that tests control which tasks
+// are queued by the time the workers look for more.
+class BlockedWorkers {
+public:
+    BlockedWorkers() {
+        for (auto& future : mFutures) {
+            // High, as a lone Normal task is left for the busy worker rather than waking another.
+            future = CommonPool::async(
+                    [this] {
+                        std::unique_lock lock{mLock};
+                        mBlocked++;
+                        mCondition.notify_all();
+                        while (!mReleased) {
+                            mCondition.wait(lock);
+                        }
+                    },
+                    CommonPool::Priority::High);
+        }
+        std::unique_lock lock{mLock};
+        while (mBlocked < CommonPool::THREAD_COUNT) {
+            mCondition.wait(lock);
+        }
+    }
+
+    ~BlockedWorkers() { release(); }
+
+    void release() {
+        {
+            std::unique_lock lock{mLock};
+            mReleased = true;
+            mCondition.notify_all();
+        }
+        for (auto& future : mFutures) {
+            if (future.valid()) {
+                future.get();
+            }
+        }
+    }
+
+private:
+    std::mutex mLock;
+    std::condition_variable mCondition;
+    int mBlocked = 0;
+    bool mReleased = false;
+    std::array<std::future<void>, CommonPool::THREAD_COUNT> mFutures;
+};
+
+TEST(CommonPool, highPriorityFirst) {
+    std::mutex lock;
+    std::vector<int> order;
+    std::vector<std::future<void>> futures;
+    {
+        BlockedWorkers blocked;
+        for (int i = 0; i < 4; i++) {
+            futures.push_back(CommonPool::async([&, i] {
+                std::unique_lock _lock{lock};
+                order.push_back(i);
+            }));
+        }
+        futures.push_back(CommonPool::async(
+                [&] {
+                    std::unique_lock _lock{lock};
+                    order.push_back(-1);
+                },
+                CommonPool::Priority::High));
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
+    // Both workers pick up a task at once when released, but without priorities the High one
+    // would have been last.
+    ASSERT_EQ(5, order.size());
+    auto high = std::find(order.begin(), order.end(), -1) - order.begin();
+    EXPECT_LT(high, CommonPool::THREAD_COUNT);
+}
+
+TEST(CommonPool, taskGroupJoinRunsPendingTasks) {
+    BlockedWorkers blocked;
+    std::set<pid_t> threads;
+    CommonPool::TaskGroup group;
+    for (int i = 0; i < 3; i++) {
+        group.run([&threads] { threads.insert(gettid()); });
+    }
+    // Every worker is blocked, so join() has to run all of them itself.
+    group.join();
+    ASSERT_EQ(1, threads.size());
+    EXPECT_EQ(gettid(), *threads.begin());
+}
+
+TEST(CommonPool, taskGroupFromWorker) {
+    std::atomic_int count{0};
+    pid_t worker = CommonPool::runSync([&count] {
+        CommonPool::TaskGroup group;
+        for (int i = 0; i < 64; i++) {
+            group.run([&count] {
+                usleep(10);
+                count++;
+            });
+        }
+        group.join();
+        return gettid();
+    });
+    EXPECT_EQ(64, count.load());
+    EXPECT_NE(gettid(), worker);
+    CommonPool::waitForIdle();
+}
+
+TEST(CommonPool, queueWaitHistogram) {
+    CommonPool::waitForIdle();
+    auto total = [](CommonPool::Priority priority) {
+        auto histogram = CommonPool::getQueueWaitHistogram(priority);
+        return std::accumulate(histogram.begin(), histogram.end(), 0u);
+    };
+    uint32_t high = total(CommonPool::Priority::High);
+    uint32_t normal = total(CommonPool::Priority::Normal);
+    CommonPool::runSync([] {}, CommonPool::Priority::High);
+    EXPECT_EQ(high + 1, total(CommonPool::Priority::High));
+    EXPECT_EQ(normal, total(CommonPool::Priority::Normal));
+}
+
+TEST(CommonPool, queueWaitHistogramSkipsJoinedTasks) {
+    auto total = [](CommonPool::Priority priority) {
+        auto histogram = CommonPool::getQueueWaitHistogram(priority);
+        return std::accumulate(histogram.begin(), histogram.end(), 0u);
+    };
+    BlockedWorkers blocked;
+    uint32_t high = total(CommonPool::Priority::High);
+    CommonPool::TaskGroup group;
+    for (int i = 0; i < 3; i++) {
+        group.run([] {});
+    }
+    group.join();
+    // The workers still dequeue the joined tasks, but they never waited on them.
+    blocked.release();
+    CommonPool::waitForIdle();
+    EXPECT_EQ(high, total(CommonPool::Priority::High));
+}
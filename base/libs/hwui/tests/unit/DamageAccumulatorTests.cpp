@@ -127,3 +127,61 @@ TEST(DamageAccumulator, perspectiveTransform) {
     da.finish(&dirty);
     ASSERT_EQ(SkRect::MakeLTRB(50, 50, 500, 500), dirty);
 }
+
+// Siblings that are only translated or scaled have their damage mapped in a batch when their
+// parent is popped, which must come out the same as mapping each one as it is popped.
+TEST(DamageAccumulator, batchedSiblings) {
+    DamageAccumulator da;
+    RenderNode parent;
+    parent.animatorProperties().setLeftTopRightBottom(10, 10, 1000, 1000);
+    parent.animatorProperties().updateMatrix();
+    std::vector<std::unique_ptr<RenderNode>> children;
+    for (int i = 0; i < 4; i++) {
+        children.push_back(std::make_unique<RenderNode>());
+    }
+    // Translated
+    children[0]->animatorProperties().setLeftTopRightBottom(0, 0, 10, 10);
+    children[0]->animatorProperties().setTranslationX(5);
+    // Mirrored around its center
+    children[1]->animatorProperties().setLeftTopRightBottom(100, 0, 110, 10);
+    children[1]->animatorProperties().setScaleX(-2);
+    // Collapsed, so its damage is empty once mapped
+    children[2]->animatorProperties().setLeftTopRightBottom(500, 500, 510, 510);
+    children[2]->animatorProperties().setScaleY(0);
+    // Rotated, mapped right away
+    children[3]->animatorProperties().setLeftTopRightBottom(200, 200, 210, 210);
+    children[3]->animatorProperties().setRotation(45);
+
+    SkRect dirty;
+    da.pushTransform(&parent);
+    for (auto& child : children) {
+        child->animatorProperties().updateMatrix();
+        da.pushTransform(child.get());
+        da.dirty(0, 0, 10, 10);
+        da.popTransform();
+    }
+    da.peekAtDirty(&dirty);
+    EXPECT_FLOAT_EQ(5, dirty.fLeft);
+    EXPECT_FLOAT_EQ(0, dirty.fTop);
+    EXPECT_NEAR(212.071f, dirty.fRight, 0.001f);
+    EXPECT_NEAR(212.071f, dirty.fBottom, 0.001f);
+    da.popTransform();
+    da.finish(&dirty);
+    ASSERT_EQ(SkRect::MakeLTRB(15, 10, 223, 223), dirty);
+}
+
+TEST(DamageAccumulator, joinBatched) {
+    DamageAccumulator da;
+    DamageAccumulator subtree;
+    RenderNode node;
+    node.animatorProperties().setLeftTopRightBottom(50, 50, 100, 100);
+    node.animatorProperties().updateMatrix();
+    subtree.pushTransform(&node);
+    subtree.dirty(0, 0, 25, 25);
+    subtree.popTransform();
+
+    da.join(subtree);
+    SkRect dirty;
+    da.finish(&dirty);
+    ASSERT_EQ(SkRect::MakeLTRB(50, 50, 75, 75), dirty);
+}
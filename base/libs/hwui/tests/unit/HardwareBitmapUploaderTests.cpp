@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <SkBitmap.h>
+#include <SkColor.h>
+
+#include <future>
+#include <vector>
+
+#include "HardwareBitmapUploader.h"
+#include "hwui/Bitmap.h"
+#include "tests/common/TestUtils.h"
+
+using namespace android;
+using namespace android::uirenderer;
+
+static SkBitmap createSolidBitmap(int width, int height, SkColorType colorType, SkColor color) {
+    SkAlphaType alphaType =
+            colorType == kRGB_565_SkColorType ? kOpaque_SkAlphaType : kPremul_SkAlphaType;
+    SkBitmap bitmap;
+    bitmap.allocPixels(SkImageInfo::Make(width, height, colorType, alphaType));
+    bitmap.eraseColor(color);
+    return bitmap;
+}
+
+// Reads the hardware bitmap back and checks its corners and center.
+static void expectSolidColor(Bitmap* hwBitmap, SkColor color) {
+    ASSERT_NE(nullptr, hwBitmap);
+    ASSERT_TRUE(hwBitmap->isHardware());
+    SkBitmap readback;
+    hwBitmap->getSkBitmap(&readback);
+    const int right = readback.width() - 1;
+    const int bottom = readback.height() - 1;
+    EXPECT_EQ(color, readback.getColor(0, 0));
+    EXPECT_EQ(color, readback.getColor(right, 0));
+    EXPECT_EQ(color, readback.getColor(0, bottom));
+    EXPECT_EQ(color, readback.getColor(right, bottom));
+    EXPECT_EQ(color, readback.getColor(right / 2, bottom / 2));
+}
+
+RENDERTHREAD_TEST(HardwareBitmapUploader, allocateHardwareBitmap) {
+    SkBitmap source = createSolidBitmap(64, 32, kRGBA_8888_SkColorType, SK_ColorRED);
+    sk_sp<Bitmap> hwBitmap = HardwareBitmapUploader::allocateHardwareBitmap(source);
+    expectSolidColor(hwBitmap.get(), SK_ColorRED);
+}
+
+RENDERTHREAD_TEST(HardwareBitmapUploader, allocateHardwareBitmapAsync) {
+    // Queued back to back, so that the uploads after the first share batches. The colors are
+    // exact in every color type, and 4444 is converted to 8888 before the upload.
+    struct Source {
+        SkBitmap bitmap;
+        SkColor color;
+    };
+    const SkColorType colorTypes[] = {kRGBA_8888_SkColorType, kRGB_565_SkColorType,
+                                      kARGB_4444_SkColorType};
+    const SkColor colors[] = {SK_ColorRED, SK_ColorGREEN, SK_ColorBLUE, SK_ColorWHITE};
+    std::vector<Source> sources;
+    for (int i = 0; i < 12; i++) {
+        SkColor color = colors[i % 4];
+        sources.push_back(
+                {createSolidBitmap(16 + i * 8, 16 + i * 4, colorTypes[i % 3], color), color});
+    }
+
+    std::vector<std::future<sk_sp<Bitmap>>> futures;
+    for (const Source& source : sources) {
+        futures.push_back(HardwareBitmapUploader::allocateHardwareBitmapAsync(source.bitmap));
+    }
+    // A blocking upload in the middle of the async ones shares their batches.
+    SkBitmap blocking = createSolidBitmap(8, 8, kRGBA_8888_SkColorType, SK_ColorBLACK);
+    expectSolidColor(HardwareBitmapUploader::allocateHardwareBitmap(blocking).get(),
+                     SK_ColorBLACK);
+
+    for (size_t i = 0; i < futures.size(); i++) {
+        sk_sp<Bitmap> hwBitmap = futures[i].get();
+        expectSolidColor(hwBitmap.get(), sources[i].color);
+        EXPECT_EQ(sources[i].bitmap.width(), hwBitmap->width());
+        EXPECT_EQ(sources[i].bitmap.height(), hwBitmap->height());
+    }
+}
+
+RENDERTHREAD_TEST(HardwareBitmapUploader, allocateHardwareBitmapAsyncUnsupported) {
+    SkBitmap source = createSolidBitmap(8, 8, kBGRA_8888_SkColorType, SK_ColorRED);
+    EXPECT_EQ(nullptr, HardwareBitmapUploader::allocateHardwareBitmapAsync(source).get());
+}
@@ -260,3 +260,42 @@ TEST(JankTracker, doubleStuffedTwoIntervalBehind) {
 
     ASSERT_EQ(2, container.get()->jankFrameCount());
 }
+
+TEST(FrameTimingHistograms, addFrame) {
+    auto histograms = std::make_unique<FrameTimingHistograms>();
+    histograms->init(1234);
+
+    FrameInfo info;
+    memset(&info, 0, sizeof(info));
+    info.set(FrameInfoIndex::IntendedVsync) = 100_ms;
+    info.set(FrameInfoIndex::Vsync) = 101_ms;
+    info.set(FrameInfoIndex::SyncQueued) = 105_ms;
+    info.set(FrameInfoIndex::SyncStart) = 105_ms;
+    info.set(FrameInfoIndex::IssueDrawCommandsStart) = 106_ms;
+    info.set(FrameInfoIndex::SwapBuffers) = 110_ms;
+    info.set(FrameInfoIndex::GpuCompleted) = 112_ms;
+    info.set(FrameInfoIndex::FrameCompleted) = 115_ms;
+    info.set(FrameInfoIndex::DequeueBufferDuration) = 250_us;
+    info.set(FrameInfoIndex::QueueBufferDuration) = 1_s;
+    histograms->addFrame(info);
+
+    auto count = [&](FrameTimingStage stage, nsecs_t duration) {
+        return histograms->counts[static_cast<int>(stage)]
+                                 [duration / FrameTimingHistograms::kBucketWidthNs];
+    };
+    EXPECT_EQ(1u, histograms->frameCount);
+    EXPECT_EQ(1u, count(FrameTimingStage::Total, 15_ms));
+    EXPECT_EQ(1u, count(FrameTimingStage::Ui, 4_ms));
+    EXPECT_EQ(1u, count(FrameTimingStage::Sync, 1_ms));
+    EXPECT_EQ(1u, count(FrameTimingStage::Draw, 4_ms));
+    EXPECT_EQ(1u, count(FrameTimingStage::Gpu, 2_ms));
+    EXPECT_EQ(1u, count(FrameTimingStage::DequeueBuffer, 200_us));
+    // Durations past the last bucket are counted in it.
+    EXPECT_EQ(1u, histograms->counts[static_cast<int>(FrameTimingStage::QueueBuffer)]
+                                    [FrameTimingHistograms::kBucketCount - 1]);
+
+    // Frames that never completed are ignored.
+    info.set(FrameInfoIndex::FrameCompleted) = 0;
+    histograms->addFrame(info);
+    EXPECT_EQ(1u, histograms->frameCount);
+}
@@ -20,6 +20,7 @@
 #include "AnimationContext.h"
 #include "DamageAccumulator.h"
 #include "IContextFactory.h"
+#include "LayerUpdateQueue.h"
 #include "RenderNode.h"
 #include "TreeInfo.h"
 #include "renderthread/CanvasContext.h"
@@ -299,6 +300,96 @@ RENDERTHREAD_TEST(RenderNode, prepareTree_nullableDisplayList) {
     canvasContext->destroy();
 }
 
+// Four rows of twelve leaves each, enough nodes for prepareTree to prepare the rows in parallel.
+static sp<RenderNode> createRows(std::vector<sp<RenderNode>>* outRows,
+                                 std::vector<sp<RenderNode>>* outLeaves) {
+    for (int i = 0; i < 4; i++) {
+        std::vector<sp<RenderNode>> leaves;
+        for (int j = 0; j < 12; j++) {
+            leaves.push_back(TestUtils::createNode(
+                    j * 10, 0, j * 10 + 10, 50, [](RenderProperties& props, Canvas& canvas) {
+                        canvas.drawColor(Color::Red_500, SkBlendMode::kSrcOver);
+                    }));
+        }
+        outRows->push_back(TestUtils::createNode(
+                0, i * 50, 200, i * 50 + 50, [&leaves](RenderProperties& props, Canvas& canvas) {
+                    for (auto& leaf : leaves) {
+                        canvas.drawRenderNode(leaf.get());
+                    }
+                }));
+        outLeaves->insert(outLeaves->end(), leaves.begin(), leaves.end());
+    }
+    return TestUtils::createNode(0, 0, 200, 200,
+                                 [outRows](RenderProperties& props, Canvas& canvas) {
+                                     for (auto& row : *outRows) {
+                                         canvas.drawRenderNode(row.get());
+                                     }
+                                 });
+}
+
+static SkRect prepareFrame(CanvasContext& canvasContext, RenderNode* root, int64_t generation,
+                           bool parallel) {
+    TreeInfo info(TreeInfo::MODE_FULL, canvasContext);
+    DamageAccumulator damageAccumulator;
+    LayerUpdateQueue layerUpdateQueue;
+    info.damageAccumulator = &damageAccumulator;
+    info.layerUpdateQueue = &layerUpdateQueue;
+    info.damageGenerationId = generation;
+
+    Properties::parallelPrepareTree = parallel;
+    root->prepareTree(info);
+    Properties::parallelPrepareTree = false;
+
+    SkRect dirty;
+    damageAccumulator.finish(&dirty);
+    return dirty;
+}
+
+RENDERTHREAD_TEST(RenderNode, prepareTree_parallelMatchesSerial) {
+    std::vector<sp<RenderNode>> serialRows, serialLeaves, parallelRows, parallelLeaves;
+    auto serialRoot = createRows(&serialRows, &serialLeaves);
+    auto parallelRoot = createRows(&parallelRows, &parallelLeaves);
+    ContextFactory contextFactory;
+    std::unique_ptr<CanvasContext> canvasContext(
+            CanvasContext::create(renderThread, false, serialRoot.get(), &contextFactory, 0, 0));
+
+    // Everything is synced and damaged
+    SkRect serialDirty = prepareFrame(*canvasContext, serialRoot.get(), 1, false);
+    SkRect parallelDirty = prepareFrame(*canvasContext, parallelRoot.get(), 1, true);
+    EXPECT_EQ(SkRect::MakeWH(200, 200), parallelDirty);
+    EXPECT_EQ(serialDirty, parallelDirty);
+    for (auto& leaf : parallelLeaves) {
+        EXPECT_TRUE(leaf->hasParents());
+        EXPECT_EQ(leaf->properties().getLeft(), leaf->stagingProperties().getLeft());
+    }
+
+    // Moving a leaf of the third row only damages its old and new bounds
+    for (auto* leaves : {&serialLeaves, &parallelLeaves}) {
+        (*leaves)[30]->mutateStagingProperties().setTranslationX(5);
+        (*leaves)[30]->setPropertyFieldsDirty(RenderNode::TRANSLATION_X);
+    }
+    serialDirty = prepareFrame(*canvasContext, serialRoot.get(), 2, false);
+    parallelDirty = prepareFrame(*canvasContext, parallelRoot.get(), 2, true);
+    EXPECT_EQ(SkRect::MakeLTRB(60, 100, 75, 150), parallelDirty);
+    EXPECT_EQ(serialDirty, parallelDirty);
+    EXPECT_EQ(5, parallelLeaves[30]->properties().getTranslationX());
+
+    // Emptying the last row removes its leaves from the tree
+    for (auto* rows : {&serialRows, &parallelRows}) {
+        TestUtils::recordNode(*rows->back(), [](Canvas& canvas) {});
+    }
+    serialDirty = prepareFrame(*canvasContext, serialRoot.get(), 3, false);
+    parallelDirty = prepareFrame(*canvasContext, parallelRoot.get(), 3, true);
+    EXPECT_EQ(SkRect::MakeLTRB(0, 150, 200, 200), parallelDirty);
+    EXPECT_EQ(serialDirty, parallelDirty);
+    for (size_t i = 0; i < parallelLeaves.size(); i++) {
+        EXPECT_EQ(i < 36, parallelLeaves[i]->hasParents()) << "leaf " << i;
+        EXPECT_EQ(serialLeaves[i]->hasParents(), parallelLeaves[i]->hasParents());
+    }
+
+    canvasContext->destroy();
+}
+
 // TODO: Is this supposed to work in SkiaGL/SkiaVK?
 RENDERTHREAD_TEST(DISABLED_RenderNode, prepareTree_HwLayer_AVD_enqueueDamage) {
     VectorDrawable::Group* group = new VectorDrawable::Group();
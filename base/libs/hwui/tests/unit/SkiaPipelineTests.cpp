@@ -26,6 +26,7 @@
 #include "IContextFactory.h"
 #include "hwui/Paint.h"
 #include "SkiaCanvas.h"
+#include "pipeline/skia/SkiaCpuPipeline.h"
 #include "pipeline/skia/SkiaDisplayList.h"
 #include "pipeline/skia/SkiaOpenGLPipeline.h"
 #include "pipeline/skia/SkiaRecordingCanvas.h"
@@ -35,6 +36,7 @@
 #include "tests/common/TestUtils.h"
 
 #include <gui/BufferItemConsumer.h>
+#include <gui/BufferQueue.h>
 #include <gui/Surface.h>
 
 using namespace android;
@@ -446,3 +448,60 @@ RENDERTHREAD_SKIA_PIPELINE_TEST(SkiaPipeline, pictureCallback) {
                           SkMatrix::I());
     EXPECT_EQ(2, callbackCount);
 }
+
+RENDERTHREAD_SKIA_PIPELINE_TEST(SkiaCpuPipeline, drawToWindow) {
+    auto redNode = TestUtils::createSkiaNode(
+            0, 0, 2, 2, [](RenderProperties& props, SkiaRecordingCanvas& redCanvas) {
+                redCanvas.drawColor(SK_ColorRED, SkBlendMode::kSrcOver);
+            });
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    sp<BufferItemConsumer> bufferConsumer =
+            new BufferItemConsumer(consumer, GRALLOC_USAGE_SW_READ_OFTEN, 1);
+    bufferConsumer->setDefaultBufferSize(2, 2);
+    sp<Surface> surface = new Surface(producer);
+
+    // The CPU pipeline needs no GPU context, whatever the pipeline the test runs with.
+    auto pipeline = std::make_unique<SkiaCpuPipeline>(renderThread);
+    EXPECT_FALSE(pipeline->isSurfaceReady());
+    ASSERT_TRUE(pipeline->setSurface(surface.get(), SwapBehavior::kSwap_default));
+    EXPECT_TRUE(pipeline->isSurfaceReady());
+    EXPECT_EQ(MakeCurrentResult::AlreadyCurrent, pipeline->makeCurrent());
+
+    Frame frame = pipeline->getFrame();
+    EXPECT_EQ(2, frame.width());
+    EXPECT_EQ(2, frame.height());
+    EXPECT_EQ(0, frame.bufferAge());
+
+    LayerUpdateQueue layerUpdateQueue;
+    std::vector<sp<RenderNode>> renderNodes;
+    renderNodes.push_back(redNode);
+    SkRect dirty = SkRect::MakeWH(2, 2);
+    LightGeometry lightGeometry;
+    lightGeometry.radius = 1.0f;
+    lightGeometry.center = {0.0f, 0.0f, 0.0f};
+    LightInfo lightInfo;
+    auto result = pipeline->draw(frame, dirty, dirty, lightGeometry, &layerUpdateQueue,
+                                 android::uirenderer::Rect(0, 0, 2, 2), true, lightInfo,
+                                 renderNodes, nullptr, HardwareBufferRenderParams());
+    EXPECT_TRUE(result.success);
+
+    FrameInfo frameInfo;
+    bool requireSwap = false;
+    EXPECT_TRUE(pipeline->swapBuffers(frame, true, dirty, &frameInfo, &requireSwap));
+    EXPECT_TRUE(requireSwap);
+    // The next buffer starts from the posted frame.
+    EXPECT_EQ(1, pipeline->getFrame().bufferAge());
+
+    BufferItem item;
+    ASSERT_EQ(OK, bufferConsumer->acquireBuffer(&item, 0));
+    void* pixels = nullptr;
+    ASSERT_EQ(OK, item.mGraphicBuffer->lock(GRALLOC_USAGE_SW_READ_OFTEN, &pixels));
+    SkPixmap pixmap(SkImageInfo::Make(2, 2, kRGBA_8888_SkColorType, kPremul_SkAlphaType), pixels,
+                    item.mGraphicBuffer->getStride() * 4);
+    EXPECT_EQ(SK_ColorRED, pixmap.getColor(0, 0));
+    EXPECT_EQ(SK_ColorRED, pixmap.getColor(1, 1));
+    item.mGraphicBuffer->unlock();
+    bufferConsumer->releaseBuffer(item);
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "utils/SpscRingBuffer.h"
+
+#include <thread>
+
+using namespace android;
+using namespace android::uirenderer;
+
+TEST(SpscRingBuffer, pushUntilFull) {
+    SpscRingBuffer<int, 4> ring;
+    int value = -1;
+    EXPECT_FALSE(ring.pop(&value));
+    for (int i = 0; i < 4; i++) {
+        EXPECT_TRUE(ring.push(i));
+    }
+    EXPECT_FALSE(ring.push(4));
+
+    EXPECT_TRUE(ring.pop(&value));
+    EXPECT_EQ(0, value);
+    EXPECT_TRUE(ring.push(4));
+    for (int i = 1; i <= 4; i++) {
+        EXPECT_TRUE(ring.pop(&value));
+        EXPECT_EQ(i, value);
+    }
+    EXPECT_FALSE(ring.pop(&value));
+}
+
+TEST(SpscRingBuffer, crossThread) {
+    static constexpr int kCount = 100000;
+    SpscRingBuffer<int, 16> ring;
+    std::thread producer([&ring]() {
+        for (int i = 0; i < kCount; i++) {
+            while (!ring.push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    for (int expected = 0; expected < kCount;) {
+        int value;
+        if (ring.pop(&value)) {
+            ASSERT_EQ(expected, value);
+            expected++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+}
@@ -27,7 +27,10 @@
 #include <SkRefCnt.h>
 #include <SkShader.h>
 
+#include <stdlib.h>
+#include <string.h>
 #include <functional>
+#include <string>
 
 namespace android {
 namespace uirenderer {
@@ -312,6 +315,64 @@ TEST(PathParser, parseAsciiStringForSkPath) {
     }
 }
 
+TEST(PathParser, parseFloatsMatchesStrtof) {
+    const char* floats[] = {"0",        "1",        "-1",          "+2.5",       ".5",
+                            "-.25",     "3.",       "0.1",         "0.3",        "12.345",
+                            "100.0000", "16777216", "16777217",    "0.0000001",  "1e3",
+                            "-2.5E-2",  "-0.5",     "123456789.5", "9.99999999", "1.000000001"};
+    for (const char* f : floats) {
+        std::string pathString = std::string("M") + f + "," + f + "z";
+        PathParser::ParseResult result;
+        PathData pathData;
+        PathParser::getPathDataFromAsciiString(&pathData, &result, pathString.c_str(),
+                                               pathString.size());
+        ASSERT_FALSE(result.failureOccurred) << pathString;
+        ASSERT_EQ(2u, pathData.points.size()) << pathString;
+        // The fast path must round exactly like strtof, bit for bit.
+        float expected = strtof(f, nullptr);
+        EXPECT_EQ(0, memcmp(&expected, &pathData.points[0], sizeof(float))) << pathString;
+        EXPECT_EQ(0, memcmp(&expected, &pathData.points[1], sizeof(float))) << pathString;
+    }
+}
+
+TEST(PathParser, cachedParseMatchesUncached) {
+    // Parse every string twice, so that the second parse is served from the cache.
+    for (int i = 0; i < 2; i++) {
+        for (const TestData& testData : sTestDataSet) {
+            size_t length = strlen(testData.pathString);
+            PathParser::ParseResult result;
+            PathData pathData;
+            PathParser::getCachedPathDataFromAsciiString(&pathData, &result, testData.pathString,
+                                                         length);
+            EXPECT_EQ(testData.pathData, pathData);
+
+            PathParser::ParseResult skResult;
+            SkPath actualPath;
+            PathParser::parseCachedAsciiStringForSkPath(&actualPath, &skResult,
+                                                        testData.pathString, length);
+            EXPECT_EQ(testData.pathData.verbs.size() > 0, !skResult.failureOccurred);
+            SkPath expectedPath;
+            testData.skPathLamda(&expectedPath);
+            EXPECT_EQ(expectedPath, actualPath);
+        }
+
+        for (StringPath stringPath : sStringPaths) {
+            PathParser::ParseResult result;
+            PathData pathData;
+            PathParser::getCachedPathDataFromAsciiString(&pathData, &result,
+                                                         stringPath.stringPath,
+                                                         strlen(stringPath.stringPath));
+            EXPECT_EQ(stringPath.isValid, !result.failureOccurred);
+
+            PathParser::ParseResult skResult;
+            SkPath skPath;
+            PathParser::parseCachedAsciiStringForSkPath(&skPath, &skResult, stringPath.stringPath,
+                                                        strlen(stringPath.stringPath));
+            EXPECT_EQ(stringPath.isValid, !skResult.failureOccurred);
+        }
+    }
+}
+
 TEST(VectorDrawableUtils, morphPathData) {
     for (const TestData& fromData : sTestDataSet) {
         for (const TestData& toData : sTestDataSet) {
@@ -415,5 +476,76 @@ TEST(VectorDrawable, drawPathWithoutIncrementingShaderRefCount) {
     EXPECT_TRUE(shader->unique());
 }
 
+static const char* sSquarePath = "M 0 0 L 10 0 L 10 10 L 0 10 Z";
+
+// Two stroked squares side by side, each in its own group, cached at twice the viewport size.
+static sp<VectorDrawableRoot> createTwoSquareTree(VectorDrawable::Group** outFirstGroup) {
+    VectorDrawable::Group* root = new VectorDrawable::Group();
+    for (int i = 0; i < 2; i++) {
+        VectorDrawable::Group* group = new VectorDrawable::Group();
+        group->mutateStagingProperties()->setTranslateX(5 + i * 20);
+        group->mutateStagingProperties()->setTranslateY(5);
+        VectorDrawable::FullPath* path =
+                new VectorDrawable::FullPath(sSquarePath, strlen(sSquarePath));
+        path->mutateStagingProperties()->setFillColor(i == 0 ? SK_ColorRED : SK_ColorBLUE);
+        path->mutateStagingProperties()->setStrokeColor(SK_ColorBLACK);
+        path->mutateStagingProperties()->setStrokeWidth(2);
+        group->addChild(path);
+        root->addChild(group);
+        if (i == 0) {
+            *outFirstGroup = group;
+        }
+    }
+    sp<VectorDrawableRoot> tree = new VectorDrawableRoot(root);
+    tree->mutateStagingProperties()->setViewportSize(40, 20);
+    tree->mutateStagingProperties()->setScaledSize(80, 40);
+    tree->syncProperties();
+    return tree;
+}
+
+TEST(VectorDrawable, partialRepaintMatchesFullRepaint) {
+    VectorDrawable::Group* group;
+    sp<VectorDrawableRoot> tree = createTwoSquareTree(&group);
+    tree->getBitmapUpdateIfDirty();
+
+    // Rotating the first square, as an animation would, only repaints the pixels around it.
+    group->mutateProperties()->setPivotX(5);
+    group->mutateProperties()->setPivotY(5);
+    group->mutateProperties()->setRotation(30);
+    ASSERT_TRUE(tree->isDirty());
+    SkBitmap partial;
+    tree->getBitmapUpdateIfDirty().getSkBitmap(&partial);
+
+    VectorDrawable::Group* expectedGroup;
+    sp<VectorDrawableRoot> expectedTree = createTwoSquareTree(&expectedGroup);
+    expectedGroup->mutateStagingProperties()->setPivotX(5);
+    expectedGroup->mutateStagingProperties()->setPivotY(5);
+    expectedGroup->mutateStagingProperties()->setRotation(30);
+    expectedTree->syncProperties();
+    SkBitmap full;
+    expectedTree->getBitmapUpdateIfDirty().getSkBitmap(&full);
+
+    ASSERT_EQ(full.width(), partial.width());
+    ASSERT_EQ(full.height(), partial.height());
+    for (int y = 0; y < full.height(); y++) {
+        for (int x = 0; x < full.width(); x++) {
+            ASSERT_EQ(full.getColor(x, y), partial.getColor(x, y)) << "at " << x << ", " << y;
+        }
+    }
+}
+
+TEST(VectorDrawable, unchangedTreeIsNotRepainted) {
+    VectorDrawable::Group* group;
+    sp<VectorDrawableRoot> tree = createTwoSquareTree(&group);
+    uint32_t generationId = tree->getBitmapUpdateIfDirty().getGenerationID();
+
+    // Running animators mark their tree dirty every frame, whether they changed it or not.
+    tree->markDirty();
+    EXPECT_EQ(generationId, tree->getBitmapUpdateIfDirty().getGenerationID());
+
+    group->mutateProperties()->setTranslateX(6);
+    EXPECT_NE(generationId, tree->getBitmapUpdateIfDirty().getGenerationID());
+}
+
 }  // namespace uirenderer
 }  // namespace android
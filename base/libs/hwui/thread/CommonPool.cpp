@@ -16,15 +16,21 @@
 
 #include "CommonPool.h"
 
+#include <android-base/stringprintf.h>
+#include <inttypes.h>
 #include <sys/resource.h>
 #include <utils/Trace.h>
 #include "renderthread/RenderThread.h"
 
+#include <algorithm>
 #include <array>
 
 namespace android {
 namespace uirenderer {
 
+// Index of the worker running on this thread, or -1 if this isn't a CommonPool thread.
+static thread_local int sWorkerIndex = -1;
+
 CommonPool::CommonPool() {
     ATRACE_CALL();
 
@@ -52,7 +58,7 @@ CommonPool::CommonPool() {
                     startHook(name.data());
                 }
             }
-            pool->workerLoop();
+            pool->workerLoop(i);
         });
         worker.detach();
     }
@@ -72,43 +78,193 @@ CommonPool& CommonPool::instance() {
     return pool;
 }
 
-void CommonPool::post(Task&& task) {
-    instance().enqueue(std::move(task));
+void CommonPool::post(Task&& task, Priority priority) {
+    instance().enqueue(std::move(task), priority);
 }
 
 std::vector<int> CommonPool::getThreadIds() {
     return instance().mWorkerThreadIds;
 }
 
-void CommonPool::enqueue(Task&& task) {
+void CommonPool::enqueue(Task&& task, Priority priority, std::atomic_bool* claimed) {
+    QueuedTask queued{std::move(task), systemTime(SYSTEM_TIME_MONOTONIC), priority, claimed};
+    if (sWorkerIndex >= 0 && enqueueLocal(queued)) {
+        return;
+    }
+
+    auto& queue = mWorkQueues[static_cast<int>(priority)];
     std::unique_lock lock(mLock);
-    while (!mWorkQueue.hasSpace()) {
+    while (!queue.hasSpace()) {
         lock.unlock();
         usleep(100);
         lock.lock();
     }
-    mWorkQueue.push(std::move(task));
-    if (mWaitingThreads == THREAD_COUNT || (mWaitingThreads > 0 && mWorkQueue.size() > 1)) {
+    queue.push(std::move(queued));
+    // A busy worker picks up a lone Normal task soon enough, but High tasks shouldn't wait for
+    // whatever it is busy with.
+    int waiting = mWaitingThreads;
+    if (waiting == THREAD_COUNT ||
+        (waiting > 0 && (priority == Priority::High || queue.size() > 1))) {
+        mCondition.notify_one();
+    }
+}
+
+bool CommonPool::enqueueLocal(QueuedTask& task) {
+    Worker& worker = mWorkers[sWorkerIndex];
+    {
+        std::lock_guard lock(worker.lock);
+        auto& tasks = worker.tasks[static_cast<int>(task.priority)];
+        if (tasks.size() >= QUEUE_SIZE) {
+            return false;
+        }
+        tasks.push_back(std::move(task));
+    }
+    // Idle workers count themselves as waiting before they look for work, so either they find
+    // this task or it finds them waiting.
+    if (mWaitingThreads > 0) {
+        std::lock_guard lock(mLock);
         mCondition.notify_one();
     }
+    return true;
+}
+
+bool CommonPool::dequeue(int workerIndex, QueuedTask* outTask) {
+    for (int priority = 0; priority < PRIORITY_COUNT; priority++) {
+        {
+            Worker& own = mWorkers[workerIndex];
+            std::lock_guard lock(own.lock);
+            auto& tasks = own.tasks[priority];
+            if (!tasks.empty()) {
+                *outTask = std::move(tasks.back());
+                tasks.pop_back();
+                return true;
+            }
+        }
+        auto& queue = mWorkQueues[priority];
+        if (queue.hasWork()) {
+            *outTask = queue.pop();
+            return true;
+        }
+        for (int i = 1; i < THREAD_COUNT; i++) {
+            Worker& victim = mWorkers[(workerIndex + i) % THREAD_COUNT];
+            std::lock_guard lock(victim.lock);
+            auto& tasks = victim.tasks[priority];
+            if (!tasks.empty()) {
+                *outTask = std::move(tasks.front());
+                tasks.pop_front();
+                return true;
+            }
+        }
+    }
+    return false;
 }
 
-void CommonPool::workerLoop() {
+void CommonPool::recordQueueWait(const QueuedTask& task) {
+    nsecs_t wait = systemTime(SYSTEM_TIME_MONOTONIC) - task.queueTime;
+    size_t bucket = std::lower_bound(QUEUE_WAIT_BUCKETS.begin(), QUEUE_WAIT_BUCKETS.end(), wait) -
+                    QUEUE_WAIT_BUCKETS.begin();
+    mQueueWaits[static_cast<int>(task.priority)][bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void CommonPool::workerLoop(int workerIndex) {
+    sWorkerIndex = workerIndex;
+    QueuedTask work;
     std::unique_lock lock(mLock);
     while (true) {
-        if (!mWorkQueue.hasWork()) {
-            mWaitingThreads++;
+        mWaitingThreads++;
+        while (!dequeue(workerIndex, &work)) {
             mCondition.wait(lock);
-            mWaitingThreads--;
         }
-        // Need to double-check that work is still available now that we have the lock
-        // It may have already been grabbed by a different thread
-        while (mWorkQueue.hasWork()) {
-            auto work = mWorkQueue.pop();
-            lock.unlock();
-            work();
-            lock.lock();
+        mWaitingThreads--;
+        lock.unlock();
+        if (!work.claimed || !work.claimed->exchange(true, std::memory_order_acq_rel)) {
+            recordQueueWait(work);
+            work.task();
         }
+        // Release whatever the task captured before this worker can be seen as idle again.
+        work.task = nullptr;
+        lock.lock();
+    }
+}
+
+CommonPool::QueueWaitHistogram CommonPool::getQueueWaitHistogram(Priority priority) {
+    auto& counts = instance().mQueueWaits[static_cast<int>(priority)];
+    QueueWaitHistogram histogram;
+    for (size_t i = 0; i < histogram.size(); i++) {
+        histogram[i] = counts[i].load(std::memory_order_relaxed);
+    }
+    return histogram;
+}
+
+void CommonPool::dumpQueueWaitHistograms(int fd) {
+    std::string log = "\nCommonPool queue wait:";
+    for (nsecs_t bucket : QUEUE_WAIT_BUCKETS) {
+        base::StringAppendF(&log, " <=%" PRId64 "us", bucket / 1000);
+    }
+    base::StringAppendF(&log, " >%" PRId64 "us", QUEUE_WAIT_BUCKETS.back() / 1000);
+    static const char* const kPriorityNames[PRIORITY_COUNT] = {"High", "Normal"};
+    for (int priority = 0; priority < PRIORITY_COUNT; priority++) {
+        base::StringAppendF(&log, "\n  %s:", kPriorityNames[priority]);
+        for (uint32_t count : getQueueWaitHistogram(static_cast<Priority>(priority))) {
+            base::StringAppendF(&log, " %u", count);
+        }
+    }
+    dprintf(fd, "%s\n", log.c_str());
+}
+
+struct CommonPool::TaskGroup::GroupTask {
+    Task task;
+    // Whoever flips this first, a worker or join(), runs the task.
+    std::atomic_bool claimed = false;
+};
+
+struct CommonPool::TaskGroup::State {
+    std::mutex lock;
+    std::condition_variable finished;
+    int pending = 0;
+
+    void runTask(GroupTask& groupTask) {
+        if (!groupTask.claimed.exchange(true, std::memory_order_acq_rel)) {
+            runClaimed(groupTask);
+        }
+    }
+
+    void runClaimed(GroupTask& groupTask) {
+        groupTask.task();
+        groupTask.task = nullptr;
+        std::lock_guard _lock(lock);
+        if (--pending == 0) {
+            finished.notify_all();
+        }
+    }
+};
+
+CommonPool::TaskGroup::TaskGroup(Priority priority)
+        : mPriority(priority), mState(std::make_shared<State>()) {}
+
+void CommonPool::TaskGroup::run(Task&& task) {
+    auto groupTask = std::make_shared<GroupTask>();
+    groupTask->task = std::move(task);
+    {
+        std::lock_guard lock(mState->lock);
+        mState->pending++;
+    }
+    mTasks.push_back(groupTask);
+    // The worker claims the task itself, see QueuedTask::claimed.
+    std::atomic_bool* claimed = &groupTask->claimed;
+    instance().enqueue([state = mState, groupTask]() { state->runClaimed(*groupTask); }, mPriority,
+                       claimed);
+}
+
+void CommonPool::TaskGroup::join() {
+    // Workers take the oldest tasks first, so the newest are the least likely to be started.
+    for (auto it = mTasks.rbegin(); it != mTasks.rend(); it++) {
+        mState->runTask(**it);
+    }
+    mTasks.clear();
+    std::unique_lock lock(mState->lock);
+    while (mState->pending > 0) {
+        mState->finished.wait(lock);
     }
 }
 
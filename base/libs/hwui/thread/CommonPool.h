@@ -20,10 +20,15 @@
 #include "utils/Macros.h"
 
 #include <log/log.h>
+#include <utils/Timers.h>
 
+#include <array>
+#include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <future>
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -63,7 +68,7 @@ public:
         int index = mTail;
         mTail = (mTail + 1) % SIZE;
         T ret = std::move(mBuffer[index]);
-        mBuffer[index] = nullptr;
+        mBuffer[index] = T();
         return ret;
     }
 
@@ -81,45 +86,108 @@ public:
     static constexpr auto THREAD_COUNT = 2;
     static constexpr auto QUEUE_SIZE = 128;
 
-    static void post(Task&& func);
+    // Workers always pick up High tasks before Normal ones. High is meant for work a frame is
+    // waiting on, everything that can finish whenever should stay Normal.
+    enum class Priority { High = 0, Normal, Count };
+    static constexpr auto PRIORITY_COUNT = static_cast<int>(Priority::Count);
+
+    // Upper bounds of the queue wait histogram buckets, the last bucket counts everything longer.
+    static constexpr std::array<nsecs_t, 9> QUEUE_WAIT_BUCKETS = {
+            50000, 100000, 250000, 500000, 1000000, 2000000, 4000000, 8000000, 16000000};
+    using QueueWaitHistogram = std::array<uint32_t, QUEUE_WAIT_BUCKETS.size() + 1>;
+
+    static void post(Task&& func, Priority priority = Priority::Normal);
 
     template <class F>
-    static auto async(F&& func) -> std::future<decltype(func())> {
+    static auto async(F&& func, Priority priority = Priority::Normal)
+            -> std::future<decltype(func())> {
         typedef std::packaged_task<decltype(func())()> task_t;
         auto task = std::make_shared<task_t>(std::forward<F>(func));
-        post([task]() { std::invoke(*task); });
+        post([task]() { std::invoke(*task); }, priority);
         return task->get_future();
     }
 
     template <class F>
-    static auto runSync(F&& func) -> decltype(func()) {
+    static auto runSync(F&& func, Priority priority = Priority::Normal) -> decltype(func()) {
         std::packaged_task<decltype(func())()> task{std::forward<F>(func)};
-        post([&task]() { std::invoke(task); });
+        post([&task]() { std::invoke(task); }, priority);
         return task.get_future().get();
     };
 
+    /**
+     * Tasks that are waited on together. join() runs the tasks no worker has started yet on the
+     * calling thread instead of waiting for a worker to get to them, so joining never waits
+     * behind unrelated work and is safe from a CommonPool task too. Destroying the group joins it.
+     */
+    class TaskGroup {
+        PREVENT_COPY_AND_ASSIGN(TaskGroup);
+
+    public:
+        explicit TaskGroup(Priority priority = Priority::High);
+        ~TaskGroup() { join(); }
+
+        void run(Task&& task);
+        void join();
+
+    private:
+        struct State;
+
+        struct GroupTask;
+
+        const Priority mPriority;
+        std::shared_ptr<State> mState;
+        std::vector<std::shared_ptr<GroupTask>> mTasks;
+    };
+
     static std::vector<int> getThreadIds();
 
+    // Time tasks of the given priority spent queued before a worker started them.
+    static QueueWaitHistogram getQueueWaitHistogram(Priority priority);
+    static void dumpQueueWaitHistograms(int fd);
+
     // For testing purposes only, blocks until all worker threads are parked.
     static void waitForIdle();
 
 private:
+    struct QueuedTask {
+        Task task;
+        nsecs_t queueTime = 0;
+        Priority priority = Priority::Normal;
+        // Set for TaskGroup tasks. The worker claims the task before running it, if join() got
+        // there first the task is already done and neither runs nor counts as a queue wait.
+        std::atomic_bool* claimed = nullptr;
+    };
+
+    // Tasks posted from a worker thread, usually the parts of a task that was split up. The
+    // owner pushes and pops at the back to stay on warm data, idle workers steal from the front.
+    struct Worker {
+        std::mutex lock;
+        std::deque<QueuedTask> tasks[PRIORITY_COUNT];
+    };
+
     static CommonPool& instance();
 
     CommonPool();
     ~CommonPool() {}
 
-    void enqueue(Task&&);
+    void enqueue(Task&&, Priority priority, std::atomic_bool* claimed = nullptr);
+    bool enqueueLocal(QueuedTask& task);
+    // Must be called with mLock held.
+    bool dequeue(int workerIndex, QueuedTask* outTask);
+    void recordQueueWait(const QueuedTask& task);
     void doWaitForIdle();
 
-    void workerLoop();
+    void workerLoop(int workerIndex);
 
     std::vector<int> mWorkerThreadIds;
+    std::array<Worker, THREAD_COUNT> mWorkers;
 
     std::mutex mLock;
     std::condition_variable mCondition;
-    int mWaitingThreads = 0;
-    ArrayQueue<Task, QUEUE_SIZE> mWorkQueue;
+    std::atomic_int mWaitingThreads = 0;
+    ArrayQueue<QueuedTask, QUEUE_SIZE> mWorkQueues[PRIORITY_COUNT];
+
+    std::atomic<uint32_t> mQueueWaits[PRIORITY_COUNT][QUEUE_WAIT_BUCKETS.size() + 1] = {};
 };
 
 }  // namespace uirenderer
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "utils/Macros.h"
+
+#include <stddef.h>
+
+#include <atomic>
+
+namespace android {
+namespace uirenderer {
+
+/**
+ * Fixed size ring buffer handing values from a single producer to a single consumer, which may
+ * run on different threads. Neither side blocks or takes a lock: push() fails when the ring is
+ * full and pop() fails when it is empty.
+ *
+ * Each side may move between threads as long as those threads are otherwise synchronized, e.g.
+ * by always pushing under the same mutex.
+ */
+template <class T, size_t SIZE>
+class SpscRingBuffer {
+    PREVENT_COPY_AND_ASSIGN(SpscRingBuffer);
+    static_assert(SIZE > 0 && (SIZE & (SIZE - 1)) == 0, "SIZE must be a power of two");
+
+public:
+    SpscRingBuffer() {}
+
+    constexpr size_t capacity() const { return SIZE; }
+
+    // Called by the producer only.
+    bool push(const T& value) {
+        size_t head = mHead.load(std::memory_order_relaxed);
+        if (head - mCachedTail == SIZE) {
+            mCachedTail = mTail.load(std::memory_order_acquire);
+            if (head - mCachedTail == SIZE) {
+                return false;
+            }
+        }
+        mBuffer[head & (SIZE - 1)] = value;
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Called by the consumer only.
+    bool pop(T* outValue) {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail == mCachedHead) {
+            mCachedHead = mHead.load(std::memory_order_acquire);
+            if (tail == mCachedHead) {
+                return false;
+            }
+        }
+        *outValue = mBuffer[tail & (SIZE - 1)];
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    static constexpr size_t kCacheLineSize = 64;
+
+    // Written by the producer. mCachedTail is the producer's last view of mTail, so that it only
+    // touches the consumer's cache line once the ring looks full.
+    alignas(kCacheLineSize) std::atomic<size_t> mHead = 0;
+    size_t mCachedTail = 0;
+
+    // Written by the consumer, mCachedHead mirrors mCachedTail.
+    alignas(kCacheLineSize) std::atomic<size_t> mTail = 0;
+    size_t mCachedHead = 0;
+
+    alignas(kCacheLineSize) T mBuffer[SIZE];
+};
+
+}  // namespace uirenderer
+}  // namespace android
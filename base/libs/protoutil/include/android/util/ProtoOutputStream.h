@@ -18,10 +18,14 @@
 #define ANDROID_UTIL_PROTOOUTPUT_STREAM_H
 
 #include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 
+#include <sys/uio.h>
+
 #include <android/util/EncodedBuffer.h>
+#include <android/util/protobuf.h>
 
 namespace android {
 namespace util {
@@ -122,6 +126,10 @@ public:
     /**
      * Flushes the protobuf data out to given fd. When the following functions are called,
      * it is not able to write to ProtoOutputStream any more since the data is compact.
+     *
+     * Only data() compacts the buffer in place. The other functions encode the sizes of the
+     * nested messages on the fly and leave the bytes where they were written, flush() sends
+     * the chunks with writev.
      */
     size_t size(); // Get the size of the serialized protobuf.
     sp<ProtoReader> data(); // Get the reader apis of the data.
@@ -139,10 +147,31 @@ public:
     void writeLengthDelimitedHeader(uint32_t id, size_t size);
     void writeRawByte(uint8_t byte);
 
+    /**
+     * Fast paths for the writers generated by protoc-gen-cppstream. The wire type of the field
+     * is known at compile time and its tag is passed already encoded, so each call is a single
+     * copy into the buffer without any field type dispatch. Returns false after compaction, or
+     * if the buffer can't grow.
+     */
+    template<size_t N> bool writeTaggedVarint(const uint8_t (&tag)[N], uint64_t val);
+    template<size_t N> bool writeTaggedFixed32(const uint8_t (&tag)[N], uint32_t val);
+    template<size_t N> bool writeTaggedFixed64(const uint8_t (&tag)[N], uint64_t val);
+    template<size_t N> bool writeTaggedBytes(const uint8_t (&tag)[N], const char* val,
+            size_t size);
+
 private:
+    // A run of encoded bytes, either in mBuffer or in the encoded sizes of nested messages.
+    struct Span {
+        bool inBuffer;
+        size_t pos;
+        size_t size;
+    };
+
     sp<EncodedBuffer> mBuffer;
     size_t mCopyBegin;
     bool mCompact;
+    bool mSizesEdited;
+    size_t mEncodedSize;
     uint32_t mDepth;
     uint32_t mObjectId;
     uint64_t mExpectedObjectToken;
@@ -164,14 +193,71 @@ private:
     inline void writeUtf8StringImpl(uint32_t id, const char* val, size_t size);
     inline void writeMessageBytesImpl(uint32_t id, const char* val, size_t size);
 
+    bool editSizes();
     bool compact();
     size_t editEncodedSize(size_t rawSize);
     bool compactSize(size_t rawSize);
+    bool spliceSize(size_t rawSize, size_t* copyBegin, std::vector<Span>* spans,
+            std::vector<uint8_t>* sizes);
+    bool encodedData(std::vector<struct iovec>* out, std::vector<uint8_t>* sizes);
 
     template<typename T>
     bool internalWrite(uint64_t fieldId, T val, const char* typeName);
 };
 
+template<size_t N>
+inline bool
+ProtoOutputStream::writeTaggedVarint(const uint8_t (&tag)[N], uint64_t val)
+{
+    if (mSizesEdited) return false;
+    uint8_t buf[N + 10];
+    memcpy(buf, tag, N);
+    uint8_t* end = write_raw_varint(buf + N, val);
+    return mBuffer->writeRaw(buf, end - buf) == NO_ERROR;
+}
+
+template<size_t N>
+inline bool
+ProtoOutputStream::writeTaggedFixed32(const uint8_t (&tag)[N], uint32_t val)
+{
+    if (mSizesEdited) return false;
+    uint8_t buf[N + 4];
+    memcpy(buf, tag, N);
+    for (size_t i = 0; i < 4; i++) {
+        buf[N + i] = (uint8_t)(val >> (8 * i));
+    }
+    return mBuffer->writeRaw(buf, sizeof(buf)) == NO_ERROR;
+}
+
+template<size_t N>
+inline bool
+ProtoOutputStream::writeTaggedFixed64(const uint8_t (&tag)[N], uint64_t val)
+{
+    if (mSizesEdited) return false;
+    uint8_t buf[N + 8];
+    memcpy(buf, tag, N);
+    for (size_t i = 0; i < 8; i++) {
+        buf[N + i] = (uint8_t)(val >> (8 * i));
+    }
+    return mBuffer->writeRaw(buf, sizeof(buf)) == NO_ERROR;
+}
+
+template<size_t N>
+inline bool
+ProtoOutputStream::writeTaggedBytes(const uint8_t (&tag)[N], const char* val, size_t size)
+{
+    if (mSizesEdited) return false;
+    if (val == NULL) return true;
+    // Same layout as writeLengthDelimitedHeader, the size is known so both halves are equal.
+    uint8_t buf[N + 8];
+    memcpy(buf, tag, N);
+    for (size_t i = 0; i < 4; i++) {
+        buf[N + i] = buf[N + 4 + i] = (uint8_t)(size >> (8 * i));
+    }
+    return mBuffer->writeRaw(buf, sizeof(buf)) == NO_ERROR
+            && mBuffer->writeRaw(reinterpret_cast<const uint8_t*>(val), size) == NO_ERROR;
+}
+
 }
 }
 
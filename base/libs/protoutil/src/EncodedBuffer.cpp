@@ -18,6 +18,8 @@
 #include <stdlib.h>
 #include <sys/mman.h>
 
+#include <mutex>
+
 #include <android/util/EncodedBuffer.h>
 #include <android/util/protobuf.h>
 #include <cutils/log.h>
@@ -27,6 +29,57 @@ namespace util {
 
 const size_t BUFFER_SIZE = 8 * 1024; // 8 KB
 
+// Number of default-sized chunks kept around for reuse across the process, 512 KB.
+const size_t MAX_POOLED_CHUNKS = 64;
+
+/**
+ * Process-wide pool of default-sized chunks. Protos are built and dropped over and over by
+ * the same process (incidentd sections, dumpsys), so recycling their chunks saves a mmap and
+ * a munmap per chunk. The pool is never destroyed so buffers living in static storage can
+ * still return their chunks at exit.
+ */
+static std::mutex& chunkPoolLock() {
+    static std::mutex* lock = new std::mutex();
+    return *lock;
+}
+
+static std::vector<uint8_t*>& chunkPool() {
+    static std::vector<uint8_t*>* pool = new std::vector<uint8_t*>();
+    return *pool;
+}
+
+static uint8_t*
+allocateChunk(size_t chunkSize)
+{
+    if (chunkSize == BUFFER_SIZE) {
+        std::lock_guard<std::mutex> lock(chunkPoolLock());
+        std::vector<uint8_t*>& pool = chunkPool();
+        if (!pool.empty()) {
+            uint8_t* buf = pool.back();
+            pool.pop_back();
+            return buf;
+        }
+    }
+    // Use mmap instead of malloc to ensure memory alignment i.e. no fragmentation so that
+    // the mem region can be immediately reused by the allocator after calling munmap()
+    void* buf = mmap(NULL, chunkSize, PROT_READ | PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+    return buf == MAP_FAILED ? NULL : (uint8_t*)buf;
+}
+
+static void
+releaseChunk(uint8_t* buf, size_t chunkSize)
+{
+    if (chunkSize == BUFFER_SIZE) {
+        std::lock_guard<std::mutex> lock(chunkPoolLock());
+        std::vector<uint8_t*>& pool = chunkPool();
+        if (pool.size() < MAX_POOLED_CHUNKS) {
+            pool.push_back(buf);
+            return;
+        }
+    }
+    munmap(buf, chunkSize);
+}
+
 EncodedBuffer::Pointer::Pointer() : Pointer(BUFFER_SIZE)
 {
 }
@@ -100,8 +153,7 @@ EncodedBuffer::EncodedBuffer(size_t chunkSize)
 EncodedBuffer::~EncodedBuffer()
 {
     for (size_t i=0; i<mBuffers.size(); i++) {
-        uint8_t* buf = mBuffers[i];
-        munmap(buf, mChunkSize);
+        releaseChunk(mBuffers[i], mChunkSize);
     }
 }
 
@@ -138,11 +190,7 @@ EncodedBuffer::writeBuffer()
     if (mWp.index() > mBuffers.size()) return NULL;
     uint8_t* buf = NULL;
     if (mWp.index() == mBuffers.size()) {
-        // Use mmap instead of malloc to ensure memory alignment i.e. no fragmentation so that
-        // the mem region can be immediately reused by the allocator after calling munmap()
-        buf = (uint8_t*)mmap(NULL, mChunkSize, PROT_READ | PROT_WRITE,
-                MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
-
+        buf = allocateChunk(mChunkSize);
         if (buf == NULL) return NULL; // This indicates NO_MEMORY
 
         mBuffers.push_back(buf);
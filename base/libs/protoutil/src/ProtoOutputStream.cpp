@@ -15,9 +15,13 @@
  */
 #define LOG_TAG "libprotoutil"
 
+#include <algorithm>
 #include <cinttypes>
 #include <type_traits>
 
+#include <limits.h>
+#include <sys/uio.h>
+
 #include <android-base/file.h>
 #include <android/util/protobuf.h>
 #include <android/util/ProtoOutputStream.h>
@@ -34,6 +38,8 @@ ProtoOutputStream::ProtoOutputStream(sp<EncodedBuffer> buffer)
         :mBuffer(buffer),
          mCopyBegin(0),
          mCompact(false),
+         mSizesEdited(false),
+         mEncodedSize(0),
          mDepth(0),
          mObjectId(0),
          mExpectedObjectToken(UINT64_C(-1))
@@ -51,6 +57,8 @@ ProtoOutputStream::clear()
     mBuffer->clear();
     mCopyBegin = 0;
     mCompact = false;
+    mSizesEdited = false;
+    mEncodedSize = 0;
     mDepth = 0;
     mObjectId = 0;
     mExpectedObjectToken = UINT64_C(-1);
@@ -60,7 +68,7 @@ template<typename T>
 bool
 ProtoOutputStream::internalWrite(uint64_t fieldId, T val, const char* typeName)
 {
-    if (mCompact) return false;
+    if (mSizesEdited) return false;
     const uint32_t id = (uint32_t)fieldId;
     switch (fieldId & FIELD_TYPE_MASK) {
         case FIELD_TYPE_DOUBLE:   writeDoubleImpl(id, (double)val);           break;
@@ -122,7 +130,7 @@ ProtoOutputStream::write(uint64_t fieldId, int val)
 bool
 ProtoOutputStream::write(uint64_t fieldId, long val)
 {
-    if (mCompact) return false;
+    if (mSizesEdited) return false;
     const uint32_t id = (uint32_t)fieldId;
     switch (fieldId & FIELD_TYPE_MASK) {
         case FIELD_TYPE_DOUBLE:   writeDoubleImpl(id, (double)val);           break;
@@ -156,7 +164,7 @@ ProtoOutputStream::write(uint64_t fieldId, long long val)
 bool
 ProtoOutputStream::write(uint64_t fieldId, bool val)
 {
-    if (mCompact) return false;
+    if (mSizesEdited) return false;
     const uint32_t id = (uint32_t)fieldId;
     switch (fieldId & FIELD_TYPE_MASK) {
         case FIELD_TYPE_BOOL:
@@ -172,7 +180,7 @@ ProtoOutputStream::write(uint64_t fieldId, bool val)
 bool
 ProtoOutputStream::write(uint64_t fieldId, std::string val)
 {
-    if (mCompact) return false;
+    if (mSizesEdited) return false;
     const uint32_t id = (uint32_t)fieldId;
     switch (fieldId & FIELD_TYPE_MASK) {
         case FIELD_TYPE_STRING:
@@ -188,7 +196,7 @@ ProtoOutputStream::write(uint64_t fieldId, std::string val)
 bool
 ProtoOutputStream::write(uint64_t fieldId, const char* val, size_t size)
 {
-    if (mCompact) return false;
+    if (mSizesEdited) return false;
     const uint32_t id = (uint32_t)fieldId;
     switch (fieldId & FIELD_TYPE_MASK) {
         case FIELD_TYPE_STRING:
@@ -312,9 +320,13 @@ ProtoOutputStream::bytesWritten()
     return mBuffer->size();
 }
 
+/**
+ * Fills in the encoded sizes of the nested objects, so the data can either be compacted
+ * in place or spliced together with the encoded sizes on output.
+ */
 bool
-ProtoOutputStream::compact() {
-    if (mCompact) return true;
+ProtoOutputStream::editSizes() {
+    if (mSizesEdited) return true;
     if (mDepth != 0) {
         ALOGE("Can't compact when depth(%" PRIu32 ") is not zero. Missing or extra calls to end.", mDepth);
         return false;
@@ -325,11 +337,26 @@ ProtoOutputStream::compact() {
 
     // reset edit pointer and recursively compute encoded size of messages.
     mBuffer->ep()->rewind();
-    if (editEncodedSize(rawBufferSize) == 0) {
+    mEncodedSize = editEncodedSize(rawBufferSize);
+    if (mEncodedSize == 0) {
         ALOGE("Failed to editEncodedSize.");
         return false;
     }
 
+    // mark true means it is not legal to write to this ProtoOutputStream anymore
+    mSizesEdited = true;
+    return true;
+}
+
+bool
+ProtoOutputStream::compact() {
+    if (mCompact) return true;
+    if (!editSizes()) return false;
+
+    // record the size of the original buffer.
+    size_t rawBufferSize = mBuffer->size();
+    if (rawBufferSize == 0) return true; // nothing to do if the buffer is empty;
+
     // reset both edit pointer and write pointer, and compact recursively.
     mBuffer->ep()->rewind();
     mBuffer->wp()->rewind();
@@ -337,12 +364,12 @@ ProtoOutputStream::compact() {
         ALOGE("Failed to compactSize.");
         return false;
     }
+
     // copy the reset to the buffer.
     if (mCopyBegin < rawBufferSize) {
         mBuffer->copy(mCopyBegin, rawBufferSize - mCopyBegin);
     }
 
-    // mark true means it is not legal to write to this ProtoOutputStream anymore
     mCompact = true;
     return true;
 }
@@ -454,28 +481,155 @@ ProtoOutputStream::compactSize(size_t rawSize)
     return true;
 }
 
+/**
+ * Same walk as compactSize, but instead of moving the data forward in the buffer, collect
+ * it as spans of the buffer separated by the varint sizes of the nested objects, which are
+ * appended to sizes.
+ */
+bool
+ProtoOutputStream::spliceSize(size_t rawSize, size_t* copyBegin, std::vector<Span>* spans,
+        std::vector<uint8_t>* sizes)
+{
+    size_t objectStart = mBuffer->ep()->pos();
+    size_t objectEnd = objectStart + rawSize;
+    int childRawSize, childEncodedSize;
+    uint8_t varint[10];
+    uint8_t* varintEnd;
+
+    while (mBuffer->ep()->pos() < objectEnd) {
+        uint32_t tag = (uint32_t)mBuffer->readRawVarint();
+        switch (read_wire_type(tag)) {
+            case WIRE_TYPE_VARINT:
+                while ((mBuffer->readRawByte() & 0x80) != 0) {}
+                break;
+            case WIRE_TYPE_FIXED64:
+                mBuffer->ep()->move(8);
+                break;
+            case WIRE_TYPE_LENGTH_DELIMITED:
+                if (mBuffer->ep()->pos() > *copyBegin) {
+                    spans->push_back({true, *copyBegin, mBuffer->ep()->pos() - *copyBegin});
+                }
+                childRawSize = (int)mBuffer->readRawFixed32();
+                childEncodedSize = (int)mBuffer->readRawFixed32();
+                *copyBegin = mBuffer->ep()->pos();
+
+                // the encoded size replaces the 64 bits reserved in the buffer.
+                varintEnd = write_raw_varint(varint, (uint32_t)childEncodedSize);
+                spans->push_back({false, sizes->size(), (size_t)(varintEnd - varint)});
+                sizes->insert(sizes->end(), varint, varintEnd);
+                if (childRawSize >= 0 && childRawSize == childEncodedSize) {
+                    mBuffer->ep()->move(childEncodedSize);
+                } else if (childRawSize < 0){
+                    if (!spliceSize(-childRawSize, copyBegin, spans, sizes)) return false;
+                } else {
+                    ALOGE("Bad raw or encoded values: raw=%d, encoded=%d",
+                            childRawSize, childEncodedSize);
+                    return false;
+                }
+                break;
+            case WIRE_TYPE_FIXED32:
+                mBuffer->ep()->move(4);
+                break;
+            default:
+                ALOGE("Unexpected wire type %d in spliceSize at [%zu, %zu]",
+                        read_wire_type(tag), objectStart, objectEnd);
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * The average size of the nested objects under which the buffer is compacted rather than spliced.
+ */
+static const size_t MIN_SPLICED_OBJECT_SIZE = 256;
+
+/**
+ * Collects the encoded data as iovecs pointing into the chunks of the buffer and into sizes,
+ * without compacting the buffer.
+ */
+bool
+ProtoOutputStream::encodedData(std::vector<struct iovec>* out, std::vector<uint8_t>* sizes)
+{
+    // Splicing costs about as much per nested object as compacting costs per byte, so a
+    // buffer of mostly small objects is cheaper to compact.
+    if (!mCompact && mBuffer->size() < (size_t)mObjectId * MIN_SPLICED_OBJECT_SIZE) {
+        if (!compact()) return false;
+    }
+
+    std::vector<Span> spans;
+    size_t rawBufferSize = mBuffer->size();
+    if (mCompact) {
+        spans.push_back({true, 0, rawBufferSize});
+    } else {
+        if (!editSizes()) return false;
+        if (rawBufferSize > 0) {
+            size_t copyBegin = 0;
+            mBuffer->ep()->rewind();
+            if (!spliceSize(rawBufferSize, &copyBegin, &spans, sizes)) {
+                ALOGE("Failed to spliceSize.");
+                return false;
+            }
+            if (copyBegin < rawBufferSize) {
+                spans.push_back({true, copyBegin, rawBufferSize - copyBegin});
+            }
+        }
+    }
+
+    // spans of the buffer are in increasing order.
+    sp<ProtoReader> reader = mBuffer->read();
+    for (const Span& span : spans) {
+        if (!span.inBuffer) {
+            out->push_back({sizes->data() + span.pos, span.size});
+            continue;
+        }
+        reader->move(span.pos - reader->bytesRead());
+        size_t remaining = span.size;
+        while (remaining > 0 && reader->readBuffer() != NULL) {
+            size_t amt = std::min(reader->currentToRead(), remaining);
+            out->push_back({const_cast<uint8_t*>(reader->readBuffer()), amt});
+            reader->move(amt);
+            remaining -= amt;
+        }
+    }
+    return true;
+}
+
 size_t
 ProtoOutputStream::size()
 {
-    if (!compact()) {
+    if (mCompact) return mBuffer->size();
+    if (!editSizes()) {
         ALOGE("compact failed, the ProtoOutputStream data is corrupted!");
         return 0;
     }
-    return mBuffer->size();
+    return mEncodedSize;
 }
 
 bool
 ProtoOutputStream::flush(int fd)
 {
     if (fd < 0) return false;
-    if (!compact()) return false;
-
-    sp<ProtoReader> reader = mBuffer->read();
-    while (reader->readBuffer() != NULL) {
-        if (!android::base::WriteFully(fd, reader->readBuffer(), reader->currentToRead())) {
+    std::vector<struct iovec> iov;
+    std::vector<uint8_t> sizes;
+    if (!encodedData(&iov, &sizes)) return false;
+
+    size_t done = 0;
+    while (done < iov.size()) {
+        int count = (int)std::min(iov.size() - done, (size_t)IOV_MAX);
+        ssize_t written = TEMP_FAILURE_RETRY(writev(fd, iov.data() + done, count));
+        if (written < 0) {
             return false;
         }
-        reader->move(reader->currentToRead());
+        // skip what has been written, a short write may stop in the middle of an iovec.
+        while (done < iov.size() && (size_t)written >= iov[done].iov_len) {
+            written -= iov[done].iov_len;
+            done++;
+        }
+        if (written > 0) {
+            iov[done].iov_base = (uint8_t*)iov[done].iov_base + written;
+            iov[done].iov_len -= written;
+        }
     }
     return true;
 }
@@ -484,14 +638,12 @@ bool
 ProtoOutputStream::serializeToString(std::string* out)
 {
     if (out == nullptr) return false;
-    if (!compact()) return false;
-
-    sp<ProtoReader> reader = mBuffer->read();
-    out->reserve(reader->size());
-    while (reader->hasNext()) {
-        out->append(static_cast<const char*>(static_cast<const void*>(reader->readBuffer())),
-                    reader->currentToRead());
-        reader->move(reader->currentToRead());
+    std::vector<struct iovec> iov;
+    std::vector<uint8_t> sizes;
+    if (!encodedData(&iov, &sizes)) return false;
+    out->reserve(size());
+    for (const struct iovec& span : iov) {
+        out->append(static_cast<const char*>(span.iov_base), span.iov_len);
     }
     return true;
 }
@@ -500,15 +652,13 @@ bool
 ProtoOutputStream::serializeToVector(std::vector<uint8_t>* out)
 {
     if (out == nullptr) return false;
-    if (!compact()) return false;
-
-    sp<ProtoReader> reader = mBuffer->read();
-    out->reserve(reader->size());
-    while (reader->hasNext()) {
-        const uint8_t* buf = reader->readBuffer();
-        size_t size = reader->currentToRead();
-        out->insert(out->end(), buf, buf + size);
-        reader->move(size);
+    std::vector<struct iovec> iov;
+    std::vector<uint8_t> sizes;
+    if (!encodedData(&iov, &sizes)) return false;
+    out->reserve(size());
+    for (const struct iovec& span : iov) {
+        const uint8_t* buf = static_cast<const uint8_t*>(span.iov_base);
+        out->insert(out->end(), buf, buf + span.iov_len);
     }
     return true;
 }
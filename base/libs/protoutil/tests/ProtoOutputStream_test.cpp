@@ -316,6 +316,126 @@ TEST(ProtoOutputStreamTest, AdvancedEncoding) {
     EXPECT_FALSE(log2.has_data());
 }
 
+TEST(ProtoOutputStreamTest, FlushBeforeCompact) {
+    ProtoOutputStream proto;
+    EXPECT_TRUE(proto.write(FIELD_TYPE_INT32 | ComplexProto::kIntsFieldNumber, 23));
+    uint64_t token = proto.start(FIELD_TYPE_MESSAGE | ComplexProto::kLogsFieldNumber);
+    EXPECT_TRUE(proto.write(FIELD_TYPE_INT32 | ComplexProto::Log::kIdFieldNumber, 12));
+    const std::string name(1000, 'c');
+    EXPECT_TRUE(proto.write(FIELD_TYPE_STRING | ComplexProto::Log::kNameFieldNumber, name));
+    proto.end(token);
+
+    // flush doesn't compact a buffer of large fields, so the data can still be compacted
+    // afterwards.
+    std::string flushed = flushToString(&proto);
+    EXPECT_EQ(proto.size(), flushed.size());
+    EXPECT_FALSE(proto.write(FIELD_TYPE_INT32 | ComplexProto::kIntsFieldNumber, 94));
+    EXPECT_EQ(iterateToString(&proto), flushed);
+    EXPECT_EQ(flushToString(&proto), flushed);
+
+    ComplexProto complex;
+    ASSERT_TRUE(complex.ParseFromString(flushed));
+    EXPECT_EQ(complex.ints_size(), 1);
+    EXPECT_EQ(complex.ints(0), 23);
+    EXPECT_EQ(complex.logs_size(), 1);
+    EXPECT_EQ(complex.logs(0).id(), 12);
+    EXPECT_EQ(complex.logs(0).name(), name);
+}
+
+TEST(ProtoOutputStreamTest, FlushManyChunks) {
+    // Enough nested messages to need several writev calls and several chunks, large enough
+    // to be flushed without compacting the buffer.
+    const int count = 5000;
+    const std::string padding(300, '-');
+    ProtoOutputStream flushed;
+    ProtoOutputStream compacted;
+    for (ProtoOutputStream* proto : { &flushed, &compacted }) {
+        for (int i = 0; i < count; i++) {
+            uint64_t token = proto->start(FIELD_TYPE_MESSAGE | ComplexProto::kLogsFieldNumber);
+            EXPECT_TRUE(proto->write(FIELD_TYPE_INT32 | ComplexProto::Log::kIdFieldNumber, i));
+            EXPECT_TRUE(proto->write(FIELD_TYPE_STRING | ComplexProto::Log::kNameFieldNumber,
+                    std::string("name-") + std::to_string(i) + padding));
+            proto->end(token);
+        }
+    }
+
+    std::string expected = iterateToString(&compacted);
+    EXPECT_EQ(flushToString(&flushed), expected);
+    std::string serialized;
+    ASSERT_TRUE(flushed.serializeToString(&serialized));
+    EXPECT_EQ(serialized, expected);
+
+    ComplexProto complex;
+    ASSERT_TRUE(complex.ParseFromString(expected));
+    ASSERT_EQ(complex.logs_size(), count);
+    EXPECT_EQ(complex.logs(count - 1).id(), count - 1);
+    EXPECT_EQ(complex.logs(count - 1).name(), "name-4999" + padding);
+}
+
+TEST(ProtoOutputStreamTest, FlushSmallAndLargeMessages) {
+    // Small nested messages are compacted before flushing, large ones aren't. Both give the
+    // same bytes.
+    for (size_t size : { 1, 4000 }) {
+        ProtoOutputStream flushed;
+        ProtoOutputStream compacted;
+        for (ProtoOutputStream* proto : { &flushed, &compacted }) {
+            for (int i = 0; i < 100; i++) {
+                uint64_t token = proto->start(FIELD_TYPE_MESSAGE | ComplexProto::kLogsFieldNumber);
+                EXPECT_TRUE(proto->write(FIELD_TYPE_INT32 | ComplexProto::Log::kIdFieldNumber, i));
+                EXPECT_TRUE(proto->write(FIELD_TYPE_STRING | ComplexProto::Log::kNameFieldNumber,
+                        std::string(size, 'a' + i % 26)));
+                proto->end(token);
+            }
+        }
+
+        std::string expected = iterateToString(&compacted);
+        EXPECT_EQ(flushToString(&flushed), expected);
+
+        ComplexProto complex;
+        ASSERT_TRUE(complex.ParseFromString(expected));
+        ASSERT_EQ(complex.logs_size(), 100);
+        EXPECT_EQ(complex.logs(99).name(), std::string(size, 'v'));
+    }
+}
+
+TEST(ProtoOutputStreamTest, TaggedWrites) {
+    // Tags of the fields, as precomputed by the generated writers.
+    static constexpr uint8_t TAG_INT64[] = { 0x10 };
+    static constexpr uint8_t TAG_FIXED32[] = { 0x3d };
+    static constexpr uint8_t TAG_FIXED64[] = { 0x41 };
+    static constexpr uint8_t TAG_STRING[] = { 0x52 };
+    static constexpr uint8_t TAG_ENUM[] = { 0x80, 0x01 };
+
+    ProtoOutputStream expected;
+    EXPECT_TRUE(expected.write(FIELD_TYPE_INT64 | PrimitiveProto::kValInt64FieldNumber, -1LL));
+    EXPECT_TRUE(expected.write(FIELD_TYPE_FIXED32 | PrimitiveProto::kValFixed32FieldNumber, 17));
+    EXPECT_TRUE(expected.write(FIELD_TYPE_FIXED64 | PrimitiveProto::kValFixed64FieldNumber,
+            -3LL));
+    EXPECT_TRUE(expected.write(FIELD_TYPE_STRING | PrimitiveProto::kValStringFieldNumber,
+            std::string("hello")));
+    EXPECT_TRUE(expected.write(FIELD_TYPE_ENUM | PrimitiveProto::kValEnumFieldNumber,
+            (int)PrimitiveProto_Count_TWO));
+
+    ProtoOutputStream proto;
+    EXPECT_TRUE(proto.writeTaggedVarint(TAG_INT64, UINT64_C(-1)));
+    EXPECT_TRUE(proto.writeTaggedFixed32(TAG_FIXED32, 17));
+    EXPECT_TRUE(proto.writeTaggedFixed64(TAG_FIXED64, UINT64_C(-3)));
+    EXPECT_TRUE(proto.writeTaggedBytes(TAG_STRING, "hello", 5));
+    EXPECT_TRUE(proto.writeTaggedVarint(TAG_ENUM, PrimitiveProto_Count_TWO));
+
+    std::string serialized = flushToString(&proto);
+    EXPECT_EQ(serialized, flushToString(&expected));
+    EXPECT_FALSE(proto.writeTaggedVarint(TAG_INT64, 1));
+
+    PrimitiveProto primitives;
+    ASSERT_TRUE(primitives.ParseFromString(serialized));
+    EXPECT_EQ(primitives.val_int64(), -1);
+    EXPECT_EQ(primitives.val_fixed32(), 17u);
+    EXPECT_EQ(primitives.val_fixed64(), UINT64_C(-3));
+    EXPECT_THAT(primitives.val_string(), StrEq("hello"));
+    EXPECT_EQ(primitives.val_enum(), PrimitiveProto_Count_TWO);
+}
+
 TEST(ProtoOutputStreamTest, InvalidTypes) {
     ProtoOutputStream proto;
     EXPECT_FALSE(proto.write(FIELD_TYPE_UNKNOWN | PrimitiveProto::kValInt32FieldNumber, 790));
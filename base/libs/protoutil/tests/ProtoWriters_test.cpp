@@ -0,0 +1,137 @@
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Tests of the Writer classes generated by protoc-gen-cppstream with the "writers" parameter.
+// The generated header declares the messages as namespaces, so it can't be included along with
+// test.pb.h: the writers are checked against ProtoOutputStream::write(), which the other tests
+// check against libprotobuf.
+//
+// The Writer classes are only generated when the genrule passes the "writers" parameter, e.g.
+// --cppstream_out=writers:$(genDir). Without it this file compiles to nothing.
+
+#include <android/util/ProtoOutputStream.h>
+#include <gtest/gtest.h>
+
+#include "frameworks/base/libs/protoutil/tests/test.proto.h"
+
+#ifdef ANDROID_FRAMEWORKS_BASE_LIBS_PROTOUTIL_TESTS_TEST_PROTO_STREAM_WRITERS
+
+using namespace android::util;
+
+static std::string serialize(ProtoOutputStream* proto) {
+    std::string content;
+    EXPECT_TRUE(proto->serializeToString(&content));
+    return content;
+}
+
+TEST(ProtoWritersTest, Primitives) {
+    const std::string s = "hello";
+    const char b[5] = { 'a', 'p', 'p', 'l', 'e' };
+
+    ProtoOutputStream expected;
+    EXPECT_TRUE(expected.write(PrimitiveProto::VAL_INT32, -123));
+    EXPECT_TRUE(expected.write(PrimitiveProto::VAL_INT64, -1LL));
+    EXPECT_TRUE(expected.write(PrimitiveProto::VAL_FLOAT, -23.5f));
+    EXPECT_TRUE(expected.write(PrimitiveProto::VAL_DOUBLE, 324.5));
+    EXPECT_TRUE(expected.write(PrimitiveProto::VAL_UINT32, 3424));
+    EXPECT_TRUE(expected.write(PrimitiveProto::VAL_UINT64, 57LL));
+    EXPECT_TRUE(expected.write(PrimitiveProto::VAL_FIXED32, -20));
+    EXPECT_TRUE(expected.write(PrimitiveProto::VAL_FIXED64, -37LL));
+    EXPECT_TRUE(expected.write(PrimitiveProto::VAL_BOOL, true));
+    EXPECT_TRUE(expected.write(PrimitiveProto::VAL_STRING, s));
+    EXPECT_TRUE(expected.write(PrimitiveProto::VAL_BYTES, b, 5));
+    EXPECT_TRUE(expected.write(PrimitiveProto::VAL_SFIXED32, 63));
+    EXPECT_TRUE(expected.write(PrimitiveProto::VAL_SFIXED64, -54));
+    EXPECT_TRUE(expected.write(PrimitiveProto::VAL_SINT32, -533));
+    EXPECT_TRUE(expected.write(PrimitiveProto::VAL_SINT64, -61224762453LL));
+    EXPECT_TRUE(expected.write(PrimitiveProto::VAL_ENUM, PrimitiveProto::TWO));
+
+    ProtoOutputStream proto;
+    PrimitiveProto::Writer writer(&proto);
+    EXPECT_TRUE(writer.set_val_int32(-123));
+    EXPECT_TRUE(writer.set_val_int64(-1));
+    EXPECT_TRUE(writer.set_val_float(-23.5f));
+    EXPECT_TRUE(writer.set_val_double(324.5));
+    EXPECT_TRUE(writer.set_val_uint32(3424));
+    EXPECT_TRUE(writer.set_val_uint64(57));
+    EXPECT_TRUE(writer.set_val_fixed32(-20));
+    EXPECT_TRUE(writer.set_val_fixed64(-37));
+    EXPECT_TRUE(writer.set_val_bool(true));
+    EXPECT_TRUE(writer.set_val_string(s));
+    EXPECT_TRUE(writer.set_val_bytes(b, 5));
+    EXPECT_TRUE(writer.set_val_sfixed32(63));
+    EXPECT_TRUE(writer.set_val_sfixed64(-54));
+    EXPECT_TRUE(writer.set_val_sint32(-533));
+    EXPECT_TRUE(writer.set_val_sint64(-61224762453LL));
+    EXPECT_TRUE(writer.set_val_enum(PrimitiveProto::TWO));
+
+    EXPECT_EQ(serialize(&expected), serialize(&proto));
+}
+
+TEST(ProtoWritersTest, EncodedBytes) {
+    ProtoOutputStream proto;
+    PrimitiveProto::Writer writer(&proto);
+    EXPECT_TRUE(writer.set_val_int32(150));
+    EXPECT_TRUE(writer.set_val_sint32(-1));
+    EXPECT_TRUE(writer.set_val_string("hi", 2));
+    EXPECT_TRUE(writer.set_val_enum(PrimitiveProto::TWO));
+
+    // Tags of field 1 varint, field 14 varint, field 10 string and field 16 varint, the last
+    // one on two bytes.
+    EXPECT_EQ(std::string("\x08\x96\x01" "\x70\x01" "\x52\x02hi" "\x80\x01\x02", 12),
+            serialize(&proto));
+}
+
+TEST(ProtoWritersTest, NestedMessages) {
+    ProtoOutputStream expected;
+    EXPECT_TRUE(expected.write(ComplexProto::INTS, 23));
+    uint64_t token = expected.start(ComplexProto::LOGS);
+    EXPECT_TRUE(expected.write(ComplexProto::Log::ID, 12));
+    EXPECT_TRUE(expected.write(ComplexProto::Log::NAME, std::string("cat")));
+    expected.end(token);
+    EXPECT_TRUE(expected.write(ComplexProto::INTS, 94));
+    token = expected.start(ComplexProto::LOGS);
+    EXPECT_TRUE(expected.write(ComplexProto::Log::DATA, "dog", 3));
+    expected.end(token);
+    // Empty messages are not written.
+    token = expected.start(ComplexProto::LOGS);
+    expected.end(token);
+
+    ProtoOutputStream proto;
+    ComplexProto::Writer writer(&proto);
+    EXPECT_TRUE(writer.add_ints(23));
+    ComplexProto::Log::Writer log = writer.start_logs();
+    EXPECT_TRUE(log.set_id(12));
+    EXPECT_TRUE(log.set_name("cat"));
+    log.end();
+    EXPECT_TRUE(writer.add_ints(94));
+    {
+        // The destructor ends the message.
+        ComplexProto::Log::Writer scoped = writer.start_logs();
+        EXPECT_TRUE(scoped.set_data("dog", 3));
+    }
+    writer.start_logs();
+
+    EXPECT_EQ(serialize(&expected), serialize(&proto));
+}
+
+TEST(ProtoWritersTest, RejectedAfterCompaction) {
+    ProtoOutputStream proto;
+    ComplexProto::Writer writer(&proto);
+    EXPECT_TRUE(writer.add_ints(1));
+    EXPECT_EQ(2u, proto.size());
+    EXPECT_FALSE(writer.add_ints(2));
+}
+
+#endif // ANDROID_FRAMEWORKS_BASE_LIBS_PROTOUTIL_TESTS_TEST_PROTO_STREAM_WRITERS
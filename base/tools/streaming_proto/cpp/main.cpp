@@ -2,8 +2,10 @@
 #include "stream_proto_utils.h"
 #include "string_utils.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <set>
 #include <sstream>
 
 using namespace android::stream_proto;
@@ -12,6 +14,10 @@ using namespace std;
 
 const bool GENERATE_MAPPING = true;
 
+// Plugin parameter asking for the typed Writer classes, e.g. --cppstream_out=writers:<dir>.
+// They need libprotoutil, so they are only generated on request.
+const string PARAMETER_WRITERS = "writers";
+
 static string
 make_filename(const FileDescriptorProto& file_descriptor)
 {
@@ -73,8 +79,297 @@ write_field(stringstream& text, const FieldDescriptorProto& field, const string&
     text << endl;
 }
 
+/**
+ * The C++ type the writer takes for a field, or "" if the field isn't supported.
+ */
+static string
+get_writer_type(const FieldDescriptorProto& field)
+{
+    switch (field.type()) {
+        case FieldDescriptorProto::TYPE_DOUBLE:
+            return "double";
+        case FieldDescriptorProto::TYPE_FLOAT:
+            return "float";
+        case FieldDescriptorProto::TYPE_INT64:
+        case FieldDescriptorProto::TYPE_SFIXED64:
+        case FieldDescriptorProto::TYPE_SINT64:
+            return "int64_t";
+        case FieldDescriptorProto::TYPE_UINT64:
+        case FieldDescriptorProto::TYPE_FIXED64:
+            return "uint64_t";
+        case FieldDescriptorProto::TYPE_INT32:
+        case FieldDescriptorProto::TYPE_SFIXED32:
+        case FieldDescriptorProto::TYPE_SINT32:
+            return "int32_t";
+        case FieldDescriptorProto::TYPE_UINT32:
+        case FieldDescriptorProto::TYPE_FIXED32:
+            return "uint32_t";
+        case FieldDescriptorProto::TYPE_BOOL:
+            return "bool";
+        case FieldDescriptorProto::TYPE_ENUM:
+            return "int";
+        default:
+            return "";
+    }
+}
+
+/**
+ * The wire type of a field, which is part of its tag.
+ */
+static int
+get_wire_type(const FieldDescriptorProto& field)
+{
+    switch (field.type()) {
+        case FieldDescriptorProto::TYPE_DOUBLE:
+        case FieldDescriptorProto::TYPE_FIXED64:
+        case FieldDescriptorProto::TYPE_SFIXED64:
+            return 1;
+        case FieldDescriptorProto::TYPE_FLOAT:
+        case FieldDescriptorProto::TYPE_FIXED32:
+        case FieldDescriptorProto::TYPE_SFIXED32:
+            return 5;
+        case FieldDescriptorProto::TYPE_STRING:
+        case FieldDescriptorProto::TYPE_BYTES:
+        case FieldDescriptorProto::TYPE_MESSAGE:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * The fully qualified C++ name of the Writer for a message type name like ".pkg.Outer.Inner".
+ */
+static string
+make_writer_class_name(const string& type_name)
+{
+    string result;
+    vector<string> parts = split(type_name, '.');
+    for (vector<string>::iterator it = parts.begin(); it != parts.end(); it++) {
+        result += "::" + *it;
+    }
+    return result + "::Writer";
+}
+
+/**
+ * Writes the typed setter of a scalar, string or bytes field.
+ */
+static void
+write_field_writer(stringstream& text, const FieldDescriptorProto& field, const string& indent)
+{
+    const string verb = field.label() == FieldDescriptorProto::LABEL_REPEATED ? "add_" : "set_";
+    const string method = verb + field.name();
+    const string tag = "k" + to_camel_case(field.name()) + "Tag";
+
+    // Precomputed tag of the field.
+    uint32_t tagValue = ((uint32_t)field.number() << 3) | get_wire_type(field);
+    text << indent << "static constexpr uint8_t " << tag << "[] = {";
+    ios::fmtflags fmt(text.flags());
+    do {
+        uint8_t b = tagValue & 0x7f;
+        tagValue >>= 7;
+        if (tagValue != 0) b |= 0x80;
+        text << " 0x" << setfill('0') << setw(2) << hex << (int)b << ",";
+    } while (tagValue != 0);
+    text.flags(fmt);
+    text << " };" << endl;
+
+    if (field.type() == FieldDescriptorProto::TYPE_STRING
+            || field.type() == FieldDescriptorProto::TYPE_BYTES) {
+        text << indent << "bool " << method << "(const char* value, size_t size) {" << endl;
+        text << indent << INDENT << "return mProto->writeTaggedBytes(" << tag
+                << ", value, size);" << endl;
+        text << indent << "}" << endl;
+        text << indent << "bool " << method << "(const std::string& value) {" << endl;
+        text << indent << INDENT << "return mProto->writeTaggedBytes(" << tag
+                << ", value.c_str(), value.size());" << endl;
+        text << indent << "}" << endl;
+        return;
+    }
+
+    // Same encodings as ProtoOutputStream::write, so both produce the same bytes.
+    string call;
+    switch (field.type()) {
+        case FieldDescriptorProto::TYPE_DOUBLE:
+            text << indent << "bool " << method << "(double value) {" << endl;
+            text << indent << INDENT << "uint64_t bits;" << endl;
+            text << indent << INDENT << "memcpy(&bits, &value, sizeof(bits));" << endl;
+            call = "writeTaggedFixed64(" + tag + ", bits)";
+            break;
+        case FieldDescriptorProto::TYPE_FLOAT:
+            text << indent << "bool " << method << "(float value) {" << endl;
+            text << indent << INDENT << "uint32_t bits;" << endl;
+            text << indent << INDENT << "memcpy(&bits, &value, sizeof(bits));" << endl;
+            call = "writeTaggedFixed32(" + tag + ", bits)";
+            break;
+        case FieldDescriptorProto::TYPE_FIXED64:
+        case FieldDescriptorProto::TYPE_SFIXED64:
+            call = "writeTaggedFixed64(" + tag + ", (uint64_t)value)";
+            break;
+        case FieldDescriptorProto::TYPE_FIXED32:
+        case FieldDescriptorProto::TYPE_SFIXED32:
+            call = "writeTaggedFixed32(" + tag + ", (uint32_t)value)";
+            break;
+        case FieldDescriptorProto::TYPE_INT64:
+        case FieldDescriptorProto::TYPE_UINT64:
+            call = "writeTaggedVarint(" + tag + ", (uint64_t)value)";
+            break;
+        case FieldDescriptorProto::TYPE_SINT64:
+            call = "writeTaggedVarint(" + tag + ", ((uint64_t)value << 1) ^ (value >> 63))";
+            break;
+        case FieldDescriptorProto::TYPE_SINT32:
+            call = "writeTaggedVarint(" + tag
+                    + ", (uint32_t)(((uint32_t)value << 1) ^ (value >> 31)))";
+            break;
+        case FieldDescriptorProto::TYPE_BOOL:
+            call = "writeTaggedVarint(" + tag + ", value ? 1 : 0)";
+            break;
+        default:
+            // int32, uint32 and enums are written as 32 bits varints.
+            call = "writeTaggedVarint(" + tag + ", (uint32_t)value)";
+            break;
+    }
+    if (field.type() != FieldDescriptorProto::TYPE_DOUBLE
+            && field.type() != FieldDescriptorProto::TYPE_FLOAT) {
+        text << indent << "bool " << method << "(" << get_writer_type(field) << " value) {"
+                << endl;
+    }
+    text << indent << INDENT << "return mProto->" << call << ";" << endl;
+    text << indent << "}" << endl;
+}
+
+/**
+ * Writes the typed Writer class of a message. The start_ methods of the message fields
+ * return the Writer of the nested message, they are declared here and defined by
+ * write_message_writer_definitions once every Writer is declared.
+ */
+static void
+write_message_writer(stringstream& text, const DescriptorProto& message,
+        const set<string>& writable_types, const string& indent)
+{
+    const string indented = indent + INDENT;
+    const int N = message.field_size();
+
+    text << indent << "/**" << endl;
+    text << indent << " * Typed writer for " << message.name()
+            << ", to write it to a ProtoOutputStream without" << endl;
+    text << indent << " * any field type dispatch at runtime." << endl;
+    text << indent << " */" << endl;
+    text << indent << "class Writer {" << endl;
+    text << indent << "public:" << endl;
+    text << indented << "explicit Writer(::android::util::ProtoOutputStream* proto)" << endl;
+    text << indented << INDENT << ": mProto(proto), mToken(0) {}" << endl;
+    text << indented << "Writer(::android::util::ProtoOutputStream* proto, uint64_t token)"
+            << endl;
+    text << indented << INDENT << ": mProto(proto), mToken(token) {}" << endl;
+    text << indented << "Writer(Writer&& that) : mProto(that.mProto), mToken(that.mToken) {"
+            << endl;
+    text << indented << INDENT << "that.mToken = 0;" << endl;
+    text << indented << "}" << endl;
+    text << indented << "Writer(const Writer&) = delete;" << endl;
+    text << indented << "Writer& operator=(const Writer&) = delete;" << endl;
+    text << indented << "~Writer() { end(); }" << endl;
+    text << endl;
+    text << indented << "// Ends the message if it was started by the writer of its parent."
+            << endl;
+    text << indented << "void end() {" << endl;
+    text << indented << INDENT << "if (mToken != 0) {" << endl;
+    text << indented << INDENT << INDENT << "mProto->end(mToken);" << endl;
+    text << indented << INDENT << INDENT << "mToken = 0;" << endl;
+    text << indented << INDENT << "}" << endl;
+    text << indented << "}" << endl;
+
+    for (int i=0; i<N; i++) {
+        const FieldDescriptorProto& field = message.field(i);
+        text << endl;
+        text << indented << "// " << get_proto_type(field) << ' ' << field.name() << " = "
+                << field.number() << ';' << endl;
+        if (field.type() == FieldDescriptorProto::TYPE_MESSAGE) {
+            if (writable_types.count(field.type_name()) == 0) {
+                // Messages from other files may not have writers, use start()/end().
+                text << indented << "// not generated, the type is declared in another file"
+                        << endl;
+                continue;
+            }
+            text << indented << "inline " << make_writer_class_name(field.type_name())
+                    << " start_" << field.name() << "();" << endl;
+        } else if (get_wire_type(field) == 2 || !get_writer_type(field).empty()) {
+            write_field_writer(text, field, indented);
+        } else {
+            text << indented << "// not generated, the type is not supported" << endl;
+        }
+    }
+
+    text << endl;
+    text << indent << "private:" << endl;
+    text << indented << "::android::util::ProtoOutputStream* mProto;" << endl;
+    text << indented << "uint64_t mToken;" << endl;
+    text << indent << "};" << endl;
+    text << endl;
+}
+
+/**
+ * Defines the start_ methods of the Writer of the message and its nested messages.
+ */
+static void
+write_message_writer_definitions(stringstream& text, const DescriptorProto& message,
+        const string& scope, const set<string>& writable_types)
+{
+    const string name = scope.empty() ? message.name() : scope + "::" + message.name();
+    const int N = message.field_size();
+    for (int i=0; i<N; i++) {
+        const FieldDescriptorProto& field = message.field(i);
+        if (field.type() != FieldDescriptorProto::TYPE_MESSAGE
+                || writable_types.count(field.type_name()) == 0) {
+            continue;
+        }
+        const string child = make_writer_class_name(field.type_name());
+        text << "inline " << child << endl;
+        text << name << "::Writer::start_" << field.name() << "()" << endl;
+        text << "{" << endl;
+        text << INDENT << "return " << child << "(mProto, mProto->start("
+                << name << "::" << make_constant_name(field.name()) << "));" << endl;
+        text << "}" << endl;
+        text << endl;
+    }
+
+    for (int i=0; i<message.nested_type_size(); i++) {
+        write_message_writer_definitions(text, message.nested_type(i), name, writable_types);
+    }
+}
+
+/**
+ * Forward declares the Writer of the message and its nested messages, so the start_ methods
+ * can return the Writer of messages declared later in the file.
+ */
+static void
+write_message_writer_declarations(stringstream& text, const DescriptorProto& message,
+        const string& indent)
+{
+    text << indent << "namespace " << message.name() << " {" << endl;
+    text << indent << INDENT << "class Writer;" << endl;
+    for (int i=0; i<message.nested_type_size(); i++) {
+        write_message_writer_declarations(text, message.nested_type(i), indent + INDENT);
+    }
+    text << indent << "} //" << message.name() << endl;
+}
+
+/**
+ * Collects the names, like ".pkg.Outer.Inner", of the messages declared in a file.
+ */
 static void
-write_message(stringstream& text, const DescriptorProto& message, const string& indent)
+collect_message_types(const DescriptorProto& message, const string& scope, set<string>* types)
+{
+    const string name = scope + "." + message.name();
+    types->insert(name);
+    for (int i=0; i<message.nested_type_size(); i++) {
+        collect_message_types(message.nested_type(i), name, types);
+    }
+}
+
+static void
+write_message(stringstream& text, const DescriptorProto& message, const set<string>* writable_types,
+        const string& indent)
 {
     int N;
     const string indented = indent + INDENT;
@@ -91,7 +386,7 @@ write_message(stringstream& text, const DescriptorProto& message, const string&
     // Nested classes
     N = message.nested_type_size();
     for (int i=0; i<N; i++) {
-        write_message(text, message.nested_type(i), indented);
+        write_message(text, message.nested_type(i), writable_types, indented);
     }
 
     // Fields
@@ -115,12 +410,17 @@ write_message(stringstream& text, const DescriptorProto& message, const string&
         text << indented << "};" << endl << endl;
     }
 
+    if (writable_types != NULL) {
+        write_message_writer(text, message, *writable_types, indented);
+    }
+
     text << indent << "} //" << message.name() << endl;
     text << endl;
 }
 
 static void
-write_header_file(CodeGeneratorResponse* response, const FileDescriptorProto& file_descriptor)
+write_header_file(CodeGeneratorResponse* response, const FileDescriptorProto& file_descriptor,
+        bool writers)
 {
     stringstream text;
 
@@ -128,12 +428,35 @@ write_header_file(CodeGeneratorResponse* response, const FileDescriptorProto& fi
     text << "// source: " << file_descriptor.name() << endl << endl;
 
     string header = "ANDROID_" + replace_string(file_descriptor.name(), '/', '_');
-    header = replace_string(header, '.', '_') + "_stream_h";
-    header = make_constant_name(header);
+    header = replace_string(header, '.', '_');
+    // Lets the sources that use the Writer classes compile out when the genrule doesn't ask for
+    // them.
+    const string writers_macro = make_constant_name(header + "_stream_writers");
+    header = make_constant_name(header + "_stream_h");
 
     text << "#ifndef " << header << endl;
     text << "#define " << header << endl;
     text << endl;
+    if (writers) {
+        text << "#define " << writers_macro << endl;
+        text << endl;
+    }
+
+    set<string> writable_types;
+    if (writers) {
+        text << "#include <android/util/ProtoOutputStream.h>" << endl;
+        text << endl;
+        text << "#include <stdint.h>" << endl;
+        text << "#include <string.h>" << endl;
+        text << "#include <string>" << endl;
+        text << endl;
+
+        const string scope = file_descriptor.package().empty()
+                ? "" : "." + file_descriptor.package();
+        for (int i=0; i<file_descriptor.message_type_size(); i++) {
+            collect_message_types(file_descriptor.message_type(i), scope, &writable_types);
+        }
+    }
 
     vector<string> namespaces = split(file_descriptor.package(), '.');
     for (vector<string>::iterator it = namespaces.begin(); it != namespaces.end(); it++) {
@@ -142,6 +465,14 @@ write_header_file(CodeGeneratorResponse* response, const FileDescriptorProto& fi
     text << endl;
 
     size_t N;
+    if (writers) {
+        N = file_descriptor.message_type_size();
+        for (size_t i=0; i<N; i++) {
+            write_message_writer_declarations(text, file_descriptor.message_type(i), "");
+        }
+        text << endl;
+    }
+
     N = file_descriptor.enum_type_size();
     for (size_t i=0; i<N; i++) {
         write_enum(text, file_descriptor.enum_type(i), "");
@@ -149,7 +480,15 @@ write_header_file(CodeGeneratorResponse* response, const FileDescriptorProto& fi
 
     N = file_descriptor.message_type_size();
     for (size_t i=0; i<N; i++) {
-        write_message(text, file_descriptor.message_type(i), "");
+        write_message(text, file_descriptor.message_type(i), writers ? &writable_types : NULL,
+                "");
+    }
+
+    if (writers) {
+        for (size_t i=0; i<N; i++) {
+            write_message_writer_definitions(text, file_descriptor.message_type(i), "",
+                    writable_types);
+        }
     }
 
     for (vector<string>::reverse_iterator it = namespaces.rbegin(); it != namespaces.rend(); it++) {
@@ -178,11 +517,14 @@ int main(int argc, char const *argv[])
     request.ParseFromIstream(&cin);
 
     // Build the files we need.
+    vector<string> parameters = split(request.parameter(), ',');
+    bool writers = find(parameters.begin(), parameters.end(), PARAMETER_WRITERS)
+            != parameters.end();
     const int N = request.proto_file_size();
     for (int i=0; i<N; i++) {
         const FileDescriptorProto& file_descriptor = request.proto_file(i);
         if (should_generate_for_file(request, file_descriptor.name())) {
-            write_header_file(&response, file_descriptor);
+            write_header_file(&response, file_descriptor, writers);
         }
     }
 
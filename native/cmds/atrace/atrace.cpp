@@ -20,6 +20,7 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdbool.h>
@@ -30,8 +31,13 @@
 #include <unistd.h>
 #include <zlib.h>
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include <binder/IBinder.h>
 #include <binder/IServiceManager.h>
@@ -296,10 +302,13 @@ static const char* g_categoriesFile = nullptr;
 static const char* g_kernelTraceFuncs = nullptr;
 static const char* g_debugAppCmdLine = "";
 static const char* g_outputFile = nullptr;
+static bool g_rawTrace = false;
 
 /* Global state */
 static bool g_tracePdx = false;
-static bool g_traceAborted = false;
+// Set by handleSignal() and polled by the raw trace reader threads; lock-free, so safe to
+// store from the signal handler.
+static std::atomic<bool> g_traceAborted = false;
 static bool g_categoryEnables[arraysize(k_categories)] = {};
 static std::string g_traceFolder;
 static std::vector<TracingVendorFileCategory> g_vendorFileCategories;
@@ -355,6 +364,14 @@ static const char* k_traceStreamPath =
 static const char* k_traceMarkerPath =
     "trace_marker";
 
+static const char* k_tracePerCpuRawPathFormat =
+    "per_cpu/cpu%u/trace_pipe_raw";
+
+/* Raw trace tuning */
+static const int k_rawTracePipePages = 64;
+static const int k_rawTracePollTimeoutMs = 100;
+static const size_t k_rawTraceDeflateBufferSize = 64 * 1024;
+
 // Check whether a file exists.
 static bool fileExists(const char* filename) {
     return access((g_traceFolder + filename).c_str(), F_OK) != -1;
@@ -938,9 +955,268 @@ static void stopTrace()
     setTracingEnabled(false);
 }
 
+// Header preceding every chunk of --raw output. The chunks of each CPU are
+// interleaved in the output; concatenating the chunks of one CPU gives the
+// content of its trace_pipe_raw (deflated if -z was given), i.e. a sequence
+// of ring buffer pages as described by events/header_page.
+struct RawTraceChunkHeader {
+    uint32_t cpu;
+    uint32_t size;
+};
+
+// Serializes the chunks read by the per-CPU threads into a single output.
+class RawTraceWriter {
+  public:
+    explicit RawTraceWriter(int outFd) : mOutFd(outFd), mCanSplice(true) {}
+
+    // Moves |size| bytes out of |pipeFd| into the output, without copying them
+    // through userspace if the output supports it.
+    bool spliceChunk(uint32_t cpu, int pipeFd, size_t size)
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (!writeHeaderLocked(cpu, size)) {
+            return false;
+        }
+        while (size > 0 && mCanSplice) {
+            ssize_t rc = TEMP_FAILURE_RETRY(splice(pipeFd, nullptr, mOutFd, nullptr, size,
+                                                   SPLICE_F_MOVE));
+            if (rc > 0) {
+                size -= rc;
+            } else if (rc == -1 && errno == EINVAL) {
+                // The output (e.g. a tty) doesn't support splice, copy instead.
+                mCanSplice = false;
+            } else {
+                fprintf(stderr, "error writing raw trace: %s (%d)\n", strerror(errno), errno);
+                return false;
+            }
+        }
+        char buf[4096];
+        while (size > 0) {
+            ssize_t rc = TEMP_FAILURE_RETRY(read(pipeFd, buf, std::min(size, sizeof(buf))));
+            if (rc <= 0 || !android::base::WriteFully(mOutFd, buf, rc)) {
+                fprintf(stderr, "error writing raw trace: %s (%d)\n", strerror(errno), errno);
+                return false;
+            }
+            size -= rc;
+        }
+        return true;
+    }
+
+    bool writeChunk(uint32_t cpu, const void* data, size_t size)
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (!writeHeaderLocked(cpu, size) || !android::base::WriteFully(mOutFd, data, size)) {
+            fprintf(stderr, "error writing raw trace: %s (%d)\n", strerror(errno), errno);
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    bool writeHeaderLocked(uint32_t cpu, size_t size)
+    {
+        RawTraceChunkHeader header = { cpu, static_cast<uint32_t>(size) };
+        return android::base::WriteFully(mOutFd, &header, sizeof(header));
+    }
+
+    int mOutFd;
+    bool mCanSplice;
+    std::mutex mLock;
+};
+
+// Waits for more data in a per-CPU raw buffer. Returns false once the caller
+// should stop reading: always when dumping, when the trace is aborted when
+// streaming.
+static bool waitForRawTraceData(int fd, bool stream)
+{
+    while (stream && !g_traceAborted) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int rc = poll(&pfd, 1, k_rawTracePollTimeoutMs);
+        if (rc > 0) {
+            return true;
+        }
+        if (rc == -1 && errno != EINTR) {
+            return false;
+        }
+    }
+    return false;
+}
+
+// Copies the pages of a per-CPU raw buffer with read(). Unlike splice, read
+// also returns the page the kernel is still writing to, so this is used to
+// flush the last partial page of each CPU.
+static bool readRawTrace(uint32_t cpu, int traceFd, RawTraceWriter* writer, bool stream)
+{
+    std::vector<uint8_t> page(sysconf(_SC_PAGESIZE));
+    for (;;) {
+        ssize_t rc = TEMP_FAILURE_RETRY(read(traceFd, page.data(), page.size()));
+        if (rc > 0) {
+            if (!writer->writeChunk(cpu, page.data(), rc)) {
+                return false;
+            }
+        } else if (rc == 0 || errno == EAGAIN) {
+            if (!waitForRawTraceData(traceFd, stream)) {
+                return true;
+            }
+        } else {
+            fprintf(stderr, "error reading raw trace of cpu%u: %s (%d)\n", cpu,
+                    strerror(errno), errno);
+            return false;
+        }
+    }
+}
+
+// Moves the full pages of a per-CPU raw buffer to the output through a pipe,
+// then flushes the remaining partial page.
+static bool spliceRawTrace(uint32_t cpu, int traceFd, RawTraceWriter* writer, bool stream)
+{
+    int pipeFds[2];
+    if (pipe2(pipeFds, O_CLOEXEC) == -1) {
+        fprintf(stderr, "error creating pipe: %s (%d)\n", strerror(errno), errno);
+        return false;
+    }
+    // A larger pipe moves more pages per splice call. This is best effort, the
+    // default size holds 16 pages.
+    fcntl(pipeFds[1], F_SETPIPE_SZ, k_rawTracePipePages * sysconf(_SC_PAGESIZE));
+    int pipeSize = fcntl(pipeFds[1], F_GETPIPE_SZ);
+    if (pipeSize <= 0) {
+        pipeSize = sysconf(_SC_PAGESIZE);
+    }
+
+    bool ok = true;
+    while (ok) {
+        ssize_t rc = TEMP_FAILURE_RETRY(splice(traceFd, nullptr, pipeFds[1], nullptr, pipeSize,
+                                               SPLICE_F_MOVE | SPLICE_F_NONBLOCK));
+        if (rc > 0) {
+            ok = writer->spliceChunk(cpu, pipeFds[0], rc);
+        } else if (rc == 0 || errno == EAGAIN) {
+            if (!waitForRawTraceData(traceFd, stream)) {
+                break;
+            }
+        } else {
+            fprintf(stderr, "error splicing raw trace of cpu%u: %s (%d)\n", cpu,
+                    strerror(errno), errno);
+            ok = false;
+        }
+    }
+    close(pipeFds[0]);
+    close(pipeFds[1]);
+
+    return ok && readRawTrace(cpu, traceFd, writer, false);
+}
+
+// Deflates the pages of a per-CPU raw buffer into an independent zlib stream.
+static bool deflateRawTrace(uint32_t cpu, int traceFd, RawTraceWriter* writer, bool stream)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    int result = deflateInit(&zs, Z_DEFAULT_COMPRESSION);
+    if (result != Z_OK) {
+        fprintf(stderr, "error initializing zlib: %d\n", result);
+        return false;
+    }
+
+    std::vector<uint8_t> in(sysconf(_SC_PAGESIZE));
+    std::vector<uint8_t> out(k_rawTraceDeflateBufferSize);
+    bool ok = true;
+    int flush = Z_NO_FLUSH;
+    while (ok && flush != Z_FINISH) {
+        ssize_t rc = TEMP_FAILURE_RETRY(read(traceFd, in.data(), in.size()));
+        if (rc > 0) {
+            zs.next_in = in.data();
+            zs.avail_in = rc;
+        } else if (rc == 0 || errno == EAGAIN) {
+            if (waitForRawTraceData(traceFd, stream)) {
+                continue;
+            }
+            // When streaming, the pages read after the abort are flushed too.
+            if (stream) {
+                stream = false;
+                continue;
+            }
+            flush = Z_FINISH;
+        } else {
+            fprintf(stderr, "error reading raw trace of cpu%u: %s (%d)\n", cpu,
+                    strerror(errno), errno);
+            flush = Z_FINISH;
+        }
+
+        do {
+            zs.next_out = out.data();
+            zs.avail_out = out.size();
+            result = deflate(&zs, flush);
+            size_t bytes = out.size() - zs.avail_out;
+            if (bytes > 0) {
+                ok = writer->writeChunk(cpu, out.data(), bytes);
+            }
+        } while (ok && zs.avail_out == 0);
+    }
+
+    if (ok && result != Z_STREAM_END) {
+        fprintf(stderr, "error deflating raw trace of cpu%u: %s\n", cpu, zs.msg);
+        ok = false;
+    }
+    deflateEnd(&zs);
+    return ok;
+}
+
+static bool traceCpuRaw(uint32_t cpu, RawTraceWriter* writer, bool stream)
+{
+    std::string path = g_traceFolder +
+            android::base::StringPrintf(k_tracePerCpuRawPathFormat, cpu);
+    int traceFd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (traceFd == -1) {
+        fprintf(stderr, "error opening %s: %s (%d)\n", path.c_str(), strerror(errno), errno);
+        return false;
+    }
+
+    bool ok;
+    if (g_compress) {
+        ok = deflateRawTrace(cpu, traceFd, writer, stream);
+    } else {
+        ok = spliceRawTrace(cpu, traceFd, writer, stream);
+        if (ok && stream) {
+            // Collect what was written between the abort and the end of tracing.
+            ok = spliceRawTrace(cpu, traceFd, writer, false);
+        }
+    }
+    close(traceFd);
+    return ok;
+}
+
+// Read the binary per-CPU buffers in parallel and write them to |outFd|. When
+// |stream| is true, keep reading until the trace is aborted; otherwise stop
+// once the buffers are empty.
+static void traceRaw(int outFd, bool stream)
+{
+    RawTraceWriter writer(outFd);
+    std::vector<std::thread> threads;
+    long cpuCount = sysconf(_SC_NPROCESSORS_CONF);
+    for (uint32_t cpu = 0; cpu < cpuCount; cpu++) {
+        std::string path = android::base::StringPrintf(k_tracePerCpuRawPathFormat, cpu);
+        if (!fileExists(path.c_str())) {
+            continue;
+        }
+        threads.emplace_back([cpu, &writer, stream]() {
+            traceCpuRaw(cpu, &writer, stream);
+        });
+    }
+    if (threads.empty()) {
+        fprintf(stderr, "error: no per-cpu raw trace buffers in %s\n", g_traceFolder.c_str());
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
 // Read data from the tracing pipe and forward to stdout
 static void streamTrace()
 {
+    if (g_rawTrace) {
+        traceRaw(STDOUT_FILENO, true);
+        return;
+    }
+
     char trace_data[4096];
     int traceFD = open((g_traceFolder + k_traceStreamPath).c_str(), O_RDWR);
     if (traceFD == -1) {
@@ -967,6 +1243,11 @@ static void streamTrace()
 static void dumpTrace(int outFd)
 {
     ALOGI("Dumping trace");
+    if (g_rawTrace) {
+        traceRaw(outFd, false);
+        return;
+    }
+
     int traceFD = open((g_traceFolder + k_tracePath).c_str(), O_RDWR);
     if (traceFD == -1) {
         fprintf(stderr, "error opening %s: %s (%d)\n", k_tracePath,
@@ -1126,6 +1407,13 @@ static void showHelp(const char *cmd)
                     "                    Note: this can take significant CPU time, and is best\n"
                     "                    used for measuring things that are not affected by\n"
                     "                    CPU performance, like pagecache usage.\n"
+                    "  --raw           dump or stream the binary per-cpu ring buffer pages\n"
+                    "                    instead of the formatted text trace. The pages are\n"
+                    "                    moved with splice(), one thread per CPU, which is\n"
+                    "                    much cheaper for high event rates. Each chunk of\n"
+                    "                    output is preceded by its cpu and size as two\n"
+                    "                    native-endian uint32; with -z, the chunks of each\n"
+                    "                    cpu form a separate zlib stream.\n"
                     "  --list_categories\n"
                     "                  list the available tracing categories\n"
                     " -o filename      write the trace to the specified file instead\n"
@@ -1296,6 +1584,7 @@ int main(int argc, char **argv)
             {"only_userspace",    no_argument, nullptr,  0 },
             {"list_categories",   no_argument, nullptr,  0 },
             {"stream",            no_argument, nullptr,  0 },
+            {"raw",               no_argument, nullptr,  0 },
             {nullptr,                       0, nullptr,  0 }
         };
 
@@ -1368,6 +1657,8 @@ int main(int argc, char **argv)
                 } else if (!strcmp(long_options[option_index].name, "stream")) {
                     traceStream = true;
                     traceDump = false;
+                } else if (!strcmp(long_options[option_index].name, "raw")) {
+                    g_rawTrace = true;
                 } else if (!strcmp(long_options[option_index].name, "list_categories")) {
                     listSupportedCategories();
                     exit(0);
@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "dumpstate"
+
+#include "DumpScheduler.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <android-base/unique_fd.h>
+#include <log/log.h>
+
+#include "DumpPool.h"
+#include "dumpstate.h"
+#include "DumpstateInternal.h"
+#include "DumpstateUtil.h"
+
+namespace android {
+namespace os {
+namespace dumpstate {
+
+namespace {
+
+using std::chrono::milliseconds;
+
+long long ToMillis(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration_cast<milliseconds>(duration).count();
+}
+
+}  // namespace
+
+const char* ResourceClassToString(ResourceClass resource) {
+    switch (resource) {
+        case ResourceClass::CPU:
+            return "CPU";
+        case ResourceClass::BINDER:
+            return "BINDER";
+        case ResourceClass::DISK:
+            return "DISK";
+        case ResourceClass::LOGD:
+            return "LOGD";
+    }
+    return "UNKNOWN";
+}
+
+DumpScheduler::DumpScheduler(const std::string& tmp_root)
+    : tmp_root_(tmp_root), finished_count_(0), started_(false), shutdown_(false) {
+    assert(!tmp_root.empty());
+    limits_.fill(std::numeric_limits<int>::max());
+    running_.fill(0);
+}
+
+DumpScheduler::~DumpScheduler() {
+    std::unique_lock lock(lock_);
+    shutdown_ = true;
+    condition_variable_.notify_all();
+    lock.unlock();
+
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+    threads_.clear();
+
+    // Fulfills the promises of the sections which never ran, so that the futures can still be
+    // destroyed (or waited on) safely; an empty path means there is nothing to dump.
+    for (auto& section : sections_) {
+        if (!section.started) {
+            section.promise.set_value("");
+        }
+    }
+}
+
+std::future<std::string> DumpScheduler::addSection(const std::string& name,
+                                                   ResourceClass resource,
+                                                   milliseconds estimated_duration,
+                                                   const std::vector<std::string>& dependencies,
+                                                   DumpFunction dump_func) {
+    std::unique_lock lock(lock_);
+    if (started_) {
+        MYLOGE("Cannot add section %s after the scheduler started\n", name.c_str());
+        return {};
+    }
+    if (section_indices_.count(name) != 0) {
+        MYLOGE("Duplicated dump section %s\n", name.c_str());
+        return {};
+    }
+    std::vector<size_t> dependency_indices;
+    for (const auto& dependency : dependencies) {
+        auto it = section_indices_.find(dependency);
+        if (it == section_indices_.end()) {
+            MYLOGE("Dump section %s depends on undeclared section %s\n", name.c_str(),
+                   dependency.c_str());
+            return {};
+        }
+        dependency_indices.push_back(it->second);
+    }
+
+    size_t index = sections_.size();
+    Section& section = sections_.emplace_back();
+    section.name = name;
+    section.resource = resource;
+    section.estimated_duration = estimated_duration;
+    section.dump_func = std::move(dump_func);
+    section.dependency_count = dependency_indices.size();
+    section.pending_dependencies = dependency_indices.size();
+    for (size_t dependency : dependency_indices) {
+        sections_[dependency].dependents.push_back(index);
+    }
+    section_indices_[name] = index;
+    return section.promise.get_future();
+}
+
+void DumpScheduler::setConcurrencyLimit(ResourceClass resource, int limit) {
+    assert(limit > 0);
+    std::unique_lock lock(lock_);
+    limits_[static_cast<size_t>(resource)] = limit;
+}
+
+void DumpScheduler::start(int thread_counts) {
+    assert(thread_counts > 0);
+    std::unique_lock lock(lock_);
+    assert(!started_);
+    if (thread_counts > MAX_THREAD_COUNT) {
+        thread_counts = MAX_THREAD_COUNT;
+    }
+    computeCriticalPaths();
+    MYLOGI("Start dump scheduler:%d threads, %zu sections\n", thread_counts, sections_.size());
+    started_ = true;
+    start_time_ = std::chrono::steady_clock::now();
+    for (auto& section : sections_) {
+        section.ready_time = start_time_;
+    }
+    for (int i = 0; i < thread_counts; i++) {
+        threads_.emplace_back(std::thread([=]() {
+            std::array<char, 15> thread_name;
+            snprintf(thread_name.data(), thread_name.size(), "dumpstate_s%d", i + 1);
+            pthread_setname_np(pthread_self(), thread_name.data());
+            loop();
+        }));
+    }
+}
+
+void DumpScheduler::computeCriticalPaths() {
+    // Dependents are always declared after their dependencies, so walking the sections backwards
+    // visits every dependent before the sections it depends on.
+    for (size_t i = sections_.size(); i-- > 0;) {
+        Section& section = sections_[i];
+        milliseconds longest_dependent{0};
+        for (size_t dependent : section.dependents) {
+            longest_dependent = std::max(longest_dependent, sections_[dependent].critical_path);
+        }
+        section.critical_path = section.estimated_duration + longest_dependent;
+    }
+}
+
+int DumpScheduler::pickReadySectionLocked() const {
+    int picked = -1;
+    for (size_t i = 0; i < sections_.size(); i++) {
+        const Section& section = sections_[i];
+        if (section.started || section.pending_dependencies > 0) {
+            continue;
+        }
+        size_t resource = static_cast<size_t>(section.resource);
+        if (running_[resource] >= limits_[resource]) {
+            continue;
+        }
+        // Ties are broken by declaration order.
+        if (picked == -1 || section.critical_path > sections_[picked].critical_path) {
+            picked = i;
+        }
+    }
+    return picked;
+}
+
+void DumpScheduler::runSection(Section& section) {
+    std::string file_name_format = "%s/" + DumpPool::PREFIX_TMPFILE_NAME + "XXXXXX";
+    char path[1024];
+    snprintf(path, sizeof(path), file_name_format.c_str(), tmp_root_.c_str());
+    android::base::unique_fd fd(TEMP_FAILURE_RETRY(mkostemp(path, O_CLOEXEC)));
+    if (fd.get() == -1) {
+        MYLOGE("open(%s, %s)\n", path, strerror(errno));
+        section.promise.set_value("");
+        return;
+    }
+    {
+        DurationReporter duration_reporter(section.name, /*logcat_only =*/false,
+                                           /*verbose =*/false, fd.get());
+        std::invoke(section.dump_func, fd.get());
+    }
+    fsync(fd.get());
+    section.promise.set_value(path);
+}
+
+void DumpScheduler::loop() {
+    std::unique_lock lock(lock_);
+    while (!shutdown_ && finished_count_ < sections_.size()) {
+        int index = pickReadySectionLocked();
+        if (index == -1) {
+            condition_variable_.wait(lock);
+            continue;
+        }
+        Section& section = sections_[index];
+        size_t resource = static_cast<size_t>(section.resource);
+        section.started = true;
+        section.start_time = std::chrono::steady_clock::now();
+        running_[resource]++;
+        lock.unlock();
+
+        runSection(section);
+
+        lock.lock();
+        section.end_time = std::chrono::steady_clock::now();
+        section.finished = true;
+        running_[resource]--;
+        finished_count_++;
+        for (size_t dependent : section.dependents) {
+            Section& next = sections_[dependent];
+            if (--next.pending_dependencies == 0) {
+                next.ready_time = section.end_time;
+            }
+        }
+        condition_variable_.notify_all();
+    }
+}
+
+void DumpScheduler::dumpSchedule(int fd, int thread_counts) const {
+    if (thread_counts > MAX_THREAD_COUNT) {
+        thread_counts = MAX_THREAD_COUNT;
+    }
+    // Works on a copy, so the schedule can be planned before (or without) starting the threads.
+    DumpScheduler plan(tmp_root_);
+    for (const auto& section : sections_) {
+        Section& copy = plan.sections_.emplace_back();
+        copy.name = section.name;
+        copy.resource = section.resource;
+        copy.estimated_duration = section.estimated_duration;
+        copy.dependents = section.dependents;
+        copy.dependency_count = section.dependency_count;
+        copy.pending_dependencies = section.dependency_count;
+    }
+    plan.limits_ = limits_;
+    plan.computeCriticalPaths();
+
+    // Simulates the workers with the estimated durations.
+    std::vector<std::pair<milliseconds, size_t>> running;  // (end time, section index)
+    std::vector<std::pair<milliseconds, milliseconds>> times(plan.sections_.size());
+    std::vector<size_t> start_order;
+    milliseconds now{0};
+    while (start_order.size() < plan.sections_.size()) {
+        int index;
+        while (static_cast<int>(running.size()) < thread_counts &&
+               (index = plan.pickReadySectionLocked()) != -1) {
+            Section& section = plan.sections_[index];
+            section.started = true;
+            plan.running_[static_cast<size_t>(section.resource)]++;
+            times[index] = {now, now + section.estimated_duration};
+            running.emplace_back(now + section.estimated_duration, index);
+            start_order.push_back(index);
+        }
+        if (running.empty()) {
+            break;
+        }
+        auto next = std::min_element(running.begin(), running.end());
+        now = next->first;
+        Section& done = plan.sections_[next->second];
+        plan.running_[static_cast<size_t>(done.resource)]--;
+        for (size_t dependent : done.dependents) {
+            plan.sections_[dependent].pending_dependencies--;
+        }
+        running.erase(next);
+    }
+
+    dprintf(fd, "Dump schedule: %zu sections, %d threads\n", sections_.size(), thread_counts);
+    dprintf(fd, "Concurrency limits:");
+    for (size_t i = 0; i < kResourceClassCount; i++) {
+        if (limits_[i] != std::numeric_limits<int>::max()) {
+            dprintf(fd, " %s=%d", ResourceClassToString(static_cast<ResourceClass>(i)),
+                    limits_[i]);
+        }
+    }
+    dprintf(fd, "\n");
+    for (size_t order = 0; order < start_order.size(); order++) {
+        size_t index = start_order[order];
+        const Section& section = plan.sections_[index];
+        dprintf(fd, "  #%zu +%lldms..+%lldms '%s' (%s, estimated %lldms, critical path %lldms)",
+                order + 1, static_cast<long long>(times[index].first.count()),
+                static_cast<long long>(times[index].second.count()), section.name.c_str(),
+                ResourceClassToString(section.resource),
+                static_cast<long long>(section.estimated_duration.count()),
+                static_cast<long long>(section.critical_path.count()));
+        bool first = true;
+        for (size_t i = 0; i < index; i++) {
+            const auto& dependents = plan.sections_[i].dependents;
+            if (std::find(dependents.begin(), dependents.end(), index) == dependents.end()) {
+                continue;
+            }
+            dprintf(fd, "%s'%s'", first ? " after " : ", ", plan.sections_[i].name.c_str());
+            first = false;
+        }
+        dprintf(fd, "\n");
+    }
+    if (start_order.size() < plan.sections_.size()) {
+        dprintf(fd, "  *** %zu sections can never start\n",
+                plan.sections_.size() - start_order.size());
+    }
+
+    // Follows the longest chain from the section with the longest critical path.
+    int current = -1;
+    for (size_t i = 0; i < plan.sections_.size(); i++) {
+        if (plan.sections_[i].dependency_count == 0 &&
+            (current == -1 ||
+             plan.sections_[i].critical_path > plan.sections_[current].critical_path)) {
+            current = i;
+        }
+    }
+    if (current == -1) {
+        return;
+    }
+    dprintf(fd, "Critical path (%lldms):",
+            static_cast<long long>(plan.sections_[current].critical_path.count()));
+    while (current != -1) {
+        const Section& section = plan.sections_[current];
+        dprintf(fd, " '%s'", section.name.c_str());
+        current = -1;
+        for (size_t dependent : section.dependents) {
+            if (current == -1 ||
+                plan.sections_[dependent].critical_path > plan.sections_[current].critical_path) {
+                current = dependent;
+            }
+        }
+    }
+    dprintf(fd, "\n");
+}
+
+void DumpScheduler::dumpTimings(int fd) {
+    std::unique_lock lock(lock_);
+    dprintf(fd, "Dump section timings (queued, running):\n");
+    for (const auto& section : sections_) {
+        if (!section.finished) {
+            dprintf(fd, "  '%s' (%s): %s\n", section.name.c_str(),
+                    ResourceClassToString(section.resource),
+                    section.started ? "running" : "not started");
+            continue;
+        }
+        dprintf(fd, "  '%s' (%s): +%lldms, queued %lldms, ran %lldms (estimated %lldms)\n",
+                section.name.c_str(), ResourceClassToString(section.resource),
+                ToMillis(section.start_time - start_time_),
+                ToMillis(section.start_time - section.ready_time),
+                ToMillis(section.end_time - section.start_time),
+                static_cast<long long>(section.estimated_duration.count()));
+    }
+}
+
+}  // namespace dumpstate
+}  // namespace os
+}  // namespace android
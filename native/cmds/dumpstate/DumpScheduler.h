@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FRAMEWORK_NATIVE_CMD_DUMPSCHEDULER_H_
+#define FRAMEWORK_NATIVE_CMD_DUMPSCHEDULER_H_
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/macros.h>
+
+namespace android {
+namespace os {
+namespace dumpstate {
+
+/*
+ * The resource a dump section mostly waits on. The scheduler limits how many
+ * sections of the same class run at the same time, e.g. to avoid flooding
+ * system_server with binder dump calls or logd with concurrent readers.
+ */
+enum class ResourceClass {
+    CPU = 0,
+    BINDER,
+    DISK,
+    LOGD,
+};
+
+const char* ResourceClassToString(ResourceClass resource);
+
+/*
+ * Runs dump sections on a pool of threads, honoring the dependencies between
+ * them and a concurrency limit per ResourceClass. Among the sections that are
+ * ready to run, the one with the longest estimated path to the end of the
+ * graph (the critical path) is started first.
+ *
+ * Like the DumpPool, each section writes its results into a temporary file
+ * through the fd it is given; the caller dumps them in a deterministic order
+ * with WaitForTask() on the future returned by addSection(). For example:
+ *
+ * DumpScheduler scheduler(tmp_root);
+ * auto hals = scheduler.addSection("DUMP HALS", ResourceClass::BINDER, 2000ms, {}, &DumpHals);
+ * auto board = scheduler.addSection("DUMP BOARD", ResourceClass::BINDER, 5000ms, {"DUMP HALS"},
+ *                                   &DumpBoard);
+ * scheduler.start();
+ * ...
+ * WaitForTask(std::move(hals));
+ * WaitForTask(std::move(board));
+ *
+ * Dependencies must be added before the sections depending on them, which
+ * keeps the graph acyclic by construction.
+ *
+ * As with the DumpPool, the returned futures must all have their `get`
+ * methods called, or have been destroyed before the DumpScheduler itself is
+ * destroyed.
+ */
+class DumpScheduler {
+  public:
+    using DumpFunction = std::function<void(int)>;
+
+    /*
+     * |tmp_root| A path to a temporary folder for threads to create temporary
+     * files.
+     */
+    explicit DumpScheduler(const std::string& tmp_root);
+
+    /*
+     * Cancels the sections which have not started yet and waits until the
+     * running ones are finished.
+     */
+    ~DumpScheduler();
+
+    /*
+     * Declares a dump section. Returns an invalid future if the name is
+     * already used, a dependency has not been declared, or the scheduler has
+     * already been started.
+     *
+     * |name| The name of the section. It's also the title of the
+     * DurationReporter log.
+     * |resource| The resource class the section is limited by.
+     * |estimated_duration| The expected duration, used to compute the critical
+     * path.
+     * |dependencies| Names of the sections that must finish first.
+     * |dump_func| Callable function taking the fd to write the results to.
+     */
+    std::future<std::string> addSection(const std::string& name, ResourceClass resource,
+                                        std::chrono::milliseconds estimated_duration,
+                                        const std::vector<std::string>& dependencies,
+                                        DumpFunction dump_func);
+
+    /*
+     * Sets the maximum number of sections of |resource| class running at the
+     * same time. Must be called before start().
+     */
+    void setConcurrencyLimit(ResourceClass resource, int limit);
+
+    /*
+     * Computes the section priorities and starts the threads.
+     *
+     * |thread_counts| the number of threads to start.
+     */
+    void start(int thread_counts = MAX_THREAD_COUNT);
+
+    /*
+     * Writes the planned schedule to |fd| without running any section: the
+     * order the sections would start in, their estimated start and end times
+     * under the concurrency limits, and the critical path.
+     */
+    void dumpSchedule(int fd, int thread_counts = MAX_THREAD_COUNT) const;
+
+    /*
+     * Writes the measured queueing and running time of every section to |fd|.
+     */
+    void dumpTimings(int fd);
+
+  private:
+    struct Section {
+        std::string name;
+        ResourceClass resource;
+        std::chrono::milliseconds estimated_duration;
+        std::vector<size_t> dependents;
+        size_t dependency_count = 0;
+        DumpFunction dump_func;
+        std::promise<std::string> promise;
+
+        // Longest estimated path from the start of this section to the end of the graph.
+        std::chrono::milliseconds critical_path{0};
+
+        // Guarded by lock_.
+        size_t pending_dependencies = 0;
+        bool started = false;
+        bool finished = false;
+        std::chrono::steady_clock::time_point ready_time;
+        std::chrono::steady_clock::time_point start_time;
+        std::chrono::steady_clock::time_point end_time;
+    };
+
+    static constexpr size_t kResourceClassCount = 4;
+
+    void computeCriticalPaths();
+    // Returns the index of the next section to run, or -1 if none can start now.
+    int pickReadySectionLocked() const;
+    void runSection(Section& section);
+    void loop();
+
+  private:
+    static const int MAX_THREAD_COUNT = 4;
+
+    std::string tmp_root_;
+    std::vector<Section> sections_;
+    std::map<std::string, size_t> section_indices_;
+    std::array<int, kResourceClassCount> limits_;
+    std::array<int, kResourceClassCount> running_;
+    size_t finished_count_;
+    bool started_;
+    bool shutdown_;
+    std::chrono::steady_clock::time_point start_time_;
+
+    std::mutex lock_;
+    std::condition_variable condition_variable_;
+    std::vector<std::thread> threads_;
+
+    DISALLOW_COPY_AND_ASSIGN(DumpScheduler);
+};
+
+}  // namespace dumpstate
+}  // namespace os
+}  // namespace android
+
+#endif //FRAMEWORK_NATIVE_CMD_DUMPSCHEDULER_H_
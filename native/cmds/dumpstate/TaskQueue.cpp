@@ -16,6 +16,8 @@
 
 #include "TaskQueue.h"
 
+#include <pthread.h>
+
 namespace android {
 namespace os {
 namespace dumpstate {
@@ -24,7 +26,20 @@ TaskQueue::~TaskQueue() {
     run(/* do_cancel = */true);
 }
 
+void TaskQueue::startWorker() {
+    std::unique_lock lock(lock_);
+    if (worker_.joinable()) {
+        return;
+    }
+    shutdown_ = false;
+    worker_ = std::thread([this]() {
+        pthread_setname_np(pthread_self(), "dumpstate_zip");
+        loop();
+    });
+}
+
 void TaskQueue::run(bool do_cancel) {
+    stopWorker();
     std::unique_lock lock(lock_);
     while (!tasks_.empty()) {
         auto task = tasks_.front();
@@ -35,6 +50,32 @@ void TaskQueue::run(bool do_cancel) {
     }
 }
 
+void TaskQueue::stopWorker() {
+    std::unique_lock lock(lock_);
+    if (!worker_.joinable()) {
+        return;
+    }
+    shutdown_ = true;
+    condition_variable_.notify_all();
+    lock.unlock();
+    worker_.join();
+}
+
+void TaskQueue::loop() {
+    std::unique_lock lock(lock_);
+    while (!shutdown_) {
+        if (tasks_.empty()) {
+            condition_variable_.wait(lock);
+            continue;
+        }
+        auto task = std::move(tasks_.front());
+        tasks_.pop();
+        lock.unlock();
+        std::invoke(task, /* do_cancel = */false);
+        lock.lock();
+    }
+}
+
 }  // namespace dumpstate
 }  // namespace os
 }  // namespace android
@@ -17,8 +17,10 @@
 #ifndef FRAMEWORK_NATIVE_CMD_TASKQUEUE_H_
 #define FRAMEWORK_NATIVE_CMD_TASKQUEUE_H_
 
+#include <condition_variable>
 #include <mutex>
 #include <queue>
+#include <thread>
 
 #include <android-base/macros.h>
 
@@ -31,6 +33,11 @@ namespace dumpstate {
  * which are needed to run in a single thread. The task is a callable function
  * included a cancel task boolean parameter. The TaskQueue could
  * cancel the task in the destructor if the task has never been called.
+ *
+ * By default the tasks are only invoked by run(). After startWorker() is
+ * called, a background thread invokes the tasks in insertion order as soon as
+ * they are added, so that expensive work such as compressing zip entries
+ * overlaps with the rest of the dump instead of running at the end of it.
  */
 class TaskQueue {
   public:
@@ -51,10 +58,19 @@ class TaskQueue {
         tasks_.emplace([=](bool cancelled) {
             std::invoke(func, cancelled);
         });
+        condition_variable_.notify_one();
     }
 
     /*
-     * Invokes all tasks in the task queue.
+     * Starts a single background thread which invokes the tasks as they are
+     * added. Tasks still run one at a time and in the order they were added.
+     * Does nothing if the worker has already been started.
+     */
+    void startWorker();
+
+    /*
+     * Invokes all tasks in the task queue. If the background worker has been
+     * started, waits for the task it is currently running and stops it first.
      *
      * |do_cancel| true to cancel all tasks in the queue.
      */
@@ -63,8 +79,14 @@ class TaskQueue {
   private:
     using Task = std::function<void(bool)>;
 
+    void loop();
+    void stopWorker();
+
     std::mutex lock_;
+    std::condition_variable condition_variable_;
     std::queue<Task> tasks_;
+    std::thread worker_;
+    bool shutdown_ = false;
 
     DISALLOW_COPY_AND_ASSIGN(TaskQueue);
 };
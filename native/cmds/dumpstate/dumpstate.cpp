@@ -20,6 +20,7 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <getopt.h>
 #include <inttypes.h>
 #include <libgen.h>
 #include <limits.h>
@@ -50,6 +51,7 @@
 #include <fstream>
 #include <functional>
 #include <future>
+#include <map>
 #include <memory>
 #include <numeric>
 #include <regex>
@@ -92,6 +94,7 @@
 #include <serviceutils/PriorityDumper.h>
 #include <utils/StrongPointer.h>
 #include <vintf/VintfObject.h>
+#include "DumpScheduler.h"
 #include "DumpstateInternal.h"
 #include "DumpstateService.h"
 #include "dumpstate.h"
@@ -122,7 +125,9 @@ using android::os::IDumpstateListener;
 using android::os::dumpstate::CommandOptions;
 using android::os::dumpstate::DumpFileToFd;
 using android::os::dumpstate::DumpPool;
+using android::os::dumpstate::DumpScheduler;
 using android::os::dumpstate::PropertiesHelper;
+using android::os::dumpstate::ResourceClass;
 using android::os::dumpstate::TaskQueue;
 using android::os::dumpstate::WaitForTask;
 
@@ -244,6 +249,15 @@ static const std::string DUMP_HALS_TASK = "DUMP HALS";
 static const std::string DUMP_BOARD_TASK = "dumpstate_board()";
 static const std::string DUMP_CHECKINS_TASK = "DUMP CHECKINS";
 static const std::string POST_PROCESS_UI_TRACES_TASK = "POST-PROCESS UI TRACES";
+static const std::string ADD_UI_TRACES_TASK = "ADD UI TRACES";
+static const std::string ADD_SYSTEM_TRACE_TASK = "ADD SYSTEM TRACE";
+static const std::string DUMP_ANR_TRACES_TASK = "DUMP ANR TRACES";
+static const std::string ADD_HISTORICAL_ANRS_TASK = "ADD HISTORICAL ANRS";
+static const std::string ADD_TOMBSTONES_TASK = "ADD TOMBSTONES";
+static const std::string DUMP_LOG_BUFFERS_TASK = "DUMP LOG BUFFERS";
+static const std::string DUMP_LOG_STATISTICS_TASK = "DUMP LOG STATISTICS";
+static const std::string RUN_DUMPSYS_HIGH_TASK = "RUN DUMPSYS HIGH";
+static const std::string RUN_DUMPSYS_NORMAL_TASK = "RUN DUMPSYS NORMAL";
 
 namespace android {
 namespace os {
@@ -430,9 +444,25 @@ static std::vector<DumpData> GetDumpFds(const std::string& dir_path,
     return dump_data;
 }
 
+// Like dump_file_from_fd(), writing to out_fd.
+static int DumpFileFromFd(const char* title, const char* path, int fd, int out_fd) {
+    if (PropertiesHelper::IsDryRun()) return 0;
+
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1) {
+        dprintf(out_fd, "*** %s: failed to get flags on fd %d: %s\n", path, fd, strerror(errno));
+        return -1;
+    } else if (!(flags & O_NONBLOCK)) {
+        dprintf(out_fd, "*** %s: fd must have O_NONBLOCK set.\n", path);
+        return -1;
+    }
+    return DumpFileFromFdToFd(title, path, fd, out_fd, PropertiesHelper::IsDryRun());
+}
+
 static bool AddDumps(const std::vector<DumpData>::const_iterator start,
                      const std::vector<DumpData>::const_iterator end,
-                     const char* type_name, const bool add_to_zip) {
+                     const char* type_name, const bool add_to_zip,
+                     int out_fd = STDOUT_FILENO) {
     bool dumped = false;
     for (auto it = start; it != end; ++it) {
         const std::string& name = it->name;
@@ -455,7 +485,7 @@ static bool AddDumps(const std::vector<DumpData>::const_iterator start,
                 MYLOGE("Unable to add %s to zip file, addZipEntryFromFd failed\n", name.c_str());
             }
         } else {
-            dump_file_from_fd(type_name, name.c_str(), fd);
+            DumpFileFromFd(type_name, name.c_str(), fd, out_fd);
         }
     }
 
@@ -836,6 +866,54 @@ static const std::set<std::string> PROBLEMATIC_FILE_EXTENSIONS = {
       ".shb", ".sys", ".vb",  ".vbe", ".vbs", ".vxd", ".wsc", ".wsf", ".wsh"
 };
 
+// Largest part of a pipe AddZipEntryFromFd() holds in memory before taking zip_writer_lock_.
+static constexpr size_t kMaxBufferedZipEntrySize = 4 * 1024 * 1024;
+
+// Reads fd until EOF, passing each chunk to |consume|. Gives up once |timeout| has elapsed
+// without the fd being readable, unless it is 0.
+static status_t ReadFromFd(const std::string& entry_name, int fd,
+                           std::chrono::milliseconds timeout,
+                           const std::function<status_t(const uint8_t*, size_t)>& consume) {
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + timeout;
+    struct pollfd pfd = {fd, POLLIN};
+
+    std::vector<uint8_t> buffer(65536);
+    while (1) {
+        if (timeout.count() > 0) {
+            // lambda to recalculate the timeout.
+            auto time_left_ms = [end]() {
+                auto now = std::chrono::steady_clock::now();
+                auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(end - now);
+                return std::max(diff.count(), 0LL);
+            };
+
+            int rc = TEMP_FAILURE_RETRY(poll(&pfd, 1, time_left_ms()));
+            if (rc < 0) {
+                MYLOGE("Error in poll while adding from fd to zip entry %s:%s\n",
+                       entry_name.c_str(), strerror(errno));
+                return -errno;
+            } else if (rc == 0) {
+                MYLOGE("Timed out adding from fd to zip entry %s:%s Timeout:%lldms\n",
+                       entry_name.c_str(), strerror(errno), timeout.count());
+                return TIMED_OUT;
+            }
+        }
+
+        ssize_t bytes_read = TEMP_FAILURE_RETRY(read(fd, buffer.data(), buffer.size()));
+        if (bytes_read == 0) {
+            return OK;
+        } else if (bytes_read == -1) {
+            MYLOGE("read(%s): %s\n", entry_name.c_str(), strerror(errno));
+            return -errno;
+        }
+        status_t status = consume(buffer.data(), bytes_read);
+        if (status != OK) {
+            return status;
+        }
+    }
+}
+
 status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
                                       std::chrono::milliseconds timeout = 0ms) {
     std::string valid_name = entry_name;
@@ -851,8 +929,37 @@ status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
         }
     }
 
-    // Logging statement  below is useful to time how long each entry takes, but it's too verbose.
-    // MYLOGD("Adding zip entry %s\n", entry_name.c_str());
+    // Only logs the entries taking longer than 0.5s, logging every entry is too verbose.
+    DurationReporter duration_reporter("ADD ZIP ENTRY " + valid_name, /* logcat_only = */true);
+
+    // A pipe, e.g. from a service dumping itself, is drained before taking zip_writer_lock_.
+    // Otherwise its writer would stall, and the timeout run out, while another thread deflates
+    // an entry. Regular files are streamed, there is no writer to hold up. Only the first
+    // kMaxBufferedZipEntrySize bytes are buffered; the rest of a larger dump is streamed once
+    // the lock is held.
+    struct stat st;
+    const bool buffered = fstat(fd, &st) != 0 || !S_ISREG(st.st_mode);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> content;
+    bool buffer_full = false;
+    status_t read_status = OK;
+    if (buffered) {
+        auto buffer_bytes = [&content, &buffer_full](const uint8_t* data, size_t size) -> status_t {
+            content.insert(content.end(), data, data + size);
+            if (content.size() >= kMaxBufferedZipEntrySize) {
+                buffer_full = true;
+                return WOULD_BLOCK;
+            }
+            return OK;
+        };
+        read_status = ReadFromFd(entry_name, fd, timeout, buffer_bytes);
+        if (buffer_full) {
+            read_status = OK;
+        }
+        // What was read before an error is still added, as it was when streaming.
+    }
+
+    std::lock_guard<std::mutex> lock(zip_writer_lock_);
     size_t flags = ZipWriter::kCompress | ZipWriter::kDefaultCompression;
     int32_t err = zip_writer_->StartEntryWithTime(valid_name.c_str(), flags,
                                                   get_mtime(fd, ds.now_));
@@ -872,44 +979,36 @@ status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
         }
     };
     auto scope_guard = android::base::make_scope_guard(finish_entry);
-    auto start = std::chrono::steady_clock::now();
-    auto end = start + timeout;
-    struct pollfd pfd = {fd, POLLIN};
-
-    std::vector<uint8_t> buffer(65536);
-    while (1) {
-        if (timeout.count() > 0) {
-            // lambda to recalculate the timeout.
-            auto time_left_ms = [end]() {
-                auto now = std::chrono::steady_clock::now();
-                auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(end - now);
-                return std::max(diff.count(), 0LL);
-            };
 
-            int rc = TEMP_FAILURE_RETRY(poll(&pfd, 1, time_left_ms()));
-            if (rc < 0) {
-                MYLOGE("Error in poll while adding from fd to zip entry %s:%s\n",
-                       entry_name.c_str(), strerror(errno));
-                return -errno;
-            } else if (rc == 0) {
-                MYLOGE("Timed out adding from fd to zip entry %s:%s Timeout:%lldms\n",
-                       entry_name.c_str(), strerror(errno), timeout.count());
-                return TIMED_OUT;
-            }
-        }
-
-        ssize_t bytes_read = TEMP_FAILURE_RETRY(read(fd, buffer.data(), buffer.size()));
-        if (bytes_read == 0) {
-            break;
-        } else if (bytes_read == -1) {
-            MYLOGE("read(%s): %s\n", entry_name.c_str(), strerror(errno));
-            return -errno;
-        }
-        err = zip_writer_->WriteBytes(buffer.data(), bytes_read);
+    auto write_bytes = [this](const uint8_t* data, size_t size) -> status_t {
+        int32_t err = zip_writer_->WriteBytes(data, size);
         if (err) {
             MYLOGE("zip_writer_->WriteBytes(): %s\n", ZipWriter::ErrorCodeString(err));
             return UNKNOWN_ERROR;
         }
+        return OK;
+    };
+    status_t status = OK;
+    if (buffered) {
+        status = write_bytes(content.data(), content.size());
+        content.clear();
+        content.shrink_to_fit();
+    }
+    if (status == OK && (!buffered || buffer_full)) {
+        // The time spent buffering, and waiting for the lock, counts against the timeout.
+        std::chrono::milliseconds time_left = timeout;
+        if (timeout.count() > 0) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start);
+            time_left = std::max(1ms, timeout - elapsed);
+        }
+        status = ReadFromFd(entry_name, fd, time_left, write_bytes);
+    }
+    if (status != OK) {
+        return status;
+    }
+    if (read_status != OK) {
+        return read_status;
     }
 
     err = zip_writer_->FinishEntry();
@@ -946,6 +1045,7 @@ void Dumpstate::AddDir(const std::string& dir, bool recursive) {
 
 bool Dumpstate::AddTextZipEntry(const std::string& entry_name, const std::string& content) {
     MYLOGD("Adding zip text entry %s\n", entry_name.c_str());
+    std::lock_guard<std::mutex> lock(zip_writer_lock_);
     size_t flags = ZipWriter::kCompress | ZipWriter::kDefaultCompression;
     int32_t err = zip_writer_->StartEntryWithTime(entry_name.c_str(), flags, ds.now_);
     if (err != 0) {
@@ -1002,39 +1102,51 @@ static void DoSystemLogcat(time_t since) {
                CommandOptions::WithTimeoutInMs(timeout_ms).Build());
 }
 
-static void DoRadioLogcat() {
+static void DoRadioLogcat(int out_fd = STDOUT_FILENO) {
     unsigned long timeout_ms = logcat_timeout({"radio"});
     RunCommand(
         "RADIO LOG",
         {"logcat", "-b", "radio", "-v", "threadtime", "-v", "printable", "-v", "uid", "-d", "*:v"},
-        CommandOptions::WithTimeoutInMs(timeout_ms).Build(), true /* verbose_duration */);
+        CommandOptions::WithTimeoutInMs(timeout_ms).Build(), true /* verbose_duration */, out_fd);
 }
 
-static void DoLogcat() {
-    unsigned long timeout_ms;
+// The main, system and crash buffers, which dumpstate's own logs end up flooding.
+static void DoMainLogcat() {
     // DumpFile("EVENT LOG TAGS", "/etc/event-log-tags");
     // calculate timeout
-    timeout_ms = logcat_timeout({"main", "system", "crash"});
+    unsigned long timeout_ms = logcat_timeout({"main", "system", "crash"});
     RunCommand("SYSTEM LOG",
                {"logcat", "-v", "threadtime", "-v", "printable", "-v", "uid", "-d", "*:v"},
                CommandOptions::WithTimeoutInMs(timeout_ms).Build());
-    timeout_ms = logcat_timeout({"events"});
+}
+
+static void DoLogBuffersLogcat(int out_fd = STDOUT_FILENO) {
+    unsigned long timeout_ms = logcat_timeout({"events"});
     RunCommand(
         "EVENT LOG",
         {"logcat", "-b", "events", "-v", "threadtime", "-v", "printable", "-v", "uid", "-d", "*:v"},
-        CommandOptions::WithTimeoutInMs(timeout_ms).Build(), true /* verbose_duration */);
+        CommandOptions::WithTimeoutInMs(timeout_ms).Build(), true /* verbose_duration */, out_fd);
     timeout_ms = logcat_timeout({"stats"});
     RunCommand(
         "STATS LOG",
         {"logcat", "-b", "stats", "-v", "threadtime", "-v", "printable", "-v", "uid", "-d", "*:v"},
-        CommandOptions::WithTimeoutInMs(timeout_ms).Build(), true /* verbose_duration */);
-    DoRadioLogcat();
+        CommandOptions::WithTimeoutInMs(timeout_ms).Build(), true /* verbose_duration */, out_fd);
+    DoRadioLogcat(out_fd);
+}
 
-    RunCommand("LOG STATISTICS", {"logcat", "-b", "all", "-S"});
+static void DoLogStatistics(int out_fd = STDOUT_FILENO) {
+    RunCommand("LOG STATISTICS", {"logcat", "-b", "all", "-S"}, CommandOptions::DEFAULT, false,
+               out_fd);
 
     /* kernels must set CONFIG_PSTORE_PMSG, slice up pstore with device tree */
     RunCommand("LAST LOGCAT", {"logcat", "-L", "-b", "all", "-v", "threadtime", "-v", "printable",
-                               "-v", "uid", "-d", "*:v"});
+                               "-v", "uid", "-d", "*:v"}, CommandOptions::DEFAULT, false, out_fd);
+}
+
+static void DoLogcat() {
+    DoMainLogcat();
+    DoLogBuffersLogcat();
+    DoLogStatistics();
 }
 
 static void DumpIncidentReport() {
@@ -1144,7 +1256,7 @@ static void DumpDynamicPartitionInfo() {
     RunCommand("DEVICE-MAPPER", {"gsid", "dump-device-mapper"});
 }
 
-static void AddAnrTraceDir(const std::string& anr_traces_dir) {
+static void AddAnrTraceDir(const std::string& anr_traces_dir, int out_fd) {
     MYLOGD("AddAnrTraceDir(): dump_traces_file=%s, anr_traces_dir=%s\n", dump_traces_path,
            anr_traces_dir.c_str());
 
@@ -1154,7 +1266,7 @@ static void AddAnrTraceDir(const std::string& anr_traces_dir) {
     if (dump_traces_path != nullptr) {
         MYLOGD("Dumping current ANR traces (%s) to the main bugreport entry\n",
                 dump_traces_path);
-        ds.DumpFile("VM TRACES JUST NOW", dump_traces_path);
+        ds.DumpFile("VM TRACES JUST NOW", dump_traces_path, out_fd);
 
         const int ret = unlink(dump_traces_path);
         if (ret == -1) {
@@ -1167,22 +1279,24 @@ static void AddAnrTraceDir(const std::string& anr_traces_dir) {
     if (ds.anr_data_.size() > 0) {
         // The "last" ANR will always be present in the body of the main entry.
         AddDumps(ds.anr_data_.begin(), ds.anr_data_.begin() + 1,
-                 "VM TRACES AT LAST ANR", false /* add_to_zip */);
-
-        // Historical ANRs are always included as separate entries in the bugreport zip file.
-        AddDumps(ds.anr_data_.begin(), ds.anr_data_.end(),
-                 "HISTORICAL ANR", true /* add_to_zip */);
+                 "VM TRACES AT LAST ANR", false /* add_to_zip */, out_fd);
     } else {
-        printf("*** NO ANRs to dump in %s\n\n", ANR_DIR.c_str());
+        dprintf(out_fd, "*** NO ANRs to dump in %s\n\n", ANR_DIR.c_str());
     }
 }
 
-static void AddAnrTraceFiles() {
+// Historical ANRs are always included as separate entries in the bugreport zip file. They share
+// the file offsets of anr_data_ with AddAnrTraceFiles(), so the two must not run concurrently.
+static void AddHistoricalAnrs() {
+    AddDumps(ds.anr_data_.begin(), ds.anr_data_.end(), "HISTORICAL ANR", true /* add_to_zip */);
+}
+
+static void AddAnrTraceFiles(int out_fd = STDOUT_FILENO) {
     std::string anr_traces_dir = "/data/anr";
 
-    AddAnrTraceDir(anr_traces_dir);
+    AddAnrTraceDir(anr_traces_dir, out_fd);
 
-    RunCommand("ANR FILES", {"ls", "-lt", ANR_DIR});
+    RunCommand("ANR FILES", {"ls", "-lt", ANR_DIR}, CommandOptions::DEFAULT, false, out_fd);
 
     // Slow traces for slow operations.
     struct stat st;
@@ -1194,11 +1308,21 @@ static void AddAnrTraceFiles() {
             // No traces file at this index, done with the files.
             break;
         }
-        ds.DumpFile("VM TRACES WHEN SLOW", slow_trace_path.c_str());
+        ds.DumpFile("VM TRACES WHEN SLOW", slow_trace_path.c_str(), out_fd);
         i++;
     }
 }
 
+// NOTE: tombstones are always added as separate entries in the zip archive
+// and are not interspersed with the main report.
+static void AddTombstones(int out_fd = STDOUT_FILENO) {
+    const bool tombstones_dumped = AddDumps(ds.tombstone_data_.begin(), ds.tombstone_data_.end(),
+                                            "TOMBSTONE", true /* add_to_zip */);
+    if (!tombstones_dumped) {
+        dprintf(out_fd, "*** NO TOMBSTONES to dump in %s\n\n", TOMBSTONE_DIR.c_str());
+    }
+}
+
 static void DumpBlockStatFiles() {
     DurationReporter duration_reporter("DUMP BLOCK STAT");
 
@@ -1240,7 +1364,8 @@ static void DumpIpAddrAndRules() {
 
 static Dumpstate::RunStatus RunDumpsysTextByPriority(const std::string& title, int priority,
                                                      std::chrono::milliseconds timeout,
-                                                     std::chrono::milliseconds service_timeout) {
+                                                     std::chrono::milliseconds service_timeout,
+                                                     int out_fd) {
     auto start = std::chrono::steady_clock::now();
     sp<android::IServiceManager> sm = defaultServiceManager();
     Dumpsys dumpsys(sm.get());
@@ -1253,27 +1378,27 @@ static Dumpstate::RunStatus RunDumpsysTextByPriority(const std::string& title, i
         path.append(" - ").append(String8(service).c_str());
         size_t bytes_written = 0;
         if (PropertiesHelper::IsDryRun()) {
-             dumpsys.writeDumpHeader(STDOUT_FILENO, service, priority);
-             dumpsys.writeDumpFooter(STDOUT_FILENO, service, std::chrono::milliseconds(1));
+             dumpsys.writeDumpHeader(out_fd, service, priority);
+             dumpsys.writeDumpFooter(out_fd, service, std::chrono::milliseconds(1));
         } else {
              status_t status = dumpsys.startDumpThread(Dumpsys::TYPE_DUMP | Dumpsys::TYPE_PID |
                                                        Dumpsys::TYPE_CLIENTS | Dumpsys::TYPE_THREAD,
                                                        service, args);
              if (status == OK) {
-                dumpsys.writeDumpHeader(STDOUT_FILENO, service, priority);
+                dumpsys.writeDumpHeader(out_fd, service, priority);
                 std::chrono::duration<double> elapsed_seconds;
                 if (priority == IServiceManager::DUMP_FLAG_PRIORITY_HIGH &&
                     service == String16("meminfo")) {
                     // Use a longer timeout for meminfo, since 30s is not always enough.
-                    status = dumpsys.writeDump(STDOUT_FILENO, service, 60s,
+                    status = dumpsys.writeDump(out_fd, service, 60s,
                                                /* as_proto = */ false, elapsed_seconds,
                                                 bytes_written);
                 } else {
-                    status = dumpsys.writeDump(STDOUT_FILENO, service, service_timeout,
+                    status = dumpsys.writeDump(out_fd, service, service_timeout,
                                                /* as_proto = */ false, elapsed_seconds,
                                                 bytes_written);
                 }
-                dumpsys.writeDumpFooter(STDOUT_FILENO, service, elapsed_seconds);
+                dumpsys.writeDumpFooter(out_fd, service, elapsed_seconds);
                 bool dump_complete = (status == OK);
                 dumpsys.stopDumpThread(dump_complete);
             } else {
@@ -1295,27 +1420,31 @@ static Dumpstate::RunStatus RunDumpsysTextByPriority(const std::string& title, i
 
 static void RunDumpsysText(const std::string& title, int priority,
                            std::chrono::milliseconds timeout,
-                           std::chrono::milliseconds service_timeout) {
-    DurationReporter duration_reporter(title);
-    dprintf(STDOUT_FILENO, "------ %s (/system/bin/dumpsys) ------\n", title.c_str());
-    fsync(STDOUT_FILENO);
-    RunDumpsysTextByPriority(title, priority, timeout, service_timeout);
+                           std::chrono::milliseconds service_timeout,
+                           int out_fd = STDOUT_FILENO) {
+    DurationReporter duration_reporter(title, false /* logcat_only */, false /* verbose */,
+                                       out_fd);
+    dprintf(out_fd, "------ %s (/system/bin/dumpsys) ------\n", title.c_str());
+    fsync(out_fd);
+    RunDumpsysTextByPriority(title, priority, timeout, service_timeout, out_fd);
 }
 
 /* Dump all services registered with Normal or Default priority. */
 static Dumpstate::RunStatus RunDumpsysTextNormalPriority(const std::string& title,
                                                          std::chrono::milliseconds timeout,
-                                                         std::chrono::milliseconds service_timeout) {
-    DurationReporter duration_reporter(title);
-    dprintf(STDOUT_FILENO, "------ %s (/system/bin/dumpsys) ------\n", title.c_str());
-    fsync(STDOUT_FILENO);
+                                                         std::chrono::milliseconds service_timeout,
+                                                         int out_fd) {
+    DurationReporter duration_reporter(title, false /* logcat_only */, false /* verbose */,
+                                       out_fd);
+    dprintf(out_fd, "------ %s (/system/bin/dumpsys) ------\n", title.c_str());
+    fsync(out_fd);
     RunDumpsysTextByPriority(title, IServiceManager::DUMP_FLAG_PRIORITY_NORMAL, timeout,
-                             service_timeout);
+                             service_timeout, out_fd);
 
     RETURN_IF_USER_DENIED_CONSENT();
 
     return RunDumpsysTextByPriority(title, IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT, timeout,
-                                    service_timeout);
+                                    service_timeout, out_fd);
 }
 
 static Dumpstate::RunStatus RunDumpsysProto(const std::string& title, int priority,
@@ -1345,8 +1474,6 @@ static Dumpstate::RunStatus RunDumpsysProto(const std::string& title, int priori
             bool dumpTerminated = (status == OK);
             dumpsys.stopDumpThread(dumpTerminated);
         }
-        ZipWriter::FileEntry file_entry;
-        ds.zip_writer_->GetLastEntry(&file_entry);
 
         auto elapsed_duration = std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::steady_clock::now() - start);
@@ -1371,12 +1498,12 @@ static Dumpstate::RunStatus RunDumpsysCritical() {
 }
 
 // Runs dumpsys on services that must dump first but can take up to 250ms to dump.
-static Dumpstate::RunStatus RunDumpsysHigh() {
+static Dumpstate::RunStatus RunDumpsysHigh(int out_fd = STDOUT_FILENO) {
     // TODO meminfo takes ~10s, connectivity takes ~5sec to dump. They are both
     // high priority. Reduce timeout once they are able to dump in a shorter time or
     // moved to a parallel task.
     RunDumpsysText("DUMPSYS HIGH", IServiceManager::DUMP_FLAG_PRIORITY_HIGH,
-                   /* timeout= */ 90s, /* service_timeout= */ 30s);
+                   /* timeout= */ 90s, /* service_timeout= */ 30s, out_fd);
 
     RETURN_IF_USER_DENIED_CONSENT();
 
@@ -1385,8 +1512,9 @@ static Dumpstate::RunStatus RunDumpsysHigh() {
 }
 
 // Runs dumpsys on services that must dump but can take up to 10s to dump.
-static Dumpstate::RunStatus RunDumpsysNormal() {
-    RunDumpsysTextNormalPriority("DUMPSYS", /* timeout= */ 90s, /* service_timeout= */ 10s);
+static Dumpstate::RunStatus RunDumpsysNormal(int out_fd = STDOUT_FILENO) {
+    RunDumpsysTextNormalPriority("DUMPSYS", /* timeout= */ 90s, /* service_timeout= */ 10s,
+                                 out_fd);
 
     RETURN_IF_USER_DENIED_CONSENT();
 
@@ -1621,6 +1749,68 @@ static void DumpAppInfos(int out_fd = STDOUT_FILENO) {
             DUMPSYS_COMPONENTS_OPTIONS, 0, out_fd);
 }
 
+// Declares the sections with the resource each one mostly waits on and a rough duration observed
+// on typical devices, which is only used to start the sections on the critical path first.
+std::map<std::string, std::future<std::string>> Dumpstate::AddParallelDumpSections(
+        DumpScheduler* scheduler) {
+    std::map<std::string, std::future<std::string>> sections;
+
+    // Most of the sections end up in system_server or in the HALs; running more than two binder
+    // dumps at once only makes them compete for the same threads. logd serves one reader at a
+    // time per buffer, so concurrent logcats mostly wait on each other.
+    scheduler->setConcurrencyLimit(ResourceClass::BINDER, 2);
+    scheduler->setConcurrencyLimit(ResourceClass::DISK, 1);
+    scheduler->setConcurrencyLimit(ResourceClass::LOGD, 1);
+
+    sections[DUMP_BOARD_TASK] = scheduler->addSection(
+        DUMP_BOARD_TASK, ResourceClass::BINDER, 10000ms, {},
+        [this](int out_fd) { DumpstateBoard(out_fd); });
+    sections[DUMP_INCIDENT_REPORT_TASK] = scheduler->addSection(
+        DUMP_INCIDENT_REPORT_TASK, ResourceClass::BINDER, 8000ms, {},
+        [](int) { DumpIncidentReport(); });
+    sections[DUMP_CHECKINS_TASK] = scheduler->addSection(
+        DUMP_CHECKINS_TASK, ResourceClass::BINDER, 5000ms, {},
+        [](int out_fd) { DumpCheckins(out_fd); });
+    sections[DUMP_HALS_TASK] = scheduler->addSection(
+        DUMP_HALS_TASK, ResourceClass::BINDER, 3000ms, {},
+        [](int out_fd) { DumpHals(out_fd); });
+    sections[DUMP_NETSTATS_PROTO_TASK] = scheduler->addSection(
+        DUMP_NETSTATS_PROTO_TASK, ResourceClass::BINDER, 1000ms, {},
+        [](int) { DumpNetstatsProto(); });
+    sections[POST_PROCESS_UI_TRACES_TASK] = scheduler->addSection(
+        POST_PROCESS_UI_TRACES_TASK, ResourceClass::DISK, 2000ms, {},
+        [this](int) { MaybePostProcessUiTraces(); });
+    sections[ADD_UI_TRACES_TASK] = scheduler->addSection(
+        ADD_UI_TRACES_TASK, ResourceClass::DISK, 500ms, {POST_PROCESS_UI_TRACES_TASK},
+        [this](int) { MaybeAddUiTracesToZip(); });
+    sections[ADD_SYSTEM_TRACE_TASK] = scheduler->addSection(
+        ADD_SYSTEM_TRACE_TASK, ResourceClass::DISK, 1000ms, {},
+        [](int) { MaybeAddSystemTraceToZip(); });
+    sections[DUMP_ANR_TRACES_TASK] = scheduler->addSection(
+        DUMP_ANR_TRACES_TASK, ResourceClass::DISK, 1000ms, {},
+        [](int out_fd) { AddAnrTraceFiles(out_fd); });
+    sections[ADD_HISTORICAL_ANRS_TASK] = scheduler->addSection(
+        ADD_HISTORICAL_ANRS_TASK, ResourceClass::DISK, 1000ms, {DUMP_ANR_TRACES_TASK},
+        [](int) { AddHistoricalAnrs(); });
+    sections[ADD_TOMBSTONES_TASK] = scheduler->addSection(
+        ADD_TOMBSTONES_TASK, ResourceClass::DISK, 1000ms, {},
+        [](int out_fd) { AddTombstones(out_fd); });
+    sections[DUMP_LOG_BUFFERS_TASK] = scheduler->addSection(
+        DUMP_LOG_BUFFERS_TASK, ResourceClass::LOGD, 5000ms, {},
+        [](int out_fd) { DoLogBuffersLogcat(out_fd); });
+    sections[DUMP_LOG_STATISTICS_TASK] = scheduler->addSection(
+        DUMP_LOG_STATISTICS_TASK, ResourceClass::LOGD, 3000ms, {},
+        [](int out_fd) { DoLogStatistics(out_fd); });
+    sections[RUN_DUMPSYS_HIGH_TASK] = scheduler->addSection(
+        RUN_DUMPSYS_HIGH_TASK, ResourceClass::BINDER, 15000ms, {},
+        [](int out_fd) { RunDumpsysHigh(out_fd); });
+    // The normal priority dump stays after the high priority one, as in the serial report.
+    sections[RUN_DUMPSYS_NORMAL_TASK] = scheduler->addSection(
+        RUN_DUMPSYS_NORMAL_TASK, ResourceClass::BINDER, 30000ms, {RUN_DUMPSYS_HIGH_TASK},
+        [](int out_fd) { RunDumpsysNormal(out_fd); });
+    return sections;
+}
+
 // Dumps various things. Returns early with status USER_CONSENT_DENIED if user denies consent
 // via the consent they are shown. Ignores other errors that occur while running various
 // commands. The consent checking is currently done around long running tasks, which happen to
@@ -1628,25 +1818,32 @@ static void DumpAppInfos(int out_fd = STDOUT_FILENO) {
 Dumpstate::RunStatus Dumpstate::dumpstate() {
     DurationReporter duration_reporter("DUMPSTATE");
 
-    // Enqueue slow functions into the thread pool, if the parallel run is enabled.
-    std::future<std::string> dump_hals, dump_incident_report, dump_board, dump_checkins,
-            dump_netstats_report, post_process_ui_traces;
+    // Schedule slow functions on the worker threads, if the parallel run is enabled. The
+    // scheduler is declared after the futures so it is destroyed first on early returns.
+    std::map<std::string, std::future<std::string>> tasks;
+    std::unique_ptr<DumpScheduler> scheduler;
     if (ds.dump_pool_) {
         // Pool was shutdown in DumpstateDefaultAfterCritical method in order to
-        // drop root user. Restarts it.
-        ds.dump_pool_->start(/* thread_counts = */3);
-
-        dump_hals = ds.dump_pool_->enqueueTaskWithFd(DUMP_HALS_TASK, &DumpHals, _1);
-        dump_incident_report = ds.dump_pool_->enqueueTask(
-            DUMP_INCIDENT_REPORT_TASK, &DumpIncidentReport);
-        dump_netstats_report = ds.dump_pool_->enqueueTask(
-            DUMP_NETSTATS_PROTO_TASK, &DumpNetstatsProto);
-        dump_board = ds.dump_pool_->enqueueTaskWithFd(
-            DUMP_BOARD_TASK, &Dumpstate::DumpstateBoard, &ds, _1);
-        dump_checkins = ds.dump_pool_->enqueueTaskWithFd(DUMP_CHECKINS_TASK, &DumpCheckins, _1);
-        post_process_ui_traces = ds.dump_pool_->enqueueTask(
-            POST_PROCESS_UI_TRACES_TASK, &Dumpstate::MaybePostProcessUiTraces, &ds);
-    }
+        // drop root user. The scheduler threads are started here, after it.
+        scheduler = std::make_unique<DumpScheduler>(ds.bugreport_internal_dir_);
+        tasks = ds.AddParallelDumpSections(scheduler.get());
+        scheduler->start(/* thread_counts = */4);
+    }
+    auto& dump_hals = tasks[DUMP_HALS_TASK];
+    auto& dump_incident_report = tasks[DUMP_INCIDENT_REPORT_TASK];
+    auto& dump_board = tasks[DUMP_BOARD_TASK];
+    auto& dump_checkins = tasks[DUMP_CHECKINS_TASK];
+    auto& dump_netstats_report = tasks[DUMP_NETSTATS_PROTO_TASK];
+    auto& post_process_ui_traces = tasks[POST_PROCESS_UI_TRACES_TASK];
+    auto& add_ui_traces = tasks[ADD_UI_TRACES_TASK];
+    auto& add_system_trace = tasks[ADD_SYSTEM_TRACE_TASK];
+    auto& dump_anr_traces = tasks[DUMP_ANR_TRACES_TASK];
+    auto& add_historical_anrs = tasks[ADD_HISTORICAL_ANRS_TASK];
+    auto& add_tombstones = tasks[ADD_TOMBSTONES_TASK];
+    auto& dump_log_buffers = tasks[DUMP_LOG_BUFFERS_TASK];
+    auto& dump_log_statistics = tasks[DUMP_LOG_STATISTICS_TASK];
+    auto& run_dumpsys_high = tasks[RUN_DUMPSYS_HIGH_TASK];
+    auto& run_dumpsys_normal = tasks[RUN_DUMPSYS_NORMAL_TASK];
 
     // Dump various things. Note that anything that takes "long" (i.e. several seconds) should
     // check intermittently (if it's intrerruptable like a foreach on pids) and/or should be wrapped
@@ -1716,16 +1913,16 @@ Dumpstate::RunStatus Dumpstate::dumpstate() {
         ds.TakeScreenshot();
     }
 
-    AddAnrTraceFiles();
-
-    MaybeAddSystemTraceToZip();
-
-    // NOTE: tombstones are always added as separate entries in the zip archive
-    // and are not interspersed with the main report.
-    const bool tombstones_dumped = AddDumps(ds.tombstone_data_.begin(), ds.tombstone_data_.end(),
-                                            "TOMBSTONE", true /* add_to_zip */);
-    if (!tombstones_dumped) {
-        printf("*** NO TOMBSTONES to dump in %s\n\n", TOMBSTONE_DIR.c_str());
+    if (ds.dump_pool_) {
+        WAIT_TASK_WITH_CONSENT_CHECK(std::move(dump_anr_traces));
+        WAIT_TASK_WITH_CONSENT_CHECK(std::move(add_historical_anrs));
+        WAIT_TASK_WITH_CONSENT_CHECK(std::move(add_system_trace));
+        WAIT_TASK_WITH_CONSENT_CHECK(std::move(add_tombstones));
+    } else {
+        AddAnrTraceFiles();
+        AddHistoricalAnrs();
+        MaybeAddSystemTraceToZip();
+        AddTombstones();
     }
 
     DumpPacketStats();
@@ -1734,6 +1931,12 @@ Dumpstate::RunStatus Dumpstate::dumpstate() {
 
     DoKmsg();
 
+    if (ds.dump_pool_) {
+        // The remaining log buffers, which DumpstateDefaultAfterCritical() left to the scheduler.
+        WAIT_TASK_WITH_CONSENT_CHECK(std::move(dump_log_buffers));
+        WAIT_TASK_WITH_CONSENT_CHECK(std::move(dump_log_statistics));
+    }
+
     DumpShutdownCheckpoints();
 
     DumpIpAddrAndRules();
@@ -1744,7 +1947,11 @@ Dumpstate::RunStatus Dumpstate::dumpstate() {
     RunCommand("IPv6 ND CACHE", {"ip", "-6", "neigh", "show"});
     RunCommand("MULTICAST ADDRESSES", {"ip", "maddr"});
 
-    RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunDumpsysHigh);
+    if (ds.dump_pool_) {
+        WAIT_TASK_WITH_CONSENT_CHECK(std::move(run_dumpsys_high));
+    } else {
+        RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunDumpsysHigh);
+    }
 
     // The dump mechanism in connectivity is refactored due to modularization work. Connectivity can
     // only register with a default priority(NORMAL priority). Dumpstate has to call connectivity
@@ -1794,7 +2001,11 @@ Dumpstate::RunStatus Dumpstate::dumpstate() {
     printf("== Android Framework Services\n");
     printf("========================================================\n");
 
-    RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunDumpsysNormal);
+    if (ds.dump_pool_) {
+        WAIT_TASK_WITH_CONSENT_CHECK(std::move(run_dumpsys_normal));
+    } else {
+        RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunDumpsysNormal);
+    }
 
     /* Dump Bluetooth HCI logs after getting bluetooth_manager dumpsys */
     ds.AddDir("/data/misc/bluetooth/logs", true);
@@ -1853,7 +2064,17 @@ Dumpstate::RunStatus Dumpstate::dumpstate() {
         RUN_SLOW_FUNCTION_AND_LOG(POST_PROCESS_UI_TRACES_TASK, MaybePostProcessUiTraces);
     }
 
-    MaybeAddUiTracesToZip();
+    if (ds.dump_pool_) {
+        WaitForTask(std::move(add_ui_traces));
+    } else {
+        MaybeAddUiTracesToZip();
+    }
+
+    if (scheduler) {
+        printf("------ DUMP SECTION TIMINGS ------\n");
+        scheduler->dumpTimings(STDOUT_FILENO);
+        printf("\n");
+    }
 
     return Dumpstate::RunStatus::OK;
 }
@@ -1868,8 +2089,12 @@ Dumpstate::RunStatus Dumpstate::dumpstate() {
  */
 Dumpstate::RunStatus Dumpstate::DumpstateDefaultAfterCritical() {
     // Capture first logcat early on; useful to take a snapshot before dumpstate logs take over the
-    // buffer.
-    DoLogcat();
+    // buffer. With the parallel run, the other buffers are dumped by the scheduler in dumpstate().
+    if (dump_pool_) {
+        DoMainLogcat();
+    } else {
+        DoLogcat();
+    }
     // Capture timestamp after first logcat to use in next logcat
     time_t logcat_ts = time(nullptr);
 
@@ -2585,7 +2810,7 @@ void Dumpstate::DumpstateBoard(int out_fd) {
 static void ShowUsage() {
     fprintf(stderr,
             "usage: dumpstate [-h] [-b soundfile] [-e soundfile] [-o directory] [-p] "
-            "[-s] [-S] [-q] [-P] [-R] [-L] [-V version]\n"
+            "[-s] [-S] [-q] [-P] [-R] [-L] [-V version] [--dry-run-schedule]\n"
             "  -h: display this help message\n"
             "  -b: play sound file instead of vibrate, at beginning of job\n"
             "  -e: play sound file instead of vibrate, at end of job\n"
@@ -2598,7 +2823,8 @@ static void ShowUsage() {
             "  -R: take bugreport in remote mode (shouldn't be used with -P)\n"
             "  -w: start binder service and make it wait for a call to startBugreport\n"
             "  -L: output limited information that is safe for submission in feedback reports\n"
-            "  -v: prints the dumpstate header and exit\n");
+            "  -v: prints the dumpstate header and exit\n"
+            "  --dry-run-schedule: prints the schedule of the parallel dump sections and exit\n");
 }
 
 static void register_sig_handler() {
@@ -2643,6 +2869,7 @@ bool Dumpstate::FinishZipFile() {
     }
     fprintf(stderr, "\n");
 
+    std::lock_guard<std::mutex> lock(zip_writer_lock_);
     int32_t err = zip_writer_->Finish();
     if (err != 0) {
         MYLOGE("zip_writer_->Finish(): %s\n", ZipWriter::ErrorCodeString(err));
@@ -2849,13 +3076,13 @@ static void LogDumpOptions(const Dumpstate::DumpOptions& options) {
         "do_vibrate: %d stream_to_socket: %d progress_updates_to_socket: %d do_screenshot: %d "
         "is_remote_mode: %d show_header_only: %d telephony_only: %d "
         "wifi_only: %d do_progress_updates: %d fd: %d bugreport_mode: %s "
-        "limited_only: %d args: %s\n",
+        "limited_only: %d dry_run_schedule: %d args: %s\n",
         options.do_vibrate, options.stream_to_socket, options.progress_updates_to_socket,
         options.do_screenshot, options.is_remote_mode, options.show_header_only,
         options.telephony_only, options.wifi_only,
         options.do_progress_updates, options.bugreport_fd.get(),
         options.bugreport_mode_string.c_str(),
-        options.limited_only, options.args.c_str());
+        options.limited_only, options.dry_run_schedule, options.args.c_str());
 }
 
 void Dumpstate::DumpOptions::Initialize(BugreportMode bugreport_mode,
@@ -2872,12 +3099,22 @@ void Dumpstate::DumpOptions::Initialize(BugreportMode bugreport_mode,
     SetOptionsFromMode(bugreport_mode, this, is_screenshot_requested);
 }
 
+// Keep flags in sync with ShouldStartServiceAndWait in main.cpp.
+static const char kDumpstateShortOptions[] = "dho:svqzpLPBRSV:w";
+static const int kDryRunScheduleOption = 256;
+static const struct option kDumpstateLongOptions[] = {
+    {"dry-run-schedule", no_argument, nullptr, kDryRunScheduleOption},
+    {nullptr, 0, nullptr, 0},
+};
+
 Dumpstate::RunStatus Dumpstate::DumpOptions::Initialize(int argc, char* argv[]) {
     RunStatus status = RunStatus::OK;
     int c;
-    while ((c = getopt(argc, argv, "dho:svqzpLPBRSV:w")) != -1) {
+    while ((c = getopt_long(argc, argv, kDumpstateShortOptions, kDumpstateLongOptions,
+                            nullptr)) != -1) {
         switch (c) {
             // clang-format off
+            case kDryRunScheduleOption: dry_run_schedule = true; break;
             case 'o': out_dir = optarg;              break;
             case 's': stream_to_socket = true;       break;
             case 'S': progress_updates_to_socket = true;    break;
@@ -3106,6 +3343,13 @@ Dumpstate::RunStatus Dumpstate::RunInternal(int32_t calling_uid,
         return RunStatus::OK;
     }
 
+    if (options_->dry_run_schedule) {
+        DumpScheduler scheduler(bugreport_internal_dir_);
+        auto sections = AddParallelDumpSections(&scheduler);
+        scheduler.dumpSchedule(STDOUT_FILENO, /* thread_counts = */3);
+        return RunStatus::OK;
+    }
+
     MYLOGD("dumpstate calling_uid = %d ; calling package = %s \n",
             calling_uid, calling_package.c_str());
 
@@ -3476,6 +3720,9 @@ void Dumpstate::EnableParallelRunIfNeeded() {
     }
     dump_pool_ = std::make_unique<DumpPool>(bugreport_internal_dir_);
     zip_entry_tasks_ = std::make_unique<TaskQueue>();
+    // Compresses the zip entries enqueued by the dump tasks in the background, so
+    // the deflate work doesn't all happen on the main thread in FinishZipFile().
+    zip_entry_tasks_->startWorker();
 }
 
 void Dumpstate::ShutdownDumpPool() {
@@ -4105,10 +4352,11 @@ void do_dmesg() {
     return;
 }
 
-int Dumpstate::DumpFile(const std::string& title, const std::string& path) {
-    DurationReporter duration_reporter(title);
+int Dumpstate::DumpFile(const std::string& title, const std::string& path, int out_fd) {
+    DurationReporter duration_reporter(title, false /* logcat_only */, false /* verbose */,
+                                       out_fd);
 
-    int status = DumpFileToFd(STDOUT_FILENO, title, path);
+    int status = DumpFileToFd(out_fd, title, path);
 
     UpdateProgress(WEIGHT_FILE);
 
@@ -4211,17 +4459,7 @@ int dump_files(const std::string& title, const char* dir, bool (*skip)(const cha
  * stuck.
  */
 int dump_file_from_fd(const char *title, const char *path, int fd) {
-    if (PropertiesHelper::IsDryRun()) return 0;
-
-    int flags = fcntl(fd, F_GETFL);
-    if (flags == -1) {
-        printf("*** %s: failed to get flags on fd %d: %s\n", path, fd, strerror(errno));
-        return -1;
-    } else if (!(flags & O_NONBLOCK)) {
-        printf("*** %s: fd must have O_NONBLOCK set.\n", path);
-        return -1;
-    }
-    return DumpFileFromFdToFd(title, path, fd, STDOUT_FILENO, PropertiesHelper::IsDryRun());
+    return DumpFileFromFd(title, path, fd, STDOUT_FILENO);
 }
 
 int Dumpstate::RunCommand(const std::string& title, const std::vector<std::string>& full_command,
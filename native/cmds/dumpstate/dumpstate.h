@@ -22,6 +22,8 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+#include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -37,6 +39,7 @@
 
 #include "DumpstateUtil.h"
 #include "DumpPool.h"
+#include "DumpScheduler.h"
 #include "TaskQueue.h"
 
 // TODO: move everything under this namespace
@@ -259,8 +262,10 @@ class Dumpstate {
      * |title| description of the command printed on `stdout` (or empty to skip
      * description).
      * |path| location of the file to be dumped.
+     * |out_fd| A fd to support the DumpPool to output results to a temporary
+     * file. Using STDOUT_FILENO if it's not running in the parallel task.
      */
-    int DumpFile(const std::string& title, const std::string& path);
+    int DumpFile(const std::string& title, const std::string& path, int out_fd = STDOUT_FILENO);
 
     /*
      * Adds a new entry to the existing zip file.
@@ -410,6 +415,8 @@ class Dumpstate {
         bool is_consent_deferred = false;
         bool is_remote_mode = false;
         bool show_header_only = false;
+        // Prints the schedule of the parallel dump sections instead of taking a bugreport.
+        bool dry_run_schedule = false;
         bool telephony_only = false;
         bool wifi_only = false;
         // Trimmed-down version of dumpstate to only include whitelisted logs.
@@ -517,6 +524,10 @@ class Dumpstate {
     // Pointer to the zip structure.
     std::unique_ptr<ZipWriter> zip_writer_;
 
+    // Serializes the entries written to zip_writer_, which is shared by the main dumpstate
+    // thread and the zip_entry_tasks_ worker when the parallel run is enabled.
+    std::mutex zip_writer_lock_;
+
     // Binder object listening to progress.
     android::sp<android::os::IDumpstateListener> listener_;
 
@@ -533,7 +544,8 @@ class Dumpstate {
     std::unique_ptr<android::os::dumpstate::DumpPool> dump_pool_;
 
     // A task queue to collect adding zip entry tasks inside dump tasks if the
-    // parallel run is enabled.
+    // parallel run is enabled. Its worker thread adds (and compresses) the entries
+    // while the rest of the bugreport is being generated.
     std::unique_ptr<android::os::dumpstate::TaskQueue> zip_entry_tasks_;
 
     // A callback to IncidentCompanion service, which checks user consent for sharing the
@@ -565,6 +577,10 @@ class Dumpstate {
     RunStatus DumpstateDefaultAfterCritical();
     RunStatus dumpstate();
 
+    // Declares the sections run in parallel by dumpstate(). Returns their futures by name.
+    std::map<std::string, std::future<std::string>> AddParallelDumpSections(
+        android::os::dumpstate::DumpScheduler* scheduler);
+
     void MaybeTakeEarlyScreenshot();
     void MaybeSnapshotSystemTrace();
     void MaybeSnapshotUiTraces();
@@ -16,6 +16,8 @@
 
 #define LOG_TAG "dumpstate"
 
+#include <getopt.h>
+
 #include <binder/IPCThreadState.h>
 
 #include "DumpstateInternal.h"
@@ -30,7 +32,12 @@ bool ShouldStartServiceAndWait(int argc, char* argv[]) {
     bool do_wait = false;
     int c;
     // Keep flags in sync with Dumpstate::DumpOptions::Initialize.
-    while ((c = getopt(argc, argv, "dho:svqzpLPBRSV:w")) != -1 && !do_wait) {
+    static const struct option long_options[] = {
+        {"dry-run-schedule", no_argument, nullptr, 0},
+        {nullptr, 0, nullptr, 0},
+    };
+    while ((c = getopt_long(argc, argv, "dho:svqzpLPBRSV:w", long_options, nullptr)) != -1 &&
+           !do_wait) {
         switch (c) {
             case 'w':
                 do_wait = true;
@@ -32,6 +32,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <filesystem>
+#include <future>
 #include <thread>
 
 #include <aidl/android/hardware/dumpstate/IDumpstateDevice.h>
@@ -51,6 +52,7 @@ namespace dumpstate {
 
 using DumpstateDeviceAidl = ::aidl::android::hardware::dumpstate::IDumpstateDevice;
 using ::android::hardware::dumpstate::V1_1::DumpstateMode;
+using ::testing::ElementsAre;
 using ::testing::EndsWith;
 using ::testing::Eq;
 using ::testing::HasSubstr;
@@ -64,6 +66,7 @@ using ::testing::internal::CaptureStderr;
 using ::testing::internal::CaptureStdout;
 using ::testing::internal::GetCapturedStderr;
 using ::testing::internal::GetCapturedStdout;
+using ::std::literals::chrono_literals::operator""ms;
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 
@@ -1079,6 +1082,46 @@ TEST_F(ZippedBugReportStreamTest, DISABLED_StreamLimitedOnlyReport) {
     VerifyEntry(handle_, bugreport_txt_name, &entry);
 }
 
+// A pipe is drained while another thread holds the zip writer, so its writer isn't held up.
+TEST_F(ZippedBugReportStreamTest, AddZipEntryFromPipeWhileZipWriterBusy) {
+    std::string out_path = kTestDataPath + "AddZipEntryFromPipeOut.zip";
+    ds_.zip_file.reset(fopen(out_path.c_str(), "wb"));
+    ASSERT_NE(nullptr, ds_.zip_file);
+    ds_.zip_writer_.reset(new ZipWriter(ds_.zip_file.get()));
+
+    int pipe_fds[2];
+    ASSERT_EQ(0, pipe2(pipe_fds, O_CLOEXEC));
+    android::base::unique_fd read_fd(pipe_fds[0]);
+    android::base::unique_fd write_fd(pipe_fds[1]);
+    // More than the pipe can hold, the writes only complete if the entry drains it.
+    const std::string content(1024 * 1024, 'x');
+
+    std::future<status_t> status;
+    std::future<bool> written;
+    {
+        std::lock_guard<std::mutex> lock(ds_.zip_writer_lock_);
+        status = std::async(std::launch::async, [&] {
+            return ds_.AddZipEntryFromFd("pipe.txt", read_fd.get(), /* timeout = */ 10000ms);
+        });
+        written = std::async(std::launch::async, [&] {
+            bool result = android::base::WriteStringToFd(content, write_fd.get());
+            write_fd.reset();
+            return result;
+        });
+        EXPECT_EQ(std::future_status::ready, written.wait_for(5000ms));
+    }
+    EXPECT_TRUE(written.get());
+    EXPECT_EQ(OK, status.get());
+    ASSERT_EQ(0, ds_.zip_writer_->Finish());
+    ds_.zip_writer_.reset();
+    ds_.zip_file.reset();
+
+    ASSERT_EQ(0, OpenArchive(out_path.c_str(), &handle_));
+    ZipEntry entry;
+    VerifyEntry(handle_, "pipe.txt", &entry);
+    EXPECT_EQ(content.size(), entry.uncompressed_length);
+}
+
 class ProgressTest : public DumpstateBaseTest {
   public:
     Progress GetInstance(int32_t max, double growth_factor, const std::string& path = "") {
@@ -1779,6 +1822,94 @@ TEST_F(DumpPoolTest, EnqueueTask_withDurationLog) {
     EXPECT_THAT(getTempFileCounts(kTestDataPath), Eq(0));
 }
 
+class DumpSchedulerTest : public DumpstateBaseTest {
+  public:
+    void SetUp() {
+        scheduler_ = std::make_unique<DumpScheduler>(kTestDataPath);
+        DumpstateBaseTest::SetUp();
+        out_path_ = kTestDataPath + "out.txt";
+        out_fd_.reset(TEMP_FAILURE_RETRY(open(out_path_.c_str(),
+                O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_NOFOLLOW,
+                S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)));
+        ASSERT_GE(out_fd_.get(), 0) << "could not create FD for path " << out_path_;
+    }
+
+    std::unique_ptr<DumpScheduler> scheduler_;
+    android::base::unique_fd out_fd_;
+    std::string out_path_;
+};
+
+TEST_F(DumpSchedulerTest, RunsDependenciesFirst) {
+    std::mutex lock;
+    std::vector<std::string> run_order;
+    auto record = [&](const std::string& name) {
+        return [&, name](int out_fd) {
+            std::lock_guard<std::mutex> guard(lock);
+            run_order.push_back(name);
+            dprintf(out_fd, "body of %s\n", name.c_str());
+        };
+    };
+    auto a = scheduler_->addSection("A", ResourceClass::CPU, 10ms, {}, record("A"));
+    auto b = scheduler_->addSection("B", ResourceClass::BINDER, 10ms, {"A"}, record("B"));
+    auto c = scheduler_->addSection("C", ResourceClass::DISK, 10ms, {"A", "B"}, record("C"));
+    scheduler_->start(/* thread_counts = */2);
+
+    WaitForTask(std::move(a), "", out_fd_.get());
+    WaitForTask(std::move(b), "", out_fd_.get());
+    WaitForTask(std::move(c), "", out_fd_.get());
+
+    EXPECT_THAT(run_order, ElementsAre("A", "B", "C"));
+    std::string result;
+    ReadFileToString(out_path_, &result);
+    size_t a_body = result.find("body of A\n");
+    size_t b_body = result.find("body of B\n");
+    size_t c_body = result.find("body of C\n");
+    ASSERT_NE(std::string::npos, a_body);
+    ASSERT_NE(std::string::npos, b_body);
+    ASSERT_NE(std::string::npos, c_body);
+    EXPECT_LT(a_body, b_body);
+    EXPECT_LT(b_body, c_body);
+}
+
+TEST_F(DumpSchedulerTest, RejectsUndeclaredDependency) {
+    auto a = scheduler_->addSection("A", ResourceClass::CPU, 10ms, {"B"}, [](int) {});
+    EXPECT_FALSE(a.valid());
+}
+
+TEST_F(DumpSchedulerTest, DumpScheduleStartsCriticalPathFirst) {
+    auto noop = [](int) {};
+    auto short_task = scheduler_->addSection("SHORT", ResourceClass::BINDER, 100ms, {}, noop);
+    auto head = scheduler_->addSection("HEAD", ResourceClass::BINDER, 50ms, {}, noop);
+    auto tail = scheduler_->addSection("TAIL", ResourceClass::CPU, 500ms, {"HEAD"}, noop);
+    scheduler_->setConcurrencyLimit(ResourceClass::BINDER, 1);
+
+    scheduler_->dumpSchedule(out_fd_.get(), /* thread_counts = */2);
+
+    std::string result;
+    ReadFileToString(out_path_, &result);
+    EXPECT_THAT(result, HasSubstr("#1 +0ms..+50ms 'HEAD' (BINDER"));
+    EXPECT_THAT(result, HasSubstr("#2 +50ms..+550ms 'TAIL' (CPU, estimated 500ms, "
+                                  "critical path 500ms) after 'HEAD'"));
+    EXPECT_THAT(result, HasSubstr("#3 +50ms..+150ms 'SHORT' (BINDER"));
+    EXPECT_THAT(result, HasSubstr("Critical path (550ms): 'HEAD' 'TAIL'"));
+}
+
+TEST_F(DumpSchedulerTest, DumpScheduleSerializesLogdReaders) {
+    auto noop = [](int) {};
+    auto buffers = scheduler_->addSection("BUFFERS", ResourceClass::LOGD, 200ms, {}, noop);
+    auto statistics = scheduler_->addSection("STATISTICS", ResourceClass::LOGD, 100ms, {}, noop);
+    auto hals = scheduler_->addSection("HALS", ResourceClass::BINDER, 100ms, {}, noop);
+    scheduler_->setConcurrencyLimit(ResourceClass::LOGD, 1);
+
+    scheduler_->dumpSchedule(out_fd_.get(), /* thread_counts = */3);
+
+    std::string result;
+    ReadFileToString(out_path_, &result);
+    EXPECT_THAT(result, HasSubstr("+0ms..+200ms 'BUFFERS' (LOGD"));
+    EXPECT_THAT(result, HasSubstr("+0ms..+100ms 'HALS' (BINDER"));
+    EXPECT_THAT(result, HasSubstr("+200ms..+300ms 'STATISTICS' (LOGD"));
+}
+
 class TaskQueueTest : public DumpstateBaseTest {
 public:
     void SetUp() {
@@ -1830,6 +1961,31 @@ TEST_F(TaskQueueTest, runTask_withCancelled) {
     EXPECT_TRUE(is_task2_cancelled);
 }
 
+TEST_F(TaskQueueTest, runTask_withWorker) {
+    std::vector<int> run_order;
+    std::promise<void> task1_done;
+    auto task_1 = [&](bool task_cancelled) {
+        if (!task_cancelled) {
+            run_order.push_back(1);
+        }
+        task1_done.set_value();
+    };
+    auto task_2 = [&](bool task_cancelled) {
+        if (!task_cancelled) {
+            run_order.push_back(2);
+        }
+    };
+    task_queue_.startWorker();
+    task_queue_.add(task_1, std::placeholders::_1);
+    // The worker runs the task without waiting for run().
+    task1_done.get_future().wait();
+    task_queue_.add(task_2, std::placeholders::_1);
+
+    task_queue_.run(/* do_cancel = */false);
+
+    EXPECT_THAT(run_order, ElementsAre(1, 2));
+}
+
 
 }  // namespace dumpstate
 }  // namespace os
@@ -0,0 +1,409 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "installd"
+
+#include "TreeSize.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+#include <cutils/multiuser.h>
+#include <private/android_filesystem_config.h>
+
+#include "SysTrace.h"
+
+using android::base::unique_fd;
+
+namespace android {
+namespace installd {
+
+// Threads walking a tree in addition to the calling one.
+static constexpr size_t kMaxHelperThreads = 3;
+
+// Helpers are only started once this many directories are waiting to be
+// walked, so that the many small trees measured by getAppSize don't pay for
+// thread creation.
+static constexpr size_t kHelperThreshold = 8;
+
+// Upper bound on the number of directory entries kept by the listing cache.
+static constexpr size_t kMaxCachedEntries = 128 * 1024;
+
+// Timestamps are only as precise as the filesystem's clock tick, so a
+// directory changed twice within a tick may keep the same mtime. Listings of
+// directories changed less than this long ago are not cached.
+static constexpr int64_t kMinCachedListingAgeNs = 2'000'000'000;
+
+static constexpr unsigned int kStatxMask =
+        STATX_TYPE | STATX_UID | STATX_GID | STATX_INO | STATX_MTIME | STATX_CTIME | STATX_BLOCKS;
+
+static constexpr int kStatxFlags = AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT;
+
+// Record returned by the getdents64 syscall.
+struct KernelDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+using DirListing = std::vector<std::string>;
+
+static int64_t timestampNs(const struct statx_timestamp& ts) {
+    return ts.tv_sec * 1'000'000'000LL + ts.tv_nsec;
+}
+
+static bool readListing(int fd, DirListing* listing) {
+    alignas(KernelDirent64) char buf[32 * 1024];
+    for (;;) {
+        long read = syscall(SYS_getdents64, fd, buf, sizeof(buf));
+        if (read == 0) {
+            return true;
+        }
+        if (read < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        for (long pos = 0; pos < read;) {
+            const auto* de = reinterpret_cast<const KernelDirent64*>(buf + pos);
+            pos += de->d_reclen;
+            if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) {
+                continue;
+            }
+            listing->emplace_back(de->d_name);
+        }
+    }
+}
+
+/**
+ * Directory listings from previous walks, keyed by inode and validated with
+ * the directory's mtime and ctime: adding, removing or renaming an entry
+ * updates both.
+ */
+class ListingCache {
+  public:
+    std::shared_ptr<const DirListing> get(const struct statx& st) {
+        std::lock_guard<std::mutex> lock(mLock);
+        auto it = mListings.find(Key(st));
+        if (it == mListings.end() || it->second.mtimeNs != timestampNs(st.stx_mtime) ||
+            it->second.ctimeNs != timestampNs(st.stx_ctime)) {
+            return nullptr;
+        }
+        return it->second.listing;
+    }
+
+    void put(const struct statx& st, std::shared_ptr<const DirListing> listing) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        int64_t nowNs = now.tv_sec * 1'000'000'000LL + now.tv_nsec;
+        int64_t changedNs = std::max(timestampNs(st.stx_mtime), timestampNs(st.stx_ctime));
+        if (nowNs - changedNs < kMinCachedListingAgeNs) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mEntryCount + listing->size() > kMaxCachedEntries) {
+            mListings.clear();
+            mEntryCount = 0;
+        }
+        auto& cached = mListings[Key(st)];
+        if (cached.listing) {
+            mEntryCount -= cached.listing->size();
+        }
+        mEntryCount += listing->size();
+        cached = {timestampNs(st.stx_mtime), timestampNs(st.stx_ctime), std::move(listing)};
+    }
+
+  private:
+    struct Key {
+        explicit Key(const struct statx& st)
+              : devMajor(st.stx_dev_major), devMinor(st.stx_dev_minor), ino(st.stx_ino) {}
+
+        bool operator==(const Key& other) const {
+            return devMajor == other.devMajor && devMinor == other.devMinor && ino == other.ino;
+        }
+
+        uint32_t devMajor;
+        uint32_t devMinor;
+        uint64_t ino;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<uint64_t>()(key.ino) ^
+                    std::hash<uint64_t>()((uint64_t(key.devMajor) << 32) | key.devMinor);
+        }
+    };
+
+    struct CachedListing {
+        int64_t mtimeNs;
+        int64_t ctimeNs;
+        std::shared_ptr<const DirListing> listing;
+    };
+
+    std::mutex mLock;
+    std::unordered_map<Key, CachedListing, KeyHash> mListings;
+    size_t mEntryCount = 0;
+};
+
+static ListingCache& listingCache() {
+    static ListingCache* cache = new ListingCache();
+    return *cache;
+}
+
+class TreeSizeWalker {
+  public:
+    TreeSizeWalker(int32_t include_gid, int32_t exclude_gid, bool exclude_apps)
+          : mIncludeGid(include_gid), mExcludeGid(exclude_gid), mExcludeApps(exclude_apps) {}
+
+    int64_t walk(const std::string& path) {
+        struct statx st;
+        if (statx(AT_FDCWD, path.c_str(), kStatxFlags, kStatxMask, &st) != 0) {
+            if (errno != ENOENT) {
+                PLOG(ERROR) << "Failed to stat " << path;
+            }
+            return 0;
+        }
+        if (isExcluded(st)) {
+            return 0;
+        }
+        if (isMatched(st)) {
+            mSize += st.stx_blocks * 512;
+        }
+        if (!S_ISDIR(st.stx_mode)) {
+            return mSize;
+        }
+
+        mDevMajor = st.stx_dev_major;
+        mDevMinor = st.stx_dev_minor;
+        auto fd = std::make_shared<unique_fd>(
+                open(path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC));
+        if (!fd->ok()) {
+            PLOG(WARNING) << "Failed to open " << path;
+            return mSize;
+        }
+        walkDirectory(0, fd, st);
+        fd.reset();
+
+        run(0);
+        for (auto& helper : mHelpers) {
+            helper.join();
+        }
+        return mSize;
+    }
+
+  private:
+    // A subdirectory waiting to be walked, and the directory containing it.
+    struct Work {
+        std::shared_ptr<unique_fd> parent;
+        std::string name;
+        struct statx st;
+    };
+
+    struct WorkQueue {
+        std::mutex lock;
+        std::deque<Work> work;
+    };
+
+    bool isExcluded(const struct statx& st) const {
+        if (!mExcludeApps) {
+            return false;
+        }
+        int32_t user_uid = multiuser_get_app_id(st.stx_uid);
+        int32_t user_gid = multiuser_get_app_id(st.stx_gid);
+        return (user_uid >= AID_APP_START && user_uid <= AID_APP_END) ||
+                (user_gid >= AID_CACHE_GID_START && user_gid <= AID_CACHE_GID_END) ||
+                (user_gid >= AID_SHARED_GID_START && user_gid <= AID_SHARED_GID_END);
+    }
+
+    bool isMatched(const struct statx& st) const {
+        int32_t gid = st.stx_gid;
+        if (mIncludeGid != -1 && gid != mIncludeGid) {
+            return false;
+        }
+        if (mExcludeGid != -1 && gid == mExcludeGid) {
+            return false;
+        }
+        return true;
+    }
+
+    // Measures the entries of the directory open as |fd|, and queues its
+    // subdirectories on |worker|'s queue.
+    void walkDirectory(size_t worker, const std::shared_ptr<unique_fd>& fd,
+                       const struct statx& st) {
+        std::shared_ptr<const DirListing> listing = listingCache().get(st);
+        if (!listing) {
+            auto read = std::make_shared<DirListing>();
+            if (!readListing(fd->get(), read.get())) {
+                return;
+            }
+            listingCache().put(st, read);
+            listing = std::move(read);
+        }
+
+        int64_t size = 0;
+        for (const std::string& name : *listing) {
+            Work child;
+            if (statx(fd->get(), name.c_str(), kStatxFlags, kStatxMask, &child.st) != 0) {
+                // Removed since it was listed.
+                continue;
+            }
+            if (isExcluded(child.st)) {
+                continue;
+            }
+            if (isMatched(child.st)) {
+                size += child.st.stx_blocks * 512;
+            }
+            if (S_ISDIR(child.st.stx_mode) && child.st.stx_dev_major == mDevMajor &&
+                child.st.stx_dev_minor == mDevMinor) {
+                child.parent = fd;
+                child.name = name;
+                push(worker, std::move(child));
+            }
+        }
+        mSize += size;
+    }
+
+    void push(size_t worker, Work&& work) {
+        mPending++;
+        {
+            std::lock_guard<std::mutex> lock(mQueues[worker].lock);
+            mQueues[worker].work.push_back(std::move(work));
+        }
+        mQueued++;
+        if (mIdle > 0) {
+            std::lock_guard<std::mutex> lock(mLock);
+            mCondition.notify_one();
+        }
+    }
+
+    // Takes the most recently queued directory of |worker|, or steals the
+    // oldest one, usually the largest subtree, from another worker.
+    bool pop(size_t worker, Work* work) {
+        for (size_t i = 0; i < kMaxHelperThreads + 1; i++) {
+            WorkQueue& queue = mQueues[(worker + i) % (kMaxHelperThreads + 1)];
+            std::lock_guard<std::mutex> lock(queue.lock);
+            if (queue.work.empty()) {
+                continue;
+            }
+            if (i == 0) {
+                *work = std::move(queue.work.back());
+                queue.work.pop_back();
+            } else {
+                *work = std::move(queue.work.front());
+                queue.work.pop_front();
+            }
+            mQueued--;
+            return true;
+        }
+        return false;
+    }
+
+    void process(size_t worker, Work& work) {
+        auto fd = std::make_shared<unique_fd>(
+                openat(work.parent->get(), work.name.c_str(),
+                       O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC));
+        work.parent.reset();
+        if (!fd->ok()) {
+            // Counted already, like the directories fts reports as FTS_DNR.
+            return;
+        }
+        walkDirectory(worker, fd, work.st);
+    }
+
+    void run(size_t worker) {
+        Work work;
+        for (;;) {
+            if (pop(worker, &work)) {
+                process(worker, work);
+                work = Work();
+                if (--mPending == 0) {
+                    std::lock_guard<std::mutex> lock(mLock);
+                    mCondition.notify_all();
+                }
+                if (worker == 0 && mHelpers.empty() && mQueued >= kHelperThreshold) {
+                    startHelpers();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mLock);
+            mIdle++;
+            mCondition.wait(lock, [this] { return mPending == 0 || mQueued > 0; });
+            mIdle--;
+            if (mPending == 0) {
+                return;
+            }
+        }
+    }
+
+    void startHelpers() {
+        for (size_t i = 1; i <= kMaxHelperThreads; i++) {
+            mHelpers.emplace_back([this, i] {
+                atrace_pm_begin("tree size walker");
+                run(i);
+                atrace_pm_end();
+            });
+        }
+    }
+
+    const int32_t mIncludeGid;
+    const int32_t mExcludeGid;
+    const bool mExcludeApps;
+    uint32_t mDevMajor = 0;
+    uint32_t mDevMinor = 0;
+
+    std::atomic<int64_t> mSize = 0;
+    // Directories queued and not yet taken by a worker.
+    std::atomic<size_t> mQueued = 0;
+    // Directories queued and not yet completely walked.
+    std::atomic<size_t> mPending = 0;
+    // Workers waiting for directories to be queued.
+    std::atomic<size_t> mIdle = 0;
+
+    WorkQueue mQueues[kMaxHelperThreads + 1];
+    std::mutex mLock;
+    std::condition_variable mCondition;
+    // Only accessed from the calling thread.
+    std::vector<std::thread> mHelpers;
+};
+
+int64_t measure_tree_size(const std::string& path, int32_t include_gid, int32_t exclude_gid,
+        bool exclude_apps) {
+    TreeSizeWalker walker(include_gid, exclude_gid, exclude_apps);
+    return walker.walk(path);
+}
+
+}  // namespace installd
+}  // namespace android
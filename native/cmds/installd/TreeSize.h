@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_INSTALLD_TREE_SIZE_H
+#define ANDROID_INSTALLD_TREE_SIZE_H
+
+#include <stdint.h>
+
+#include <string>
+
+namespace android {
+namespace installd {
+
+/**
+ * Returns the space used by |path| and everything below it, without following
+ * symlinks or crossing mount points, i.e. the same nodes an
+ * fts_open(FTS_PHYSICAL | FTS_XDEV) walk visits.
+ *
+ * Nodes whose gid differs from |include_gid|, or equals |exclude_gid|, are not
+ * counted. With |exclude_apps|, nodes owned by an app uid, cache gid or shared
+ * gid are neither counted nor traversed.
+ *
+ * Large trees are walked by several threads, each taking whole subtrees and
+ * stealing pending ones from the others once it runs out of work. Directory
+ * listings are cached between calls and reused while the directory's mtime
+ * and ctime are unchanged; every node is still stat'ed on each call, since a
+ * file changing size doesn't update its parent directory.
+ */
+int64_t measure_tree_size(const std::string& path, int32_t include_gid = -1,
+        int32_t exclude_gid = -1, bool exclude_apps = false);
+
+}  // namespace installd
+}  // namespace android
+
+#endif  // ANDROID_INSTALLD_TREE_SIZE_H
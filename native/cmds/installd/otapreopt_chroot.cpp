@@ -17,18 +17,25 @@
 #include <fcntl.h>
 #include <linux/unistd.h>
 #include <sys/mount.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <time.h>
 
+#include <algorithm>
 #include <array>
 #include <fstream>
+#include <map>
 #include <sstream>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/macros.h>
+#include <android-base/parseint.h>
+#include <android-base/properties.h>
 #include <android-base/scopeguard.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
 #include <android-base/unique_fd.h>
 #include <libdm/dm.h>
 #include <selinux/android.h>
@@ -40,11 +47,21 @@
 #define LOG_TAG "otapreopt"
 #endif
 
+using android::base::Join;
 using android::base::StringPrintf;
 
 namespace android {
 namespace installd {
 
+// Argument requesting to read the otapreopt commands to run from stdin.
+static constexpr const char* kBatchArg = "--batch";
+
+// Upper bound on the number of otapreopt processes running at the same time in batch mode.
+static constexpr size_t kMaxBatchJobs = 4;
+
+// Memory to keep available for each concurrent otapreopt process, i.e. for its dex2oat.
+static constexpr uint64_t kBatchJobMemoryBytes = 1024ull * 1024 * 1024;
+
 // We don't know the filesystem types of the partitions in the update package,
 // so just try the possibilities one by one.
 static constexpr std::array kTryMountFsTypes = {"ext4", "erofs"};
@@ -128,10 +145,144 @@ static void TryExtraMount(const char* name, const char* slot, const char* target
     (void)TryMountWithFstypes(block_device.c_str(), target);
 }
 
+// Reads the otapreopt commands of a batch, one per line. Like the arguments of a single
+// invocation, the parameters of a command are separated by whitespace.
+static std::vector<std::vector<std::string>> ReadBatchCommands(int fd) {
+    std::string input;
+    if (!android::base::ReadFdToString(fd, &input)) {
+        return {};
+    }
+    std::vector<std::vector<std::string>> commands;
+    for (const std::string& line : android::base::Split(input, "\n")) {
+        std::vector<std::string> params = android::base::Tokenize(line, " \t");
+        if (!params.empty()) {
+            commands.push_back(std::move(params));
+        }
+    }
+    return commands;
+}
+
+// Returns the number of CPUs dex2oat may run on, from the same cpu-set property run_dex2oat
+// uses, or all online CPUs.
+static size_t GetDex2oatCpuCount() {
+    std::string cpu_set = android::base::GetProperty("dalvik.vm.dex2oat-cpu-set", "");
+    size_t count = 0;
+    for (const std::string& cpu : android::base::Split(cpu_set, ",")) {
+        unsigned int ignored;
+        if (android::base::ParseUint(cpu, &ignored)) {
+            count++;
+        }
+    }
+    if (count > 0) {
+        return count;
+    }
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    return online > 0 ? online : 1;
+}
+
+static uint64_t GetAvailableMemoryBytes() {
+    std::string meminfo;
+    if (!android::base::ReadFileToString("/proc/meminfo", &meminfo)) {
+        return 0;
+    }
+    for (const std::string& line : android::base::Split(meminfo, "\n")) {
+        std::vector<std::string> fields = android::base::Tokenize(line, " ");
+        uint64_t kb;
+        if (fields.size() >= 2 && fields[0] == "MemAvailable:" &&
+            android::base::ParseUint(fields[1], &kb)) {
+            return kb * 1024;
+        }
+    }
+    return 0;
+}
+
+// Number of otapreopt processes to run at the same time. dex2oat is multi-threaded but spends
+// long phases on a single thread, so two CPUs per job keep the cpu set busy without
+// oversubscribing it, as long as there is memory for every job.
+static size_t GetBatchJobCount() {
+    size_t jobs = std::max<size_t>(1, GetDex2oatCpuCount() / 2);
+    jobs = std::min(jobs, kMaxBatchJobs);
+    uint64_t memory_jobs = std::max<uint64_t>(1, GetAvailableMemoryBytes() / kBatchJobMemoryBytes);
+    return std::min<uint64_t>(jobs, memory_jobs);
+}
+
+static int64_t ToMillis(const struct timeval& tv) {
+    return tv.tv_sec * 1000LL + tv.tv_usec / 1000;
+}
+
+static int64_t ElapsedMillis(const struct timespec& start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) * 1000LL + (now.tv_nsec - start.tv_nsec) / 1000000;
+}
+
+// Runs the otapreopt commands of a batch in order, up to GetBatchJobCount() of them at the
+// same time, and logs the wall and CPU time each of them took. The commands are started in
+// the order they were given, which is the priority order chosen by the OTA dexopt service.
+// Returns whether all of them succeeded.
+static bool RunBatch(const char* target_slot,
+                     const std::vector<std::vector<std::string>>& commands) {
+    struct Job {
+        std::string params;
+        struct timespec start;
+    };
+
+    const size_t max_jobs = GetBatchJobCount();
+    LOG(INFO) << "Running " << commands.size() << " otapreopt commands, up to " << max_jobs
+              << " at a time";
+
+    std::map<pid_t, Job> running;
+    size_t next = 0;
+    bool ok = true;
+    while (next < commands.size() || !running.empty()) {
+        if (next < commands.size() && running.size() < max_jobs) {
+            std::vector<std::string> cmd{"/system/bin/otapreopt", target_slot};
+            cmd.insert(cmd.end(), commands[next].begin(), commands[next].end());
+            Job job{Join(commands[next], ' '), {}};
+            next++;
+
+            clock_gettime(CLOCK_MONOTONIC, &job.start);
+            std::string error_msg;
+            pid_t pid = Spawn(cmd, &error_msg);
+            if (pid == -1) {
+                LOG(ERROR) << "Running otapreopt failed: " << error_msg;
+                ok = false;
+                continue;
+            }
+            running.emplace(pid, std::move(job));
+            continue;
+        }
+
+        int status;
+        struct rusage usage;
+        pid_t pid = TEMP_FAILURE_RETRY(wait4(-1, &status, 0, &usage));
+        if (pid == -1) {
+            PLOG(ERROR) << "Failed waiting for otapreopt";
+            return false;
+        }
+        auto it = running.find(pid);
+        if (it == running.end()) {
+            continue;
+        }
+        bool succeeded = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        // The usage includes the dex2oat processes otapreopt waited for.
+        LOG(INFO) << "otapreopt " << (succeeded ? "finished" : "failed") << " in "
+                  << ElapsedMillis(it->second.start) << "ms wall, "
+                  << ToMillis(usage.ru_utime) + ToMillis(usage.ru_stime) << "ms cpu: "
+                  << it->second.params;
+        ok &= succeeded;
+        running.erase(it);
+    }
+    return ok;
+}
+
 // Entry for otapreopt_chroot. Expected parameters are:
 //   [cmd] [status-fd] [target-slot] "dexopt" [dexopt-params]
 // The file descriptor denoted by status-fd will be closed. The rest of the parameters will
 // be passed on to otapreopt in the chroot.
+// Alternatively, to set up the chroot only once for several otapreopt commands:
+//   [cmd] [status-fd] [target-slot] "--batch"
+// with the parameters following target-slot of each command on a line of stdin.
 static int otapreopt_chroot(const int argc, char **arg) {
     // Validate arguments
     // We need the command, status channel and target slot, at a minimum.
@@ -139,6 +290,12 @@ static int otapreopt_chroot(const int argc, char **arg) {
         PLOG(ERROR) << "Not enough arguments.";
         exit(208);
     }
+    const bool batch = argc == 4 && strcmp(arg[3], kBatchArg) == 0;
+    std::vector<std::vector<std::string>> batch_commands;
+    if (batch) {
+        batch_commands = ReadBatchCommands(STDIN_FILENO);
+    }
+
     // Close all file descriptors. They are coming from the caller, we do not want to pass them
     // on across our fork/exec into a different domain.
     // 1) Default descriptors.
@@ -331,6 +488,13 @@ static int otapreopt_chroot(const int argc, char **arg) {
 
     // Now go on and run otapreopt.
 
+    if (batch) {
+        if (!RunBatch(arg[2], batch_commands)) {
+            exit(213);
+        }
+        return 0;
+    }
+
     // Incoming:  cmd + status-fd + target-slot + cmd...      | Incoming | = argc
     // Outgoing:  cmd             + target-slot + cmd...      | Outgoing | = argc - 1
     std::vector<std::string> cmd;
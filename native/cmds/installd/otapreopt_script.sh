@@ -58,22 +58,37 @@ PREPARE=$(cmd otadexopt prepare)
 PROGRESS=$(cmd otadexopt progress)
 print -u${STATUS_FD} "global_progress $PROGRESS"
 
+# Maximum number of packages handed to otapreopt_chroot at once. It sets up the chroot once
+# for the batch and dexopts several of its packages at the same time.
+BATCH_SIZE=8
+
 i=0
 while ((i<MAXIMUM_PACKAGES)) ; do
-  DONE=$(cmd otadexopt done)
-  if [ "$DONE" = "OTA complete." ] ; then
+  BATCH=""
+  j=0
+  while ((j<BATCH_SIZE && i<MAXIMUM_PACKAGES)) ; do
+    DONE=$(cmd otadexopt done)
+    if [ "$DONE" = "OTA complete." ] ; then
+      break
+    fi
+
+    DEXOPT_PARAMS=$(cmd otadexopt next)
+    BATCH="$BATCH$DEXOPT_PARAMS
+"
+    i=$((i+1))
+    j=$((j+1))
+  done
+
+  if [ -z "$BATCH" ] ; then
     break
   fi
 
-  DEXOPT_PARAMS=$(cmd otadexopt next)
-
-  /system/bin/otapreopt_chroot $STATUS_FD $TARGET_SLOT_SUFFIX $DEXOPT_PARAMS >&- 2>&-
+  print -rn -- "$BATCH" | /system/bin/otapreopt_chroot $STATUS_FD $TARGET_SLOT_SUFFIX --batch >&- 2>&-
 
   PROGRESS=$(cmd otadexopt progress)
   print -u${STATUS_FD} "global_progress $PROGRESS"
 
   sleep 1
-  i=$((i+1))
 done
 
 DONE=$(cmd otadexopt done)
@@ -30,7 +30,7 @@ using android::base::StringPrintf;
 namespace android {
 namespace installd {
 
-bool Exec(const std::vector<std::string>& arg_vector, std::string* error_msg) {
+pid_t Spawn(const std::vector<std::string>& arg_vector, std::string* error_msg) {
     const std::string command_line = Join(arg_vector, ' ');
 
     CHECK_GE(arg_vector.size(), 1U) << command_line;
@@ -59,27 +59,34 @@ bool Exec(const std::vector<std::string>& arg_vector, std::string* error_msg) {
         PLOG(ERROR) << "Failed to execv(" << command_line << ")";
         // _exit to avoid atexit handlers in child.
         _exit(1);
-    } else {
-        if (pid == -1) {
-            *error_msg = StringPrintf("Failed to execv(%s) because fork failed: %s",
-                    command_line.c_str(), strerror(errno));
-            return false;
-        }
+    }
+    if (pid == -1) {
+        *error_msg = StringPrintf("Failed to execv(%s) because fork failed: %s",
+                command_line.c_str(), strerror(errno));
+    }
+    return pid;
+}
 
-        // wait for subprocess to finish
-        int status;
-        pid_t got_pid = TEMP_FAILURE_RETRY(waitpid(pid, &status, 0));
-        if (got_pid != pid) {
-            *error_msg = StringPrintf("Failed after fork for execv(%s) because waitpid failed: "
-                    "wanted %d, got %d: %s",
-                    command_line.c_str(), pid, got_pid, strerror(errno));
-            return false;
-        }
-        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
-            *error_msg = StringPrintf("Failed execv(%s) because non-0 exit status",
-                    command_line.c_str());
-            return false;
-        }
+bool Exec(const std::vector<std::string>& arg_vector, std::string* error_msg) {
+    pid_t pid = Spawn(arg_vector, error_msg);
+    if (pid == -1) {
+        return false;
+    }
+
+    // wait for subprocess to finish
+    const std::string command_line = Join(arg_vector, ' ');
+    int status;
+    pid_t got_pid = TEMP_FAILURE_RETRY(waitpid(pid, &status, 0));
+    if (got_pid != pid) {
+        *error_msg = StringPrintf("Failed after fork for execv(%s) because waitpid failed: "
+                "wanted %d, got %d: %s",
+                command_line.c_str(), pid, got_pid, strerror(errno));
+        return false;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        *error_msg = StringPrintf("Failed execv(%s) because non-0 exit status",
+                command_line.c_str());
+        return false;
     }
     return true;
 }
@@ -15,12 +15,15 @@
  */
 
 #include <errno.h>
+#include <fts.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <android-base/logging.h>
 #include <android-base/scopeguard.h>
+#include <android-base/stringprintf.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
@@ -48,6 +51,7 @@
 namespace android {
 namespace installd {
 
+using android::base::StringPrintf;
 using ::testing::UnorderedElementsAre;
 
 class UtilsTest : public testing::Test {
@@ -678,6 +682,60 @@ TEST_F(UtilsTest, TestForEachSubdir) {
     EXPECT_THAT(result, UnorderedElementsAre("com.foo", "com.bar"));
 }
 
+static int64_t fts_tree_size(const std::string& path) {
+    char* argv[] = {(char*)path.c_str(), nullptr};
+    FTS* fts = fts_open(argv, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, nullptr);
+    if (fts == nullptr) return -1;
+    int64_t size = 0;
+    FTSENT* p;
+    while ((p = fts_read(fts)) != nullptr) {
+        switch (p->fts_info) {
+            case FTS_D:
+            case FTS_DEFAULT:
+            case FTS_F:
+            case FTS_SL:
+            case FTS_SLNONE:
+                size += p->fts_statp->st_blocks * 512;
+                break;
+        }
+    }
+    fts_close(fts);
+    return size;
+}
+
+TEST_F(UtilsTest, TestCalculateTreeSize) {
+    auto deleter = [&]() {
+        delete_dir_contents_and_dir("/data/local/tmp/user/0", true /* ignore_if_missing */);
+    };
+    auto scope_guard = android::base::make_scope_guard(deleter);
+
+    // Wide enough for the walk to be split across threads.
+    for (int i = 0; i < 32; i++) {
+        system(StringPrintf("mkdir -p /data/local/tmp/user/0/d%d/a/b /data/local/tmp/user/0/d%d/c",
+                            i, i).c_str());
+        system(StringPrintf("head -c %d /dev/zero > /data/local/tmp/user/0/d%d/a/b/file",
+                            4096 * (i + 1), i).c_str());
+    }
+    system("ln -s d0 /data/local/tmp/user/0/link");
+
+    int64_t expected = fts_tree_size("/data/local/tmp/user/0");
+    int64_t size = 0;
+    ASSERT_EQ(0, calculate_tree_size("/data/local/tmp/user/0", &size));
+    EXPECT_EQ(expected, size);
+
+    // Growing a file doesn't touch its directory, and must still be noticed.
+    system("head -c 65536 /dev/zero >> /data/local/tmp/user/0/d3/a/b/file");
+    system("mkdir /data/local/tmp/user/0/d4/c/new");
+    expected = fts_tree_size("/data/local/tmp/user/0");
+    size = 0;
+    ASSERT_EQ(0, calculate_tree_size("/data/local/tmp/user/0", &size));
+    EXPECT_EQ(expected, size);
+
+    size = 0;
+    ASSERT_EQ(0, calculate_tree_size("/data/local/tmp/user/0/missing", &size));
+    EXPECT_EQ(0, size);
+}
+
 TEST_F(UtilsTest, TestSdkSandboxDataPaths) {
     // Ce data paths
     EXPECT_EQ("/data/misc_ce/0/sdksandbox",
@@ -118,7 +118,30 @@ Access::CallingContext Access::getCallingContext() {
 }
 
 bool Access::canFind(const CallingContext& ctx,const std::string& name) {
-    return actionAllowedFromLookup(ctx, name, "find");
+    invalidateFindCacheIfPolicyChanged();
+
+    auto sidIt = mAllowedFinds.find(ctx.sid);
+    if (sidIt != mAllowedFinds.end() && sidIt->second.count(name) > 0) {
+        return true;
+    }
+
+    if (!actionAllowedFromLookup(ctx, name, "find")) {
+        return false;
+    }
+
+    if (mAllowedFindCount >= kMaxCachedFinds) {
+        // Clients look up a small, stable set of services, so simply starting
+        // over is enough to bound the cache.
+        mAllowedFinds.clear();
+        mAllowedFindCount = 0;
+        sidIt = mAllowedFinds.end();
+    }
+    if (sidIt == mAllowedFinds.end()) {
+        sidIt = mAllowedFinds.emplace(ctx.sid, StringSet()).first;
+    }
+    sidIt->second.insert(name);
+    mAllowedFindCount++;
+    return true;
 }
 
 bool Access::canAdd(const CallingContext& ctx, const std::string& name) {
@@ -129,6 +152,21 @@ bool Access::canList(const CallingContext& ctx) {
     return actionAllowed(ctx, mThisProcessContext, "list", "service_manager");
 }
 
+void Access::invalidateFindCacheIfPolicyChanged() {
+#ifdef __ANDROID__
+    // Both are read from the mapped selinux status page, without a syscall.
+    int seqno = selinux_status_policyload();
+    int enforcing = selinux_status_getenforce();
+    if (seqno == mPolicyLoadSeqno && enforcing == mEnforcing) {
+        return;
+    }
+    mPolicyLoadSeqno = seqno;
+    mEnforcing = enforcing;
+    mAllowedFinds.clear();
+    mAllowedFindCount = 0;
+#endif
+}
+
 bool Access::actionAllowed(const CallingContext& sctx, const char* tctx, const char* perm,
         const std::string& tname) {
 #ifdef __ANDROID__
@@ -19,6 +19,8 @@
 #include <string>
 #include <sys/types.h>
 
+#include "StringHash.h"
+
 namespace android {
 
 // singleton
@@ -45,12 +47,29 @@ public:
     virtual bool canList(const CallingContext& ctx);
 
 private:
+    // Upper bound on the number of (sid, name) pairs remembered by canFind.
+    static constexpr size_t kMaxCachedFinds = 4096;
+
+    // Drops the cached decisions if the policy was reloaded or the enforcing
+    // mode changed since they were made.
+    void invalidateFindCacheIfPolicyChanged();
+
     bool actionAllowed(const CallingContext& sctx, const char* tctx, const char* perm,
             const std::string& tname);
     bool actionAllowedFromLookup(const CallingContext& sctx, const std::string& name,
             const char *perm);
 
     char* mThisProcessContext = nullptr;
+
+    // Calling sid -> names of the services it was allowed to find. Only allowed
+    // lookups are cached, so every denial still goes through (and is audited
+    // by) selinux_check_access. Not thread-safe, like ServiceManager itself.
+    StringMap<StringSet> mAllowedFinds;
+    size_t mAllowedFindCount = 0;
+#ifdef __ANDROID__
+    int mPolicyLoadSeqno = -1;
+    int mEnforcing = -1;
+#endif
 };
 
 };
@@ -21,6 +21,7 @@
 #include <android/os/IServiceCallback.h>
 
 #include "Access.h"
+#include "StringHash.h"
 
 namespace android {
 
@@ -86,7 +87,9 @@ private:
 
     using ServiceCallbackMap = std::map<std::string, std::vector<sp<IServiceCallback>>>;
     using ClientCallbackMap = std::map<std::string, std::vector<sp<IClientCallback>>>;
-    using ServiceMap = std::map<std::string, Service>;
+    // Looked up on every getService/checkService call; iteration order is not
+    // meaningful, callers listing services sort the names themselves.
+    using ServiceMap = StringMap<Service>;
 
     // removes a callback from mNameToRegistrationCallback, removing it if the vector is empty
     // this updates iterator to the next location
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace android {
+
+// Hashes std::string, std::string_view and const char* the same way, so that
+// the containers below can be searched without building a std::string key.
+struct StringHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+    size_t operator()(const std::string& str) const { return (*this)(std::string_view(str)); }
+    size_t operator()(const char* str) const { return (*this)(std::string_view(str)); }
+};
+
+template <typename T>
+using StringMap = std::unordered_map<std::string, T, StringHash, std::equal_to<>>;
+
+using StringSet = std::unordered_set<std::string, StringHash, std::equal_to<>>;
+
+}  // namespace android
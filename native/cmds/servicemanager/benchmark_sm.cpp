@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+#include <binder/Binder.h>
+#include <binder/IServiceManager.h>
+
+#include <mutex>
+
+#include "Access.h"
+#include "ServiceManager.h"
+
+// Usage: atest servicemanager_benchmark
+//
+// Measures getService/checkService lookups per second, going through the real
+// Access checks. Binder calls into servicemanager are handled by a single
+// looper thread, so concurrent clients are modeled by threads serialized on a
+// lock around the ServiceManager.
+
+using android::Access;
+using android::BBinder;
+using android::IBinder;
+using android::ServiceManager;
+using android::sp;
+using android::base::StringPrintf;
+using android::os::IServiceManager;
+
+static constexpr size_t kServiceCount = 256;
+
+static std::mutex gLooperLock;
+static sp<ServiceManager> gServiceManager;
+
+static void SetUp(const benchmark::State& state) {
+    if (state.thread_index() != 0) return;
+
+    std::lock_guard<std::mutex> lock(gLooperLock);
+    gServiceManager = sp<ServiceManager>::make(std::make_unique<Access>());
+    for (size_t i = 0; i < kServiceCount; i++) {
+        gServiceManager->addService(StringPrintf("benchmark.service%zu", i),
+                                    sp<BBinder>::make(), false /*allowIsolated*/,
+                                    IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT);
+    }
+}
+
+static void TearDown(const benchmark::State& state) {
+    if (state.thread_index() != 0) return;
+
+    std::lock_guard<std::mutex> lock(gLooperLock);
+    gServiceManager->clear();
+    gServiceManager = nullptr;
+}
+
+static void BM_CheckService(benchmark::State& state) {
+    std::vector<std::string> names;
+    for (size_t i = 0; i < kServiceCount; i++) {
+        names.push_back(StringPrintf("benchmark.service%zu", i));
+    }
+
+    size_t i = state.thread_index();
+    size_t found = 0;
+    for (auto _ : state) {
+        sp<IBinder> binder;
+        {
+            std::lock_guard<std::mutex> lock(gLooperLock);
+            gServiceManager->checkService(names[i++ % kServiceCount], &binder);
+        }
+        found += binder != nullptr;
+    }
+    if (found == 0) {
+        state.SkipWithError("no service found, was addService denied?");
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CheckService)->Setup(SetUp)->Teardown(TearDown)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_CheckMissingService(benchmark::State& state) {
+    const std::string name = "benchmark.missing_service";
+    for (auto _ : state) {
+        sp<IBinder> binder;
+        std::lock_guard<std::mutex> lock(gLooperLock);
+        gServiceManager->checkService(name, &binder);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CheckMissingService)
+        ->Setup(SetUp)
+        ->Teardown(TearDown)
+        ->ThreadRange(1, 8)
+        ->UseRealTime();
+
+BENCHMARK_MAIN();
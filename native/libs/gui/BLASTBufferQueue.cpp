@@ -110,9 +110,9 @@ void BLASTBufferItemConsumer::updateFrameTimestamps(uint64_t frameNumber, nsecs_
     // if the producer is not connected, don't bother updating,
     // the next producer that connects won't access this frame event
     if (!mCurrentlyConnected) return;
-    std::shared_ptr<FenceTime> glDoneFenceTime = std::make_shared<FenceTime>(glDoneFence);
-    std::shared_ptr<FenceTime> presentFenceTime = std::make_shared<FenceTime>(presentFence);
-    std::shared_ptr<FenceTime> releaseFenceTime = std::make_shared<FenceTime>(prevReleaseFence);
+    std::shared_ptr<FenceTime> glDoneFenceTime = FenceTime::create(glDoneFence);
+    std::shared_ptr<FenceTime> presentFenceTime = FenceTime::create(presentFence);
+    std::shared_ptr<FenceTime> releaseFenceTime = FenceTime::create(prevReleaseFence);
 
     mFrameEventHistory.addLatch(frameNumber, latchTime);
     mFrameEventHistory.addRelease(frameNumber, dequeueReadyTime, std::move(releaseFenceTime));
@@ -337,6 +337,7 @@ void BLASTBufferQueue::transactionCallback(nsecs_t /*latchTime*/, const sp<Fence
                                            const std::vector<SurfaceControlStats>& stats) {
     {
         std::lock_guard _lock{mMutex};
+        deferReleasesLocked();
         BBQ_TRACE();
         BQA_LOGV("transactionCallback");
 
@@ -364,13 +365,15 @@ void BLASTBufferQueue::transactionCallback(nsecs_t /*latchTime*/, const sp<Fence
                                                     stat.frameEventStats.dequeueReadyTime);
                 }
                 auto currFrameNumber = stat.frameEventStats.frameNumber;
-                std::vector<ReleaseCallbackId> staleReleases;
-                for (const auto& [key, value]: mSubmitted) {
-                    if (currFrameNumber > key.framenumber) {
-                        staleReleases.push_back(key);
+                std::array<ReleaseCallbackId, BufferQueueDefs::NUM_BUFFER_SLOTS> staleReleases;
+                size_t numStaleReleases = 0;
+                mSubmitted.forEach([&](const ReleaseCallbackId& id, const BufferItem&) {
+                    if (currFrameNumber > id.framenumber) {
+                        staleReleases[numStaleReleases++] = id;
                     }
-                }
-                for (const auto& staleRelease : staleReleases) {
+                });
+                for (size_t i = 0; i < numStaleReleases; i++) {
+                    const ReleaseCallbackId& staleRelease = staleReleases[i];
                     releaseBufferCallbackLocked(staleRelease,
                                                 stat.previousReleaseFence
                                                         ? stat.previousReleaseFence
@@ -386,6 +389,7 @@ void BLASTBufferQueue::transactionCallback(nsecs_t /*latchTime*/, const sp<Fence
                      "empty.");
         }
 
+        drainReleaseQueueLocked();
         decStrong((void*)transactionCallbackThunk);
     }
 }
@@ -417,12 +421,81 @@ void BLASTBufferQueue::flushShadowQueue() {
 void BLASTBufferQueue::releaseBufferCallback(
         const ReleaseCallbackId& id, const sp<Fence>& releaseFence,
         std::optional<uint32_t> currentMaxAcquiredBufferCount) {
+    if (mReleaseQueue.push({id, releaseFence, currentMaxAcquiredBufferCount})) {
+        // Pairs with the fence in drainReleaseQueueLocked(): either the holder of mMutex sees the
+        // release we just queued, or we see that it no longer defers releases.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::unique_lock lock{mMutex, std::try_to_lock};
+        if (!lock.owns_lock()) {
+            if (mDeferReleases.load(std::memory_order_relaxed)) {
+                // The holder processes the release before it lets go of mMutex.
+                return;
+            }
+            lock.lock();
+        }
+        base::ScopedLockAssertion assumeLocked(mMutex);
+        BBQ_TRACE();
+        drainReleaseQueueLocked();
+        return;
+    }
+
+    // The queue only fills up if the releases outnumber the buffers, process this one directly.
     std::lock_guard _lock{mMutex};
     BBQ_TRACE();
+    drainReleaseQueueLocked();
     releaseBufferCallbackLocked(id, releaseFence, currentMaxAcquiredBufferCount,
                                 false /* fakeRelease */);
 }
 
+bool BLASTBufferQueue::ReleaseQueue::push(QueuedRelease release) {
+    std::lock_guard _lock{mPushMutex};
+    const size_t head = mHead.load(std::memory_order_relaxed);
+    if (head - mTail.load(std::memory_order_acquire) == kSize) {
+        return false;
+    }
+    mReleases[head % kSize] = std::move(release);
+    mHead.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool BLASTBufferQueue::ReleaseQueue::pop(QueuedRelease* outRelease) {
+    const size_t tail = mTail.load(std::memory_order_relaxed);
+    if (tail == mHead.load(std::memory_order_acquire)) {
+        return false;
+    }
+    // Move the release out so that the queue doesn't keep its fence alive.
+    *outRelease = std::move(mReleases[tail % kSize]);
+    mTail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+void BLASTBufferQueue::deferReleasesLocked() {
+    mDeferReleases.store(true, std::memory_order_relaxed);
+}
+
+bool BLASTBufferQueue::drainReleaseQueueLocked() {
+    mDeferReleases.store(false, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    bool drained = false;
+    QueuedRelease release;
+    while (mReleaseQueue.pop(&release)) {
+        releaseBufferCallbackLocked(release.id, release.releaseFence,
+                                    release.currentMaxAcquiredBufferCount,
+                                    false /* fakeRelease */);
+        drained = true;
+    }
+    return drained;
+}
+
+void BLASTBufferQueue::waitForReleaseLocked(std::unique_lock<std::mutex>& lock) {
+    // The release being waited for may have been queued while we held mMutex.
+    if (!drainReleaseQueueLocked()) {
+        mCallbackCV.wait(lock);
+    }
+    deferReleasesLocked();
+}
+
 void BLASTBufferQueue::releaseBufferCallbackLocked(
         const ReleaseCallbackId& id, const sp<Fence>& releaseFence,
         std::optional<uint32_t> currentMaxAcquiredBufferCount, bool fakeRelease) {
@@ -433,8 +506,8 @@ void BLASTBufferQueue::releaseBufferCallbackLocked(
     // to the buffer queue. This will prevent higher latency when we are running
     // on a lower refresh rate than the max supported. We only do that for EGL
     // clients as others don't care about latency
-    const auto it = mSubmitted.find(id);
-    const bool isEGL = it != mSubmitted.end() && it->second.mApi == NATIVE_WINDOW_API_EGL;
+    const int index = mSubmitted.find(id);
+    const bool isEGL = index >= 0 && mSubmitted.get(index).mApi == NATIVE_WINDOW_API_EGL;
 
     if (currentMaxAcquiredBufferCount) {
         mCurrentMaxAcquiredBufferCount = *currentMaxAcquiredBufferCount;
@@ -473,10 +546,34 @@ void BLASTBufferQueue::releaseBufferCallbackLocked(
     mCallbackCV.notify_all();
 }
 
+void BLASTBufferQueue::SubmittedBuffers::add(const ReleaseCallbackId& id, const BufferItem& item) {
+    LOG_ALWAYS_FATAL_IF(size() == mIds.size(), "BLASTBufferQueue: too many submitted buffers");
+    const int index = __builtin_ctzll(~mUsedEntries);
+    mIds[index] = id;
+    mItems[index] = item;
+    mUsedEntries |= 1ULL << index;
+}
+
+int BLASTBufferQueue::SubmittedBuffers::find(const ReleaseCallbackId& id) const {
+    for (uint64_t entries = mUsedEntries; entries != 0; entries &= entries - 1) {
+        const int index = __builtin_ctzll(entries);
+        if (mIds[index] == id) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+void BLASTBufferQueue::SubmittedBuffers::remove(int index) {
+    mUsedEntries &= ~(1ULL << index);
+    // Drop the references to the buffer and its fence now rather than when the entry is reused.
+    mItems[index] = BufferItem();
+}
+
 void BLASTBufferQueue::releaseBuffer(const ReleaseCallbackId& callbackId,
                                      const sp<Fence>& releaseFence) {
-    auto it = mSubmitted.find(callbackId);
-    if (it == mSubmitted.end()) {
+    const int index = mSubmitted.find(callbackId);
+    if (index < 0) {
         BQA_LOGE("ERROR: releaseBufferCallback without corresponding submitted buffer %s",
                  callbackId.to_string().c_str());
         return;
@@ -484,8 +581,8 @@ void BLASTBufferQueue::releaseBuffer(const ReleaseCallbackId& callbackId,
     mNumAcquired--;
     BBQ_TRACE("frame=%" PRIu64, callbackId.framenumber);
     BQA_LOGV("released %s", callbackId.to_string().c_str());
-    mBufferItemConsumer->releaseBuffer(it->second, releaseFence);
-    mSubmitted.erase(it);
+    mBufferItemConsumer->releaseBuffer(mSubmitted.get(index), releaseFence);
+    mSubmitted.remove(index);
     // Remove the frame number from mSyncedFrameNumbers since we can get a release callback
     // without getting a transaction committed if the buffer was dropped.
     mSyncedFrameNumbers.erase(callbackId.framenumber);
@@ -524,9 +621,8 @@ status_t BLASTBufferQueue::acquireNextBufferLocked(
         return NAME_NOT_FOUND;
     }
 
-    SurfaceComposerClient::Transaction localTransaction;
     bool applyTransaction = true;
-    SurfaceComposerClient::Transaction* t = &localTransaction;
+    SurfaceComposerClient::Transaction* t = &mBufferTransaction;
     if (transaction) {
         t = *transaction;
         applyTransaction = false;
@@ -566,7 +662,7 @@ status_t BLASTBufferQueue::acquireNextBufferLocked(
     mNumAcquired++;
     mLastAcquiredFrameNumber = bufferItem.mFrameNumber;
     ReleaseCallbackId releaseCallbackId(buffer->getId(), mLastAcquiredFrameNumber);
-    mSubmitted[releaseCallbackId] = bufferItem;
+    mSubmitted.add(releaseCallbackId, bufferItem);
 
     bool needsDisconnect = false;
     mBufferItemConsumer->getConnectionEvents(bufferItem.mFrameNumber, &needsDisconnect);
@@ -654,7 +750,11 @@ status_t BLASTBufferQueue::acquireNextBufferLocked(
     mergePendingTransactions(t, bufferItem.mFrameNumber);
     if (applyTransaction) {
         // All transactions on our apply token are one-way. See comment on mAppliedLastTransaction
-        t->setApplyToken(mApplyToken).apply(false, true);
+        if (t->setApplyToken(mApplyToken).apply(false, true) != NO_ERROR) {
+            // The transaction is only cleared once it has been sent, don't carry it over to the
+            // next buffer.
+            t->clear();
+        }
         mAppliedLastTransaction = true;
         mLastAppliedFrameNumber = bufferItem.mFrameNumber;
     } else {
@@ -699,6 +799,7 @@ void BLASTBufferQueue::onFrameAvailable(const BufferItem& item) {
 
     {
         UNIQUE_LOCK_WITH_ASSERTION(mMutex);
+        deferReleasesLocked();
         BBQ_TRACE();
         bool waitForTransactionCallback = !mSyncedFrameNumbers.empty();
 
@@ -737,7 +838,7 @@ void BLASTBufferQueue::onFrameAvailable(const BufferItem& item) {
                 // need to flush the buffers before proceeding with the sync.
                 while (mNumFrameAvailable > 0) {
                     BQA_LOGD("waiting until no queued buffers");
-                    mCallbackCV.wait(_lock);
+                    waitForReleaseLocked(_lock);
                 }
             }
         }
@@ -763,7 +864,7 @@ void BLASTBufferQueue::onFrameAvailable(const BufferItem& item) {
             // instead of returning since we guarantee a buffer will be acquired for the sync.
             while (acquireNextBufferLocked(mSyncTransaction) == BufferQueue::NO_BUFFER_AVAILABLE) {
                 BQA_LOGD("waiting for available buffer");
-                mCallbackCV.wait(_lock);
+                waitForReleaseLocked(_lock);
             }
 
             // Only need a commit callback when syncing to ensure the buffer that's synced has been
@@ -780,6 +881,7 @@ void BLASTBufferQueue::onFrameAvailable(const BufferItem& item) {
         } else if (!waitForTransactionCallback) {
             acquireNextBufferLocked(std::nullopt);
         }
+        drainReleaseQueueLocked();
     }
     if (prevCallback) {
         prevCallback(prevTransaction);
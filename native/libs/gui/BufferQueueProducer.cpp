@@ -68,6 +68,38 @@ namespace android {
           ##__VA_ARGS__)
 
 static constexpr uint32_t BQ_LAYER_COUNT = 1;
+
+// A slot picked by dequeueBufferLocked, with everything that is needed to finish the dequeue
+// once mCore->mMutex has been dropped.
+struct BufferQueueProducer::DequeuedBuffer {
+    int slot = BufferQueueCore::INVALID_BUFFER_SLOT;
+    // The dequeue flags such as BUFFER_NEEDS_REALLOCATION, or an error
+    status_t result = NO_ERROR;
+    sp<Fence> fence = Fence::NO_FENCE;
+    uint64_t bufferAge = 0;
+    bool attachedByConsumer = false;
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+    EGLSyncKHR eglFence = EGL_NO_SYNC_KHR;
+
+    // The attributes a new buffer is allocated with, and the buffer itself until it is
+    // installed in the slot
+    uint32_t width = 0;
+    uint32_t height = 0;
+    PixelFormat format = 0;
+    uint64_t usage = 0;
+    sp<GraphicBuffer> graphicBuffer;
+};
+
+// A frame going through queueBuffer, from its validated input to the consumer callbacks.
+struct BufferQueueProducer::QueuedFrame {
+    BufferItem item;
+    uint32_t transform = 0;
+    uint32_t stickyTransform = 0;
+    bool getFrameTimestamps = false;
+    bool queued = false;
+    sp<IConsumerListener> frameAvailableListener;
+    sp<IConsumerListener> frameReplacedListener;
+};
 ProducerListener::~ProducerListener() = default;
 
 BufferQueueProducer::BufferQueueProducer(const sp<BufferQueueCore>& core,
@@ -92,7 +124,23 @@ status_t BufferQueueProducer::requestBuffer(int slot, sp<GraphicBuffer>* buf) {
     ATRACE_CALL();
     BQ_LOGV("requestBuffer: slot %d", slot);
     std::lock_guard<std::mutex> lock(mCore->mMutex);
+    return requestBufferLocked(slot, buf);
+}
+
+status_t BufferQueueProducer::requestBuffers(const std::vector<int32_t>& slots,
+                                             std::vector<RequestBufferOutput>* outputs) {
+    ATRACE_CALL();
+    outputs->clear();
+    outputs->reserve(slots.size());
+    std::lock_guard<std::mutex> lock(mCore->mMutex);
+    for (int32_t slot : slots) {
+        RequestBufferOutput& output = outputs->emplace_back();
+        output.result = requestBufferLocked(static_cast<int>(slot), &output.buffer);
+    }
+    return NO_ERROR;
+}
 
+status_t BufferQueueProducer::requestBufferLocked(int slot, sp<GraphicBuffer>* buf) {
     if (mCore->mIsAbandoned) {
         BQ_LOGE("requestBuffer: BufferQueue has been abandoned");
         return NO_INIT;
@@ -413,207 +461,330 @@ status_t BufferQueueProducer::dequeueBuffer(int* outSlot, sp<android::Fence>* ou
         return BAD_VALUE;
     }
 
-    status_t returnFlags = NO_ERROR;
-    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
-    EGLSyncKHR eglFence = EGL_NO_SYNC_KHR;
-    bool attachedByConsumer = false;
-
+    DequeuedBuffer buffer;
     { // Autolock scope
         std::unique_lock<std::mutex> lock(mCore->mMutex);
-
-        // If we don't have a free buffer, but we are currently allocating, we wait until allocation
-        // is finished such that we don't allocate in parallel.
-        if (mCore->mFreeBuffers.empty() && mCore->mIsAllocating) {
-            mDequeueWaitingForAllocation = true;
-            mCore->waitWhileAllocatingLocked(lock);
-            mDequeueWaitingForAllocation = false;
-            mDequeueWaitingForAllocationCondition.notify_all();
+        status_t status = dequeueBufferLocked(lock, width, height, format, usage,
+                                              /*waitForAllocation*/ true, &buffer);
+        if (status != NO_ERROR) {
+            return status;
         }
+    } // Autolock scope
 
-        if (format == 0) {
-            format = mCore->mDefaultBufferFormat;
-        }
+    allocateDequeuedBuffers(&buffer, 1);
 
-        // Enable the usage bits the consumer requested
-        usage |= mCore->mConsumerUsageBits;
+    *outSlot = buffer.slot;
+    if (buffer.result < 0) {
+        return buffer.result;
+    }
 
-        const bool useDefaultSize = !width && !height;
-        if (useDefaultSize) {
-            width = mCore->mDefaultWidth;
-            height = mCore->mDefaultHeight;
-            if (mCore->mAutoPrerotation &&
-                (mCore->mTransformHintInUse & NATIVE_WINDOW_TRANSFORM_ROT_90)) {
-                std::swap(width, height);
-            }
-        }
+    finishDequeue(&buffer);
 
-        int found = BufferItem::INVALID_BUFFER_SLOT;
-        while (found == BufferItem::INVALID_BUFFER_SLOT) {
-            status_t status = waitForFreeSlotThenRelock(FreeSlotCaller::Dequeue, lock, &found);
-            if (status != NO_ERROR) {
-                return status;
+    *outFence = buffer.fence;
+    if (outBufferAge) {
+        *outBufferAge = buffer.bufferAge;
+    }
+    addAndGetFrameTimestamps(nullptr, outTimestamps);
+
+    return buffer.result;
+}
+
+status_t BufferQueueProducer::dequeueBuffers(const std::vector<DequeueBufferInput>& inputs,
+                                             std::vector<DequeueBufferOutput>* outputs) {
+    ATRACE_CALL();
+    std::vector<DequeuedBuffer> buffers(inputs.size());
+
+    { // Autolock scope
+        std::unique_lock<std::mutex> lock(mCore->mMutex);
+        mConsumerName = mCore->mConsumerName;
+
+        // Once a buffer of the batch needs to be allocated, mCore->mIsAllocating stays set until
+        // allocateDequeuedBuffers installs it, so the following ones must not wait for it.
+        bool allocating = false;
+        for (size_t i = 0; i < inputs.size(); i++) {
+            const DequeueBufferInput& input = inputs[i];
+            DequeuedBuffer& buffer = buffers[i];
+
+            if (mCore->mIsAbandoned) {
+                BQ_LOGE("dequeueBuffers: BufferQueue has been abandoned");
+                buffer.result = NO_INIT;
+                continue;
             }
 
-            // This should not happen
-            if (found == BufferQueueCore::INVALID_BUFFER_SLOT) {
-                BQ_LOGE("dequeueBuffer: no available buffer slots");
-                return -EBUSY;
+            if (mCore->mConnectedApi == BufferQueueCore::NO_CONNECTED_API) {
+                BQ_LOGE("dequeueBuffers: BufferQueue has no connected producer");
+                buffer.result = NO_INIT;
+                continue;
             }
 
-            const sp<GraphicBuffer>& buffer(mSlots[found].mGraphicBuffer);
+            BQ_LOGV("dequeueBuffers: w=%u h=%u format=%#x, usage=%#" PRIx64, input.width,
+                    input.height, input.format, input.usage);
 
-            // If we are not allowed to allocate new buffers,
-            // waitForFreeSlotThenRelock must have returned a slot containing a
-            // buffer. If this buffer would require reallocation to meet the
-            // requested attributes, we free it and attempt to get another one.
-            if (!mCore->mAllowAllocation) {
-                if (buffer->needsReallocation(width, height, format, BQ_LAYER_COUNT, usage)) {
-                    if (mCore->mSharedBufferSlot == found) {
-                        BQ_LOGE("dequeueBuffer: cannot re-allocate a sharedbuffer");
-                        return BAD_VALUE;
-                    }
-                    mCore->mFreeSlots.insert(found);
-                    mCore->clearBufferSlotLocked(found);
-                    found = BufferItem::INVALID_BUFFER_SLOT;
-                    continue;
-                }
+            if ((input.width && !input.height) || (!input.width && input.height)) {
+                BQ_LOGE("dequeueBuffers: invalid size: w=%u h=%u", input.width, input.height);
+                buffer.result = BAD_VALUE;
+                continue;
+            }
+
+            status_t status = dequeueBufferLocked(lock, input.width, input.height, input.format,
+                                                  input.usage, !allocating, &buffer);
+            if (status != NO_ERROR) {
+                buffer.result = status;
+                continue;
             }
+            allocating |= (buffer.result & BUFFER_NEEDS_REALLOCATION) != 0;
         }
+    } // Autolock scope
 
-        const sp<GraphicBuffer>& buffer(mSlots[found].mGraphicBuffer);
-        if (mCore->mSharedBufferSlot == found &&
-                buffer->needsReallocation(width, height, format, BQ_LAYER_COUNT, usage)) {
-            BQ_LOGE("dequeueBuffer: cannot re-allocate a shared"
-                    "buffer");
+    allocateDequeuedBuffers(buffers.data(), buffers.size());
 
-            return BAD_VALUE;
+    outputs->clear();
+    outputs->resize(inputs.size());
+    DequeueBufferOutput* lastTimestampsOutput = nullptr;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        DequeuedBuffer& buffer = buffers[i];
+        DequeueBufferOutput& output = (*outputs)[i];
+        if (buffer.result >= 0) {
+            finishDequeue(&buffer);
         }
-
-        if (mCore->mSharedBufferSlot != found) {
-            mCore->mActiveBuffers.insert(found);
+        output.result = buffer.result;
+        output.slot = buffer.slot;
+        output.fence = buffer.fence;
+        output.bufferAge = buffer.bufferAge;
+        if (inputs[i].getTimestamps) {
+            output.timestamps.emplace();
+            lastTimestampsOutput = &output;
         }
-        *outSlot = found;
-        ATRACE_BUFFER_INDEX(found);
+    }
 
-        attachedByConsumer = mSlots[found].mNeedsReallocation;
-        mSlots[found].mNeedsReallocation = false;
+    // The deltas are applied in order by the producer, so one covering the whole batch is enough.
+    if (lastTimestampsOutput != nullptr) {
+        addAndGetFrameTimestamps(nullptr, &*lastTimestampsOutput->timestamps);
+    }
 
-        mSlots[found].mBufferState.dequeue();
+    return NO_ERROR;
+}
 
-        if ((buffer == nullptr) ||
-                buffer->needsReallocation(width, height, format, BQ_LAYER_COUNT, usage))
-        {
-            if (CC_UNLIKELY(ATRACE_ENABLED())) {
-                if (buffer == nullptr) {
-                    ATRACE_FORMAT_INSTANT("%s buffer reallocation: null", mConsumerName.string());
-                } else {
-                    ATRACE_FORMAT_INSTANT("%s buffer reallocation actual %dx%d format:%d "
-                                          "layerCount:%d "
-                                          "usage:%d requested: %dx%d format:%d layerCount:%d "
-                                          "usage:%d ",
-                                          mConsumerName.string(), width, height, format,
-                                          BQ_LAYER_COUNT, usage, buffer->getWidth(),
-                                          buffer->getHeight(), buffer->getPixelFormat(),
-                                          buffer->getLayerCount(), buffer->getUsage());
-                }
-            }
-            mSlots[found].mAcquireCalled = false;
-            mSlots[found].mGraphicBuffer = nullptr;
-            mSlots[found].mRequestBufferCalled = false;
-            mSlots[found].mEglDisplay = EGL_NO_DISPLAY;
-            mSlots[found].mEglFence = EGL_NO_SYNC_KHR;
-            mSlots[found].mFence = Fence::NO_FENCE;
-            mCore->mBufferAge = 0;
-            mCore->mIsAllocating = true;
+status_t BufferQueueProducer::dequeueBufferLocked(std::unique_lock<std::mutex>& lock,
+                                                  uint32_t width, uint32_t height,
+                                                  PixelFormat format, uint64_t usage,
+                                                  bool waitForAllocation,
+                                                  DequeuedBuffer* outBuffer) {
+    // If we don't have a free buffer, but we are currently allocating, we wait until allocation
+    // is finished such that we don't allocate in parallel.
+    if (waitForAllocation && mCore->mFreeBuffers.empty() && mCore->mIsAllocating) {
+        mDequeueWaitingForAllocation = true;
+        mCore->waitWhileAllocatingLocked(lock);
+        mDequeueWaitingForAllocation = false;
+        mDequeueWaitingForAllocationCondition.notify_all();
+    }
 
-            returnFlags |= BUFFER_NEEDS_REALLOCATION;
-        } else {
-            // We add 1 because that will be the frame number when this buffer
-            // is queued
-            mCore->mBufferAge = mCore->mFrameCounter + 1 - mSlots[found].mFrameNumber;
-        }
+    if (format == 0) {
+        format = mCore->mDefaultBufferFormat;
+    }
 
-        BQ_LOGV("dequeueBuffer: setting buffer age to %" PRIu64,
-                mCore->mBufferAge);
+    // Enable the usage bits the consumer requested
+    usage |= mCore->mConsumerUsageBits;
 
-        if (CC_UNLIKELY(mSlots[found].mFence == nullptr)) {
-            BQ_LOGE("dequeueBuffer: about to return a NULL fence - "
-                    "slot=%d w=%d h=%d format=%u",
-                    found, buffer->width, buffer->height, buffer->format);
+    const bool useDefaultSize = !width && !height;
+    if (useDefaultSize) {
+        width = mCore->mDefaultWidth;
+        height = mCore->mDefaultHeight;
+        if (mCore->mAutoPrerotation &&
+            (mCore->mTransformHintInUse & NATIVE_WINDOW_TRANSFORM_ROT_90)) {
+            std::swap(width, height);
         }
+    }
 
-        eglDisplay = mSlots[found].mEglDisplay;
-        eglFence = mSlots[found].mEglFence;
-        // Don't return a fence in shared buffer mode, except for the first
-        // frame.
-        *outFence = (mCore->mSharedBufferMode &&
-                mCore->mSharedBufferSlot == found) ?
-                Fence::NO_FENCE : mSlots[found].mFence;
-        mSlots[found].mEglFence = EGL_NO_SYNC_KHR;
-        mSlots[found].mFence = Fence::NO_FENCE;
+    int found = BufferItem::INVALID_BUFFER_SLOT;
+    while (found == BufferItem::INVALID_BUFFER_SLOT) {
+        status_t status = waitForFreeSlotThenRelock(FreeSlotCaller::Dequeue, lock, &found);
+        if (status != NO_ERROR) {
+            return status;
+        }
 
-        // If shared buffer mode has just been enabled, cache the slot of the
-        // first buffer that is dequeued and mark it as the shared buffer.
-        if (mCore->mSharedBufferMode && mCore->mSharedBufferSlot ==
-                BufferQueueCore::INVALID_BUFFER_SLOT) {
-            mCore->mSharedBufferSlot = found;
-            mSlots[found].mBufferState.mShared = true;
+        // This should not happen
+        if (found == BufferQueueCore::INVALID_BUFFER_SLOT) {
+            BQ_LOGE("dequeueBuffer: no available buffer slots");
+            return -EBUSY;
         }
 
-        if (!(returnFlags & BUFFER_NEEDS_REALLOCATION)) {
-            if (mCore->mConsumerListener != nullptr) {
-                mCore->mConsumerListener->onFrameDequeued(mSlots[*outSlot].mGraphicBuffer->getId());
+        const sp<GraphicBuffer>& buffer(mSlots[found].mGraphicBuffer);
+
+        // If we are not allowed to allocate new buffers,
+        // waitForFreeSlotThenRelock must have returned a slot containing a
+        // buffer. If this buffer would require reallocation to meet the
+        // requested attributes, we free it and attempt to get another one.
+        if (!mCore->mAllowAllocation) {
+            if (buffer->needsReallocation(width, height, format, BQ_LAYER_COUNT, usage)) {
+                if (mCore->mSharedBufferSlot == found) {
+                    BQ_LOGE("dequeueBuffer: cannot re-allocate a sharedbuffer");
+                    return BAD_VALUE;
+                }
+                mCore->mFreeSlots.insert(found);
+                mCore->clearBufferSlotLocked(found);
+                found = BufferItem::INVALID_BUFFER_SLOT;
+                continue;
             }
         }
-    } // Autolock scope
+    }
 
-    if (returnFlags & BUFFER_NEEDS_REALLOCATION) {
-        BQ_LOGV("dequeueBuffer: allocating a new buffer for slot %d", *outSlot);
-        sp<GraphicBuffer> graphicBuffer = new GraphicBuffer(
-                width, height, format, BQ_LAYER_COUNT, usage,
-                {mConsumerName.string(), mConsumerName.size()});
+    const sp<GraphicBuffer>& buffer(mSlots[found].mGraphicBuffer);
+    if (mCore->mSharedBufferSlot == found &&
+            buffer->needsReallocation(width, height, format, BQ_LAYER_COUNT, usage)) {
+        BQ_LOGE("dequeueBuffer: cannot re-allocate a shared"
+                "buffer");
 
-        status_t error = graphicBuffer->initCheck();
+        return BAD_VALUE;
+    }
 
-        { // Autolock scope
-            std::lock_guard<std::mutex> lock(mCore->mMutex);
-
-            if (error == NO_ERROR && !mCore->mIsAbandoned) {
-                graphicBuffer->setGenerationNumber(mCore->mGenerationNumber);
-                mSlots[*outSlot].mGraphicBuffer = graphicBuffer;
-                if (mCore->mConsumerListener != nullptr) {
-                    mCore->mConsumerListener->onFrameDequeued(
-                            mSlots[*outSlot].mGraphicBuffer->getId());
-                }
-            }
+    if (mCore->mSharedBufferSlot != found) {
+        mCore->mActiveBuffers.insert(found);
+    }
+    outBuffer->slot = found;
+    outBuffer->result = NO_ERROR;
+    outBuffer->width = width;
+    outBuffer->height = height;
+    outBuffer->format = format;
+    outBuffer->usage = usage;
+    ATRACE_BUFFER_INDEX(found);
 
-            mCore->mIsAllocating = false;
-            mCore->mIsAllocatingCondition.notify_all();
+    outBuffer->attachedByConsumer = mSlots[found].mNeedsReallocation;
+    mSlots[found].mNeedsReallocation = false;
 
-            if (error != NO_ERROR) {
-                mCore->mFreeSlots.insert(*outSlot);
-                mCore->clearBufferSlotLocked(*outSlot);
-                BQ_LOGE("dequeueBuffer: createGraphicBuffer failed");
-                return error;
+    mSlots[found].mBufferState.dequeue();
+
+    if ((buffer == nullptr) ||
+            buffer->needsReallocation(width, height, format, BQ_LAYER_COUNT, usage))
+    {
+        if (CC_UNLIKELY(ATRACE_ENABLED())) {
+            if (buffer == nullptr) {
+                ATRACE_FORMAT_INSTANT("%s buffer reallocation: null", mConsumerName.string());
+            } else {
+                ATRACE_FORMAT_INSTANT("%s buffer reallocation actual %dx%d format:%d "
+                                      "layerCount:%d "
+                                      "usage:%d requested: %dx%d format:%d layerCount:%d "
+                                      "usage:%d ",
+                                      mConsumerName.string(), width, height, format,
+                                      BQ_LAYER_COUNT, usage, buffer->getWidth(),
+                                      buffer->getHeight(), buffer->getPixelFormat(),
+                                      buffer->getLayerCount(), buffer->getUsage());
             }
+        }
+        mSlots[found].mAcquireCalled = false;
+        mSlots[found].mGraphicBuffer = nullptr;
+        mSlots[found].mRequestBufferCalled = false;
+        mSlots[found].mEglDisplay = EGL_NO_DISPLAY;
+        mSlots[found].mEglFence = EGL_NO_SYNC_KHR;
+        mSlots[found].mFence = Fence::NO_FENCE;
+        mCore->mBufferAge = 0;
+        mCore->mIsAllocating = true;
+
+        outBuffer->result |= BUFFER_NEEDS_REALLOCATION;
+    } else {
+        // We add 1 because that will be the frame number when this buffer
+        // is queued
+        mCore->mBufferAge = mCore->mFrameCounter + 1 - mSlots[found].mFrameNumber;
+    }
+    outBuffer->bufferAge = mCore->mBufferAge;
 
-            if (mCore->mIsAbandoned) {
-                mCore->mFreeSlots.insert(*outSlot);
-                mCore->clearBufferSlotLocked(*outSlot);
-                BQ_LOGE("dequeueBuffer: BufferQueue has been abandoned");
-                return NO_INIT;
+    BQ_LOGV("dequeueBuffer: setting buffer age to %" PRIu64,
+            mCore->mBufferAge);
+
+    if (CC_UNLIKELY(mSlots[found].mFence == nullptr)) {
+        BQ_LOGE("dequeueBuffer: about to return a NULL fence - "
+                "slot=%d w=%d h=%d format=%u",
+                found, buffer->width, buffer->height, buffer->format);
+    }
+
+    outBuffer->eglDisplay = mSlots[found].mEglDisplay;
+    outBuffer->eglFence = mSlots[found].mEglFence;
+    // Don't return a fence in shared buffer mode, except for the first
+    // frame.
+    outBuffer->fence = (mCore->mSharedBufferMode &&
+            mCore->mSharedBufferSlot == found) ?
+            Fence::NO_FENCE : mSlots[found].mFence;
+    mSlots[found].mEglFence = EGL_NO_SYNC_KHR;
+    mSlots[found].mFence = Fence::NO_FENCE;
+
+    // If shared buffer mode has just been enabled, cache the slot of the
+    // first buffer that is dequeued and mark it as the shared buffer.
+    if (mCore->mSharedBufferMode && mCore->mSharedBufferSlot ==
+            BufferQueueCore::INVALID_BUFFER_SLOT) {
+        mCore->mSharedBufferSlot = found;
+        mSlots[found].mBufferState.mShared = true;
+    }
+
+    if (!(outBuffer->result & BUFFER_NEEDS_REALLOCATION)) {
+        if (mCore->mConsumerListener != nullptr) {
+            mCore->mConsumerListener->onFrameDequeued(mSlots[found].mGraphicBuffer->getId());
+        }
+    }
+
+    return NO_ERROR;
+}
+
+void BufferQueueProducer::allocateDequeuedBuffers(DequeuedBuffer* buffers, size_t count) {
+    bool allocating = false;
+    for (size_t i = 0; i < count; i++) {
+        DequeuedBuffer& buffer = buffers[i];
+        if (buffer.result < 0 || !(buffer.result & BUFFER_NEEDS_REALLOCATION)) {
+            continue;
+        }
+        BQ_LOGV("dequeueBuffer: allocating a new buffer for slot %d", buffer.slot);
+        buffer.graphicBuffer = new GraphicBuffer(
+                buffer.width, buffer.height, buffer.format, BQ_LAYER_COUNT, buffer.usage,
+                {mConsumerName.string(), mConsumerName.size()});
+        allocating = true;
+    }
+
+    if (!allocating) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mCore->mMutex);
+    for (size_t i = 0; i < count; i++) {
+        DequeuedBuffer& buffer = buffers[i];
+        if (buffer.graphicBuffer == nullptr) {
+            continue;
+        }
+
+        status_t error = buffer.graphicBuffer->initCheck();
+        if (error == NO_ERROR && !mCore->mIsAbandoned) {
+            buffer.graphicBuffer->setGenerationNumber(mCore->mGenerationNumber);
+            mSlots[buffer.slot].mGraphicBuffer = std::move(buffer.graphicBuffer);
+            if (mCore->mConsumerListener != nullptr) {
+                mCore->mConsumerListener->onFrameDequeued(
+                        mSlots[buffer.slot].mGraphicBuffer->getId());
             }
+            continue;
+        }
 
-            VALIDATE_CONSISTENCY();
-        } // Autolock scope
+        mCore->mFreeSlots.insert(buffer.slot);
+        mCore->clearBufferSlotLocked(buffer.slot);
+        buffer.graphicBuffer.clear();
+        if (error != NO_ERROR) {
+            BQ_LOGE("dequeueBuffer: createGraphicBuffer failed");
+            buffer.result = error;
+        } else {
+            BQ_LOGE("dequeueBuffer: BufferQueue has been abandoned");
+            buffer.result = NO_INIT;
+        }
     }
 
-    if (attachedByConsumer) {
-        returnFlags |= BUFFER_NEEDS_REALLOCATION;
+    mCore->mIsAllocating = false;
+    mCore->mIsAllocatingCondition.notify_all();
+
+    VALIDATE_CONSISTENCY();
+}
+
+void BufferQueueProducer::finishDequeue(DequeuedBuffer* buffer) {
+    if (buffer->attachedByConsumer) {
+        buffer->result |= BUFFER_NEEDS_REALLOCATION;
     }
 
-    if (eglFence != EGL_NO_SYNC_KHR) {
-        EGLint result = eglClientWaitSyncKHR(eglDisplay, eglFence, 0,
+    if (buffer->eglFence != EGL_NO_SYNC_KHR) {
+        EGLint result = eglClientWaitSyncKHR(buffer->eglDisplay, buffer->eglFence, 0,
                 1000000000);
         // If something goes wrong, log the error, but return the buffer without
         // synchronizing access to it. It's too late at this point to abort the
@@ -624,20 +795,13 @@ status_t BufferQueueProducer::dequeueBuffer(int* outSlot, sp<android::Fence>* ou
         } else if (result == EGL_TIMEOUT_EXPIRED_KHR) {
             BQ_LOGE("dequeueBuffer: timeout waiting for fence");
         }
-        eglDestroySyncKHR(eglDisplay, eglFence);
+        eglDestroySyncKHR(buffer->eglDisplay, buffer->eglFence);
     }
 
     BQ_LOGV("dequeueBuffer: returning slot=%d/%" PRIu64 " buf=%p flags=%#x",
-            *outSlot,
-            mSlots[*outSlot].mFrameNumber,
-            mSlots[*outSlot].mGraphicBuffer->handle, returnFlags);
-
-    if (outBufferAge) {
-        *outBufferAge = mCore->mBufferAge;
-    }
-    addAndGetFrameTimestamps(nullptr, outTimestamps);
-
-    return returnFlags;
+            buffer->slot,
+            mSlots[buffer->slot].mFrameNumber,
+            mSlots[buffer->slot].mGraphicBuffer->handle, buffer->result);
 }
 
 status_t BufferQueueProducer::detachBuffer(int slot) {
@@ -833,28 +997,154 @@ status_t BufferQueueProducer::queueBuffer(int slot,
     ATRACE_CALL();
     ATRACE_BUFFER_INDEX(slot);
 
-    int64_t requestedPresentTimestamp;
+    QueuedFrame frame;
+    status_t status = prepareQueueBuffer(input, &frame);
+    if (status != NO_ERROR) {
+        return status;
+    }
+
+    int callbackTicket = 0;
+    { // Autolock scope
+        std::lock_guard<std::mutex> lock(mCore->mMutex);
+        status = queueBufferLocked(slot, &frame, output);
+        if (status != NO_ERROR) {
+            return status;
+        }
+        mCore->mDequeueCondition.notify_all();
+
+        // Take a ticket for the callback functions
+        callbackTicket = mNextCallbackTicket++;
+
+        VALIDATE_CONSISTENCY();
+    } // Autolock scope
+
+    // It is okay not to clear the GraphicBuffer when the consumer is SurfaceFlinger because
+    // it is guaranteed that the BufferQueue is inside SurfaceFlinger's process and
+    // there will be no Binder call
+    if (!mConsumerIsSurfaceFlinger) {
+        frame.item.mGraphicBuffer.clear();
+    }
+
+    // Update and get FrameEventHistory.
+    nsecs_t postedTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    NewFrameEventsEntry newFrameEventsEntry = {
+        frame.item.mFrameNumber,
+        postedTime,
+        frame.item.mTimestamp,
+        frame.item.mFenceTime
+    };
+    addAndGetFrameTimestamps(&newFrameEventsEntry,
+            frame.getFrameTimestamps ? &output->frameTimestamps : nullptr);
+
+    sp<Fence> lastQueuedFence = Fence::NO_FENCE;
+    int connectedApi = onFramesQueued(&frame, 1, callbackTicket, &lastQueuedFence);
+
+    // Wait without lock held
+    if (connectedApi == NATIVE_WINDOW_API_EGL) {
+        // Waiting here allows for two full buffers to be queued but not a
+        // third. In the event that frames take varying time, this makes a
+        // small trade-off in favor of latency rather than throughput.
+        lastQueuedFence->waitForever("Throttling EGL Production");
+    }
+
+    return NO_ERROR;
+}
+
+status_t BufferQueueProducer::queueBuffers(const std::vector<QueueBufferInput>& inputs,
+                                           std::vector<QueueBufferOutput>* outputs) {
+    ATRACE_CALL();
+    outputs->clear();
+    outputs->resize(inputs.size());
+    std::vector<QueuedFrame> frames(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++) {
+        (*outputs)[i].result = prepareQueueBuffer(inputs[i], &frames[i]);
+    }
+
+    bool queuedAny = false;
+    int callbackTicket = 0;
+    sp<IConsumerListener> listener;
+    { // Autolock scope
+        std::lock_guard<std::mutex> lock(mCore->mMutex);
+        for (size_t i = 0; i < inputs.size(); i++) {
+            QueueBufferOutput& output = (*outputs)[i];
+            if (output.result != NO_ERROR) {
+                continue;
+            }
+            ATRACE_BUFFER_INDEX(inputs[i].slot);
+            output.result = queueBufferLocked(inputs[i].slot, &frames[i], &output);
+            queuedAny |= output.result == NO_ERROR;
+        }
+
+        if (!queuedAny) {
+            return NO_ERROR;
+        }
+        mCore->mDequeueCondition.notify_all();
+
+        // A single ticket keeps the callbacks of the whole batch together and in order
+        callbackTicket = mNextCallbackTicket++;
+        listener = mCore->mConsumerListener;
+
+        VALIDATE_CONSISTENCY();
+    } // Autolock scope
+
+    // Only the last delta asked for is filled in, the producer applies them in order.
+    size_t lastTimestampsIndex = inputs.size();
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if ((*outputs)[i].result == NO_ERROR && frames[i].getFrameTimestamps) {
+            lastTimestampsIndex = i;
+        }
+    }
+
+    nsecs_t postedTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (size_t i = 0; i < inputs.size(); i++) {
+        QueuedFrame& frame = frames[i];
+        if ((*outputs)[i].result != NO_ERROR) {
+            continue;
+        }
+        if (!mConsumerIsSurfaceFlinger) {
+            frame.item.mGraphicBuffer.clear();
+        }
+        if (listener != nullptr) {
+            NewFrameEventsEntry newFrameEventsEntry = {
+                frame.item.mFrameNumber,
+                postedTime,
+                frame.item.mTimestamp,
+                frame.item.mFenceTime
+            };
+            listener->addAndGetFrameTimestamps(&newFrameEventsEntry,
+                    i == lastTimestampsIndex ? &(*outputs)[i].frameTimestamps : nullptr);
+        }
+    }
+
+    sp<Fence> lastQueuedFence = Fence::NO_FENCE;
+    int connectedApi = onFramesQueued(frames.data(), frames.size(), callbackTicket,
+                                      &lastQueuedFence);
+
+    // Wait without lock held, throttling on the buffer queued before the last one of the batch
+    if (connectedApi == NATIVE_WINDOW_API_EGL) {
+        lastQueuedFence->waitForever("Throttling EGL Production");
+    }
+
+    return NO_ERROR;
+}
+
+status_t BufferQueueProducer::prepareQueueBuffer(const QueueBufferInput& input,
+                                                 QueuedFrame* outFrame) {
     bool isAutoTimestamp;
     android_dataspace dataSpace;
     Rect crop(Rect::EMPTY_RECT);
     int scalingMode;
     uint32_t transform;
-    uint32_t stickyTransform;
     sp<Fence> acquireFence;
-    bool getFrameTimestamps = false;
-    input.deflate(&requestedPresentTimestamp, &isAutoTimestamp, &dataSpace,
-            &crop, &scalingMode, &transform, &acquireFence, &stickyTransform,
-            &getFrameTimestamps);
-    const Region& surfaceDamage = input.getSurfaceDamage();
-    const HdrMetadata& hdrMetadata = input.getHdrMetadata();
+    input.deflate(&outFrame->item.mTimestamp, &isAutoTimestamp, &dataSpace,
+            &crop, &scalingMode, &transform, &acquireFence, &outFrame->stickyTransform,
+            &outFrame->getFrameTimestamps);
 
     if (acquireFence == nullptr) {
         BQ_LOGE("queueBuffer: fence is NULL");
         return BAD_VALUE;
     }
 
-    auto acquireFenceTime = std::make_shared<FenceTime>(acquireFence);
-
     switch (scalingMode) {
         case NATIVE_WINDOW_SCALING_MODE_FREEZE:
         case NATIVE_WINDOW_SCALING_MODE_SCALE_TO_WINDOW:
@@ -866,239 +1156,211 @@ status_t BufferQueueProducer::queueBuffer(int slot,
             return BAD_VALUE;
     }
 
-    sp<IConsumerListener> frameAvailableListener;
-    sp<IConsumerListener> frameReplacedListener;
-    int callbackTicket = 0;
-    uint64_t currentFrameNumber = 0;
-    BufferItem item;
-    { // Autolock scope
-        std::lock_guard<std::mutex> lock(mCore->mMutex);
+    BufferItem& item = outFrame->item;
+    item.mCrop = crop;
+    item.mTransform = transform &
+            ~static_cast<uint32_t>(NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY);
+    item.mTransformToDisplayInverse =
+            (transform & NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY) != 0;
+    item.mScalingMode = static_cast<uint32_t>(scalingMode);
+    item.mIsAutoTimestamp = isAutoTimestamp;
+    item.mDataSpace = dataSpace;
+    item.mHdrMetadata = input.getHdrMetadata();
+    item.mFence = acquireFence;
+    item.mFenceTime = std::make_shared<FenceTime>(acquireFence);
+    item.mSurfaceDamage = input.getSurfaceDamage();
+    item.mQueuedBuffer = true;
+    outFrame->transform = transform;
+    return NO_ERROR;
+}
 
-        if (mCore->mIsAbandoned) {
-            BQ_LOGE("queueBuffer: BufferQueue has been abandoned");
-            return NO_INIT;
-        }
+status_t BufferQueueProducer::queueBufferLocked(int slot, QueuedFrame* frame,
+                                                QueueBufferOutput* output) {
+    BufferItem& item = frame->item;
 
-        if (mCore->mConnectedApi == BufferQueueCore::NO_CONNECTED_API) {
-            BQ_LOGE("queueBuffer: BufferQueue has no connected producer");
-            return NO_INIT;
-        }
+    if (mCore->mIsAbandoned) {
+        BQ_LOGE("queueBuffer: BufferQueue has been abandoned");
+        return NO_INIT;
+    }
 
-        if (slot < 0 || slot >= BufferQueueDefs::NUM_BUFFER_SLOTS) {
-            BQ_LOGE("queueBuffer: slot index %d out of range [0, %d)",
-                    slot, BufferQueueDefs::NUM_BUFFER_SLOTS);
-            return BAD_VALUE;
-        } else if (!mSlots[slot].mBufferState.isDequeued()) {
-            BQ_LOGE("queueBuffer: slot %d is not owned by the producer "
-                    "(state = %s)", slot, mSlots[slot].mBufferState.string());
-            return BAD_VALUE;
-        } else if (!mSlots[slot].mRequestBufferCalled) {
-            BQ_LOGE("queueBuffer: slot %d was queued without requesting "
-                    "a buffer", slot);
-            return BAD_VALUE;
-        }
+    if (mCore->mConnectedApi == BufferQueueCore::NO_CONNECTED_API) {
+        BQ_LOGE("queueBuffer: BufferQueue has no connected producer");
+        return NO_INIT;
+    }
 
-        // If shared buffer mode has just been enabled, cache the slot of the
-        // first buffer that is queued and mark it as the shared buffer.
-        if (mCore->mSharedBufferMode && mCore->mSharedBufferSlot ==
-                BufferQueueCore::INVALID_BUFFER_SLOT) {
-            mCore->mSharedBufferSlot = slot;
-            mSlots[slot].mBufferState.mShared = true;
-        }
+    if (slot < 0 || slot >= BufferQueueDefs::NUM_BUFFER_SLOTS) {
+        BQ_LOGE("queueBuffer: slot index %d out of range [0, %d)",
+                slot, BufferQueueDefs::NUM_BUFFER_SLOTS);
+        return BAD_VALUE;
+    } else if (!mSlots[slot].mBufferState.isDequeued()) {
+        BQ_LOGE("queueBuffer: slot %d is not owned by the producer "
+                "(state = %s)", slot, mSlots[slot].mBufferState.string());
+        return BAD_VALUE;
+    } else if (!mSlots[slot].mRequestBufferCalled) {
+        BQ_LOGE("queueBuffer: slot %d was queued without requesting "
+                "a buffer", slot);
+        return BAD_VALUE;
+    }
 
-        BQ_LOGV("queueBuffer: slot=%d/%" PRIu64 " time=%" PRIu64 " dataSpace=%d"
-                " validHdrMetadataTypes=0x%x crop=[%d,%d,%d,%d] transform=%#x scale=%s",
-                slot, mCore->mFrameCounter + 1, requestedPresentTimestamp, dataSpace,
-                hdrMetadata.validTypes, crop.left, crop.top, crop.right, crop.bottom,
-                transform,
-                BufferItem::scalingModeName(static_cast<uint32_t>(scalingMode)));
-
-        const sp<GraphicBuffer>& graphicBuffer(mSlots[slot].mGraphicBuffer);
-        Rect bufferRect(graphicBuffer->getWidth(), graphicBuffer->getHeight());
-        Rect croppedRect(Rect::EMPTY_RECT);
-        crop.intersect(bufferRect, &croppedRect);
-        if (croppedRect != crop) {
-            BQ_LOGE("queueBuffer: crop rect is not contained within the "
-                    "buffer in slot %d", slot);
-            return BAD_VALUE;
-        }
+    // If shared buffer mode has just been enabled, cache the slot of the
+    // first buffer that is queued and mark it as the shared buffer.
+    if (mCore->mSharedBufferMode && mCore->mSharedBufferSlot ==
+            BufferQueueCore::INVALID_BUFFER_SLOT) {
+        mCore->mSharedBufferSlot = slot;
+        mSlots[slot].mBufferState.mShared = true;
+    }
 
-        // Override UNKNOWN dataspace with consumer default
-        if (dataSpace == HAL_DATASPACE_UNKNOWN) {
-            dataSpace = mCore->mDefaultBufferDataSpace;
-        }
+    BQ_LOGV("queueBuffer: slot=%d/%" PRIu64 " time=%" PRIu64 " dataSpace=%d"
+            " validHdrMetadataTypes=0x%x crop=[%d,%d,%d,%d] transform=%#x scale=%s",
+            slot, mCore->mFrameCounter + 1, item.mTimestamp, item.mDataSpace,
+            item.mHdrMetadata.validTypes, item.mCrop.left, item.mCrop.top, item.mCrop.right,
+            item.mCrop.bottom, frame->transform,
+            BufferItem::scalingModeName(item.mScalingMode));
+
+    const sp<GraphicBuffer>& graphicBuffer(mSlots[slot].mGraphicBuffer);
+    Rect bufferRect(graphicBuffer->getWidth(), graphicBuffer->getHeight());
+    Rect croppedRect(Rect::EMPTY_RECT);
+    item.mCrop.intersect(bufferRect, &croppedRect);
+    if (croppedRect != item.mCrop) {
+        BQ_LOGE("queueBuffer: crop rect is not contained within the "
+                "buffer in slot %d", slot);
+        return BAD_VALUE;
+    }
 
-        mSlots[slot].mFence = acquireFence;
-        mSlots[slot].mBufferState.queue();
-
-        // Increment the frame counter and store a local version of it
-        // for use outside the lock on mCore->mMutex.
-        ++mCore->mFrameCounter;
-        currentFrameNumber = mCore->mFrameCounter;
-        mSlots[slot].mFrameNumber = currentFrameNumber;
-
-        item.mAcquireCalled = mSlots[slot].mAcquireCalled;
-        item.mGraphicBuffer = mSlots[slot].mGraphicBuffer;
-        item.mCrop = crop;
-        item.mTransform = transform &
-                ~static_cast<uint32_t>(NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY);
-        item.mTransformToDisplayInverse =
-                (transform & NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY) != 0;
-        item.mScalingMode = static_cast<uint32_t>(scalingMode);
-        item.mTimestamp = requestedPresentTimestamp;
-        item.mIsAutoTimestamp = isAutoTimestamp;
-        item.mDataSpace = dataSpace;
-        item.mHdrMetadata = hdrMetadata;
-        item.mFrameNumber = currentFrameNumber;
-        item.mSlot = slot;
-        item.mFence = acquireFence;
-        item.mFenceTime = acquireFenceTime;
-        item.mIsDroppable = mCore->mAsyncMode ||
-                (mConsumerIsSurfaceFlinger && mCore->mQueueBufferCanDrop) ||
-                (mCore->mLegacyBufferDrop && mCore->mQueueBufferCanDrop) ||
-                (mCore->mSharedBufferMode && mCore->mSharedBufferSlot == slot);
-        item.mSurfaceDamage = surfaceDamage;
-        item.mQueuedBuffer = true;
-        item.mAutoRefresh = mCore->mSharedBufferMode && mCore->mAutoRefresh;
-        item.mApi = mCore->mConnectedApi;
-
-        mStickyTransform = stickyTransform;
-
-        // Cache the shared buffer data so that the BufferItem can be recreated.
-        if (mCore->mSharedBufferMode) {
-            mCore->mSharedBufferCache.crop = crop;
-            mCore->mSharedBufferCache.transform = transform;
-            mCore->mSharedBufferCache.scalingMode = static_cast<uint32_t>(
-                    scalingMode);
-            mCore->mSharedBufferCache.dataspace = dataSpace;
-        }
+    // Override UNKNOWN dataspace with consumer default
+    if (item.mDataSpace == HAL_DATASPACE_UNKNOWN) {
+        item.mDataSpace = mCore->mDefaultBufferDataSpace;
+    }
 
-        output->bufferReplaced = false;
-        if (mCore->mQueue.empty()) {
-            // When the queue is empty, we can ignore mDequeueBufferCannotBlock
-            // and simply queue this buffer
-            mCore->mQueue.push_back(item);
-            frameAvailableListener = mCore->mConsumerListener;
-        } else {
-            // When the queue is not empty, we need to look at the last buffer
-            // in the queue to see if we need to replace it
-            const BufferItem& last = mCore->mQueue.itemAt(
-                    mCore->mQueue.size() - 1);
-            if (last.mIsDroppable) {
-
-                if (!last.mIsStale) {
-                    mSlots[last.mSlot].mBufferState.freeQueued();
-
-                    // After leaving shared buffer mode, the shared buffer will
-                    // still be around. Mark it as no longer shared if this
-                    // operation causes it to be free.
-                    if (!mCore->mSharedBufferMode &&
-                            mSlots[last.mSlot].mBufferState.isFree()) {
-                        mSlots[last.mSlot].mBufferState.mShared = false;
-                    }
-                    // Don't put the shared buffer on the free list.
-                    if (!mSlots[last.mSlot].mBufferState.isShared()) {
-                        mCore->mActiveBuffers.erase(last.mSlot);
-                        mCore->mFreeBuffers.push_back(last.mSlot);
-                        output->bufferReplaced = true;
-                    }
-                }
+    mSlots[slot].mFence = item.mFence;
+    mSlots[slot].mBufferState.queue();
 
-                // Make sure to merge the damage rect from the frame we're about
-                // to drop into the new frame's damage rect.
-                if (last.mSurfaceDamage.bounds() == Rect::INVALID_RECT ||
-                    item.mSurfaceDamage.bounds() == Rect::INVALID_RECT) {
-                    item.mSurfaceDamage = Region::INVALID_REGION;
-                } else {
-                    item.mSurfaceDamage |= last.mSurfaceDamage;
+    // Increment the frame counter and store a local version of it
+    // for use outside the lock on mCore->mMutex.
+    ++mCore->mFrameCounter;
+    mSlots[slot].mFrameNumber = mCore->mFrameCounter;
+
+    item.mAcquireCalled = mSlots[slot].mAcquireCalled;
+    item.mGraphicBuffer = mSlots[slot].mGraphicBuffer;
+    item.mFrameNumber = mCore->mFrameCounter;
+    item.mSlot = slot;
+    item.mIsDroppable = mCore->mAsyncMode ||
+            (mConsumerIsSurfaceFlinger && mCore->mQueueBufferCanDrop) ||
+            (mCore->mLegacyBufferDrop && mCore->mQueueBufferCanDrop) ||
+            (mCore->mSharedBufferMode && mCore->mSharedBufferSlot == slot);
+    item.mAutoRefresh = mCore->mSharedBufferMode && mCore->mAutoRefresh;
+    item.mApi = mCore->mConnectedApi;
+
+    mStickyTransform = frame->stickyTransform;
+
+    // Cache the shared buffer data so that the BufferItem can be recreated.
+    if (mCore->mSharedBufferMode) {
+        mCore->mSharedBufferCache.crop = item.mCrop;
+        mCore->mSharedBufferCache.transform = frame->transform;
+        mCore->mSharedBufferCache.scalingMode = item.mScalingMode;
+        mCore->mSharedBufferCache.dataspace = item.mDataSpace;
+    }
+
+    output->bufferReplaced = false;
+    if (mCore->mQueue.empty()) {
+        // When the queue is empty, we can ignore mDequeueBufferCannotBlock
+        // and simply queue this buffer
+        mCore->mQueue.push_back(item);
+        frame->frameAvailableListener = mCore->mConsumerListener;
+    } else {
+        // When the queue is not empty, we need to look at the last buffer
+        // in the queue to see if we need to replace it
+        const BufferItem& last = mCore->mQueue.itemAt(
+                mCore->mQueue.size() - 1);
+        if (last.mIsDroppable) {
+
+            if (!last.mIsStale) {
+                mSlots[last.mSlot].mBufferState.freeQueued();
+
+                // After leaving shared buffer mode, the shared buffer will
+                // still be around. Mark it as no longer shared if this
+                // operation causes it to be free.
+                if (!mCore->mSharedBufferMode &&
+                        mSlots[last.mSlot].mBufferState.isFree()) {
+                    mSlots[last.mSlot].mBufferState.mShared = false;
+                }
+                // Don't put the shared buffer on the free list.
+                if (!mSlots[last.mSlot].mBufferState.isShared()) {
+                    mCore->mActiveBuffers.erase(last.mSlot);
+                    mCore->mFreeBuffers.push_back(last.mSlot);
+                    output->bufferReplaced = true;
                 }
+            }
 
-                // Overwrite the droppable buffer with the incoming one
-                mCore->mQueue.editItemAt(mCore->mQueue.size() - 1) = item;
-                frameReplacedListener = mCore->mConsumerListener;
+            // Make sure to merge the damage rect from the frame we're about
+            // to drop into the new frame's damage rect.
+            if (last.mSurfaceDamage.bounds() == Rect::INVALID_RECT ||
+                item.mSurfaceDamage.bounds() == Rect::INVALID_RECT) {
+                item.mSurfaceDamage = Region::INVALID_REGION;
             } else {
-                mCore->mQueue.push_back(item);
-                frameAvailableListener = mCore->mConsumerListener;
+                item.mSurfaceDamage |= last.mSurfaceDamage;
             }
+
+            // Overwrite the droppable buffer with the incoming one
+            mCore->mQueue.editItemAt(mCore->mQueue.size() - 1) = item;
+            frame->frameReplacedListener = mCore->mConsumerListener;
+        } else {
+            mCore->mQueue.push_back(item);
+            frame->frameAvailableListener = mCore->mConsumerListener;
         }
+    }
 
-        mCore->mBufferHasBeenQueued = true;
-        mCore->mDequeueCondition.notify_all();
-        mCore->mLastQueuedSlot = slot;
+    mCore->mBufferHasBeenQueued = true;
+    mCore->mLastQueuedSlot = slot;
 
-        output->width = mCore->mDefaultWidth;
-        output->height = mCore->mDefaultHeight;
-        output->transformHint = mCore->mTransformHintInUse = mCore->mTransformHint;
-        output->numPendingBuffers = static_cast<uint32_t>(mCore->mQueue.size());
-        output->nextFrameNumber = mCore->mFrameCounter + 1;
+    output->width = mCore->mDefaultWidth;
+    output->height = mCore->mDefaultHeight;
+    output->transformHint = mCore->mTransformHintInUse = mCore->mTransformHint;
+    output->numPendingBuffers = static_cast<uint32_t>(mCore->mQueue.size());
+    output->nextFrameNumber = mCore->mFrameCounter + 1;
 
-        ATRACE_INT(mCore->mConsumerName.string(),
-                static_cast<int32_t>(mCore->mQueue.size()));
+    ATRACE_INT(mCore->mConsumerName.string(),
+            static_cast<int32_t>(mCore->mQueue.size()));
 #ifndef NO_BINDER
-        mCore->mOccupancyTracker.registerOccupancyChange(mCore->mQueue.size());
+    mCore->mOccupancyTracker.registerOccupancyChange(mCore->mQueue.size());
 #endif
-        // Take a ticket for the callback functions
-        callbackTicket = mNextCallbackTicket++;
-
-        VALIDATE_CONSISTENCY();
-    } // Autolock scope
-
-    // It is okay not to clear the GraphicBuffer when the consumer is SurfaceFlinger because
-    // it is guaranteed that the BufferQueue is inside SurfaceFlinger's process and
-    // there will be no Binder call
-    if (!mConsumerIsSurfaceFlinger) {
-        item.mGraphicBuffer.clear();
-    }
-
-    // Update and get FrameEventHistory.
-    nsecs_t postedTime = systemTime(SYSTEM_TIME_MONOTONIC);
-    NewFrameEventsEntry newFrameEventsEntry = {
-        currentFrameNumber,
-        postedTime,
-        requestedPresentTimestamp,
-        std::move(acquireFenceTime)
-    };
-    addAndGetFrameTimestamps(&newFrameEventsEntry,
-            getFrameTimestamps ? &output->frameTimestamps : nullptr);
+    frame->queued = true;
+    return NO_ERROR;
+}
 
+int BufferQueueProducer::onFramesQueued(QueuedFrame* frames, size_t count, int callbackTicket,
+                                        sp<Fence>* outThrottleFence) {
     // Call back without the main BufferQueue lock held, but with the callback
     // lock held so we can ensure that callbacks occur in order
+    std::unique_lock<std::mutex> lock(mCallbackMutex);
+    while (callbackTicket != mCurrentCallbackTicket) {
+        mCallbackCondition.wait(lock);
+    }
 
-    int connectedApi;
-    sp<Fence> lastQueuedFence;
-
-    { // scope for the lock
-        std::unique_lock<std::mutex> lock(mCallbackMutex);
-        while (callbackTicket != mCurrentCallbackTicket) {
-            mCallbackCondition.wait(lock);
+    for (size_t i = 0; i < count; i++) {
+        QueuedFrame& frame = frames[i];
+        if (!frame.queued) {
+            continue;
         }
 
-        if (frameAvailableListener != nullptr) {
-            frameAvailableListener->onFrameAvailable(item);
-        } else if (frameReplacedListener != nullptr) {
-            frameReplacedListener->onFrameReplaced(item);
+        if (frame.frameAvailableListener != nullptr) {
+            frame.frameAvailableListener->onFrameAvailable(frame.item);
+        } else if (frame.frameReplacedListener != nullptr) {
+            frame.frameReplacedListener->onFrameReplaced(frame.item);
         }
 
-        connectedApi = mCore->mConnectedApi;
-        lastQueuedFence = std::move(mLastQueueBufferFence);
+        *outThrottleFence = std::move(mLastQueueBufferFence);
 
-        mLastQueueBufferFence = std::move(acquireFence);
-        mLastQueuedCrop = item.mCrop;
-        mLastQueuedTransform = item.mTransform;
-
-        ++mCurrentCallbackTicket;
-        mCallbackCondition.notify_all();
+        mLastQueueBufferFence = frame.item.mFence;
+        mLastQueuedCrop = frame.item.mCrop;
+        mLastQueuedTransform = frame.item.mTransform;
     }
 
-    // Wait without lock held
-    if (connectedApi == NATIVE_WINDOW_API_EGL) {
-        // Waiting here allows for two full buffers to be queued but not a
-        // third. In the event that frames take varying time, this makes a
-        // small trade-off in favor of latency rather than throughput.
-        lastQueuedFence->waitForever("Throttling EGL Production");
-    }
+    int connectedApi = mCore->mConnectedApi;
 
-    return NO_ERROR;
+    ++mCurrentCallbackTicket;
+    mCallbackCondition.notify_all();
+    return connectedApi;
 }
 
 status_t BufferQueueProducer::cancelBuffer(int slot, const sp<Fence>& fence) {
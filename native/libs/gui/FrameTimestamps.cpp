@@ -25,6 +25,7 @@
 #include <utils/Log.h>
 
 #include <algorithm>
+#include <iterator>
 #include <limits>
 #include <numeric>
 
@@ -265,7 +266,7 @@ void ProducerFrameEventHistory::updateAcquireFence(
     } else {
         // If there isn't an acquire fence, assume that buffer was
         // ready for the consumer when posted.
-        frame->acquireFence = std::make_shared<FenceTime>(frame->postedTime);
+        frame->acquireFence = FenceTime::create(frame->postedTime);
     }
 }
 
@@ -320,10 +321,9 @@ void ProducerFrameEventHistory::applyDelta(
 }
 
 void ProducerFrameEventHistory::updateSignalTimes() {
-    mAcquireTimeline.updateSignalTimes();
-    mGpuCompositionDoneTimeline.updateSignalTimes();
-    mPresentTimeline.updateSignalTimes();
-    mReleaseTimeline.updateSignalTimes();
+    FenceTimeline* timelines[] = {&mAcquireTimeline, &mGpuCompositionDoneTimeline,
+                                  &mPresentTimeline, &mReleaseTimeline};
+    FenceTimeline::updateSignalTimes(timelines, std::size(timelines));
 }
 
 void ProducerFrameEventHistory::applyFenceDelta(FenceTimeline* timeline,
@@ -345,7 +345,7 @@ void ProducerFrameEventHistory::applyFenceDelta(FenceTimeline* timeline,
             if ((*dst)->isValid()) {
                 (*dst)->applyTrustedSnapshot(src);
             } else {
-                *dst = std::make_shared<FenceTime>(src.signalTime);
+                *dst = FenceTime::create(src.signalTime);
             }
             return;
     }
@@ -353,7 +353,7 @@ void ProducerFrameEventHistory::applyFenceDelta(FenceTimeline* timeline,
 
 std::shared_ptr<FenceTime> ProducerFrameEventHistory::createFenceTime(
         const sp<Fence>& fence) const {
-    return std::make_shared<FenceTime>(fence);
+    return FenceTime::create(fence);
 }
 
 void ProducerFrameEventHistory::resize(size_t newSize) {
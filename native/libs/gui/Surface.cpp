@@ -1055,7 +1055,7 @@ void Surface::onBufferQueuedLocked(int slot, sp<Fence> fence,
         // The consumer doesn't send it back to prevent us from having two
         // file descriptors of the same fence.
         mFrameEventHistory->updateAcquireFence(mNextFrameNumber,
-                std::make_shared<FenceTime>(fence));
+                FenceTime::create(fence));
 
         // Cache timestamps of signaled fences so we can close their file
         // descriptors.
@@ -805,11 +805,10 @@ status_t SurfaceComposerClient::Transaction::readFromParcel(const Parcel* parcel
         sp<IBinder> surfaceControlHandle;
         SAFE_PARCEL(parcel->readStrongBinder, &surfaceControlHandle);
 
-        ComposerState composerState;
+        ComposerState& composerState = composerStates[surfaceControlHandle];
         if (composerState.read(*parcel) == BAD_VALUE) {
             return BAD_VALUE;
         }
-        composerStates[surfaceControlHandle] = composerState;
     }
 
     InputWindowCommands inputWindowCommands;
@@ -846,10 +845,10 @@ status_t SurfaceComposerClient::Transaction::readFromParcel(const Parcel* parcel
     mIsAutoTimestamp = isAutoTimestamp;
     mFrameTimelineInfo = frameTimelineInfo;
     mDisplayStates = displayStates;
-    mListenerCallbacks = listenerCallbacks;
-    mComposerStates = composerStates;
-    mInputWindowCommands = inputWindowCommands;
-    mApplyToken = applyToken;
+    mListenerCallbacks = std::move(listenerCallbacks);
+    mComposerStates = std::move(composerStates);
+    mInputWindowCommands = std::move(inputWindowCommands);
+    mApplyToken = std::move(applyToken);
     mUncacheBuffers = std::move(uncacheBuffers);
     mMergedTransactionIds = std::move(mergedTransactionIds);
     return NO_ERROR;
@@ -891,7 +890,7 @@ status_t SurfaceComposerClient::Transaction::writeToParcel(Parcel* parcel) const
             parcel->writeParcelable(callbackId);
         }
         parcel->writeUint32(static_cast<uint32_t>(callbackInfo.surfaceControls.size()));
-        for (auto surfaceControl : callbackInfo.surfaceControls) {
+        for (const auto& surfaceControl : callbackInfo.surfaceControls) {
             SAFE_PARCEL(surfaceControl->writeToParcel, *parcel);
         }
     }
@@ -956,13 +955,12 @@ SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::merge(Tr
     mMergedTransactionIds.insert(mMergedTransactionIds.begin(), other.mId);
 
     for (auto const& [handle, composerState] : other.mComposerStates) {
-        if (mComposerStates.count(handle) == 0) {
-            mComposerStates[handle] = composerState;
-        } else {
+        auto [it, inserted] = mComposerStates.try_emplace(handle, composerState);
+        if (!inserted) {
             if (composerState.state.what & layer_state_t::eBufferChanged) {
-                releaseBufferIfOverwriting(mComposerStates[handle].state);
+                releaseBufferIfOverwriting(it->second.state);
             }
-            mComposerStates[handle].state.merge(composerState.state);
+            it->second.state.merge(composerState.state);
         }
     }
 
@@ -1030,6 +1028,7 @@ void SurfaceComposerClient::Transaction::clear() {
     clearFrameTimelineInfo(mFrameTimelineInfo);
     mApplyToken = nullptr;
     mMergedTransactionIds.clear();
+    mStatus = NO_ERROR;
 }
 
 uint64_t SurfaceComposerClient::Transaction::getId() {
@@ -1162,6 +1161,7 @@ status_t SurfaceComposerClient::Transaction::apply(bool synchronous, bool oneWay
 
     bool hasListenerCallbacks = !mListenerCallbacks.empty();
     std::vector<ListenerCallbacks> listenerCallbacks;
+    listenerCallbacks.reserve(mListenerCallbacks.size());
     // For every listener with registered callbacks
     for (const auto& [listener, callbackInfo] : mListenerCallbacks) {
         auto& [callbackIds, surfaceControls] = callbackInfo;
@@ -1193,6 +1193,7 @@ status_t SurfaceComposerClient::Transaction::apply(bool synchronous, bool oneWay
     Vector<DisplayState> displayStates;
     uint32_t flags = 0;
 
+    composerStates.setCapacity(mComposerStates.size());
     for (auto const& kv : mComposerStates) {
         composerStates.add(kv.second);
     }
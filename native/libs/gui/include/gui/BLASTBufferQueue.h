@@ -20,6 +20,7 @@
 #include <gui/IGraphicBufferProducer.h>
 #include <gui/BufferItemConsumer.h>
 #include <gui/BufferItem.h>
+#include <gui/BufferQueueDefs.h>
 #include <gui/SurfaceComposerClient.h>
 
 #include <utils/Condition.h>
@@ -27,6 +28,8 @@
 #include <utils/RefBase.h>
 
 #include <system/window.h>
+#include <array>
+#include <atomic>
 #include <thread>
 #include <queue>
 
@@ -150,6 +153,15 @@ private:
     void releaseBuffer(const ReleaseCallbackId& callbackId, const sp<Fence>& releaseFence)
             REQUIRES(mMutex);
 
+    // Lets release callbacks that find mMutex taken queue their release for this thread to
+    // process, rather than wait for it. Must be followed by drainReleaseQueueLocked() before
+    // mMutex is unlocked or waited on.
+    void deferReleasesLocked() REQUIRES(mMutex);
+    // Processes the queued releases, returns true if there were any.
+    bool drainReleaseQueueLocked() REQUIRES(mMutex);
+    // Waits on mCallbackCV unless queued releases were processed instead.
+    void waitForReleaseLocked(std::unique_lock<std::mutex>& lock) REQUIRES(mMutex);
+
     std::string mName;
     // Represents the queued buffer count from buffer queue,
     // pre-BLAST. This is mNumFrameAvailable (buffers that queued to blast) +
@@ -173,10 +185,67 @@ private:
     // latch stale buffers and that we don't wait on barriers from an old producer.
     uint32_t mProducerId = 0;
 
+    // Buffers submitted to SurfaceFlinger, keyed by their ReleaseCallbackId. The BufferQueue slot
+    // can't be the key: when the producer disconnects, the slots of the acquired buffers are freed
+    // and may be acquired again before SurfaceFlinger releases the old buffers. Lookups compare
+    // the ids of the entries in use, of which there are at most mMaxAcquiredBuffers + 2.
+    class SubmittedBuffers {
+    public:
+        void add(const ReleaseCallbackId& id, const BufferItem& item);
+        // Returns the index of the entry holding the buffer, or -1.
+        int find(const ReleaseCallbackId& id) const;
+        const BufferItem& get(int index) const { return mItems[index]; }
+        void remove(int index);
+        size_t size() const { return static_cast<size_t>(__builtin_popcountll(mUsedEntries)); }
+
+        // Calls f with the id and item of every submitted buffer.
+        template <typename F>
+        void forEach(F f) const {
+            for (uint64_t entries = mUsedEntries; entries != 0; entries &= entries - 1) {
+                const int index = __builtin_ctzll(entries);
+                f(mIds[index], mItems[index]);
+            }
+        }
+
+    private:
+        static_assert(BufferQueueDefs::NUM_BUFFER_SLOTS <= 64, "mUsedEntries is a 64 bit mask");
+
+        uint64_t mUsedEntries = 0;
+        std::array<ReleaseCallbackId, BufferQueueDefs::NUM_BUFFER_SLOTS> mIds;
+        std::array<BufferItem, BufferQueueDefs::NUM_BUFFER_SLOTS> mItems;
+    };
+
     // Keep a reference to the submitted buffers so we can release when surfaceflinger drops the
     // buffer or the buffer has been presented and a new buffer is ready to be presented.
-    std::unordered_map<ReleaseCallbackId, BufferItem, ReleaseBufferCallbackIdHash> mSubmitted
-            GUARDED_BY(mMutex);
+    SubmittedBuffers mSubmitted GUARDED_BY(mMutex);
+
+    // Release callbacks that arrived while mMutex was held by a thread that agreed to process
+    // them, see deferReleasesLocked().
+    struct QueuedRelease {
+        ReleaseCallbackId id;
+        sp<Fence> releaseFence;
+        std::optional<uint32_t> currentMaxAcquiredBufferCount;
+    };
+    // Fixed size ring of QueuedRelease. Releases come from binder and release callback threads,
+    // which push under mPushMutex. That lock is only held to push, so it is never waited on for
+    // long. Only holders of mMutex pop, and they don't take mPushMutex.
+    class ReleaseQueue {
+    public:
+        // Returns false if the queue is full.
+        bool push(QueuedRelease release);
+        // Returns false if the queue is empty.
+        bool pop(QueuedRelease* outRelease);
+
+    private:
+        static constexpr size_t kSize = BufferQueueDefs::NUM_BUFFER_SLOTS;
+
+        std::mutex mPushMutex;
+        std::atomic<size_t> mHead = 0;
+        std::atomic<size_t> mTail = 0;
+        std::array<QueuedRelease, kSize> mReleases;
+    };
+    ReleaseQueue mReleaseQueue;
+    std::atomic<bool> mDeferReleases = false;
 
     // Keep a queue of the released buffers instead of immediately releasing
     // the buffers back to the buffer queue. This would be controlled by SF
@@ -239,6 +308,9 @@ private:
     std::function<void(SurfaceComposerClient::Transaction*)> mTransactionReadyCallback
             GUARDED_BY(mMutex);
     SurfaceComposerClient::Transaction* mSyncTransaction GUARDED_BY(mMutex);
+    // Holds the buffers that are applied directly rather than handed to a sync transaction. It is
+    // reused from one buffer to the next so that its containers keep their storage.
+    SurfaceComposerClient::Transaction mBufferTransaction GUARDED_BY(mMutex);
     std::vector<std::tuple<uint64_t /* framenumber */, SurfaceComposerClient::Transaction>>
             mPendingTransactions GUARDED_BY(mMutex);
 
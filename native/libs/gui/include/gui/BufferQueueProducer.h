@@ -45,6 +45,10 @@ public:
     // flags indicating that previously-returned buffers are no longer valid.
     virtual status_t requestBuffer(int slot, sp<GraphicBuffer>* buf);
 
+    // See IGraphicBufferProducer::requestBuffers, all of the slots are looked up under one lock.
+    virtual status_t requestBuffers(const std::vector<int32_t>& slots,
+                                    std::vector<RequestBufferOutput>* outputs) override;
+
     // see IGraphicsBufferProducer::setMaxDequeuedBufferCount
     virtual status_t setMaxDequeuedBufferCount(int maxDequeuedBuffers);
 
@@ -91,6 +95,12 @@ public:
                                    uint64_t* outBufferAge,
                                    FrameEventHistoryDelta* outTimestamps) override;
 
+    // See IGraphicBufferProducer::dequeueBuffers. The slots of the whole batch are picked under
+    // one lock, the buffers that need it are allocated together and the frame event history is
+    // fetched once, into the last output asking for timestamps.
+    virtual status_t dequeueBuffers(const std::vector<DequeueBufferInput>& inputs,
+                                    std::vector<DequeueBufferOutput>* outputs) override;
+
     // See IGraphicBufferProducer::detachBuffer
     virtual status_t detachBuffer(int slot);
 
@@ -119,6 +129,12 @@ public:
     virtual status_t queueBuffer(int slot,
             const QueueBufferInput& input, QueueBufferOutput* output);
 
+    // See IGraphicBufferProducer::queueBuffers. The whole batch is queued under one lock and its
+    // consumer callbacks are delivered in a single pass, in order. Only the last output asking
+    // for frame timestamps gets a delta.
+    virtual status_t queueBuffers(const std::vector<QueueBufferInput>& inputs,
+                                  std::vector<QueueBufferOutput>* outputs) override;
+
     // cancelBuffer returns a dequeued buffer to the BufferQueue, but doesn't
     // queue it for use by the consumer.
     //
@@ -222,6 +238,38 @@ private:
     void addAndGetFrameTimestamps(const NewFrameEventsEntry* newTimestamps,
             FrameEventHistoryDelta* outDelta);
 
+    struct DequeuedBuffer;
+    struct QueuedFrame;
+
+    status_t requestBufferLocked(int slot, sp<GraphicBuffer>* buf);
+
+    // Picks a slot for a dequeue with mCore->mMutex held, marking it for reallocation when its
+    // buffer doesn't match. waitForAllocation is false when the caller already has an
+    // allocation pending, which it must complete with allocateDequeuedBuffers.
+    status_t dequeueBufferLocked(std::unique_lock<std::mutex>& lock, uint32_t width,
+            uint32_t height, PixelFormat format, uint64_t usage, bool waitForAllocation,
+            DequeuedBuffer* outBuffer);
+
+    // Allocates the buffers that need it without the lock held, then installs them all under
+    // one lock.
+    void allocateDequeuedBuffers(DequeuedBuffer* buffers, size_t count);
+
+    // Completes a successful dequeue once the lock has been dropped.
+    void finishDequeue(DequeuedBuffer* buffer);
+
+    // Validates a queueBuffer input, this doesn't need the lock.
+    status_t prepareQueueBuffer(const QueueBufferInput& input, QueuedFrame* outFrame);
+
+    // Queues the frame with mCore->mMutex held. The caller is responsible for waking up
+    // dequeuers and taking a callback ticket.
+    status_t queueBufferLocked(int slot, QueuedFrame* frame, QueueBufferOutput* output);
+
+    // Waits for callbackTicket and delivers the consumer callbacks of the queued frames.
+    // outThrottleFence is set to the fence of the frame queued before the last one, the
+    // connected api is returned.
+    int onFramesQueued(QueuedFrame* frames, size_t count, int callbackTicket,
+            sp<Fence>* outThrottleFence);
+
     // waitForFreeSlotThenRelock finds the oldest slot in the FREE state. It may
     // block if there are no available slots and we are not in non-blocking
     // mode (producer and consumer controlled by the application). If it blocks,
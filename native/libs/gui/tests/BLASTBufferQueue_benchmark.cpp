@@ -0,0 +1,93 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <gui/BLASTBufferQueue.h>
+#include <gui/IProducerListener.h>
+#include <gui/SurfaceComposerClient.h>
+#include <system/window.h>
+
+#include <chrono>
+#include <limits>
+
+// Measures queueBuffer() on a BLASTBufferQueue while the release and transaction callbacks of
+// the previous frames, coming from SurfaceFlinger, compete with it for the queue's lock.
+// Dequeuing, which waits on those releases, is not part of the measurement.
+
+namespace android {
+namespace {
+
+using QueueBufferInput = IGraphicBufferProducer::QueueBufferInput;
+using QueueBufferOutput = IGraphicBufferProducer::QueueBufferOutput;
+
+constexpr uint32_t kWidth = 64;
+constexpr uint32_t kHeight = 64;
+
+void BM_QueueBuffer(benchmark::State& state) {
+    sp<SurfaceComposerClient> client = sp<SurfaceComposerClient>::make();
+    sp<SurfaceControl> surfaceControl =
+            client->createSurface(String8("BLASTBufferQueueBenchmark"), kWidth, kHeight,
+                                  PIXEL_FORMAT_RGBA_8888,
+                                  ISurfaceComposerClient::eFXSurfaceBufferState,
+                                  /*parent*/ nullptr);
+    if (surfaceControl == nullptr) {
+        state.SkipWithError("failed to create a surface");
+        return;
+    }
+    SurfaceComposerClient::Transaction()
+            .setLayerStack(surfaceControl, ui::DEFAULT_LAYER_STACK)
+            .setLayer(surfaceControl, std::numeric_limits<int32_t>::max())
+            .show(surfaceControl)
+            .apply(true);
+
+    sp<BLASTBufferQueue> bbq = sp<BLASTBufferQueue>::make("BLASTBufferQueueBenchmark",
+                                                          surfaceControl, kWidth, kHeight,
+                                                          PIXEL_FORMAT_RGBA_8888);
+    sp<IGraphicBufferProducer> producer = bbq->getIGraphicBufferProducer();
+    producer->setMaxDequeuedBufferCount(static_cast<int>(state.range(0)));
+    QueueBufferOutput output;
+    producer->connect(sp<StubProducerListener>::make(), NATIVE_WINDOW_API_CPU, false, &output);
+
+    for (auto _ : state) {
+        int slot;
+        sp<Fence> fence;
+        status_t result = producer->dequeueBuffer(&slot, &fence, kWidth, kHeight,
+                                                  PIXEL_FORMAT_RGBA_8888,
+                                                  GRALLOC_USAGE_SW_WRITE_OFTEN, nullptr, nullptr);
+        if (result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+            sp<GraphicBuffer> buffer;
+            producer->requestBuffer(slot, &buffer);
+        }
+        QueueBufferInput input(systemTime(), true /* autotimestamp */, HAL_DATASPACE_UNKNOWN,
+                               Rect(kWidth, kHeight), NATIVE_WINDOW_SCALING_MODE_FREEZE, 0,
+                               Fence::NO_FENCE);
+
+        auto start = std::chrono::steady_clock::now();
+        producer->queueBuffer(slot, input, &output);
+        auto end = std::chrono::steady_clock::now();
+        state.SetIterationTime(std::chrono::duration<double>(end - start).count());
+    }
+
+    producer->disconnect(NATIVE_WINDOW_API_CPU);
+}
+// The argument is the number of buffers the producer may have dequeued, the more there are the
+// more releases are in flight.
+BENCHMARK(BM_QueueBuffer)->Arg(1)->Arg(2)->Arg(3)->UseManualTime();
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -169,6 +169,15 @@ public:
         mBlastBufferQueueAdapter->mergeWithNextTransaction(merge, frameNumber);
     }
 
+    uint64_t getLastAcquiredFrameNum() {
+        return mBlastBufferQueueAdapter->getLastAcquiredFrameNum();
+    }
+
+    int32_t getNumAcquired() {
+        std::unique_lock lock{mBlastBufferQueueAdapter->mMutex};
+        return mBlastBufferQueueAdapter->mNumAcquired;
+    }
+
 private:
     sp<TestBLASTBufferQueue> mBlastBufferQueueAdapter;
 };
@@ -511,6 +520,71 @@ TEST_F(BLASTBufferQueueTest, TripleBuffering) {
     adapter.waitForCallbacks();
 }
 
+// Release callbacks that find the BLASTBufferQueue busy are handed to the thread holding it, make
+// sure none of them get lost while another thread keeps taking the lock.
+TEST_F(BLASTBufferQueueTest, ReleaseCallbacksUnderContention) {
+    BLASTBufferQueueHelper adapter(mSurfaceControl, mDisplayWidth, mDisplayHeight);
+    sp<IGraphicBufferProducer> igbProducer;
+    setUpProducer(adapter, igbProducer);
+
+    std::atomic<bool> done = false;
+    std::thread contender([&]() {
+        while (!done) {
+            adapter.getLastAcquiredFrameNum();
+        }
+    });
+
+    constexpr int kNumFrames = 100;
+    for (int i = 0; i < kNumFrames; i++) {
+        int slot;
+        sp<Fence> fence;
+        sp<GraphicBuffer> buf;
+        auto ret = igbProducer->dequeueBuffer(&slot, &fence, mDisplayWidth, mDisplayHeight,
+                                              PIXEL_FORMAT_RGBA_8888, GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                              nullptr, nullptr);
+        ASSERT_TRUE(ret == IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION || ret == NO_ERROR);
+        ASSERT_EQ(OK, igbProducer->requestBuffer(slot, &buf));
+        IGraphicBufferProducer::QueueBufferOutput qbOutput;
+        IGraphicBufferProducer::QueueBufferInput input(systemTime(), true /* autotimestamp */,
+                                                       HAL_DATASPACE_UNKNOWN,
+                                                       Rect(mDisplayWidth, mDisplayHeight),
+                                                       NATIVE_WINDOW_SCALING_MODE_FREEZE, 0,
+                                                       Fence::NO_FENCE);
+        igbProducer->queueBuffer(slot, input, &qbOutput);
+    }
+
+    done = true;
+    contender.join();
+    adapter.waitForCallback(kNumFrames);
+    adapter.waitForCallbacks();
+    adapter.validateNumFramesSubmitted(1);
+    ASSERT_EQ(static_cast<uint64_t>(kNumFrames), adapter.getLastAcquiredFrameNum());
+}
+
+// Disconnecting the producer frees the slots of the buffers SurfaceFlinger still holds, so they
+// can be acquired again before the old buffers are released. Make sure those releases still
+// count against the acquired buffers.
+TEST_F(BLASTBufferQueueTest, ReconnectWithBufferHeld) {
+    BLASTBufferQueueHelper adapter(mSurfaceControl, mDisplayWidth, mDisplayHeight);
+    sp<IGraphicBufferProducer> igbProducer;
+    setUpProducer(adapter, igbProducer);
+
+    constexpr int kNumReconnects = 5;
+    for (int i = 0; i < kNumReconnects; i++) {
+        queueBuffer(igbProducer, 255, 0, 0, 0);
+        adapter.waitForCallback(static_cast<int64_t>(adapter.getLastAcquiredFrameNum()));
+        // The buffer is still on screen, so it is still acquired.
+        ASSERT_EQ(NO_ERROR, igbProducer->disconnect(NATIVE_WINDOW_API_CPU));
+        setUpProducer(igbProducer, 2);
+    }
+
+    queueBuffer(igbProducer, 0, 255, 0, 0);
+    adapter.waitForCallback(static_cast<int64_t>(adapter.getLastAcquiredFrameNum()));
+    adapter.waitForCallbacks();
+    adapter.validateNumFramesSubmitted(1);
+    ASSERT_EQ(1, adapter.getNumAcquired());
+}
+
 TEST_F(BLASTBufferQueueTest, SetCrop_Item) {
     uint8_t r = 255;
     uint8_t g = 0;
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MockConsumer.h"
+
+#include <benchmark/benchmark.h>
+#include <gui/BufferItem.h>
+#include <gui/BufferQueue.h>
+#include <gui/IProducerListener.h>
+#include <system/window.h>
+
+#include <vector>
+
+// Compares a round trip of a batch of buffers through a BufferQueue done one buffer at a time
+// with the same round trip done through the batched IGraphicBufferProducer calls.
+
+namespace android {
+namespace {
+
+using DequeueBufferInput = IGraphicBufferProducer::DequeueBufferInput;
+using DequeueBufferOutput = IGraphicBufferProducer::DequeueBufferOutput;
+using QueueBufferInput = IGraphicBufferProducer::QueueBufferInput;
+using QueueBufferOutput = IGraphicBufferProducer::QueueBufferOutput;
+using RequestBufferOutput = IGraphicBufferProducer::RequestBufferOutput;
+
+constexpr uint32_t kWidth = 64;
+constexpr uint32_t kHeight = 64;
+
+QueueBufferInput createQueueBufferInput(int slot) {
+    QueueBufferInput input(0ll, true, HAL_DATASPACE_UNKNOWN, Rect::INVALID_RECT,
+                           NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    input.slot = slot;
+    return input;
+}
+
+class BatchBufferQueue {
+public:
+    explicit BatchBufferQueue(size_t batchSize) {
+        BufferQueue::createBufferQueue(&mProducer, &mConsumer);
+        mConsumer->consumerConnect(sp<MockConsumer>::make(), true);
+        mConsumer->setDefaultBufferSize(kWidth, kHeight);
+        mConsumer->setMaxAcquiredBufferCount(static_cast<int>(batchSize));
+        QueueBufferOutput output;
+        mProducer->connect(sp<StubProducerListener>::make(), NATIVE_WINDOW_API_CPU, true, &output);
+        mProducer->setMaxDequeuedBufferCount(static_cast<int>(batchSize));
+    }
+
+    // Hands the queued buffers back to the producer, this isn't part of what is measured.
+    void releaseAll(size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            BufferItem item;
+            if (mConsumer->acquireBuffer(&item, 0) != NO_ERROR) {
+                return;
+            }
+            mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber, EGL_NO_DISPLAY,
+                                     EGL_NO_SYNC_KHR, Fence::NO_FENCE);
+        }
+    }
+
+    sp<IGraphicBufferProducer> mProducer;
+    sp<IGraphicBufferConsumer> mConsumer;
+};
+
+void BM_SingleDequeueQueue(benchmark::State& state) {
+    const size_t batchSize = static_cast<size_t>(state.range(0));
+    BatchBufferQueue queue(batchSize);
+    std::vector<int> slots(batchSize);
+    for (auto _ : state) {
+        for (size_t i = 0; i < batchSize; i++) {
+            sp<Fence> fence;
+            status_t result = queue.mProducer->dequeueBuffer(&slots[i], &fence, 0, 0, 0, 0,
+                                                             nullptr, nullptr);
+            if (result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+                sp<GraphicBuffer> buffer;
+                queue.mProducer->requestBuffer(slots[i], &buffer);
+            }
+        }
+        for (size_t i = 0; i < batchSize; i++) {
+            QueueBufferOutput output;
+            queue.mProducer->queueBuffer(slots[i], createQueueBufferInput(slots[i]), &output);
+        }
+        state.PauseTiming();
+        queue.releaseAll(batchSize);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * batchSize);
+}
+BENCHMARK(BM_SingleDequeueQueue)->Arg(2)->Arg(4)->Arg(8);
+
+void BM_BatchedDequeueQueue(benchmark::State& state) {
+    const size_t batchSize = static_cast<size_t>(state.range(0));
+    BatchBufferQueue queue(batchSize);
+    std::vector<DequeueBufferInput> dequeueInputs(batchSize, DequeueBufferInput{});
+    std::vector<DequeueBufferOutput> dequeueOutputs;
+    std::vector<int32_t> requestSlots;
+    std::vector<RequestBufferOutput> requestOutputs;
+    std::vector<QueueBufferInput> queueInputs;
+    std::vector<QueueBufferOutput> queueOutputs;
+    for (auto _ : state) {
+        queue.mProducer->dequeueBuffers(dequeueInputs, &dequeueOutputs);
+        requestSlots.clear();
+        for (const DequeueBufferOutput& output : dequeueOutputs) {
+            if (output.result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+                requestSlots.push_back(output.slot);
+            }
+        }
+        if (!requestSlots.empty()) {
+            queue.mProducer->requestBuffers(requestSlots, &requestOutputs);
+        }
+        queueInputs.clear();
+        for (const DequeueBufferOutput& output : dequeueOutputs) {
+            queueInputs.push_back(createQueueBufferInput(output.slot));
+        }
+        queue.mProducer->queueBuffers(queueInputs, &queueOutputs);
+        state.PauseTiming();
+        queue.releaseAll(batchSize);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * batchSize);
+}
+BENCHMARK(BM_BatchedDequeueQueue)->Arg(2)->Arg(4)->Arg(8);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
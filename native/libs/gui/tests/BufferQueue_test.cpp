@@ -36,6 +36,7 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <thread>
 
 using namespace std::chrono_literals;
@@ -1209,6 +1210,70 @@ TEST_F(BufferQueueTest, TestStaleBufferHandleSentAfterDisconnect) {
     ASSERT_NE(nullptr, item.mGraphicBuffer.get());
 }
 
+struct FrameCountingConsumer : public MockConsumer {
+    void onFrameAvailable(const BufferItem& item) override {
+        frameNumbers.push_back(item.mFrameNumber);
+    }
+    std::vector<uint64_t> frameNumbers;
+};
+
+TEST_F(BufferQueueTest, TestBatchedDequeueAndQueue) {
+    createBufferQueue();
+    sp<FrameCountingConsumer> fc(new FrameCountingConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(fc, true));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK,
+              mProducer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, true, &output));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(3));
+    ASSERT_EQ(OK, mConsumer->setMaxAcquiredBufferCount(3));
+
+    // All of the buffers of the batch are allocated together
+    IGraphicBufferProducer::DequeueBufferInput dequeueInput{};
+    std::vector<IGraphicBufferProducer::DequeueBufferInput> dequeueInputs(3, dequeueInput);
+    std::vector<IGraphicBufferProducer::DequeueBufferOutput> dequeueOutputs;
+    ASSERT_EQ(OK, mProducer->dequeueBuffers(dequeueInputs, &dequeueOutputs));
+    ASSERT_EQ(3u, dequeueOutputs.size());
+    std::vector<int32_t> slots;
+    for (const auto& dequeueOutput : dequeueOutputs) {
+        ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION, dequeueOutput.result);
+        ASSERT_EQ(slots.end(), std::find(slots.begin(), slots.end(), dequeueOutput.slot));
+        slots.push_back(dequeueOutput.slot);
+    }
+
+    std::vector<IGraphicBufferProducer::RequestBufferOutput> requestOutputs;
+    ASSERT_EQ(OK, mProducer->requestBuffers(slots, &requestOutputs));
+    ASSERT_EQ(3u, requestOutputs.size());
+    for (const auto& requestOutput : requestOutputs) {
+        ASSERT_EQ(OK, requestOutput.result);
+        ASSERT_NE(nullptr, requestOutput.buffer.get());
+    }
+
+    // A failing frame doesn't prevent the rest of the batch from being queued
+    std::vector<IGraphicBufferProducer::QueueBufferInput> queueInputs;
+    for (int32_t slot : {slots[0], -1, slots[1], slots[2]}) {
+        queueInputs.emplace_back(0ull, true, HAL_DATASPACE_UNKNOWN, Rect::INVALID_RECT,
+                                 NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE)
+                .slot = slot;
+    }
+    std::vector<IGraphicBufferProducer::QueueBufferOutput> queueOutputs;
+    ASSERT_EQ(OK, mProducer->queueBuffers(queueInputs, &queueOutputs));
+    ASSERT_EQ(4u, queueOutputs.size());
+    ASSERT_EQ(OK, queueOutputs[0].result);
+    ASSERT_EQ(BAD_VALUE, queueOutputs[1].result);
+    ASSERT_EQ(OK, queueOutputs[2].result);
+    ASSERT_EQ(OK, queueOutputs[3].result);
+    ASSERT_EQ(4u, queueOutputs[3].nextFrameNumber);
+
+    // Consumers still see one frame available per queued buffer, in order
+    ASSERT_EQ((std::vector<uint64_t>{1, 2, 3}), fc->frameNumbers);
+    for (size_t i = 0; i < slots.size(); i++) {
+        BufferItem item;
+        ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+        ASSERT_EQ(slots[i], item.mSlot);
+        ASSERT_EQ(i + 1, item.mFrameNumber);
+    }
+}
+
 TEST_F(BufferQueueTest, TestProducerConnectDisconnect) {
     createBufferQueue();
     sp<MockConsumer> mc(new MockConsumer);
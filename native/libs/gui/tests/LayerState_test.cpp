@@ -0,0 +1,98 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <binder/Parcel.h>
+
+#include <gui/LayerState.h>
+
+namespace android {
+namespace test {
+
+TEST(LayerState, ParcellingGeometryOnly) {
+    layer_state_t s1;
+    s1.what = layer_state_t::ePositionChanged | layer_state_t::eMatrixChanged |
+            layer_state_t::eCropChanged | layer_state_t::eAlphaChanged;
+    s1.x = 10.5f;
+    s1.y = -4.0f;
+    s1.matrix = {2.0f, 0.0f, 0.0f, 2.0f};
+    s1.crop = Rect(1, 2, 30, 40);
+    s1.color.a = 0.5f;
+    // Not flagged, so it should not be sent.
+    s1.cornerRadius = 8.0f;
+
+    Parcel p;
+    ASSERT_EQ(OK, s1.write(p));
+    p.setDataPosition(0);
+
+    layer_state_t s2;
+    ASSERT_EQ(OK, s2.read(p));
+    ASSERT_EQ(p.dataSize(), p.dataPosition());
+
+    ASSERT_EQ(s1.what, s2.what);
+    ASSERT_EQ(s1.x, s2.x);
+    ASSERT_EQ(s1.y, s2.y);
+    ASSERT_EQ(s1.matrix.dsdx, s2.matrix.dsdx);
+    ASSERT_EQ(s1.matrix.dtdy, s2.matrix.dtdy);
+    ASSERT_EQ(s1.crop, s2.crop);
+    ASSERT_EQ(s1.color.a, s2.color.a);
+    ASSERT_EQ(0.0f, s2.cornerRadius);
+}
+
+TEST(LayerState, ParcellingBufferOnly) {
+    layer_state_t s1;
+    s1.what = layer_state_t::eBufferChanged | layer_state_t::eDataspaceChanged;
+    s1.bufferData = std::make_shared<BufferData>();
+    s1.bufferData->flags |= BufferData::BufferDataChange::frameNumberChanged;
+    s1.bufferData->frameNumber = 42;
+    s1.bufferData->cachedBuffer.id = 7;
+    s1.dataspace = ui::Dataspace::SRGB;
+    // Not flagged, so it should not be sent.
+    s1.crop = Rect(0, 0, 5, 5);
+
+    Parcel p;
+    ASSERT_EQ(OK, s1.write(p));
+    p.setDataPosition(0);
+
+    layer_state_t s2;
+    ASSERT_EQ(OK, s2.read(p));
+    ASSERT_EQ(p.dataSize(), p.dataPosition());
+
+    ASSERT_EQ(s1.what, s2.what);
+    ASSERT_NE(nullptr, s2.bufferData);
+    ASSERT_EQ(s1.bufferData->flags, s2.bufferData->flags);
+    ASSERT_EQ(s1.bufferData->frameNumber, s2.bufferData->frameNumber);
+    ASSERT_EQ(s1.bufferData->cachedBuffer.id, s2.bufferData->cachedBuffer.id);
+    ASSERT_EQ(s1.dataspace, s2.dataspace);
+    ASSERT_EQ(Rect::INVALID_RECT, s2.crop);
+}
+
+TEST(LayerState, ParcelSizeFollowsChangedFields) {
+    layer_state_t s;
+    s.what = layer_state_t::ePositionChanged;
+    Parcel positionOnly;
+    ASSERT_EQ(OK, s.write(positionOnly));
+
+    s.what |= layer_state_t::eMatrixChanged | layer_state_t::eCropChanged;
+    Parcel geometry;
+    ASSERT_EQ(OK, s.write(geometry));
+
+    ASSERT_LT(positionOnly.dataSize(), geometry.dataSize());
+}
+
+} // namespace test
+} // namespace android
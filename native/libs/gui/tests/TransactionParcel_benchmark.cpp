@@ -0,0 +1,88 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <binder/Parcel.h>
+#include <gui/LayerState.h>
+
+// Measures the size and the cost of parceling the layer states of the two most common
+// transactions: a new buffer from BLASTBufferQueue, and a geometry update from an animation.
+
+namespace android {
+namespace {
+
+ComposerState createBufferOnlyState() {
+    ComposerState composerState;
+    layer_state_t& s = composerState.state;
+    s.what = layer_state_t::eBufferChanged | layer_state_t::eBufferTransformChanged |
+            layer_state_t::eDataspaceChanged | layer_state_t::eHdrMetadataChanged |
+            layer_state_t::eSurfaceDamageRegionChanged | layer_state_t::eApiChanged |
+            layer_state_t::eBufferCropChanged | layer_state_t::eDestinationFrameChanged;
+    s.bufferData = std::make_shared<BufferData>();
+    s.bufferData->flags |= BufferData::BufferDataChange::frameNumberChanged;
+    s.bufferData->flags |= BufferData::BufferDataChange::cachedBufferChanged;
+    s.bufferData->frameNumber = 1;
+    s.bufferData->cachedBuffer.id = 1;
+    s.dataspace = ui::Dataspace::SRGB;
+    s.surfaceDamageRegion = Region(Rect(0, 0, 1080, 2400));
+    s.bufferCrop = Rect(0, 0, 1080, 2400);
+    s.destinationFrame = Rect(0, 0, 1080, 2400);
+    return composerState;
+}
+
+ComposerState createGeometryOnlyState() {
+    ComposerState composerState;
+    layer_state_t& s = composerState.state;
+    s.what = layer_state_t::ePositionChanged | layer_state_t::eMatrixChanged |
+            layer_state_t::eCropChanged | layer_state_t::eAlphaChanged |
+            layer_state_t::eCornerRadiusChanged;
+    s.x = 100.0f;
+    s.y = 200.0f;
+    s.matrix = {0.5f, 0.0f, 0.0f, 0.5f};
+    s.crop = Rect(0, 0, 540, 1200);
+    s.color.a = 0.5f;
+    s.cornerRadius = 16.0f;
+    return composerState;
+}
+
+void parcelState(benchmark::State& state, const ComposerState& composerState) {
+    Parcel parcel;
+    ComposerState readState;
+    for (auto _ : state) {
+        parcel.setDataSize(0);
+        composerState.write(parcel);
+        parcel.setDataPosition(0);
+        readState = ComposerState();
+        readState.read(parcel);
+        benchmark::DoNotOptimize(readState);
+    }
+    state.counters["bytes"] = parcel.dataSize();
+}
+
+void BM_ParcelBufferOnlyState(benchmark::State& state) {
+    parcelState(state, createBufferOnlyState());
+}
+BENCHMARK(BM_ParcelBufferOnlyState);
+
+void BM_ParcelGeometryOnlyState(benchmark::State& state) {
+    parcelState(state, createGeometryOnlyState());
+}
+BENCHMARK(BM_ParcelGeometryOnlyState);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
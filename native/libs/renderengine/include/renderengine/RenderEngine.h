@@ -33,6 +33,7 @@
 
 #include <future>
 #include <memory>
+#include <string>
 
 /**
  * Allows to set RenderEngine backend to GLES (default) or SkiaGL (NOT yet supported).
@@ -266,6 +267,9 @@ struct RenderEngineCreationArgs {
     bool supportsBackgroundBlur;
     RenderEngine::ContextPriority contextPriority;
     RenderEngine::RenderEngineType renderEngineType;
+    // If not empty, the Skia backends record the draws they issue to this file, and primeCache()
+    // compiles the shaders listed in it rather than the built-in set.
+    std::string shaderManifestPath;
 
     struct Builder;
 
@@ -275,7 +279,8 @@ private:
                              bool _enableProtectedContext, bool _precacheToneMapperShaderOnly,
                              bool _supportsBackgroundBlur,
                              RenderEngine::ContextPriority _contextPriority,
-                             RenderEngine::RenderEngineType _renderEngineType)
+                             RenderEngine::RenderEngineType _renderEngineType,
+                             std::string _shaderManifestPath)
           : pixelFormat(_pixelFormat),
             imageCacheSize(_imageCacheSize),
             useColorManagement(_useColorManagement),
@@ -283,7 +288,8 @@ private:
             precacheToneMapperShaderOnly(_precacheToneMapperShaderOnly),
             supportsBackgroundBlur(_supportsBackgroundBlur),
             contextPriority(_contextPriority),
-            renderEngineType(_renderEngineType) {}
+            renderEngineType(_renderEngineType),
+            shaderManifestPath(std::move(_shaderManifestPath)) {}
     RenderEngineCreationArgs() = delete;
 };
 
@@ -322,10 +328,15 @@ struct RenderEngineCreationArgs::Builder {
         this->renderEngineType = renderEngineType;
         return *this;
     }
+    Builder& setShaderManifestPath(std::string shaderManifestPath) {
+        this->shaderManifestPath = std::move(shaderManifestPath);
+        return *this;
+    }
     RenderEngineCreationArgs build() const {
         return RenderEngineCreationArgs(pixelFormat, imageCacheSize, useColorManagement,
                                         enableProtectedContext, precacheToneMapperShaderOnly,
-                                        supportsBackgroundBlur, contextPriority, renderEngineType);
+                                        supportsBackgroundBlur, contextPriority, renderEngineType,
+                                        shaderManifestPath);
     }
 
 private:
@@ -339,6 +350,7 @@ private:
     RenderEngine::ContextPriority contextPriority = RenderEngine::ContextPriority::MEDIUM;
     RenderEngine::RenderEngineType renderEngineType =
             RenderEngine::RenderEngineType::SKIA_GL_THREADED;
+    std::string shaderManifestPath;
 };
 
 } // namespace renderengine
@@ -15,6 +15,7 @@
  */
 #include "Cache.h"
 #include "AutoBackendTexture.h"
+#include "ShaderManifest.h"
 #include "SkiaRenderEngine.h"
 #include "android-base/unique_fd.h"
 #include "renderengine/DisplaySettings.h"
@@ -51,6 +52,8 @@ const auto kFlip = mat4(1.1f, -0.1f,  0.f, 0.f,
 // a color correction effect is added to the shader.
 constexpr auto kDestDataSpace = ui::Dataspace::SRGB;
 constexpr auto kOtherDataSpace = ui::Dataspace::DISPLAY_P3;
+// Any non-identity color transform adds a LinearEffect.
+const auto kLinearEffectColorTransform = mat4::scale(vec4(0.9f, 0.9f, 0.9f, 1.f));
 } // namespace
 
 static void drawShadowLayers(SkiaRenderEngine* renderengine, const DisplaySettings& display,
@@ -324,6 +327,66 @@ static void drawHolePunchLayer(SkiaRenderEngine* renderengine, const DisplaySett
     renderengine->drawLayers(display, layers, dstTexture, kUseFrameBufferCache, base::unique_fd());
 }
 
+// Builds a layer that generates the same shaders as the draws recorded under key.
+static LayerSettings createManifestLayer(const ShaderManifest::Key& key, const Rect& displayRect,
+                                         const std::shared_ptr<ExternalTexture>& srcTexture) {
+    const bool clipped = key.flags & ShaderManifest::CLIPPED;
+    const FloatRect crop(0, 0, displayRect.width(), displayRect.height());
+    LayerSettings layer;
+    // As in drawClippedLayers, a boundary slightly smaller than the rounded rect crop has to be
+    // clipped by it.
+    layer.geometry.boundaries =
+            clipped ? FloatRect(0, 0, displayRect.width(), displayRect.height() - 20) : crop;
+    layer.geometry.roundedCornersCrop = crop;
+    if (key.flags & ShaderManifest::ROUNDED_CORNERS) {
+        const float radius = clipped ? 27.f : 50.f;
+        layer.geometry.roundedCornersRadius = key.flags & ShaderManifest::ELLIPTICAL_CORNERS
+                ? vec2(radius, radius * 1.5f)
+                : vec2(radius, radius);
+    }
+    if (key.flags & ShaderManifest::ROTATED) {
+        layer.geometry.positionTransform = kFlip;
+    }
+    layer.sourceDataspace = key.inputDataspace;
+    layer.alpha = key.flags & ShaderManifest::TRANSLUCENT ? 0.5f : 1.f;
+    layer.disableBlending = key.flags & ShaderManifest::DISABLE_BLENDING;
+    if (key.flags & ShaderManifest::LINEAR_EFFECT) {
+        layer.colorTransform = kLinearEffectColorTransform;
+    }
+
+    switch (key.kind) {
+        case ShaderManifest::Kind::Solid:
+            layer.source.solidColor = half3(0.1f, 0.2f, 0.3f);
+            break;
+        case ShaderManifest::Kind::Image:
+            layer.source.buffer = Buffer{
+                    .buffer = srcTexture,
+                    .usePremultipliedAlpha =
+                            static_cast<bool>(key.flags & ShaderManifest::PREMULTIPLIED_ALPHA),
+                    .isOpaque = static_cast<bool>(key.flags & ShaderManifest::OPAQUE),
+                    .maxLuminanceNits = 1000.f,
+            };
+            break;
+        case ShaderManifest::Kind::Shadow:
+            layer.shadow = ShadowSettings{
+                    .boundaries = layer.geometry.boundaries,
+                    .ambientColor = vec4(0, 0, 0, 0.00935997f),
+                    .spotColor = vec4(0, 0, 0, 0.0455841f),
+                    .lightPos = vec3(500.f, -1500.f, 1500.f),
+                    .lightRadius = 2500.0f,
+                    .length = 15.f,
+            };
+            layer.skipContentDraw = true;
+            break;
+        case ShaderManifest::Kind::Blur:
+            // The same radii as drawBlurLayers, on each side of the crossfade threshold.
+            layer.backgroundBlurRadius = key.flags & ShaderManifest::CROSSFADE ? 9 : 60;
+            layer.skipContentDraw = true;
+            break;
+    }
+    return layer;
+}
+
 //
 // The collection of shaders cached here were found by using perfetto to record shader compiles
 // during actions that involve RenderEngine, logging the layer settings, and the shader code
@@ -447,4 +510,103 @@ void Cache::primeShaderCache(SkiaRenderEngine* renderengine) {
     }
 }
 
+// Unlike the above, the draws come from what the device drew before rather than from a fixed
+// list. They are submitted from the most to the least hit one without waiting for each to
+// complete, so that the shaders most likely to be needed are compiled first.
+void Cache::primeShaderCache(SkiaRenderEngine* renderengine, const ShaderManifest& manifest) {
+    const int previousCount = renderengine->reportShadersCompiled();
+    if (previousCount) {
+        ALOGD("%d Shaders already compiled before Cache::primeShaderCache ran\n", previousCount);
+    }
+
+    const nsecs_t timeBefore = systemTime();
+    const Rect displayRect(0, 0, 128, 128);
+    const int64_t usage = GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_TEXTURE;
+    sp<GraphicBuffer> dstBuffer =
+            sp<GraphicBuffer>::make(displayRect.width(), displayRect.height(),
+                                    PIXEL_FORMAT_RGBA_8888, 1, usage, "primeShaderCache_dst");
+    const auto dstTexture =
+            std::make_shared<impl::ExternalTexture>(dstBuffer, *renderengine,
+                                                    impl::ExternalTexture::Usage::WRITEABLE);
+
+    // Whether a buffer was sampled as an external texture is not recorded, so image draws are
+    // replayed with both kinds of source.
+    sp<GraphicBuffer> srcBuffer =
+            sp<GraphicBuffer>::make(displayRect.width(), displayRect.height(),
+                                    PIXEL_FORMAT_RGBA_8888, 1, usage, "drawImageLayer_src");
+    const auto srcTexture = std::make_shared<
+            impl::ExternalTexture>(srcBuffer, *renderengine,
+                                   impl::ExternalTexture::Usage::READABLE |
+                                           impl::ExternalTexture::Usage::WRITEABLE);
+    const int64_t usageExternal = GRALLOC_USAGE_HW_TEXTURE;
+    sp<GraphicBuffer> externalBuffer =
+            sp<GraphicBuffer>::make(displayRect.width(), displayRect.height(),
+                                    PIXEL_FORMAT_RGBA_8888, 1, usageExternal,
+                                    "primeShaderCache_external");
+    const auto externalTexture =
+            std::make_shared<impl::ExternalTexture>(externalBuffer, *renderengine,
+                                                    impl::ExternalTexture::Usage::READABLE);
+
+    // The isOpaque workaround is only taken for F16 or 1010102 buffers.
+    std::shared_ptr<ExternalTexture> f16ExternalTexture;
+    sp<GraphicBuffer> f16ExternalBuffer =
+            sp<GraphicBuffer>::make(displayRect.width(), displayRect.height(),
+                                    PIXEL_FORMAT_RGBA_FP16, 1, usageExternal,
+                                    "primeShaderCache_external_f16");
+    if (f16ExternalBuffer->initCheck() == NO_ERROR) {
+        f16ExternalTexture =
+                std::make_shared<impl::ExternalTexture>(f16ExternalBuffer, *renderengine,
+                                                        impl::ExternalTexture::Usage::READABLE);
+    }
+
+    size_t keysPrimed = 0;
+    for (const auto& [key, hits] : manifest.getEntriesByPriority()) {
+        if (key.kind == ShaderManifest::Kind::Blur && !renderengine->supportsBackgroundBlur()) {
+            continue;
+        }
+
+        const DisplaySettings display{
+                .physicalDisplay = displayRect,
+                .clip = displayRect,
+                .maxLuminance = 500,
+                .outputDataspace = key.outputDataspace,
+        };
+        std::vector<std::shared_ptr<ExternalTexture>> sources = {srcTexture, externalTexture};
+        if (key.flags & ShaderManifest::OPAQUE_WORKAROUND) {
+            if (!f16ExternalTexture) {
+                continue;
+            }
+            sources = {f16ExternalTexture};
+        } else if (key.kind != ShaderManifest::Kind::Image) {
+            sources.resize(1);
+        }
+        for (const auto& source : sources) {
+            auto layers = std::vector<LayerSettings>{createManifestLayer(key, displayRect, source)};
+            renderengine->drawLayers(display, layers, dstTexture, kUseFrameBufferCache,
+                                     base::unique_fd());
+        }
+        keysPrimed++;
+    }
+
+    // draw one final layer synchronously to force GL submit
+    const DisplaySettings display{
+            .physicalDisplay = displayRect,
+            .clip = displayRect,
+            .maxLuminance = 500,
+            .outputDataspace = kDestDataSpace,
+    };
+    LayerSettings layer{
+            .source = PixelSource{.solidColor = half3(0.f, 0.f, 0.f)},
+    };
+    auto layers = std::vector<LayerSettings>{layer};
+    renderengine->drawLayers(display, layers, dstTexture, kUseFrameBufferCache, base::unique_fd())
+            .get();
+
+    const nsecs_t timeAfter = systemTime();
+    const float compileTimeMs = static_cast<float>(timeAfter - timeBefore) / 1.0E6;
+    const int shadersCompiled = renderengine->reportShadersCompiled() - previousCount;
+    ALOGD("Shader cache generated %d shaders for %zu of %zu manifest keys in %f ms\n",
+          shadersCompiled, keysPrimed, manifest.size(), compileTimeMs);
+}
+
 } // namespace android::renderengine::skia
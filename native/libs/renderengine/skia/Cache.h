@@ -18,12 +18,16 @@
 
 namespace android::renderengine::skia {
 
+class ShaderManifest;
 class SkiaRenderEngine;
 
 class Cache {
 public:
     static void primeShaderCache(SkiaRenderEngine*);
 
+    // Only compiles the shaders of the draws listed in the manifest, the most hit first.
+    static void primeShaderCache(SkiaRenderEngine*, const ShaderManifest&);
+
 private:
     Cache() = default;
 };
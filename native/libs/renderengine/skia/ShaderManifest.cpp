@@ -0,0 +1,178 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ShaderManifest.h"
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <log/log.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <limits>
+#include <tuple>
+
+namespace android::renderengine::skia {
+
+namespace {
+constexpr std::string_view kHeader = "# RenderEngine shader manifest v1\n";
+
+auto asTuple(const ShaderManifest::Key& key) {
+    return std::make_tuple(key.kind, key.flags, static_cast<int32_t>(key.inputDataspace),
+                           static_cast<int32_t>(key.outputDataspace));
+}
+} // namespace
+
+size_t ShaderManifest::KeyHasher::operator()(const Key& key) const {
+    // Same combination as shaders::LinearEffectHasher.
+    auto combine = [](size_t seed, size_t val) {
+        return seed ^ (val + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+    };
+    size_t result = std::hash<uint8_t>{}(static_cast<uint8_t>(key.kind));
+    result = combine(result, std::hash<ui::Dataspace>{}(key.inputDataspace));
+    result = combine(result, std::hash<ui::Dataspace>{}(key.outputDataspace));
+    return combine(result, std::hash<uint32_t>{}(key.flags));
+}
+
+bool ShaderManifest::record(const Key& key) {
+    auto [it, inserted] = mHits.try_emplace(key, 0);
+    if (it->second < std::numeric_limits<uint32_t>::max()) {
+        it->second++;
+    }
+    return inserted;
+}
+
+std::vector<ShaderManifest::Entry> ShaderManifest::getEntriesByPriority() const {
+    std::vector<Entry> entries;
+    entries.reserve(mHits.size());
+    for (const auto& [key, hits] : mHits) {
+        entries.push_back({key, hits});
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+        if (lhs.hits != rhs.hits) {
+            return lhs.hits > rhs.hits;
+        }
+        return asTuple(lhs.key) < asTuple(rhs.key);
+    });
+    return entries;
+}
+
+bool ShaderManifest::covers(Kind kind, uint32_t flags, uint32_t mask) const {
+    return std::any_of(mHits.begin(), mHits.end(), [&](const auto& hit) {
+        return hit.first.kind == kind && (hit.first.flags & mask) == (flags & mask);
+    });
+}
+
+std::string ShaderManifest::serialize() const {
+    std::string result(kHeader);
+    for (const auto& [key, hits] : getEntriesByPriority()) {
+        base::StringAppendF(&result, "%s %" PRIx32 " %" PRIx32 " %" PRIx32 " %" PRIu32 "\n",
+                            toString(key.kind), static_cast<uint32_t>(key.inputDataspace),
+                            static_cast<uint32_t>(key.outputDataspace), key.flags, hits);
+    }
+    return result;
+}
+
+size_t ShaderManifest::parse(std::string_view text) {
+    size_t malformed = 0;
+    while (!text.empty()) {
+        const size_t end = std::min(text.find('\n'), text.size());
+        const std::string line(text.substr(0, end));
+        text.remove_prefix(std::min(end + 1, text.size()));
+
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        char kindName[16];
+        uint32_t inputDataspace, outputDataspace, flags, hits;
+        int consumed = 0;
+        if (sscanf(line.c_str(), "%15s %" SCNx32 " %" SCNx32 " %" SCNx32 " %" SCNu32 "%n",
+                   kindName, &inputDataspace, &outputDataspace, &flags, &hits, &consumed) != 5 ||
+            static_cast<size_t>(consumed) != line.size()) {
+            malformed++;
+            continue;
+        }
+        const auto kind = kindFromString(kindName);
+        if (!kind) {
+            malformed++;
+            continue;
+        }
+
+        const Key key{.kind = *kind,
+                      .inputDataspace = static_cast<ui::Dataspace>(inputDataspace),
+                      .outputDataspace = static_cast<ui::Dataspace>(outputDataspace),
+                      .flags = flags};
+        uint32_t& total = mHits[key];
+        total = hits > std::numeric_limits<uint32_t>::max() - total
+                ? std::numeric_limits<uint32_t>::max()
+                : total + hits;
+    }
+    return malformed;
+}
+
+bool ShaderManifest::load(const std::string& path) {
+    mHits.clear();
+    std::string text;
+    if (!base::ReadFileToString(path, &text)) {
+        return false;
+    }
+    if (const size_t malformed = parse(text)) {
+        ALOGW("Skipped %zu malformed lines in shader manifest %s", malformed, path.c_str());
+    }
+    return true;
+}
+
+bool ShaderManifest::save(const std::string& path) const {
+    const std::string tmpPath = path + ".tmp";
+    if (!base::WriteStringToFile(serialize(), tmpPath)) {
+        ALOGE("Failed to write shader manifest %s", tmpPath.c_str());
+        return false;
+    }
+    if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+        ALOGE("Failed to rename shader manifest to %s", path.c_str());
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+const char* ShaderManifest::toString(Kind kind) {
+    switch (kind) {
+        case Kind::Solid:
+            return "solid";
+        case Kind::Image:
+            return "image";
+        case Kind::Shadow:
+            return "shadow";
+        case Kind::Blur:
+            return "blur";
+    }
+    return "unknown";
+}
+
+std::optional<ShaderManifest::Kind> ShaderManifest::kindFromString(std::string_view name) {
+    for (Kind kind : {Kind::Solid, Kind::Image, Kind::Shadow, Kind::Blur}) {
+        if (name == toString(kind)) {
+            return kind;
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace android::renderengine::skia
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <ui/GraphicTypes.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace android::renderengine::skia {
+
+// Set of the draws SkiaRenderEngine has issued, each with the number of times it was hit, so that
+// Cache can prime the shaders a device actually uses instead of its built-in set.
+//
+// A key only keeps what selects the shader program Skia generates for a layer: the kind of draw,
+// the dataspaces of the LinearEffect if any, and a few flags. Uniforms like colors, radii and
+// matrices are left out.
+//
+// The manifest is stored as text, one key per line:
+//     <kind> <input dataspace> <output dataspace> <flags> <hits>
+// where the dataspaces and the flags are in hex. Empty lines and lines starting with '#' are
+// skipped.
+class ShaderManifest {
+public:
+    enum class Kind : uint8_t {
+        Solid,
+        Image,
+        Shadow,
+        Blur,
+    };
+
+    enum Flags : uint32_t {
+        // The layer has rounded corners.
+        ROUNDED_CORNERS = 1 << 0,
+        // The corners are rounded with a clip rather than by drawing a rounded rect.
+        CLIPPED = 1 << 1,
+        // The corners have different horizontal and vertical radii.
+        ELLIPTICAL_CORNERS = 1 << 2,
+        // The position transform rotates or skews the layer.
+        ROTATED = 1 << 3,
+        // The layer's alpha is below 1.
+        TRANSLUCENT = 1 << 4,
+        // The color is passed through a LinearEffect.
+        LINEAR_EFFECT = 1 << 5,
+        // The layer is drawn with SkBlendMode::kSrc.
+        DISABLE_BLENDING = 1 << 6,
+        // Image only: the buffer is opaque.
+        OPAQUE = 1 << 7,
+        // Image only: the buffer uses premultiplied alpha.
+        PREMULTIPLIED_ALPHA = 1 << 8,
+        // Image only: the buffer is an opaque F16 or 1010102 buffer, which needs the isOpaque
+        // workaround.
+        OPAQUE_WORKAROUND = 1 << 9,
+        // Blur only: the radius is small enough for the blur to be crossfaded with its input.
+        CROSSFADE = 1 << 10,
+    };
+
+    struct Key {
+        Kind kind = Kind::Solid;
+        ui::Dataspace inputDataspace = ui::Dataspace::UNKNOWN;
+        ui::Dataspace outputDataspace = ui::Dataspace::UNKNOWN;
+        uint32_t flags = 0;
+
+        bool operator==(const Key& other) const {
+            return kind == other.kind && inputDataspace == other.inputDataspace &&
+                    outputDataspace == other.outputDataspace && flags == other.flags;
+        }
+    };
+
+    struct Entry {
+        Key key;
+        uint32_t hits = 0;
+    };
+
+    // Counts a hit on key. Returns true if key wasn't in the manifest yet.
+    bool record(const Key& key);
+
+    // Returns the entries from the most to the least hit. Ties keep a stable order so that
+    // priming is reproducible.
+    std::vector<Entry> getEntriesByPriority() const;
+
+    // Returns true if an entry of the given kind has the given flags, compared under mask.
+    // Dataspaces are ignored.
+    bool covers(Kind kind, uint32_t flags, uint32_t mask) const;
+
+    size_t size() const { return mHits.size(); }
+    bool empty() const { return mHits.empty(); }
+    void clear() { mHits.clear(); }
+
+    std::string serialize() const;
+
+    // Adds the entries in text to the manifest, summing the hits of the keys already in it.
+    // Malformed lines are skipped, and their count is returned.
+    size_t parse(std::string_view text);
+
+    // Reads the manifest at path, replacing the current entries. Returns false if the file
+    // could not be read, in which case the manifest is left empty.
+    bool load(const std::string& path);
+
+    // Writes the manifest to path. The file is replaced atomically so that a crash while writing
+    // doesn't lose the previous manifest.
+    bool save(const std::string& path) const;
+
+    static const char* toString(Kind kind);
+    static std::optional<Kind> kindFromString(std::string_view name);
+
+private:
+    struct KeyHasher {
+        size_t operator()(const Key& key) const;
+    };
+
+    std::unordered_map<Key, uint32_t, KeyHasher> mHits;
+};
+
+} // namespace android::renderengine::skia
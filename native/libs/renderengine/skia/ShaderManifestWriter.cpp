@@ -0,0 +1,81 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ShaderManifestWriter.h"
+
+#include <pthread.h>
+#include <sys/resource.h>
+#include <system/thread_defs.h>
+#include <utils/Trace.h>
+
+namespace android::renderengine::skia {
+
+ShaderManifestWriter::ShaderManifestWriter(std::string path, std::chrono::milliseconds minInterval)
+      : mPath(std::move(path)), mMinInterval(minInterval) {
+    mThread = std::thread(&ShaderManifestWriter::threadMain, this);
+}
+
+ShaderManifestWriter::~ShaderManifestWriter() {
+    {
+        std::lock_guard lock(mMutex);
+        mExiting = true;
+    }
+    mCondition.notify_all();
+    mThread.join();
+}
+
+void ShaderManifestWriter::queueSave(ShaderManifest manifest) {
+    {
+        std::lock_guard lock(mMutex);
+        mPending = std::move(manifest);
+    }
+    mCondition.notify_all();
+}
+
+void ShaderManifestWriter::flush() {
+    std::lock_guard lock(mMutex);
+    mCondition.wait(mMutex, [this]() REQUIRES(mMutex) { return !mPending && !mWriting; });
+}
+
+void ShaderManifestWriter::threadMain() {
+    pthread_setname_np(pthread_self(), "ShaderManifest");
+    setpriority(PRIO_PROCESS, 0, ANDROID_PRIORITY_BACKGROUND);
+
+    while (true) {
+        std::optional<ShaderManifest> manifest;
+        {
+            std::lock_guard lock(mMutex);
+            mCondition.wait(mMutex, [this]() REQUIRES(mMutex) { return mPending || mExiting; });
+            if (!mPending) {
+                return;
+            }
+            manifest.swap(mPending);
+            mWriting = true;
+        }
+        {
+            ATRACE_NAME("SaveShaderManifest");
+            manifest->save(mPath);
+        }
+        std::lock_guard lock(mMutex);
+        mWriting = false;
+        mCondition.notify_all();
+        // Let the keys recorded meanwhile pile up in mPending. Exiting cuts the wait short, and
+        // what is pending is still written.
+        mCondition.wait_for(mMutex, mMinInterval, [this]() REQUIRES(mMutex) { return mExiting; });
+    }
+}
+
+} // namespace android::renderengine::skia
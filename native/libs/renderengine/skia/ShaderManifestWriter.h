@@ -0,0 +1,63 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "ShaderManifest.h"
+
+namespace android::renderengine::skia {
+
+// Saves a ShaderManifest from a background thread, so that the thread that renders never waits
+// on the file system.
+//
+// Only the last manifest queued is written, and writes are at least minInterval apart: the burst
+// of new keys seen early after boot ends up in a few writes rather than one per key.
+class ShaderManifestWriter {
+public:
+    ShaderManifestWriter(std::string path, std::chrono::milliseconds minInterval);
+    // Writes the manifest still queued, if any, before returning.
+    ~ShaderManifestWriter();
+
+    // Replaces the manifest waiting to be written, if any.
+    void queueSave(ShaderManifest manifest);
+
+    // Blocks until the queued manifest, if any, is written. Only meant for tests.
+    void flush();
+
+private:
+    void threadMain();
+
+    const std::string mPath;
+    const std::chrono::milliseconds mMinInterval;
+
+    std::mutex mMutex;
+    std::condition_variable_any mCondition;
+    std::optional<ShaderManifest> mPending GUARDED_BY(mMutex);
+    bool mWriting GUARDED_BY(mMutex) = false;
+    bool mExiting GUARDED_BY(mMutex) = false;
+    std::thread mThread;
+};
+
+} // namespace android::renderengine::skia
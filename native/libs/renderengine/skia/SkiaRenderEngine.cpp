@@ -68,6 +68,7 @@
 #include <deque>
 #include <memory>
 #include <numeric>
+#include <optional>
 
 #include "Cache.h"
 #include "ColorSpaces.h"
@@ -242,7 +243,21 @@ namespace skia {
 using base::StringAppendF;
 
 std::future<void> SkiaRenderEngine::primeCache() {
-    Cache::primeShaderCache(this);
+    ShaderManifest manifest;
+    {
+        std::lock_guard<std::mutex> lock(mRenderingMutex);
+        manifest = mShaderManifest;
+        mPrimingCache = true;
+    }
+    if (manifest.empty()) {
+        Cache::primeShaderCache(this);
+    } else {
+        Cache::primeShaderCache(this, manifest);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mRenderingMutex);
+        mPrimingCache = false;
+    }
     return {};
 }
 
@@ -268,15 +283,27 @@ void SkiaRenderEngine::setEnableTracing(bool tracingEnabled) {
 }
 
 SkiaRenderEngine::SkiaRenderEngine(RenderEngineType type, PixelFormat pixelFormat,
-                                   bool useColorManagement, bool supportsBackgroundBlur)
+                                   bool useColorManagement, bool supportsBackgroundBlur,
+                                   std::string shaderManifestPath)
       : RenderEngine(type),
         mDefaultPixelFormat(pixelFormat),
-        mUseColorManagement(useColorManagement) {
+        mUseColorManagement(useColorManagement),
+        mShaderManifestPath(std::move(shaderManifestPath)) {
     if (supportsBackgroundBlur) {
         ALOGD("Background Blurs Enabled");
         mBlurFilter = new KawaseBlurFilter();
     }
     mCapture = std::make_unique<SkiaCapture>();
+    if (!mShaderManifestPath.empty() && mShaderManifest.load(mShaderManifestPath)) {
+        ALOGD("Loaded %zu shader keys from %s", mShaderManifest.size(),
+              mShaderManifestPath.c_str());
+    }
+    if (!mShaderManifestPath.empty()) {
+        // New keys come in bursts early after boot, one write covers a burst.
+        static constexpr std::chrono::seconds kMinSaveInterval{1};
+        mShaderManifestWriter =
+                std::make_unique<ShaderManifestWriter>(mShaderManifestPath, kMinSaveInterval);
+    }
 }
 
 SkiaRenderEngine::~SkiaRenderEngine() { }
@@ -481,13 +508,35 @@ std::shared_ptr<AutoBackendTexture::LocalRef> SkiaRenderEngine::getOrCreateBacke
 
 bool SkiaRenderEngine::canSkipPostRenderCleanup() const {
     std::lock_guard<std::mutex> lock(mRenderingMutex);
-    return mTextureCleanupMgr.isEmpty();
+    return mTextureCleanupMgr.isEmpty() && !mShaderManifestDirty;
 }
 
 void SkiaRenderEngine::cleanupPostRender() {
     ATRACE_CALL();
-    std::lock_guard<std::mutex> lock(mRenderingMutex);
-    mTextureCleanupMgr.cleanup();
+    std::optional<ShaderManifest> manifest;
+    {
+        std::lock_guard<std::mutex> lock(mRenderingMutex);
+        mTextureCleanupMgr.cleanup();
+        if (mShaderManifestDirty) {
+            manifest = mShaderManifest;
+            mShaderManifestDirty = false;
+            mShaderManifestPendingHits = 0;
+        }
+    }
+    // With RenderEngineThreaded this runs on the RenderEngine thread and the next drawLayers()
+    // waits behind it, so the file is written by mShaderManifestWriter.
+    if (manifest) {
+        mShaderManifestWriter->queueSave(std::move(*manifest));
+    }
+}
+
+void SkiaRenderEngine::recordShaderKey(const ShaderManifest::Key& key) {
+    // A new key is saved right away. Otherwise the hit counts, which only order the priming, are
+    // saved once in a while.
+    static constexpr uint32_t kSaveHitsInterval = 4096;
+    if (mShaderManifest.record(key) || ++mShaderManifestPendingHits >= kSaveHitsInterval) {
+        mShaderManifestDirty = true;
+    }
 }
 
 sk_sp<SkShader> SkiaRenderEngine::createRuntimeEffectShader(
@@ -616,6 +665,24 @@ static bool equalsWithinMargin(float expected, float value, float margin = kDefa
     return std::abs(expected - value) < margin;
 }
 
+// Returns the ShaderManifest flags describing how rrect is rounded once drawn with matrix.
+static uint32_t getGeometryFlags(const SkMatrix& matrix, const SkRRect& rrect) {
+    uint32_t flags = 0;
+    if (matrix.getSkewX() != 0 || matrix.getSkewY() != 0) {
+        flags |= ShaderManifest::ROTATED;
+    }
+    if (rrect.isEmpty() || rrect.isRect()) {
+        return flags;
+    }
+    flags |= ShaderManifest::ROUNDED_CORNERS;
+    const SkVector radii = rrect.radii(SkRRect::kUpperLeft_Corner);
+    if (!equalsWithinMargin(radii.fX * std::abs(matrix.getScaleX()),
+                            radii.fY * std::abs(matrix.getScaleY()))) {
+        flags |= ShaderManifest::ELLIPTICAL_CORNERS;
+    }
+    return flags;
+}
+
 namespace {
 template <typename T>
 void logSettings(const T& t) {
@@ -665,6 +732,7 @@ void SkiaRenderEngine::drawLayersInternal(
     validateOutputBufferUsage(buffer->getBuffer());
 
     auto grContext = getActiveGrContext();
+    const bool recordShaders = !mShaderManifestPath.empty() && !mPrimingCache;
 
     // any AutoBackendTexture deletions will now be deferred until cleanupPostRender is called
     DeferTextureCleanup dtc(mTextureCleanupMgr);
@@ -846,6 +914,21 @@ void SkiaRenderEngine::drawLayersInternal(
 
                     mBlurFilter->drawBlurRegion(canvas, bounds, layer.backgroundBlurRadius, 1.0f,
                                                 blurRect, blurredImage, blurInput);
+
+                    if (recordShaders) {
+                        uint32_t flags = getGeometryFlags(canvas->getTotalMatrix(),
+                                                          roundRectClip.isEmpty() ? bounds
+                                                                                  : roundRectClip);
+                        if (!roundRectClip.isEmpty()) {
+                            flags |= ShaderManifest::CLIPPED;
+                        }
+                        if (layer.backgroundBlurRadius < mBlurFilter->getMaxCrossFadeRadius()) {
+                            flags |= ShaderManifest::CROSSFADE;
+                        }
+                        recordShaderKey({.kind = ShaderManifest::Kind::Blur,
+                                         .outputDataspace = display.outputDataspace,
+                                         .flags = flags});
+                    }
                 }
 
                 canvas->concat(getSkM44(layer.blurRegionTransform).asM33());
@@ -860,6 +943,20 @@ void SkiaRenderEngine::drawLayersInternal(
                     mBlurFilter->drawBlurRegion(canvas, getBlurRRect(region), region.blurRadius,
                                                 region.alpha, blurRect,
                                                 cachedBlurs[region.blurRadius], blurInput);
+
+                    if (recordShaders) {
+                        uint32_t flags =
+                                getGeometryFlags(canvas->getTotalMatrix(), getBlurRRect(region));
+                        if (region.blurRadius < mBlurFilter->getMaxCrossFadeRadius()) {
+                            flags |= ShaderManifest::CROSSFADE;
+                        }
+                        if (region.alpha < 1.0f) {
+                            flags |= ShaderManifest::TRANSLUCENT;
+                        }
+                        recordShaderKey({.kind = ShaderManifest::Kind::Blur,
+                                         .outputDataspace = display.outputDataspace,
+                                         .flags = flags});
+                    }
                 }
             }
         }
@@ -887,6 +984,12 @@ void SkiaRenderEngine::drawLayersInternal(
             const auto& rrect =
                     shadowBounds.isRect() && !shadowClip.isEmpty() ? shadowClip : shadowBounds;
             drawShadow(canvas, rrect, layer.shadow);
+
+            if (recordShaders) {
+                recordShaderKey({.kind = ShaderManifest::Kind::Shadow,
+                                 .outputDataspace = display.outputDataspace,
+                                 .flags = getGeometryFlags(canvas->getTotalMatrix(), rrect)});
+            }
         }
 
         const float layerDimmingRatio = layer.whitePointNits <= 0.f
@@ -934,6 +1037,11 @@ void SkiaRenderEngine::drawLayersInternal(
         const ui::Dataspace layerDataspace =
                 !mUseColorManagement ? display.outputDataspace : layer.sourceDataspace;
 
+        ShaderManifest::Key shaderKey{.inputDataspace = layerDataspace,
+                                      .outputDataspace = requiresLinearEffect
+                                              ? runtimeEffectDataspace
+                                              : display.outputDataspace};
+
         SkPaint paint;
         if (layer.source.buffer.buffer) {
             ATRACE_NAME("DrawImage");
@@ -970,6 +1078,17 @@ void SkiaRenderEngine::drawLayersInternal(
                                                          : kUnpremul_SkAlphaType;
             sk_sp<SkImage> image = imageTextureRef->makeImage(layerDataspace, alphaType, grContext);
 
+            shaderKey.kind = ShaderManifest::Kind::Image;
+            if (item.isOpaque) {
+                shaderKey.flags |= ShaderManifest::OPAQUE;
+            }
+            if (item.usePremultipliedAlpha) {
+                shaderKey.flags |= ShaderManifest::PREMULTIPLIED_ALPHA;
+            }
+            if (useIsOpaqueWorkaround) {
+                shaderKey.flags |= ShaderManifest::OPAQUE_WORKAROUND;
+            }
+
             auto texMatrix = getSkM44(item.textureTransform).asM33();
             // textureTansform was intended to be passed directly into a shader, so when
             // building the total matrix with the textureTransform we need to first
@@ -1064,6 +1183,7 @@ void SkiaRenderEngine::drawLayersInternal(
             }
         } else {
             ATRACE_NAME("DrawColor");
+            shaderKey.kind = ShaderManifest::Kind::Solid;
             const auto color = layer.source.solidColor;
             sk_sp<SkShader> shader = SkShaders::Color(SkColor4f{.fR = color.r,
                                                                 .fG = color.g,
@@ -1107,6 +1227,24 @@ void SkiaRenderEngine::drawLayersInternal(
             }
         }
 
+        if (recordShaders) {
+            shaderKey.flags |= getGeometryFlags(canvas->getTotalMatrix(),
+                                                roundRectClip.isEmpty() ? bounds : roundRectClip);
+            if (!roundRectClip.isEmpty()) {
+                shaderKey.flags |= ShaderManifest::CLIPPED;
+            }
+            if (requiresLinearEffect) {
+                shaderKey.flags |= ShaderManifest::LINEAR_EFFECT;
+            }
+            if (layer.alpha < 1.0f) {
+                shaderKey.flags |= ShaderManifest::TRANSLUCENT;
+            }
+            if (layer.disableBlending) {
+                shaderKey.flags |= ShaderManifest::DISABLE_BLENDING;
+            }
+            recordShaderKey(shaderKey);
+        }
+
         if (!roundRectClip.isEmpty()) {
             canvas->clipRRect(roundRectClip, true);
         }
@@ -1212,6 +1350,11 @@ void SkiaRenderEngine::dump(std::string& result) {
     StringAppendF(&result, "RenderEngine is in protected context: %d\n", mInProtectedContext);
     StringAppendF(&result, "RenderEngine shaders cached since last dump/primeCache: %d\n",
                   mSkSLCacheMonitor.shadersCachedSinceLastCall());
+    if (!mShaderManifestPath.empty()) {
+        std::lock_guard<std::mutex> lock(mRenderingMutex);
+        StringAppendF(&result, "RenderEngine shader manifest %s: %zu keys\n",
+                      mShaderManifestPath.c_str(), mShaderManifest.size());
+    }
 
     std::vector<ResourcePair> cpuResourceMap = {
             {"skia/sk_resource_cache/bitmap_", "Bitmaps"},
@@ -33,6 +33,8 @@
 
 #include "AutoBackendTexture.h"
 #include "GrContextOptions.h"
+#include "ShaderManifest.h"
+#include "ShaderManifestWriter.h"
 #include "SkImageInfo.h"
 #include "SkiaRenderEngine.h"
 #include "android-base/macros.h"
@@ -62,7 +64,8 @@ public:
     SkiaRenderEngine(RenderEngineType type,
                      PixelFormat pixelFormat,
                      bool useColorManagement,
-                     bool supportsBackgroundBlur);
+                     bool supportsBackgroundBlur,
+                     std::string shaderManifestPath);
     ~SkiaRenderEngine() override;
 
     std::future<void> primeCache() override final;
@@ -160,6 +163,8 @@ private:
     };
     sk_sp<SkShader> createRuntimeEffectShader(const RuntimeEffectShaderParameters&);
 
+    void recordShaderKey(const ShaderManifest::Key& key) REQUIRES(mRenderingMutex);
+
     const PixelFormat mDefaultPixelFormat;
     const bool mUseColorManagement;
 
@@ -192,6 +197,18 @@ private:
     mutable std::mutex mRenderingMutex;
     SkSLCacheMonitor mSkSLCacheMonitor;
 
+    // Where the draws issued by this instance are recorded, empty if they are not.
+    const std::string mShaderManifestPath;
+    ShaderManifest mShaderManifest GUARDED_BY(mRenderingMutex);
+    // Hits recorded since mShaderManifest was last saved.
+    uint32_t mShaderManifestPendingHits GUARDED_BY(mRenderingMutex) = 0;
+    // Whether mShaderManifest should be saved by the next cleanupPostRender().
+    bool mShaderManifestDirty GUARDED_BY(mRenderingMutex) = false;
+    // Saves mShaderManifest off the rendering thread, null if draws are not recorded.
+    std::unique_ptr<ShaderManifestWriter> mShaderManifestWriter;
+    // Set while Cache draws, so that the priming draws are not recorded.
+    bool mPrimingCache GUARDED_BY(mRenderingMutex) = false;
+
     // Graphics context used for creating surfaces and submitting commands
     sk_sp<GrDirectContext> mGrContext;
     // Same as above, but for protected content (eg. DRM)
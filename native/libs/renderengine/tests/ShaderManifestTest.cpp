@@ -0,0 +1,158 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "ShaderManifestTest"
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include "../skia/ShaderManifest.h"
+#include "../skia/ShaderManifestWriter.h"
+
+namespace android::renderengine::skia {
+
+using Key = ShaderManifest::Key;
+using Kind = ShaderManifest::Kind;
+
+const Key kImage{.kind = Kind::Image,
+                 .inputDataspace = ui::Dataspace::DISPLAY_P3,
+                 .outputDataspace = ui::Dataspace::SRGB,
+                 .flags = ShaderManifest::ROUNDED_CORNERS | ShaderManifest::LINEAR_EFFECT};
+const Key kShadow{.kind = Kind::Shadow,
+                  .outputDataspace = ui::Dataspace::SRGB,
+                  .flags = ShaderManifest::ROUNDED_CORNERS};
+const Key kBlur{.kind = Kind::Blur,
+                .outputDataspace = ui::Dataspace::SRGB,
+                .flags = ShaderManifest::CROSSFADE};
+
+TEST(ShaderManifestTest, recordCountsHits) {
+    ShaderManifest manifest;
+    EXPECT_TRUE(manifest.record(kImage));
+    EXPECT_FALSE(manifest.record(kImage));
+    EXPECT_TRUE(manifest.record(kShadow));
+
+    const auto entries = manifest.getEntriesByPriority();
+    ASSERT_EQ(2u, entries.size());
+    EXPECT_EQ(kImage, entries[0].key);
+    EXPECT_EQ(2u, entries[0].hits);
+    EXPECT_EQ(kShadow, entries[1].key);
+    EXPECT_EQ(1u, entries[1].hits);
+}
+
+TEST(ShaderManifestTest, differentFlagsAreDifferentKeys) {
+    ShaderManifest manifest;
+    Key clipped = kImage;
+    clipped.flags |= ShaderManifest::CLIPPED;
+    EXPECT_TRUE(manifest.record(kImage));
+    EXPECT_TRUE(manifest.record(clipped));
+    EXPECT_EQ(2u, manifest.size());
+}
+
+TEST(ShaderManifestTest, serializeRoundTrips) {
+    ShaderManifest manifest;
+    for (int i = 0; i < 3; i++) {
+        manifest.record(kBlur);
+    }
+    manifest.record(kImage);
+    manifest.record(kImage);
+    manifest.record(kShadow);
+
+    ShaderManifest parsed;
+    EXPECT_EQ(0u, parsed.parse(manifest.serialize()));
+    const auto expected = manifest.getEntriesByPriority();
+    const auto actual = parsed.getEntriesByPriority();
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        EXPECT_EQ(expected[i].key, actual[i].key);
+        EXPECT_EQ(expected[i].hits, actual[i].hits);
+    }
+    EXPECT_EQ(kBlur, actual[0].key);
+}
+
+TEST(ShaderManifestTest, parseSkipsMalformedLines) {
+    ShaderManifest manifest;
+    EXPECT_EQ(3u,
+              manifest.parse("# comment\n"
+                             "\n"
+                             "solid 8810000 8810000 10 4\n"
+                             "sparkles 0 0 0 1\n"
+                             "image 0 0\n"
+                             "shadow 0 8810000 1 2 extra\n"
+                             "blur 0 8810000 400 7"));
+    const auto entries = manifest.getEntriesByPriority();
+    ASSERT_EQ(2u, entries.size());
+    EXPECT_EQ(Kind::Blur, entries[0].key.kind);
+    EXPECT_EQ(7u, entries[0].hits);
+    EXPECT_EQ(Kind::Solid, entries[1].key.kind);
+    EXPECT_EQ(ui::Dataspace::V0_SRGB, entries[1].key.inputDataspace);
+    EXPECT_EQ(ShaderManifest::TRANSLUCENT, entries[1].key.flags);
+}
+
+TEST(ShaderManifestTest, coversComparesMaskedFlags) {
+    ShaderManifest manifest;
+    manifest.record(kImage);
+
+    const uint32_t mask = ShaderManifest::ROUNDED_CORNERS | ShaderManifest::LINEAR_EFFECT;
+    EXPECT_TRUE(manifest.covers(Kind::Image, kImage.flags | ShaderManifest::CLIPPED, mask));
+    EXPECT_FALSE(manifest.covers(Kind::Image, ShaderManifest::ROUNDED_CORNERS, mask));
+    EXPECT_FALSE(manifest.covers(Kind::Solid, kImage.flags, mask));
+}
+
+TEST(ShaderManifestTest, saveAndLoad) {
+    TemporaryDir dir;
+    const std::string path = std::string(dir.path) + "/shader_manifest";
+
+    ShaderManifest manifest;
+    EXPECT_FALSE(manifest.load(path));
+    manifest.record(kImage);
+    manifest.record(kShadow);
+    ASSERT_TRUE(manifest.save(path));
+
+    ShaderManifest loaded;
+    loaded.record(kBlur);
+    ASSERT_TRUE(loaded.load(path));
+    EXPECT_EQ(2u, loaded.size());
+    EXPECT_FALSE(loaded.covers(Kind::Blur, 0, 0));
+}
+
+
+TEST(ShaderManifestTest, writerCoalescesSaves) {
+    TemporaryDir dir;
+    const std::string path = std::string(dir.path) + "/shader_manifest";
+    ShaderManifest manifest;
+    ShaderManifest loaded;
+    {
+        ShaderManifestWriter writer(path, std::chrono::hours(1));
+        manifest.record(kImage);
+        writer.queueSave(manifest);
+        writer.flush();
+        ASSERT_TRUE(loaded.load(path));
+        EXPECT_EQ(1u, loaded.size());
+
+        // Within the interval, only the last manifest queued is kept.
+        manifest.record(kShadow);
+        writer.queueSave(manifest);
+        manifest.record(kBlur);
+        writer.queueSave(manifest);
+        ASSERT_TRUE(loaded.load(path));
+        EXPECT_EQ(1u, loaded.size());
+    }
+    // Destroying the writer writes it.
+    ASSERT_TRUE(loaded.load(path));
+    EXPECT_EQ(3u, loaded.size());
+}
+} // namespace android::renderengine::skia
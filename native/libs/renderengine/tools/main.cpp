@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "frameworks/native/services/surfaceflinger/layerproto/layerstrace.pb.h"
+#include "skia/ShaderManifest.h"
+
+using android::renderengine::skia::ShaderManifest;
+using android::surfaceflinger::HwcCompositionType;
+using android::surfaceflinger::LayerProto;
+using android::surfaceflinger::LayersTraceFileProto;
+
+namespace {
+
+// The radius under which BlurFilter crossfades the blur with its input, see its constructor.
+constexpr uint32_t kMaxCrossFadeRadius = 10;
+
+// The flags a layers trace tells about. The others, like whether the corners are clipped, depend
+// on the geometry SurfaceFlinger computes when compositing. LINEAR_EFFECT depends on the
+// dataspaces and dimming of the layer and the display, which the trace does not have.
+constexpr uint32_t kTracedFlags = ShaderManifest::ROUNDED_CORNERS | ShaderManifest::TRANSLUCENT |
+        ShaderManifest::OPAQUE | ShaderManifest::CROSSFADE;
+
+using TracedKey = std::tuple<ShaderManifest::Kind, uint32_t>;
+
+// Returns the keys RenderEngine records when compositing layer.
+std::vector<TracedKey> getTracedKeys(const LayerProto& layer) {
+    std::vector<TracedKey> keys;
+    const uint32_t rounded = layer.corner_radius() > 0 ? ShaderManifest::ROUNDED_CORNERS : 0;
+
+    if (layer.shadow_radius() > 0) {
+        keys.emplace_back(ShaderManifest::Kind::Shadow, rounded);
+    }
+    if (layer.background_blur_radius() > 0) {
+        const uint32_t crossfade = static_cast<uint32_t>(layer.background_blur_radius()) <
+                        kMaxCrossFadeRadius
+                ? ShaderManifest::CROSSFADE
+                : 0;
+        keys.emplace_back(ShaderManifest::Kind::Blur, rounded | crossfade);
+    }
+    for (const auto& region : layer.blur_regions()) {
+        uint32_t flags = region.blur_radius() < kMaxCrossFadeRadius ? ShaderManifest::CROSSFADE : 0;
+        if (region.corner_radius_tl() > 0) {
+            flags |= ShaderManifest::ROUNDED_CORNERS;
+        }
+        if (region.alpha() < 1.f) {
+            flags |= ShaderManifest::TRANSLUCENT;
+        }
+        keys.emplace_back(ShaderManifest::Kind::Blur, flags);
+    }
+
+    const bool hasBuffer = layer.has_active_buffer() && layer.active_buffer().width() > 0;
+    const float alpha = layer.color().a();
+    if (!hasBuffer && alpha <= 0.f) {
+        return keys;
+    }
+    uint32_t flags = rounded;
+    if (alpha < 1.f) {
+        flags |= ShaderManifest::TRANSLUCENT;
+    }
+    if (hasBuffer && layer.is_opaque()) {
+        flags |= ShaderManifest::OPAQUE;
+    }
+    keys.emplace_back(hasBuffer ? ShaderManifest::Kind::Image : ShaderManifest::Kind::Solid, flags);
+    return keys;
+}
+
+std::string toString(const TracedKey& key) {
+    const auto [kind, flags] = key;
+    std::string result = ShaderManifest::toString(kind);
+    for (const auto& [flag, name] : std::initializer_list<std::pair<uint32_t, const char*>>{
+                 {ShaderManifest::ROUNDED_CORNERS, "rounded"},
+                 {ShaderManifest::TRANSLUCENT, "translucent"},
+                 {ShaderManifest::OPAQUE, "opaque"},
+                 {ShaderManifest::CROSSFADE, "crossfade"},
+         }) {
+        if (flags & flag) {
+            result += " ";
+            result += name;
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cout << "Usage: " << argv[0] << " shader-manifest-path layers-trace-path\n";
+        return -1;
+    }
+
+    ShaderManifest manifest;
+    if (!manifest.load(argv[1])) {
+        std::cout << "Error: Could not read " << argv[1] << "\n";
+        return -1;
+    }
+
+    const char* layersTracePath = argv[2];
+    std::fstream input(layersTracePath, std::ios::in | std::ios::binary);
+    if (!input) {
+        std::cout << "Error: Could not open " << layersTracePath << "\n";
+        return -1;
+    }
+    LayersTraceFileProto layersTraceFile;
+    if (!layersTraceFile.ParseFromIstream(&input)) {
+        std::cout << "Error: Failed to parse " << layersTracePath << "\n";
+        return -1;
+    }
+
+    size_t skippedEntries = 0;
+    uint64_t draws = 0;
+    std::map<TracedKey, uint64_t> uncovered;
+    for (const auto& entry : layersTraceFile.entry()) {
+        if (entry.excludes_composition_state()) {
+            skippedEntries++;
+            continue;
+        }
+        for (const auto& layer : entry.layers().layers()) {
+            if (layer.hwc_composition_type() != HwcCompositionType::CLIENT) {
+                continue;
+            }
+            for (const auto& key : getTracedKeys(layer)) {
+                draws++;
+                const auto [kind, flags] = key;
+                if (!manifest.covers(kind, flags, kTracedFlags)) {
+                    uncovered[key]++;
+                }
+            }
+        }
+    }
+
+    if (skippedEntries) {
+        std::cout << "Skipped " << skippedEntries << " of " << layersTraceFile.entry_size()
+                  << " entries without composition state\n";
+    }
+    uint64_t uncoveredDraws = 0;
+    for (const auto& [key, count] : uncovered) {
+        uncoveredDraws += count;
+    }
+    std::cout << "Manifest has " << manifest.size() << " keys, covering "
+              << draws - uncoveredDraws << " of " << draws << " RenderEngine draws\n";
+    for (const auto& [key, count] : uncovered) {
+        std::cout << "  not covered: " << toString(key) << " (" << count << " draws)\n";
+    }
+    return uncovered.empty() ? 0 : 1;
+}
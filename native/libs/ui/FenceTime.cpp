@@ -20,13 +20,100 @@
 
 #include <cutils/compiler.h>  // For CC_[UN]LIKELY
 #include <utils/Log.h>
+#include <errno.h>
 #include <inttypes.h>
+#include <poll.h>
 #include <stdlib.h>
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <memory>
 
 namespace android {
 
+namespace {
+
+// Keeps the memory of released FenceTimes for the next ones, so that the
+// FenceTimes created and dropped every frame don't each go through malloc.
+template <size_t SIZE>
+class FenceTimeBlockPool {
+public:
+    // Never destroyed, FenceTimes may outlive static destructors.
+    static FenceTimeBlockPool& getInstance() {
+        static FenceTimeBlockPool* sPool = new FenceTimeBlockPool;
+        return *sPool;
+    }
+
+    void* allocate() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mFreeCount > 0) {
+                return mFreeBlocks[--mFreeCount];
+            }
+        }
+        return ::operator new(SIZE);
+    }
+
+    void deallocate(void* block) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mFreeCount < MAX_FREE_BLOCKS) {
+                mFreeBlocks[mFreeCount++] = block;
+                return;
+            }
+        }
+        ::operator delete(block);
+    }
+
+private:
+    // A few frames worth of FenceTimes for several surfaces.
+    static constexpr size_t MAX_FREE_BLOCKS = 256;
+
+    std::mutex mMutex;
+    size_t mFreeCount GUARDED_BY(mMutex) = 0;
+    std::array<void*, MAX_FREE_BLOCKS> mFreeBlocks GUARDED_BY(mMutex);
+};
+
+// Allocator for std::allocate_shared, which rebinds it to its control block
+// holding the FenceTime.
+template <typename T>
+struct FenceTimeAllocator {
+    static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned type");
+
+    using value_type = T;
+
+    FenceTimeAllocator() = default;
+    template <typename U>
+    FenceTimeAllocator(const FenceTimeAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        if (n != 1) {
+            return std::allocator<T>().allocate(n);
+        }
+        return static_cast<T*>(FenceTimeBlockPool<sizeof(T)>::getInstance().allocate());
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (n != 1) {
+            std::allocator<T>().deallocate(p, n);
+            return;
+        }
+        FenceTimeBlockPool<sizeof(T)>::getInstance().deallocate(p);
+    }
+
+    template <typename U>
+    bool operator==(const FenceTimeAllocator<U>&) const {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(const FenceTimeAllocator<U>&) const {
+        return false;
+    }
+};
+
+} // namespace
+
 // ============================================================================
 // FenceTime
 // ============================================================================
@@ -125,6 +212,14 @@ status_t FenceTime::wait(int timeout) {
     return fence->wait(timeout);
 }
 
+std::shared_ptr<FenceTime> FenceTime::create(const sp<Fence>& fence) {
+    return std::allocate_shared<FenceTime>(FenceTimeAllocator<FenceTime>(), fence);
+}
+
+std::shared_ptr<FenceTime> FenceTime::create(nsecs_t signalTime) {
+    return std::allocate_shared<FenceTime>(FenceTimeAllocator<FenceTime>(), signalTime);
+}
+
 nsecs_t FenceTime::getSignalTime() {
     // See if we already have a cached value we can return.
     nsecs_t signalTime = mSignalTime.load(std::memory_order_relaxed);
@@ -177,6 +272,64 @@ nsecs_t FenceTime::getCachedSignalTime() const {
     return mSignalTime.load(std::memory_order_acquire);
 }
 
+void FenceTime::updateSignalTimes(const std::shared_ptr<FenceTime>* fenceTimes, size_t count) {
+    constexpr size_t kBatchSize = FenceTimeline::MAX_ENTRIES;
+    std::array<FenceTime*, kBatchSize> polledFenceTimes;
+    std::array<sp<Fence>, kBatchSize> polledFences;
+    std::array<struct pollfd, kBatchSize> pollFds;
+
+    while (count > 0) {
+        const size_t batchSize = std::min(count, kBatchSize);
+        size_t polledCount = 0;
+        for (size_t i = 0; i < batchSize; i++) {
+            FenceTime* fenceTime = fenceTimes[i].get();
+            sp<Fence> fence = fenceTime->getPendingFence();
+            if (fence == nullptr) {
+                continue;
+            }
+            if (!fence->isValid() || fenceTime->mState == State::FORCED_VALID_FOR_TEST) {
+                // Nothing to poll, let the fence answer for itself.
+                fenceTime->getSignalTime();
+                continue;
+            }
+            polledFenceTimes[polledCount] = fenceTime;
+            pollFds[polledCount].fd = fence->get();
+            pollFds[polledCount].events = POLLIN;
+            pollFds[polledCount].revents = 0;
+            // Keeps the fd open until the poll is done.
+            polledFences[polledCount] = std::move(fence);
+            polledCount++;
+        }
+
+        if (polledCount > 0) {
+            int ready;
+            do {
+                ready = poll(pollFds.data(), polledCount, 0);
+            } while (ready < 0 && errno == EINTR);
+
+            for (size_t i = 0; i < polledCount; i++) {
+                // Signaled fences are readable, errors also end up in
+                // getSignalTime() so that they are reported the same way.
+                if (ready < 0 || pollFds[i].revents != 0) {
+                    polledFenceTimes[i]->getSignalTime();
+                }
+                polledFences[i].clear();
+            }
+        }
+
+        fenceTimes += batchSize;
+        count -= batchSize;
+    }
+}
+
+sp<Fence> FenceTime::getPendingFence() const {
+    if (mSignalTime.load(std::memory_order_relaxed) != Fence::SIGNAL_TIME_PENDING) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mFence;
+}
+
 FenceTime::Snapshot FenceTime::getSnapshot() const {
     // Quick check without the lock.
     nsecs_t signalTime = mSignalTime.load(std::memory_order_relaxed);
@@ -301,29 +454,62 @@ void FenceTimeline::push(const std::shared_ptr<FenceTime>& fence) {
             // we are removing it from the timeline.
             front->getSignalTime();
         }
-        mQueue.pop();
+        mQueue.pop_front();
     }
-    mQueue.push(fence);
+    mQueue.push_back(fence);
 }
 
 void FenceTimeline::updateSignalTimes() {
-    std::lock_guard<std::mutex> lock(mMutex);
+    FenceTimeline* timeline = this;
+    updateSignalTimes(&timeline, 1);
+}
+
+void FenceTimeline::updateSignalTimes(FenceTimeline* const* timelines, size_t count) {
+    constexpr size_t kBatchSize = MAX_ENTRIES;
+    std::array<std::shared_ptr<FenceTime>, kBatchSize> batch;
+    size_t batchCount = 0;
+    auto flushBatch = [&]() {
+        FenceTime::updateSignalTimes(batch.data(), batchCount);
+        for (size_t i = 0; i < batchCount; i++) {
+            batch[i].reset();
+        }
+        batchCount = 0;
+    };
+
+    for (size_t i = 0; i < count; i++) {
+        FenceTimeline* timeline = timelines[i];
+        std::lock_guard<std::mutex> lock(timeline->mMutex);
+        for (const auto& weakFence : timeline->mQueue) {
+            std::shared_ptr<FenceTime> fence = weakFence.lock();
+            if (!fence || fence->getCachedSignalTime() != Fence::SIGNAL_TIME_PENDING) {
+                continue;
+            }
+            batch[batchCount++] = std::move(fence);
+            if (batchCount == kBatchSize) {
+                flushBatch();
+            }
+        }
+    }
+    flushBatch();
+
+    for (size_t i = 0; i < count; i++) {
+        FenceTimeline* timeline = timelines[i];
+        std::lock_guard<std::mutex> lock(timeline->mMutex);
+        timeline->popSignaledLocked();
+    }
+}
+
+void FenceTimeline::popSignaledLocked() {
     while (!mQueue.empty()) {
         std::shared_ptr<FenceTime> fence = mQueue.front().lock();
-        if (!fence) {
-            // The shared_ptr no longer exists and no one cares about the
-            // timestamp anymore.
-            mQueue.pop();
-            continue;
-        } else if (fence->getSignalTime() != Fence::SIGNAL_TIME_PENDING) {
-            // The fence has signaled and we've removed the sp<Fence> ref.
-            mQueue.pop();
-            continue;
-        } else {
-            // The fence didn't signal yet. Break since the later ones
+        if (fence && fence->getCachedSignalTime() == Fence::SIGNAL_TIME_PENDING) {
+            // The fence didn't signal yet. Stop since the later ones
             // shouldn't have signaled either.
             break;
         }
+        // Either no one cares about the timestamp anymore, or the fence
+        // has signaled and we've removed the sp<Fence> ref.
+        mQueue.pop_front();
     }
 }
 
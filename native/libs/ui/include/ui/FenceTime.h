@@ -23,9 +23,11 @@
 #include <utils/Timers.h>
 
 #include <atomic>
+#include <deque>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <unordered_map>
+#include <vector>
 
 namespace android {
 
@@ -87,6 +89,12 @@ public:
     // with Fence::SIGNAL_TIME_INVALID instead.
     FenceTime() = delete;
 
+    // Same as std::make_shared<FenceTime>, but the memory is recycled from
+    // FenceTimes that were released before. Meant for the FenceTimes that are
+    // created and dropped every frame.
+    static std::shared_ptr<FenceTime> create(const sp<Fence>& fence);
+    static std::shared_ptr<FenceTime> create(nsecs_t signalTime);
+
     // Do not allow copy, assign, or move. Use a shared_ptr to share the
     // signalTime result. Or use getSnapshot() if a thread-safe copy is really
     // needed.
@@ -109,6 +117,11 @@ public:
     // Gets the cached timestamp without attempting to query the Fence.
     nsecs_t getCachedSignalTime() const;
 
+    // Same as calling getSignalTime() on each of the FenceTimes, but a single
+    // poll() finds out which of the pending fences have signaled so that only
+    // those are queried for their timestamp.
+    static void updateSignalTimes(const std::shared_ptr<FenceTime>* fenceTimes, size_t count);
+
     // Returns a snapshot of the FenceTime in its current state.
     Snapshot getSnapshot() const;
 
@@ -126,6 +139,9 @@ private:
     // never return SIGNAL_TIME_INVALID and isValid will always return true.
     FenceTime(const sp<Fence>& fence, bool forceValidForTest);
 
+    // Returns the fence if the signal time is still pending, nullptr otherwise.
+    sp<Fence> getPendingFence() const;
+
     enum class State {
         VALID,
         INVALID,
@@ -165,9 +181,15 @@ public:
     void push(const std::shared_ptr<FenceTime>& fence);
     void updateSignalTimes();
 
+    // Same as calling updateSignalTimes() on each of the timelines, with a
+    // single poll() for all of their pending fences.
+    static void updateSignalTimes(FenceTimeline* const* timelines, size_t count);
+
 private:
+    void popSignaledLocked() REQUIRES(mMutex);
+
     mutable std::mutex mMutex;
-    std::queue<std::weak_ptr<FenceTime>> mQueue GUARDED_BY(mMutex);
+    std::deque<std::weak_ptr<FenceTime>> mQueue GUARDED_BY(mMutex);
 };
 
 // Used by test code to create or get FenceTimes for a given Fence.
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <sys/eventfd.h>
+#include <ui/FenceTime.h>
+
+#include <memory>
+#include <vector>
+
+// Compares polling pending fences one at a time with FenceTime::updateSignalTimes(). Creating
+// sync files needs sw_sync, so eventfds stand in for them: they poll the same way, and stay
+// pending since nothing writes to them. Polling one fence is cheaper than the sync_file_info()
+// that getSignalTime() does, so the per-fence numbers are a lower bound.
+
+namespace android {
+namespace {
+
+std::vector<std::shared_ptr<FenceTime>> createPendingFenceTimes(size_t count) {
+    std::vector<std::shared_ptr<FenceTime>> fenceTimes;
+    for (size_t i = 0; i < count; i++) {
+        fenceTimes.push_back(
+                FenceTime::create(sp<Fence>::make(base::unique_fd(eventfd(0, EFD_CLOEXEC)))));
+    }
+    return fenceTimes;
+}
+
+void BM_PollFencesIndividually(benchmark::State& state) {
+    std::vector<sp<Fence>> fences;
+    for (const auto& fenceTime : createPendingFenceTimes(static_cast<size_t>(state.range(0)))) {
+        fences.push_back(fenceTime->getSnapshot().fence);
+    }
+    for (auto _ : state) {
+        for (const sp<Fence>& fence : fences) {
+            benchmark::DoNotOptimize(fence->getStatus());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PollFencesIndividually)->Arg(4)->Arg(16)->Arg(64);
+
+void BM_UpdateSignalTimesBatched(benchmark::State& state) {
+    auto fenceTimes = createPendingFenceTimes(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        FenceTime::updateSignalTimes(fenceTimes.data(), fenceTimes.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UpdateSignalTimesBatched)->Arg(4)->Arg(16)->Arg(64);
+
+void BM_MakeSharedFenceTime(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(std::make_shared<FenceTime>(Fence::NO_FENCE));
+    }
+}
+BENCHMARK(BM_MakeSharedFenceTime);
+
+void BM_CreatePooledFenceTime(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(FenceTime::create(Fence::NO_FENCE));
+    }
+}
+BENCHMARK(BM_CreatePooledFenceTime);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ui/FenceTime.h>
+#include <ui/MockFence.h>
+
+#include <gtest/gtest.h>
+#include <sys/eventfd.h>
+
+#include <vector>
+
+namespace android::ui {
+
+using testing::Return;
+
+// Eventfds stand in for sync files: they poll as readable once written to.
+sp<Fence> createEventFence(base::unique_fd* outEventFd) {
+    outEventFd->reset(eventfd(0, EFD_CLOEXEC));
+    return sp<Fence>::make(base::unique_fd(dup(outEventFd->get())));
+}
+
+void signalEventFence(const base::unique_fd& eventFd) {
+    eventfd_write(eventFd.get(), 1);
+}
+
+TEST(FenceTimeTest, createKeepsSignalTime) {
+    std::shared_ptr<FenceTime> fenceTime = FenceTime::create(1234);
+    EXPECT_TRUE(fenceTime->isValid());
+    EXPECT_EQ(1234, fenceTime->getSignalTime());
+
+    fenceTime = FenceTime::create(Fence::NO_FENCE);
+    EXPECT_FALSE(fenceTime->isValid());
+    EXPECT_EQ(Fence::SIGNAL_TIME_INVALID, fenceTime->getSignalTime());
+}
+
+TEST(FenceTimeTest, updateSignalTimesOnlyQueriesSignaledFences) {
+    base::unique_fd pendingEventFd;
+    base::unique_fd signaledEventFd;
+    std::vector<std::shared_ptr<FenceTime>> fenceTimes = {
+            FenceTime::create(createEventFence(&pendingEventFd)),
+            FenceTime::create(createEventFence(&signaledEventFd)),
+    };
+    signalEventFence(signaledEventFd);
+
+    FenceTime::updateSignalTimes(fenceTimes.data(), fenceTimes.size());
+
+    // The pending fence was never asked for its signal time. The signaled one was, an eventfd
+    // has no timestamp to give so it resolves to invalid.
+    EXPECT_EQ(Fence::SIGNAL_TIME_PENDING, fenceTimes[0]->getCachedSignalTime());
+    EXPECT_EQ(Fence::SIGNAL_TIME_INVALID, fenceTimes[1]->getCachedSignalTime());
+}
+
+TEST(FenceTimeTest, updateSignalTimesQueriesFencesWithoutFd) {
+    sp<mock::MockFence> mockFence = sp<mock::MockFence>::make();
+    std::vector<std::shared_ptr<FenceTime>> fenceTimes = {FenceTime::create(1234)};
+    FenceToFenceTimeMap fenceMap;
+    fenceTimes.push_back(fenceMap.createFenceTimeForTest(mockFence));
+
+    EXPECT_CALL(*mockFence, getSignalTime).WillOnce(Return(5678));
+    FenceTime::updateSignalTimes(fenceTimes.data(), fenceTimes.size());
+
+    EXPECT_EQ(1234, fenceTimes[0]->getCachedSignalTime());
+    EXPECT_EQ(5678, fenceTimes[1]->getCachedSignalTime());
+}
+
+TEST(FenceTimelineTest, updateSignalTimesAcrossTimelines) {
+    base::unique_fd eventFds[3];
+    std::shared_ptr<FenceTime> first = FenceTime::create(createEventFence(&eventFds[0]));
+    std::shared_ptr<FenceTime> second = FenceTime::create(createEventFence(&eventFds[1]));
+    std::shared_ptr<FenceTime> other = FenceTime::create(createEventFence(&eventFds[2]));
+
+    FenceTimeline timeline;
+    timeline.push(first);
+    timeline.push(second);
+    FenceTimeline otherTimeline;
+    otherTimeline.push(other);
+
+    signalEventFence(eventFds[0]);
+    signalEventFence(eventFds[2]);
+    FenceTimeline* timelines[] = {&timeline, &otherTimeline};
+    FenceTimeline::updateSignalTimes(timelines, std::size(timelines));
+
+    EXPECT_NE(Fence::SIGNAL_TIME_PENDING, first->getCachedSignalTime());
+    EXPECT_EQ(Fence::SIGNAL_TIME_PENDING, second->getCachedSignalTime());
+    EXPECT_NE(Fence::SIGNAL_TIME_PENDING, other->getCachedSignalTime());
+
+    // The timeline still tracks the pending fence.
+    signalEventFence(eventFds[1]);
+    timeline.updateSignalTimes();
+    EXPECT_NE(Fence::SIGNAL_TIME_PENDING, second->getCachedSignalTime());
+}
+
+} // namespace android::ui